@@ -11,12 +11,41 @@ TEMPLATE = app
 
 SOURCES += main.cpp
 
+HEADERS += descriptorallocator.h \
+    appconfig.h \
+    assetarchive.h \
+    bcencoder.h \
+    benchmarkreport.h \
+    colorspace.h \
+    deletionqueue.h \
+    framepacer.h \
+    framestats.h \
+    gpuprofiler.h \
+    imagekernels.h \
+    imagewriter.h \
+    jobbenchmark.h \
+    jobsystem.h \
+    kernelbenchmark.h \
+    ktx2.h \
+    mappedfile.h \
+    meshchunks.h \
+    meshcooker.h \
+    resolutionscaler.h \
+    texturecooker.h \
+    texturestreaming.h \
+    tracer.h \
+    virtualtexture.h \
+    virtualtexturecooker.h \
+    workerpool.h
+
 GLM_DIR = F:/opengl/glm-0.9.9.4/qt5.6/lib-release
 GLFW_DIR = F:/opengl/glfw-3.2.1/qt5.6/lib-release
 VulKan_LIB_DIR = D:/VulkanSDK/1.1.77.0/Source/lib32
 VulKan_DIR = D:/VulkanSDK/1.1.77.0/
 Stb_DIR = F:/vulkan/stb
 ObjLoader_DIR = F:/vulkan/tinyobjloader
+#资源包使用 zstd 压缩时需要 libzstd
+#Zstd_DIR = F:/vulkan/zstd
 
 INCLUDEPATH += $${GLM_DIR}/include
 INCLUDEPATH += $${GLFW_DIR}/include
@@ -30,3 +59,6 @@ LIBS += -L$${GLFW_DIR}/lib/ -lglfw3
 LIBS += -L$${VulKan_LIB_DIR}/ \
         libvulkan-1
 
+#DEFINES += VULKANLEARN_ZSTD
+#INCLUDEPATH += $${Zstd_DIR}/include
+#LIBS += -L$${Zstd_DIR}/lib/ -lzstd
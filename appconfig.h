@@ -0,0 +1,252 @@
+#ifndef APPCONFIG_H
+#define APPCONFIG_H
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+
+//同时处理的帧数的上限,实际使用的帧数由 AppConfig::framesInFlight 指定
+const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+//在 GPU 上生成细化链的方式
+enum class MipGenMode{
+    Auto,
+    Blit,
+    Compute,
+    Compare
+};
+
+/**
+  运行参数,由命令行解析得到:
+  --frames-in-flight <1-4>   同时处理的帧数,默认 2
+  --sync <timeline|binary>   帧同步方式,默认支持时使用时间线信号量
+  --frame-bench [frames]     依次测试各种同步方式和帧数的延迟与吞吐量
+  --present-mode <auto|fifo|mailbox|immediate>
+                             呈现模式,默认 auto(优先 mailbox,其次 immediate,最后 fifo)
+  --pace-fps <fps>           读取输入前睡眠,把帧率限制到 fps 以降低延迟,
+                             0 表示不限制,默认 fifo 模式下使用显示器刷新率
+  --serial-init              在主线程上依次加载纹理和模型,用于比较并行启动的效果
+  --headless [frames]        不创建窗口和表面,渲染到离屏图像,默认绘制 60 帧
+  --width <w> --height <h>   无窗口模式下离屏图像的大小,默认 800x600
+  --readback <dir>           把每一帧读回并保存到已经存在的目录 dir 中
+  --readback-format <png|exr>
+                             读回帧的文件格式,默认 png
+  --readback-threads <n>     编码保存文件的工作线程数,默认 0 表示使用硬件线程数
+  --benchmark [frames]       沿固定的相机路径以固定时间步长绘制 frames 帧(默认 600),
+                             输出 CPU/GPU 时间统计的 JSON 报告
+  --benchmark-warmup <n>     基准测试开始统计前绘制的帧数,默认 60
+  --benchmark-out <file>     JSON 报告写入的文件,默认输出到标准输出
+  --gpu-profile-log <file>   把每一帧各个范围的 GPU 时间写入 CSV 文件
+  --trace <file>             记录启动和每一帧的 CPU/GPU 时间线,退出时写入 Chrome trace 文件
+  --mesh <file>              流式加载 --cook-mesh 生成的分块网格文件,代替 OBJ 模型
+  --stream-budget <KB>       每一帧上传网格数据块的暂存空间大小,默认 4096
+  --archive <file>           从 --pack-archive 生成的资源包读取着色器,纹理和模型,
+                             资源包中没有的文件仍从磁盘读取
+  --virtual-texture <file>   使用 --cook-vt 生成的虚拟纹理代替模型纹理,只加载被采样的页
+  --vt-cache <pages>         虚拟纹理物理缓存每边的页数,默认 16
+  --vt-uploads <pages>       每一帧最多加载的虚拟纹理页数,默认 16
+  --texture-budget <KB>      按细化级别流式加载模型纹理,驻留的级别不超过这一显存预算,
+                             先显示最小的几级,再按屏幕上的大小逐级提高,默认 0 表示一次全部加载
+  --mipgen <auto|blit|compute|compare>
+                             在 GPU 上生成纹理细化链的方式:blit 为逐级 vkCmdBlitImage,
+                             compute 为一次计算着色器调度(在线性空间求平均,不需要格式支持线性 blit),
+                             compare 使用 compute 并在启动时比较两种方式生成 4096x4096 RGBA8 纹理的 GPU 时间,
+                             再用 2048x2048 RGBA32F 纹理(不保证支持线性 blit)检查计算着色器的结果,
+                             默认 auto 优先 blit,格式不支持时使用 compute
+  --msaa <1|2|4|8>           多重采样的采样数,超过设备同时支持的颜色和深度附着采样数时
+                             使用支持的最大值,默认 1 表示不使用多重采样
+  --dynamic-res <us>         动态分辨率:按测得的 GPU 帧时间每帧调整内部渲染目标的缩放比例,
+                             使 GPU 时间接近目标 us 微秒,再双线性放大到交换链图像,
+                             默认 0 表示按交换链图像的大小渲染
+  --res-scale-min <percent>  动态分辨率每个方向的最小缩放比例,默认 50
+  */
+struct AppConfig{
+    uint32_t framesInFlight = 2;
+    bool useTimelineSemaphore = true;
+    uint32_t frameBenchFrames = 0;//大于 0 时运行帧同步基准测试,每种设置绘制的帧数
+    bool autoPresentMode = true;//为 false 时使用 presentMode
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    int paceFps = -1;//小于 0 表示自动选择
+    bool serialInit = false;//为 true 时不在工作线程上加载资源
+    bool headless = false;//不使用 GLFW 窗口,表面和交换链
+    uint32_t headlessFrames = 60;//无窗口模式下绘制的帧数
+    uint32_t width = 800;
+    uint32_t height = 600;
+    std::string readbackDir;//为空时不读回
+    std::string readbackFormat = "png";
+    uint32_t readbackThreads = 0;
+    uint32_t benchmarkFrames = 0;//大于 0 时运行基准测试
+    uint32_t benchmarkWarmup = 60;
+    std::string benchmarkOut;//为空时输出到标准输出
+    std::string gpuProfileLog;//为空时不写日志
+    std::string traceFile;//为空时不记录时间线
+    std::string meshFile;//为空时一次性加载 OBJ 模型
+    uint32_t meshStreamBudgetKb = 4096;
+    std::string archiveFile;//为空时从单独的文件读取资源
+    std::string virtualTextureFile;//为空时不使用虚拟纹理
+    uint32_t virtualCachePages = 16;
+    uint32_t virtualUploadsPerFrame = 16;
+    uint32_t textureBudgetKb = 0;//为 0 时不流式加载纹理
+    MipGenMode mipgen = MipGenMode::Auto;
+    uint32_t msaaSamples = 1;
+    uint32_t dynamicResTargetUs = 0;//为 0 时不使用动态分辨率
+    uint32_t resScaleMinPercent = 50;
+};
+
+//呈现模式的名称,用于命令行和输出
+inline const char* presentModeName(VkPresentModeKHR mode){
+    switch(mode){
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+    default: return "unknown";
+    }
+}
+
+//解析一个非负整数参数,超出 [minValue,maxValue] 时抛出异常
+inline uint32_t parseUintArgument(const std::string& option,
+                                  const std::string& value,
+                                  uint32_t minValue,uint32_t maxValue){
+    char* end = nullptr;
+    unsigned long v = std::strtoul(value.c_str(),&end,10);
+    if(value.empty() || *end != '\0' || v < minValue || v > maxValue){
+        throw std::runtime_error("invalid value for " + option + ": " + value +
+                                 " (expected " + std::to_string(minValue) +
+                                 "-" + std::to_string(maxValue) + ")");
+    }
+    return static_cast<uint32_t>(v);
+}
+
+inline AppConfig parseAppConfig(int argc,char* argv[]){
+    AppConfig config;
+    for(int i = 1;i < argc;i++){
+        std::string arg = argv[i];
+        //取得选项后面的参数,没有时抛出异常
+        auto nextValue = [&](){
+            if(i + 1 >= argc){
+                throw std::runtime_error("missing value for " + arg);
+            }
+            return std::string(argv[++i]);
+        };
+        if(arg == "--frames-in-flight"){
+            config.framesInFlight = parseUintArgument(
+                        arg,nextValue(),1,MAX_FRAMES_IN_FLIGHT);
+        }else if(arg == "--sync"){
+            std::string mode = nextValue();
+            if(mode == "timeline"){
+                config.useTimelineSemaphore = true;
+            }else if(mode == "binary"){
+                config.useTimelineSemaphore = false;
+            }else{
+                throw std::runtime_error("invalid value for --sync: " + mode +
+                                         " (expected timeline or binary)");
+            }
+        }else if(arg == "--frame-bench"){
+            config.frameBenchFrames = 300;
+            //帧数是可选的
+            if(i + 1 < argc && argv[i + 1][0] != '-'){
+                config.frameBenchFrames = parseUintArgument(
+                            arg,argv[++i],1,1000000);
+            }
+        }else if(arg == "--present-mode"){
+            std::string mode = nextValue();
+            config.autoPresentMode = mode == "auto";
+            if(mode == "fifo"){
+                config.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            }else if(mode == "mailbox"){
+                config.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            }else if(mode == "immediate"){
+                config.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            }else if(mode != "auto"){
+                throw std::runtime_error("invalid value for --present-mode: " +
+                        mode + " (expected auto, fifo, mailbox or immediate)");
+            }
+        }else if(arg == "--pace-fps"){
+            config.paceFps = static_cast<int>(
+                        parseUintArgument(arg,nextValue(),0,1000));
+        }else if(arg == "--serial-init"){
+            config.serialInit = true;
+        }else if(arg == "--headless"){
+            config.headless = true;
+            if(i + 1 < argc && argv[i + 1][0] != '-'){
+                config.headlessFrames = parseUintArgument(
+                            arg,argv[++i],1,1000000);
+            }
+        }else if(arg == "--width"){
+            config.width = parseUintArgument(arg,nextValue(),1,16384);
+        }else if(arg == "--height"){
+            config.height = parseUintArgument(arg,nextValue(),1,16384);
+        }else if(arg == "--readback"){
+            config.readbackDir = nextValue();
+        }else if(arg == "--readback-format"){
+            config.readbackFormat = nextValue();
+            if(config.readbackFormat != "png" && config.readbackFormat != "exr"){
+                throw std::runtime_error("invalid value for --readback-format: " +
+                        config.readbackFormat + " (expected png or exr)");
+            }
+        }else if(arg == "--readback-threads"){
+            config.readbackThreads = parseUintArgument(arg,nextValue(),0,256);
+        }else if(arg == "--benchmark"){
+            config.benchmarkFrames = 600;
+            if(i + 1 < argc && argv[i + 1][0] != '-'){
+                config.benchmarkFrames = parseUintArgument(
+                            arg,argv[++i],1,1000000);
+            }
+        }else if(arg == "--benchmark-warmup"){
+            config.benchmarkWarmup = parseUintArgument(arg,nextValue(),0,100000);
+        }else if(arg == "--benchmark-out"){
+            config.benchmarkOut = nextValue();
+        }else if(arg == "--gpu-profile-log"){
+            config.gpuProfileLog = nextValue();
+        }else if(arg == "--trace"){
+            config.traceFile = nextValue();
+        }else if(arg == "--mesh"){
+            config.meshFile = nextValue();
+        }else if(arg == "--stream-budget"){
+            config.meshStreamBudgetKb = parseUintArgument(arg,nextValue(),64,1048576);
+        }else if(arg == "--archive"){
+            config.archiveFile = nextValue();
+        }else if(arg == "--virtual-texture"){
+            config.virtualTextureFile = nextValue();
+        }else if(arg == "--vt-cache"){
+            config.virtualCachePages = parseUintArgument(arg,nextValue(),2,255);
+        }else if(arg == "--vt-uploads"){
+            config.virtualUploadsPerFrame = parseUintArgument(arg,nextValue(),1,1024);
+        }else if(arg == "--texture-budget"){
+            config.textureBudgetKb = parseUintArgument(arg,nextValue(),1,16777216);
+        }else if(arg == "--mipgen"){
+            std::string mode = nextValue();
+            if(mode == "auto"){
+                config.mipgen = MipGenMode::Auto;
+            }else if(mode == "blit"){
+                config.mipgen = MipGenMode::Blit;
+            }else if(mode == "compute"){
+                config.mipgen = MipGenMode::Compute;
+            }else if(mode == "compare"){
+                config.mipgen = MipGenMode::Compare;
+            }else{
+                throw std::runtime_error("invalid value for --mipgen: " + mode +
+                                         " (expected auto, blit, compute or compare)");
+            }
+        }else if(arg == "--msaa"){
+            std::string samples = nextValue();
+            if(samples != "1" && samples != "2" && samples != "4" && samples != "8"){
+                throw std::runtime_error("invalid value for --msaa: " + samples +
+                                         " (expected 1, 2, 4 or 8)");
+            }
+            config.msaaSamples = parseUintArgument(arg,samples,1,8);
+        }else if(arg == "--dynamic-res"){
+            config.dynamicResTargetUs = parseUintArgument(arg,nextValue(),100,1000000);
+        }else if(arg == "--res-scale-min"){
+            config.resScaleMinPercent = parseUintArgument(arg,nextValue(),10,100);
+        }else{
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+    return config;
+}
+
+#endif // APPCONFIG_H
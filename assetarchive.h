@@ -0,0 +1,581 @@
+#ifndef ASSETARCHIVE_H
+#define ASSETARCHIVE_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+#ifdef VULKANLEARN_ZSTD
+#include <zstd.h>
+#endif
+
+#include "mappedfile.h"
+#include "jobsystem.h"
+
+/**
+  LZ4 块格式的压缩和解压.
+  数据由若干序列组成:标记字节(高 4 位为字面量长度,低 4 位为匹配长度减 4,
+  取 15 时后面跟着扩展长度字节),字面量,2 字节小端序的匹配偏移,扩展的匹配长度.
+  最后一个序列只有字面量;最后 5 个字节必须是字面量,最后一个匹配必须在结尾 12 字节之前开始.
+  这里的压缩器是单趟的贪心匹配,解压时检查所有越界情况,损坏的数据返回 false
+  */
+namespace lz4 {
+
+inline uint32_t read32(const unsigned char* p){
+    uint32_t v;
+    std::memcpy(&v,p,sizeof(v));
+    return v;
+}
+
+inline void writeLength(std::vector<unsigned char>& out,size_t length){
+    while(length >= 255){
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<unsigned char>(length));
+}
+
+inline void writeSequence(std::vector<unsigned char>& out,
+                          const unsigned char* literals,size_t literalLength,
+                          size_t offset,size_t matchLength){
+    unsigned char token = static_cast<unsigned char>(
+                std::min<size_t>(literalLength,15) << 4);
+    if(matchLength > 0){
+        token |= static_cast<unsigned char>(std::min<size_t>(matchLength - 4,15));
+    }
+    out.push_back(token);
+    if(literalLength >= 15){
+        writeLength(out,literalLength - 15);
+    }
+    out.insert(out.end(),literals,literals + literalLength);
+    if(matchLength > 0){
+        out.push_back(static_cast<unsigned char>(offset));
+        out.push_back(static_cast<unsigned char>(offset >> 8));
+        if(matchLength - 4 >= 15){
+            writeLength(out,matchLength - 4 - 15);
+        }
+    }
+}
+
+//压缩 src 追加到 out
+inline void compress(const unsigned char* src,size_t size,
+                     std::vector<unsigned char>& out){
+    const int hashBits = 14;
+    std::vector<int64_t> table(size_t(1) << hashBits,-1);
+    size_t anchor = 0;
+    size_t i = 0;
+    const size_t matchStartLimit = size > 12 ? size - 12 : 0;
+    const size_t matchEndLimit = size > 5 ? size - 5 : 0;
+    while(i < matchStartLimit){
+        uint32_t sequence = read32(src + i);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+        int64_t candidate = table[hash];
+        table[hash] = static_cast<int64_t>(i);
+        if(candidate >= 0 && i - size_t(candidate) <= 65535 &&
+                read32(src + candidate) == sequence){
+            size_t length = 4;
+            while(i + length < matchEndLimit &&
+                  src[candidate + length] == src[i + length]){
+                length++;
+            }
+            writeSequence(out,src + anchor,i - anchor,i - size_t(candidate),length);
+            i += length;
+            anchor = i;
+        }else{
+            i++;
+        }
+    }
+    writeSequence(out,src + anchor,size - anchor,0,0);
+}
+
+//解压到 dst,解压后的大小必须正好是 dstSize
+inline bool decompress(const unsigned char* src,size_t srcSize,
+                       unsigned char* dst,size_t dstSize){
+    const unsigned char* ip = src;
+    const unsigned char* const ipEnd = src + srcSize;
+    unsigned char* op = dst;
+    unsigned char* const opEnd = dst + dstSize;
+    auto readLength = [&](size_t& length){
+        unsigned char byte;
+        do{
+            if(ip >= ipEnd){
+                return false;
+            }
+            byte = *ip++;
+            length += byte;
+        }while(byte == 255);
+        return true;
+    };
+    while(ip < ipEnd){
+        unsigned char token = *ip++;
+        size_t literalLength = token >> 4;
+        if(literalLength == 15 && !readLength(literalLength)){
+            return false;
+        }
+        if(literalLength > size_t(ipEnd - ip) || literalLength > size_t(opEnd - op)){
+            return false;
+        }
+        if(literalLength > 0){
+            std::memcpy(op,ip,literalLength);
+        }
+        ip += literalLength;
+        op += literalLength;
+        if(ip == ipEnd){
+            break;//最后一个序列没有匹配
+        }
+        if(ipEnd - ip < 2){
+            return false;
+        }
+        size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+        ip += 2;
+        if(offset == 0 || offset > size_t(op - dst)){
+            return false;
+        }
+        size_t matchLength = token & 15;
+        if(matchLength == 15 && !readLength(matchLength)){
+            return false;
+        }
+        matchLength += 4;
+        if(matchLength > size_t(opEnd - op)){
+            return false;
+        }
+        const unsigned char* match = op - offset;
+        if(offset >= matchLength){
+            std::memcpy(op,match,matchLength);
+            op += matchLength;
+        }else{
+            //重叠的匹配逐字节复制,重复最近的数据
+            for(size_t k = 0;k < matchLength;k++){
+                *op++ = *match++;
+            }
+        }
+    }
+    return op == opEnd;
+}
+
+} // namespace lz4
+
+//资源包中数据的压缩方式
+enum class AssetCodec : uint32_t{
+    None = 0,
+    Lz4 = 1,
+    Zstd = 2
+};
+
+inline AssetCodec parseAssetCodec(const std::string& name){
+    if(name == "none"){
+        return AssetCodec::None;
+    }else if(name == "lz4"){
+        return AssetCodec::Lz4;
+    }else if(name == "zstd"){
+#ifdef VULKANLEARN_ZSTD
+        return AssetCodec::Zstd;
+#else
+        throw std::runtime_error("zstd support is not compiled in "
+                                 "(define VULKANLEARN_ZSTD and link libzstd)");
+#endif
+    }
+    throw std::runtime_error("unsupported codec: " + name +
+                             " (expected none, lz4 or zstd)");
+}
+
+inline const char* assetCodecName(AssetCodec codec){
+    switch(codec){
+    case AssetCodec::None: return "none";
+    case AssetCodec::Lz4: return "lz4";
+    case AssetCodec::Zstd: return "zstd";
+    }
+    return "unknown";
+}
+
+namespace archive {
+
+const char MAGIC[4] = {'V','L','P','K'};
+const uint32_t VERSION = 1;
+const uint64_t ALIGNMENT = 4096;//每个数据块在文件中的对齐,与页大小一致
+const uint32_t BLOCK_SIZE = 256 * 1024;//压缩时每一块的原始大小,各块可以并行解压
+const uint32_t STORED_BLOCK = 0x80000000u;//块大小的最高位:这一块没有压缩
+const size_t HEADER_SIZE = 4 + 4 + 4 + 4 + 8 + 8;
+
+//资源名的 64 位 FNV-1a 哈希
+inline uint64_t hashName(const std::string& name){
+    uint64_t hash = 14695981039346656037ull;
+    for(unsigned char c : name){
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline void put32(std::vector<unsigned char>& out,uint32_t v){
+    for(int i = 0;i < 4;i++){
+        out.push_back(static_cast<unsigned char>(v >> (8 * i)));
+    }
+}
+inline void put64(std::vector<unsigned char>& out,uint64_t v){
+    put32(out,static_cast<uint32_t>(v));
+    put32(out,static_cast<uint32_t>(v >> 32));
+}
+inline uint32_t get32(const unsigned char* p){
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) |
+            (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+inline uint64_t get64(const unsigned char* p){
+    return uint64_t(get32(p)) | (uint64_t(get32(p + 4)) << 32);
+}
+
+//压缩一块,没有变小时返回 false
+inline bool compressBlock(AssetCodec codec,const unsigned char* src,size_t size,
+                          std::vector<unsigned char>& out){
+    size_t start = out.size();
+    if(codec == AssetCodec::Lz4){
+        lz4::compress(src,size,out);
+    }
+#ifdef VULKANLEARN_ZSTD
+    else if(codec == AssetCodec::Zstd){
+        size_t bound = ZSTD_compressBound(size);
+        out.resize(start + bound);
+        size_t written = ZSTD_compress(out.data() + start,bound,src,size,9);
+        if(ZSTD_isError(written)){
+            throw std::runtime_error(std::string("zstd: ") +
+                                     ZSTD_getErrorName(written));
+        }
+        out.resize(start + written);
+    }
+#endif
+    if(out.size() - start >= size){
+        out.resize(start);
+        return false;
+    }
+    return true;
+}
+
+inline bool decompressBlock(AssetCodec codec,const unsigned char* src,
+                            size_t srcSize,unsigned char* dst,size_t dstSize){
+    if(codec == AssetCodec::Lz4){
+        return lz4::decompress(src,srcSize,dst,dstSize);
+    }
+#ifdef VULKANLEARN_ZSTD
+    if(codec == AssetCodec::Zstd){
+        size_t written = ZSTD_decompress(dst,dstSize,src,srcSize);
+        return !ZSTD_isError(written) && written == dstSize;
+    }
+#endif
+    return false;
+}
+
+} // namespace archive
+
+/**
+  资源包:把网格,纹理和着色器等文件打包成一个文件,启动时只打开一次并映射.
+  文件结构(小端序):
+  1. 文件头:魔数 "VLPK",版本,资源个数,压缩块大小,目录的偏移和大小,补齐到 4096 字节
+  2. 各个资源的数据,起始位置按 4096 字节对齐.
+     不压缩的资源直接存放原始数据,可以从映射中直接使用(例如流式读取的分块网格);
+     压缩的资源按 BLOCK_SIZE 分块独立压缩,开头是每一块压缩后的大小,
+     最高位为 1 表示这一块没有变小而直接存放,然后依次是各块的数据
+  3. 目录:按名称哈希排序,每一项为哈希,偏移,存放的大小,原始大小,压缩方式,
+     名称长度和名称,查找时二分查找哈希再比较名称
+  */
+class AssetArchive{
+public:
+    struct Entry{
+        std::string name;
+        uint64_t hash = 0;
+        uint64_t offset = 0;
+        uint64_t storedSize = 0;
+        uint64_t size = 0;
+        AssetCodec codec = AssetCodec::None;
+    };
+
+    void open(const std::string& filename){
+        using namespace archive;
+        file.open(filename);
+        const unsigned char* p = file.data();
+        if(file.size() < HEADER_SIZE || std::memcmp(p,MAGIC,4) != 0 ||
+                get32(p + 4) != VERSION){
+            throw std::runtime_error("not an asset archive: " + filename);
+        }
+        uint32_t count = get32(p + 8);
+        blockSize = get32(p + 12);
+        uint64_t tocOffset = get64(p + 16);
+        uint64_t tocSize = get64(p + 24);
+        if(blockSize == 0 || tocOffset > file.size() ||
+                tocSize > file.size() - tocOffset){
+            throw std::runtime_error("corrupt asset archive: " + filename);
+        }
+        const unsigned char* toc = p + tocOffset;
+        const unsigned char* tocEnd = toc + tocSize;
+        entries.clear();
+        entries.reserve(count);
+        for(uint32_t i = 0;i < count;i++){
+            if(tocEnd - toc < 40){
+                throw std::runtime_error("corrupt asset archive: " + filename);
+            }
+            Entry entry;
+            entry.hash = get64(toc);
+            entry.offset = get64(toc + 8);
+            entry.storedSize = get64(toc + 16);
+            entry.size = get64(toc + 24);
+            entry.codec = static_cast<AssetCodec>(get32(toc + 32));
+            uint32_t nameLength = get32(toc + 36);
+            toc += 40;
+            //不压缩的资源直接从映射中读取 size 字节,存放的大小必须相同
+            if(uint64_t(tocEnd - toc) < nameLength ||
+                    entry.offset > file.size() ||
+                    entry.storedSize > file.size() - entry.offset ||
+                    (entry.codec == AssetCodec::None &&
+                     entry.storedSize != entry.size)){
+                throw std::runtime_error("corrupt asset archive: " + filename);
+            }
+            entry.name.assign(reinterpret_cast<const char*>(toc),nameLength);
+            toc += nameLength;
+            entries.push_back(entry);
+        }
+    }
+    bool isOpen() const { return file.isOpen(); }
+    const std::vector<Entry>& list() const { return entries; }
+
+    //按名称查找,没有时返回 nullptr
+    const Entry* find(const std::string& name) const {
+        uint64_t hash = archive::hashName(name);
+        auto it = std::lower_bound(entries.begin(),entries.end(),hash,
+                                   [](const Entry& e,uint64_t h){ return e.hash < h; });
+        for(;it != entries.end() && it->hash == hash;++it){
+            if(it->name == name){
+                return &*it;
+            }
+        }
+        return nullptr;
+    }
+    //不压缩的资源在映射中的数据,压缩的资源返回 nullptr
+    const unsigned char* storedData(const Entry& entry) const {
+        return entry.codec == AssetCodec::None ? file.data() + entry.offset : nullptr;
+    }
+    /**
+    把资源解压到 dst(至少 entry.size 字节),例如直接写入映射的暂存缓冲.
+    jobs 不为空时各块在任务调度器上并行解压
+      */
+    void read(const Entry& entry,void* dst,JobSystem* jobs = nullptr) const {
+        unsigned char* out = static_cast<unsigned char*>(dst);
+        if(entry.codec == AssetCodec::None){
+            if(entry.size > 0){
+                std::memcpy(out,file.data() + entry.offset,
+                            static_cast<size_t>(entry.size));
+            }
+            return;
+        }
+        std::vector<uint64_t> offsets = blockOffsets(entry);
+        size_t blockCount = offsets.size() - 1;
+        std::atomic<bool> failed(false);
+        auto decodeBlocks = [&](size_t first,size_t last){
+            for(size_t i = first;i < last;i++){
+                if(!decodeBlock(entry,offsets,i,out + i * blockSize)){
+                    failed = true;
+                }
+            }
+        };
+        if(jobs != nullptr && blockCount > 1){
+            jobs->parallelFor(0,blockCount,1,decodeBlocks);
+        }else{
+            decodeBlocks(0,blockCount);
+        }
+        if(failed){
+            throw std::runtime_error("corrupt asset: " + entry.name);
+        }
+    }
+    /**
+    只读取资源开头的 size 字节(例如文件头),压缩的资源只解压第一块.
+    返回读取的字节数,资源比 size 小时读取整个资源
+      */
+    size_t readPrefix(const Entry& entry,void* dst,size_t size) const {
+        size = static_cast<size_t>(std::min<uint64_t>(size,entry.size));
+        if(size == 0){
+            return 0;
+        }
+        if(entry.codec == AssetCodec::None){
+            std::memcpy(dst,file.data() + entry.offset,size);
+            return size;
+        }
+        std::vector<uint64_t> offsets = blockOffsets(entry);
+        std::vector<unsigned char> block(static_cast<size_t>(
+                                             std::min<uint64_t>(blockSize,entry.size)));
+        if(!decodeBlock(entry,offsets,0,block.data())){
+            throw std::runtime_error("corrupt asset: " + entry.name);
+        }
+        std::memcpy(dst,block.data(),size);
+        return size;
+    }
+    std::vector<unsigned char> read(const Entry& entry,JobSystem* jobs = nullptr) const {
+        std::vector<unsigned char> data(static_cast<size_t>(entry.size));
+        read(entry,data.data(),jobs);
+        return data;
+    }
+
+private:
+    //压缩的资源中各块数据相对于资源起始位置的偏移,最后一项为数据的结尾
+    std::vector<uint64_t> blockOffsets(const Entry& entry) const {
+        using namespace archive;
+        const unsigned char* blob = file.data() + entry.offset;
+        size_t blockCount = static_cast<size_t>((entry.size + blockSize - 1) / blockSize);
+        if(entry.storedSize < blockCount * 4){
+            throw std::runtime_error("corrupt asset: " + entry.name);
+        }
+        std::vector<uint64_t> offsets(blockCount + 1);
+        offsets[0] = blockCount * 4;
+        for(size_t i = 0;i < blockCount;i++){
+            offsets[i + 1] = offsets[i] + (get32(blob + i * 4) & ~STORED_BLOCK);
+        }
+        if(offsets[blockCount] > entry.storedSize){
+            throw std::runtime_error("corrupt asset: " + entry.name);
+        }
+        return offsets;
+    }
+    //解压第 index 块到 dst,数据损坏时返回 false
+    bool decodeBlock(const Entry& entry,const std::vector<uint64_t>& offsets,
+                     size_t index,unsigned char* dst) const {
+        using namespace archive;
+        const unsigned char* blob = file.data() + entry.offset;
+        size_t rawSize = static_cast<size_t>(
+                    std::min<uint64_t>(blockSize,entry.size - uint64_t(index) * blockSize));
+        size_t packedSize = static_cast<size_t>(offsets[index + 1] - offsets[index]);
+        const unsigned char* src = blob + offsets[index];
+        if(get32(blob + index * 4) & STORED_BLOCK){
+            if(packedSize != rawSize){
+                return false;
+            }
+            std::memcpy(dst,src,rawSize);
+            return true;
+        }
+        return decompressBlock(entry.codec,src,packedSize,dst,rawSize);
+    }
+
+    MappedFile file;
+    uint32_t blockSize = archive::BLOCK_SIZE;
+    std::vector<Entry> entries;
+};
+
+//资源在包中的名称:去掉目录的文件名
+inline std::string assetName(const std::string& path){
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+/**
+  打包资源文件.分块网格文件和虚拟纹理需要随机访问,总是不压缩存放,可以直接从映射中流式读取
+  */
+inline void packArchive(const std::string& filename,AssetCodec codec,
+                        const std::vector<std::string>& inputs){
+    using namespace archive;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::ofstream out(filename,std::ios::binary);
+    if(!out){
+        throw std::runtime_error("failed to open file: " + filename);
+    }
+    std::vector<unsigned char> header(ALIGNMENT,0);
+    out.write(reinterpret_cast<const char*>(header.data()),header.size());
+    uint64_t position = ALIGNMENT;
+    std::vector<AssetArchive::Entry> entries;
+    uint64_t totalSize = 0;
+    uint64_t totalStored = 0;
+    for(const std::string& input : inputs){
+        MappedFile source(input);
+        AssetArchive::Entry entry;
+        entry.name = assetName(input);
+        entry.hash = hashName(entry.name);
+        entry.offset = position;
+        entry.size = source.size();
+        auto hasExtension = [&](const std::string& extension){
+            return entry.name.size() > extension.size() &&
+                    entry.name.compare(entry.name.size() - extension.size(),
+                                       extension.size(),extension) == 0;
+        };
+        //虚拟纹理的每一页已经单独压缩过
+        bool streamed = hasExtension(".vmesh") || hasExtension(".vtex");
+        entry.codec = streamed ? AssetCodec::None : codec;
+        for(const auto& other : entries){
+            if(other.name == entry.name){
+                throw std::runtime_error("duplicate asset name: " + entry.name);
+            }
+        }
+        std::vector<unsigned char> blob;
+        if(entry.codec == AssetCodec::None){
+            out.write(reinterpret_cast<const char*>(source.data()),source.size());
+            entry.storedSize = source.size();
+        }else{
+            size_t blockCount = (source.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            blob.resize(blockCount * 4);
+            for(size_t i = 0;i < blockCount;i++){
+                size_t offset = i * BLOCK_SIZE;
+                size_t rawSize = std::min<size_t>(BLOCK_SIZE,source.size() - offset);
+                size_t start = blob.size();
+                uint32_t size;
+                if(compressBlock(entry.codec,source.data() + offset,rawSize,blob)){
+                    size = static_cast<uint32_t>(blob.size() - start);
+                }else{
+                    blob.insert(blob.end(),source.data() + offset,
+                                source.data() + offset + rawSize);
+                    size = static_cast<uint32_t>(rawSize) | STORED_BLOCK;
+                }
+                for(int b = 0;b < 4;b++){
+                    blob[i * 4 + b] = static_cast<unsigned char>(size >> (8 * b));
+                }
+            }
+            out.write(reinterpret_cast<const char*>(blob.data()),blob.size());
+            entry.storedSize = blob.size();
+        }
+        position += entry.storedSize;
+        //下一个资源按页对齐
+        uint64_t padding = (ALIGNMENT - position % ALIGNMENT) % ALIGNMENT;
+        std::vector<char> zeros(static_cast<size_t>(padding),0);
+        out.write(zeros.data(),zeros.size());
+        position += padding;
+        std::cout<<entry.name<<": "<<entry.size<<" -> "<<entry.storedSize
+                 <<" bytes ("<<assetCodecName(entry.codec)<<")"<<std::endl;
+        totalSize += entry.size;
+        totalStored += entry.storedSize;
+        entries.push_back(entry);
+    }
+    std::sort(entries.begin(),entries.end(),
+              [](const AssetArchive::Entry& a,const AssetArchive::Entry& b){
+        return a.hash < b.hash;
+    });
+    std::vector<unsigned char> toc;
+    for(const auto& entry : entries){
+        put64(toc,entry.hash);
+        put64(toc,entry.offset);
+        put64(toc,entry.storedSize);
+        put64(toc,entry.size);
+        put32(toc,static_cast<uint32_t>(entry.codec));
+        put32(toc,static_cast<uint32_t>(entry.name.size()));
+        toc.insert(toc.end(),entry.name.begin(),entry.name.end());
+    }
+    out.write(reinterpret_cast<const char*>(toc.data()),toc.size());
+    header.clear();
+    header.insert(header.end(),MAGIC,MAGIC + 4);
+    put32(header,VERSION);
+    put32(header,static_cast<uint32_t>(entries.size()));
+    put32(header,BLOCK_SIZE);
+    put64(header,position);
+    put64(header,toc.size());
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(header.data()),header.size());
+    out.close();
+    if(!out){
+        throw std::runtime_error("failed to write file: " + filename);
+    }
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout<<"packed "<<entries.size()<<" assets into "<<filename<<": "
+             <<totalSize<<" -> "<<totalStored<<" bytes, "
+             <<std::chrono::duration<double,std::milli>(
+                   endTime - startTime).count()<<" ms"<<std::endl;
+}
+
+#endif // ASSETARCHIVE_H
@@ -0,0 +1,556 @@
+#ifndef BCENCODER_H
+#define BCENCODER_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+/**
+  块压缩(BC)纹理的 CPU 编码器
+  每个 4x4 像素块独立编码:
+  BC1:8 字节,两个 RGB565 端点加 16 个 2 位索引,每个像素 0.5 字节
+  BC3:16 字节,BC4 形式的 alpha 块加 BC1 形式的颜色块,每个像素 1 字节
+  BC7:16 字节,这里只使用模式 6(单子集,RGBA 7777 端点加 p 位,4 位索引)
+  端点通过主成分分析求出的主轴确定,然后用最小二乘法优化一次。
+  解码器只用于计算压缩质量(PSNR),BC7 只能解码模式 6
+  */
+namespace bc {
+
+inline int clamp255(float v){
+    return static_cast<int>(std::min(255.0f,std::max(0.0f,v + 0.5f)));
+}
+
+//按位写入,低位在前
+struct BitWriter{
+    unsigned char* out;
+    uint32_t pos = 0;
+    explicit BitWriter(unsigned char* dst) : out(dst) {}
+    void write(uint32_t value,uint32_t bits){
+        for(uint32_t i = 0;i < bits;i++,pos++){
+            if(value & (1u << i)){
+                out[pos >> 3] |= static_cast<unsigned char>(1u << (pos & 7));
+            }
+        }
+    }
+};
+struct BitReader{
+    const unsigned char* in;
+    uint32_t pos = 0;
+    explicit BitReader(const unsigned char* src) : in(src) {}
+    uint32_t read(uint32_t bits){
+        uint32_t value = 0;
+        for(uint32_t i = 0;i < bits;i++,pos++){
+            if(in[pos >> 3] & (1u << (pos & 7))){
+                value |= 1u << i;
+            }
+        }
+        return value;
+    }
+};
+
+/**
+  求像素块在 channels 个通道上的主轴,结果为两个端点(未量化)
+  使用协方差矩阵的幂迭代求最大特征向量,再把像素投影到主轴上取两端
+  */
+inline void principalEndpoints(const unsigned char block[64],int channels,
+                               float e0[4],float e1[4]){
+    float mean[4] = {0,0,0,0};
+    for(int i = 0;i < 16;i++){
+        for(int c = 0;c < channels;c++){
+            mean[c] += block[i*4 + c];
+        }
+    }
+    for(int c = 0;c < channels;c++){
+        mean[c] /= 16.0f;
+    }
+    float cov[4][4] = {};
+    for(int i = 0;i < 16;i++){
+        float d[4];
+        for(int c = 0;c < channels;c++){
+            d[c] = block[i*4 + c] - mean[c];
+        }
+        for(int a = 0;a < channels;a++){
+            for(int b = 0;b < channels;b++){
+                cov[a][b] += d[a] * d[b];
+            }
+        }
+    }
+    float axis[4] = {1,1,1,1};
+    for(int iter = 0;iter < 8;iter++){
+        float next[4] = {0,0,0,0};
+        for(int a = 0;a < channels;a++){
+            for(int b = 0;b < channels;b++){
+                next[a] += cov[a][b] * axis[b];
+            }
+        }
+        float len = 0.0f;
+        for(int c = 0;c < channels;c++){
+            len += next[c] * next[c];
+        }
+        len = std::sqrt(len);
+        if(len < 1e-6f){
+            break;
+        }
+        for(int c = 0;c < channels;c++){
+            axis[c] = next[c] / len;
+        }
+    }
+    float tMin = 0.0f,tMax = 0.0f;
+    for(int i = 0;i < 16;i++){
+        float t = 0.0f;
+        for(int c = 0;c < channels;c++){
+            t += (block[i*4 + c] - mean[c]) * axis[c];
+        }
+        tMin = std::min(tMin,t);
+        tMax = std::max(tMax,t);
+    }
+    for(int c = 0;c < 4;c++){
+        e0[c] = c < channels ? mean[c] + axis[c] * tMax : 255.0f;
+        e1[c] = c < channels ? mean[c] + axis[c] * tMin : 255.0f;
+    }
+}
+
+/**
+  已知每个像素的插值权重 t(端点 0 的权重为 1-t,端点 1 的权重为 t),
+  用最小二乘法求使误差最小的两个端点。所有权重相同时返回 false
+  */
+inline bool leastSquaresEndpoints(const unsigned char block[64],int channels,
+                                  const float t[16],float e0[4],float e1[4]){
+    float aa = 0,ab = 0,bb = 0;
+    float ax[4] = {0,0,0,0},bx[4] = {0,0,0,0};
+    for(int i = 0;i < 16;i++){
+        float a = 1.0f - t[i],b = t[i];
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for(int c = 0;c < channels;c++){
+            ax[c] += a * block[i*4 + c];
+            bx[c] += b * block[i*4 + c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if(std::fabs(det) < 1e-6f){
+        return false;
+    }
+    for(int c = 0;c < channels;c++){
+        e0[c] = std::min(255.0f,std::max(0.0f,(ax[c] * bb - bx[c] * ab) / det));
+        e1[c] = std::min(255.0f,std::max(0.0f,(bx[c] * aa - ax[c] * ab) / det));
+    }
+    return true;
+}
+
+//---------------------------------- BC1 ----------------------------------
+inline uint16_t packRgb565(const float c[4]){
+    int r = (clamp255(c[0]) * 31 + 127) / 255;
+    int g = (clamp255(c[1]) * 63 + 127) / 255;
+    int b = (clamp255(c[2]) * 31 + 127) / 255;
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+inline void unpackRgb565(uint16_t v,int rgb[3]){
+    int r = (v >> 11) & 31,g = (v >> 5) & 63,b = v & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+//四色模式的调色板
+inline void bc1Palette(uint16_t c0,uint16_t c1,int palette[4][3]){
+    unpackRgb565(c0,palette[0]);
+    unpackRgb565(c1,palette[1]);
+    for(int c = 0;c < 3;c++){
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+//选择每个像素最接近的调色板颜色,返回总误差
+inline uint32_t bc1Indices(const unsigned char block[64],uint16_t c0,uint16_t c1,
+                           uint32_t& indices){
+    int palette[4][3];
+    bc1Palette(c0,c1,palette);
+    uint32_t totalError = 0;
+    indices = 0;
+    for(int i = 0;i < 16;i++){
+        uint32_t best = 0xffffffff;
+        uint32_t bestIndex = 0;
+        for(uint32_t p = 0;p < 4;p++){
+            int dr = block[i*4] - palette[p][0];
+            int dg = block[i*4 + 1] - palette[p][1];
+            int db = block[i*4 + 2] - palette[p][2];
+            uint32_t err = dr*dr + dg*dg + db*db;
+            if(err < best){
+                best = err;
+                bestIndex = p;
+            }
+        }
+        indices |= bestIndex << (i * 2);
+        totalError += best;
+    }
+    return totalError;
+}
+//量化端点并保证 c0 > c1(四色模式),返回误差
+inline uint32_t bc1Quantize(const unsigned char block[64],const float e0[4],
+                            const float e1[4],uint16_t& c0,uint16_t& c1,
+                            uint32_t& indices){
+    c0 = packRgb565(e0);
+    c1 = packRgb565(e1);
+    if(c0 < c1){
+        std::swap(c0,c1);
+    }
+    if(c0 == c1){
+        //两个端点相同时所有像素使用端点 0
+        indices = 0;
+        int palette[4][3];
+        bc1Palette(c0,c1,palette);
+        uint32_t err = 0;
+        for(int i = 0;i < 16;i++){
+            for(int c = 0;c < 3;c++){
+                int d = block[i*4 + c] - palette[0][c];
+                err += d * d;
+            }
+        }
+        return err;
+    }
+    return bc1Indices(block,c0,c1,indices);
+}
+inline void encodeBC1Block(const unsigned char block[64],unsigned char out[8]){
+    float e0[4],e1[4];
+    principalEndpoints(block,3,e0,e1);
+    uint16_t c0,c1;
+    uint32_t indices;
+    uint32_t err = bc1Quantize(block,e0,e1,c0,c1,indices);
+    //根据选出的索引用最小二乘法优化端点
+    if(c0 != c1){
+        static const float weights[4] = {0.0f,1.0f,1.0f/3.0f,2.0f/3.0f};
+        float t[16];
+        for(int i = 0;i < 16;i++){
+            t[i] = weights[(indices >> (i*2)) & 3];
+        }
+        float r0[4],r1[4];
+        if(leastSquaresEndpoints(block,3,t,r0,r1)){
+            uint16_t rc0,rc1;
+            uint32_t rindices;
+            uint32_t rerr = bc1Quantize(block,r0,r1,rc0,rc1,rindices);
+            if(rerr < err){
+                c0 = rc0;
+                c1 = rc1;
+                indices = rindices;
+            }
+        }
+    }
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    for(int i = 0;i < 4;i++){
+        out[4 + i] = static_cast<unsigned char>(indices >> (i*8));
+    }
+}
+inline void decodeBC1Block(const unsigned char in[8],unsigned char block[64],
+                           bool alwaysFourColor = false){
+    uint16_t c0 = in[0] | (in[1] << 8);
+    uint16_t c1 = in[2] | (in[3] << 8);
+    int palette[4][3];
+    bc1Palette(c0,c1,palette);
+    int alpha[4] = {255,255,255,255};
+    if(c0 <= c1 && !alwaysFourColor){
+        //三色模式,第 4 个颜色为透明黑色
+        for(int c = 0;c < 3;c++){
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+        alpha[3] = 0;
+    }
+    uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) |
+            (uint32_t(in[7]) << 24);
+    for(int i = 0;i < 16;i++){
+        uint32_t p = (indices >> (i*2)) & 3;
+        block[i*4] = static_cast<unsigned char>(palette[p][0]);
+        block[i*4 + 1] = static_cast<unsigned char>(palette[p][1]);
+        block[i*4 + 2] = static_cast<unsigned char>(palette[p][2]);
+        block[i*4 + 3] = static_cast<unsigned char>(alpha[p]);
+    }
+}
+
+//---------------------------------- BC3 ----------------------------------
+//BC4 形式的 alpha 块:两个 8 位端点加 16 个 3 位索引
+inline void encodeAlphaBlock(const unsigned char block[64],unsigned char out[8]){
+    int a0 = 0,a1 = 255;
+    for(int i = 0;i < 16;i++){
+        a0 = std::max(a0,int(block[i*4 + 3]));
+        a1 = std::min(a1,int(block[i*4 + 3]));
+    }
+    memset(out,0,8);
+    out[0] = static_cast<unsigned char>(a0);
+    out[1] = static_cast<unsigned char>(a1);
+    if(a0 == a1){
+        return;
+    }
+    //a0 > a1 时使用 8 个插值
+    int palette[8] = {a0,a1};
+    for(int i = 1;i < 7;i++){
+        palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    }
+    BitWriter writer(out + 2);
+    for(int i = 0;i < 16;i++){
+        int best = 1 << 30,bestIndex = 0;
+        for(int p = 0;p < 8;p++){
+            int d = std::abs(block[i*4 + 3] - palette[p]);
+            if(d < best){
+                best = d;
+                bestIndex = p;
+            }
+        }
+        writer.write(bestIndex,3);
+    }
+}
+inline void decodeAlphaBlock(const unsigned char in[8],unsigned char block[64]){
+    int a0 = in[0],a1 = in[1];
+    int palette[8] = {a0,a1};
+    if(a0 > a1){
+        for(int i = 1;i < 7;i++){
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+    }else{
+        for(int i = 1;i < 5;i++){
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    BitReader reader(in + 2);
+    for(int i = 0;i < 16;i++){
+        block[i*4 + 3] = static_cast<unsigned char>(palette[reader.read(3)]);
+    }
+}
+inline void encodeBC3Block(const unsigned char block[64],unsigned char out[16]){
+    encodeAlphaBlock(block,out);
+    encodeBC1Block(block,out + 8);
+}
+inline void decodeBC3Block(const unsigned char in[16],unsigned char block[64]){
+    decodeBC1Block(in + 8,block,true);
+    decodeAlphaBlock(in,block);
+}
+
+//------------------------------ BC7 模式 6 -------------------------------
+static const int BC7_WEIGHTS4[16] = {
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+};
+//把端点量化为 7 位加共享 p 位,选择误差较小的 p 位
+inline void bc7QuantizeEndpoint(const float e[4],int q[4],int& pbit){
+    uint32_t bestError = 0xffffffff;
+    for(int p = 0;p < 2;p++){
+        int candidate[4];
+        uint32_t err = 0;
+        for(int c = 0;c < 4;c++){
+            int v = (clamp255(e[c]) - p + 1) >> 1;
+            candidate[c] = std::min(127,std::max(0,v));
+            int d = ((candidate[c] << 1) | p) - clamp255(e[c]);
+            err += d * d;
+        }
+        if(err < bestError){
+            bestError = err;
+            pbit = p;
+            memcpy(q,candidate,sizeof(candidate));
+        }
+    }
+}
+inline void bc7Palette(const int q0[4],int p0,const int q1[4],int p1,
+                       int palette[16][4]){
+    for(int c = 0;c < 4;c++){
+        int v0 = (q0[c] << 1) | p0;
+        int v1 = (q1[c] << 1) | p1;
+        for(int i = 0;i < 16;i++){
+            palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * v0 +
+                             BC7_WEIGHTS4[i] * v1 + 32) >> 6;
+        }
+    }
+}
+inline uint32_t bc7Indices(const unsigned char block[64],const int q0[4],int p0,
+                           const int q1[4],int p1,int indices[16]){
+    int palette[16][4];
+    bc7Palette(q0,p0,q1,p1,palette);
+    uint32_t totalError = 0;
+    for(int i = 0;i < 16;i++){
+        uint32_t best = 0xffffffff;
+        for(int p = 0;p < 16;p++){
+            uint32_t err = 0;
+            for(int c = 0;c < 4;c++){
+                int d = block[i*4 + c] - palette[p][c];
+                err += d * d;
+            }
+            if(err < best){
+                best = err;
+                indices[i] = p;
+            }
+        }
+        totalError += best;
+    }
+    return totalError;
+}
+inline void encodeBC7Block(const unsigned char block[64],unsigned char out[16]){
+    float e0[4],e1[4];
+    principalEndpoints(block,4,e0,e1);
+    int q0[4],q1[4],p0,p1,indices[16];
+    bc7QuantizeEndpoint(e0,q0,p0);
+    bc7QuantizeEndpoint(e1,q1,p1);
+    uint32_t err = bc7Indices(block,q0,p0,q1,p1,indices);
+    //根据选出的索引用最小二乘法优化端点
+    float t[16];
+    for(int i = 0;i < 16;i++){
+        t[i] = BC7_WEIGHTS4[indices[i]] / 64.0f;
+    }
+    float r0[4],r1[4];
+    if(leastSquaresEndpoints(block,4,t,r0,r1)){
+        int rq0[4],rq1[4],rp0,rp1,rindices[16];
+        bc7QuantizeEndpoint(r0,rq0,rp0);
+        bc7QuantizeEndpoint(r1,rq1,rp1);
+        uint32_t rerr = bc7Indices(block,rq0,rp0,rq1,rp1,rindices);
+        if(rerr < err){
+            memcpy(q0,rq0,sizeof(q0));
+            memcpy(q1,rq1,sizeof(q1));
+            p0 = rp0;
+            p1 = rp1;
+            memcpy(indices,rindices,sizeof(indices));
+        }
+    }
+    //第一个像素的索引(锚点)最高位必须为 0,否则交换端点并翻转索引
+    if(indices[0] & 8){
+        std::swap(q0,q1);
+        std::swap(p0,p1);
+        for(int i = 0;i < 16;i++){
+            indices[i] = 15 - indices[i];
+        }
+    }
+    memset(out,0,16);
+    BitWriter writer(out);
+    writer.write(1u << 6,7);//模式 6
+    for(int c = 0;c < 4;c++){
+        writer.write(q0[c],7);
+        writer.write(q1[c],7);
+    }
+    writer.write(p0,1);
+    writer.write(p1,1);
+    writer.write(indices[0],3);
+    for(int i = 1;i < 16;i++){
+        writer.write(indices[i],4);
+    }
+}
+inline void decodeBC7Block(const unsigned char in[16],unsigned char block[64]){
+    BitReader reader(in);
+    if(reader.read(7) != (1u << 6)){
+        throw std::runtime_error("bc7: only mode 6 blocks can be decoded!");
+    }
+    int q0[4],q1[4];
+    for(int c = 0;c < 4;c++){
+        q0[c] = reader.read(7);
+        q1[c] = reader.read(7);
+    }
+    int p0 = reader.read(1);
+    int p1 = reader.read(1);
+    int palette[16][4];
+    bc7Palette(q0,p0,q1,p1,palette);
+    for(int i = 0;i < 16;i++){
+        uint32_t index = reader.read(i == 0 ? 3 : 4);
+        for(int c = 0;c < 4;c++){
+            block[i*4 + c] = static_cast<unsigned char>(palette[index][c]);
+        }
+    }
+}
+
+//------------------------------ 整幅图像 ---------------------------------
+inline bool isBlockCompressed(VkFormat format){
+    return format == VK_FORMAT_BC1_RGB_UNORM_BLOCK ||
+            format == VK_FORMAT_BC3_UNORM_BLOCK ||
+            format == VK_FORMAT_BC7_UNORM_BLOCK;
+}
+inline uint32_t blockBytes(VkFormat format){
+    return format == VK_FORMAT_BC1_RGB_UNORM_BLOCK ? 8 : 16;
+}
+
+//压缩一个 RGBA8 图像,不足 4 像素的边界块重复边缘像素
+inline std::vector<unsigned char> compressImage(VkFormat format,
+                                                const unsigned char* rgba,
+                                                uint32_t width,uint32_t height){
+    if(!isBlockCompressed(format)){
+        throw std::runtime_error("bc: unsupported format!");
+    }
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    uint32_t bytes = blockBytes(format);
+    std::vector<unsigned char> out(size_t(blocksX) * blocksY * bytes);
+    unsigned char block[64];
+    for(uint32_t by = 0;by < blocksY;by++){
+        for(uint32_t bx = 0;bx < blocksX;bx++){
+            for(uint32_t y = 0;y < 4;y++){
+                uint32_t sy = std::min(by*4 + y,height - 1);
+                for(uint32_t x = 0;x < 4;x++){
+                    uint32_t sx = std::min(bx*4 + x,width - 1);
+                    memcpy(&block[(y*4 + x)*4],
+                           &rgba[(size_t(sy) * width + sx) * 4],4);
+                }
+            }
+            unsigned char* dst = &out[(size_t(by) * blocksX + bx) * bytes];
+            if(format == VK_FORMAT_BC1_RGB_UNORM_BLOCK){
+                encodeBC1Block(block,dst);
+            }else if(format == VK_FORMAT_BC3_UNORM_BLOCK){
+                encodeBC3Block(block,dst);
+            }else{
+                encodeBC7Block(block,dst);
+            }
+        }
+    }
+    return out;
+}
+
+inline std::vector<unsigned char> decompressImage(VkFormat format,
+                                                  const unsigned char* data,
+                                                  uint32_t width,uint32_t height){
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    uint32_t bytes = blockBytes(format);
+    std::vector<unsigned char> rgba(size_t(width) * height * 4);
+    unsigned char block[64];
+    for(uint32_t by = 0;by < blocksY;by++){
+        for(uint32_t bx = 0;bx < blocksX;bx++){
+            const unsigned char* src = &data[(size_t(by) * blocksX + bx) * bytes];
+            if(format == VK_FORMAT_BC1_RGB_UNORM_BLOCK){
+                decodeBC1Block(src,block);
+            }else if(format == VK_FORMAT_BC3_UNORM_BLOCK){
+                decodeBC3Block(src,block);
+            }else{
+                decodeBC7Block(src,block);
+            }
+            for(uint32_t y = 0;y < 4 && by*4 + y < height;y++){
+                for(uint32_t x = 0;x < 4 && bx*4 + x < width;x++){
+                    memcpy(&rgba[((size_t(by*4 + y)) * width + bx*4 + x) * 4],
+                           &block[(y*4 + x)*4],4);
+                }
+            }
+        }
+    }
+    return rgba;
+}
+
+//RGB 通道的峰值信噪比(dB),图像完全相同时返回无穷大
+inline double computePsnr(const unsigned char* a,const unsigned char* b,
+                          size_t pixelCount){
+    double sum = 0.0;
+    for(size_t i = 0;i < pixelCount;i++){
+        for(int c = 0;c < 3;c++){
+            double d = double(a[i*4 + c]) - double(b[i*4 + c]);
+            sum += d * d;
+        }
+    }
+    double mse = sum / (pixelCount * 3.0);
+    if(mse <= 0.0){
+        return INFINITY;
+    }
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+}//namespace bc
+
+#endif // BCENCODER_H
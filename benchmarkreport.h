@@ -0,0 +1,90 @@
+#ifndef BENCHMARKREPORT_H
+#define BENCHMARKREPORT_H
+
+#include <ostream>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+
+#include "framestats.h"
+
+/**
+  基准测试的结果,以 JSON 格式输出,方便比较同一台机器上不同版本的性能.
+  时间单位都是毫秒
+  */
+struct BenchmarkReport{
+    std::string device;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::string presentMode;
+    std::string sync;
+    uint32_t framesInFlight = 0;
+    uint32_t msaaSamples = 1;
+    uint32_t warmupFrames = 0;
+    uint32_t frames = 0;
+    double timestepMs = 0.0;//每一帧场景前进的固定时间
+    double totalMs = 0.0;//绘制统计的帧所用的时间
+    bool gpuTimingAvailable = false;
+    FrameStats stats;
+};
+
+//转义 JSON 字符串中的引号,反斜杠和控制字符
+inline std::string jsonEscape(const std::string& text){
+    std::string out;
+    for(char c : text){
+        if(c == '"' || c == '\\'){
+            out += '\\';
+            out += c;
+        }else if(static_cast<unsigned char>(c) < 0x20){
+            char buffer[8];
+            std::snprintf(buffer,sizeof(buffer),"\\u%04x",c);
+            out += buffer;
+        }else{
+            out += c;
+        }
+    }
+    return out;
+}
+
+inline void writeSampleStatsJson(std::ostream& out,const SampleStats& stats){
+    out<<"{\"count\": "<<stats.count()
+       <<", \"mean\": "<<stats.mean()
+       <<", \"stddev\": "<<stats.stddev()
+       <<", \"min\": "<<stats.percentile(0)
+       <<", \"p50\": "<<stats.percentile(50)
+       <<", \"p95\": "<<stats.percentile(95)
+       <<", \"p99\": "<<stats.percentile(99)
+       <<", \"max\": "<<stats.percentile(100)<<"}";
+}
+
+inline void writeBenchmarkReport(std::ostream& out,const BenchmarkReport& report){
+    out<<"{\n"
+       <<"  \"device\": \""<<jsonEscape(report.device)<<"\",\n"
+       <<"  \"width\": "<<report.width<<",\n"
+       <<"  \"height\": "<<report.height<<",\n"
+       <<"  \"present_mode\": \""<<report.presentMode<<"\",\n"
+       <<"  \"sync\": \""<<report.sync<<"\",\n"
+       <<"  \"frames_in_flight\": "<<report.framesInFlight<<",\n"
+       <<"  \"msaa_samples\": "<<report.msaaSamples<<",\n"
+       <<"  \"warmup_frames\": "<<report.warmupFrames<<",\n"
+       <<"  \"frames\": "<<report.frames<<",\n"
+       <<"  \"timestep_ms\": "<<report.timestepMs<<",\n"
+       <<"  \"total_ms\": "<<report.totalMs<<",\n"
+       <<"  \"fps\": "<<(report.totalMs > 0.0 ?
+                             report.frames * 1000.0 / report.totalMs : 0.0)<<",\n"
+       <<"  \"cpu_ms\": ";
+    writeSampleStatsJson(out,report.stats.cpuTimes);
+    out<<",\n  \"frame_ms\": ";
+    writeSampleStatsJson(out,report.stats.frameTimes);
+    out<<",\n  \"latency_ms\": ";
+    writeSampleStatsJson(out,report.stats.latencies);
+    out<<",\n  \"gpu_ms\": ";
+    if(report.gpuTimingAvailable){
+        writeSampleStatsJson(out,report.stats.gpuTimes);
+    }else{
+        out<<"null";
+    }
+    out<<"\n}\n";
+}
+
+#endif // BENCHMARKREPORT_H
@@ -0,0 +1,16 @@
+#ifndef COLORSPACE_H
+#define COLORSPACE_H
+
+#include <cmath>
+
+//sRGB 编码值与线性值之间的转换
+inline float srgbToLinear(float c){
+    return c <= 0.04045f ? c / 12.92f
+                         : std::pow((c + 0.055f) / 1.055f,2.4f);
+}
+inline float linearToSrgb(float c){
+    return c <= 0.0031308f ? c * 12.92f
+                           : 1.055f * std::pow(c,1.0f / 2.4f) - 0.055f;
+}
+
+#endif // COLORSPACE_H
@@ -0,0 +1,48 @@
+#ifndef DELETIONQUEUE_H
+#define DELETIONQUEUE_H
+
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+/**
+  延迟销毁队列
+  GPU 可能仍在使用刚被替换下来的资源(交换链,暂存缓冲,一次性指令缓冲等),
+  立即销毁需要先等待设备空闲。这里把销毁操作和最后可能使用该资源的帧对应的
+  时间线值一起记录下来,等确认时间线到达这个值(这一帧已经执行完毕)后再执行销毁。
+  记录的值需要单调不减,销毁操作按记录的顺序执行
+  */
+class DeletionQueue{
+public:
+    //记录一个销毁操作,value 为最后可能使用该资源的帧对应的时间线值
+    void push(uint64_t value,std::function<void()> destroy){
+        entries.push_back(Entry{value,std::move(destroy)});
+    }
+    //执行所有时间线值不大于 completedValue 的销毁操作
+    void collect(uint64_t completedValue){
+        while(!entries.empty() && entries.front().value <= completedValue){
+            //先移出队列再执行,销毁操作中可以继续向队列中添加
+            std::function<void()> destroy = std::move(entries.front().destroy);
+            entries.pop_front();
+            destroy();
+        }
+    }
+    //设备空闲时执行所有剩余的销毁操作
+    void flush(){
+        while(!entries.empty()){
+            std::function<void()> destroy = std::move(entries.front().destroy);
+            entries.pop_front();
+            destroy();
+        }
+    }
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry{
+        uint64_t value;
+        std::function<void()> destroy;
+    };
+    std::deque<Entry> entries;
+};
+
+#endif // DELETIONQUEUE_H
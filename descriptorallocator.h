@@ -0,0 +1,316 @@
+#ifndef DESCRIPTORALLOCATOR_H
+#define DESCRIPTORALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+/**
+  描述符分配器
+  描述符池的大小在创建时就固定了,原来的做法是按交换链图像个数精确计算池的大小,
+  一旦增加新的材质或物体就会分配失败。
+  这里把多个描述符池串起来使用：当前池分配失败(VK_ERROR_OUT_OF_POOL_MEMORY 或
+  VK_ERROR_FRAGMENTED_POOL)时，就换一个新的池继续分配，新池的容量逐渐增大。
+  resetPools 会一次性重置所有用过的池，描述符集不需要单独释放，
+  适合每一帧都重新分配的临时描述符集
+  */
+class DescriptorAllocator{
+public:
+    void init(VkDevice dev,uint32_t initialSetsPerPool = 64,
+              VkDescriptorPoolCreateFlags flags = 0){
+        device = dev;
+        setsPerPool = initialSetsPerPool;
+        poolFlags = flags;
+    }
+    //分配一个描述符集,pNext 可以附加扩展结构体
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout,
+                             const void* pNext = nullptr){
+        if(currentPool == VK_NULL_HANDLE){
+            currentPool = grabPool();
+        }
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.pNext = pNext;
+        allocInfo.descriptorPool = currentPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        VkResult result = vkAllocateDescriptorSets(device,&allocInfo,&set);
+        if(result == VK_ERROR_FRAGMENTED_POOL ||
+                result == VK_ERROR_OUT_OF_POOL_MEMORY){
+            //当前池已满,换一个新的池重新分配
+            currentPool = grabPool();
+            allocInfo.descriptorPool = currentPool;
+            result = vkAllocateDescriptorSets(device,&allocInfo,&set);
+        }
+        if(result != VK_SUCCESS){
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
+        return set;
+    }
+    //重置所有用过的池,之前从这里分配的描述符集全部失效
+    void resetPools(){
+        for(VkDescriptorPool pool : usedPools){
+            vkResetDescriptorPool(device,pool,0);
+            freePools.push_back(pool);
+        }
+        usedPools.clear();
+        currentPool = VK_NULL_HANDLE;
+    }
+    /**
+    取出所有用过的池,之后的分配使用新的池.池中的描述符集可能还在被没有执行完的
+    指令缓冲使用,调用方等这些帧执行完毕后再交给 recyclePools
+      */
+    std::vector<VkDescriptorPool> detachPools(){
+        std::vector<VkDescriptorPool> pools;
+        pools.swap(usedPools);
+        currentPool = VK_NULL_HANDLE;
+        return pools;
+    }
+    //重置 detachPools 取出的池,放回可以复用的池中
+    void recyclePools(const std::vector<VkDescriptorPool>& pools){
+        for(VkDescriptorPool pool : pools){
+            vkResetDescriptorPool(device,pool,0);
+            freePools.push_back(pool);
+        }
+    }
+    void cleanup(){
+        for(VkDescriptorPool pool : usedPools){
+            vkDestroyDescriptorPool(device,pool,nullptr);
+        }
+        for(VkDescriptorPool pool : freePools){
+            vkDestroyDescriptorPool(device,pool,nullptr);
+        }
+        usedPools.clear();
+        freePools.clear();
+        currentPool = VK_NULL_HANDLE;
+    }
+    size_t poolCount() const { return usedPools.size() + freePools.size(); }
+
+private:
+    //优先复用重置过的池,没有时创建一个新池
+    VkDescriptorPool grabPool(){
+        VkDescriptorPool pool;
+        if(!freePools.empty()){
+            pool = freePools.back();
+            freePools.pop_back();
+        }else{
+            pool = createPool(setsPerPool);
+            //下一个池的容量翻倍,减少链上池的个数
+            if(setsPerPool < MAX_SETS_PER_POOL){
+                setsPerPool *= 2;
+            }
+        }
+        usedPools.push_back(pool);
+        return pool;
+    }
+    VkDescriptorPool createPool(uint32_t maxSets){
+        //每个描述符集平均使用的各类描述符个数
+        static const struct { VkDescriptorType type; float ratio; } ratios[] = {
+            { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1.0f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1.0f },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+            { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f }
+        };
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for(const auto& r : ratios){
+            VkDescriptorPoolSize size = {};
+            size.type = r.type;
+            size.descriptorCount =
+                    static_cast<uint32_t>(r.ratio * maxSets) + 1;
+            poolSizes.push_back(size);
+        }
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = poolFlags;
+        poolInfo.maxSets = maxSets;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        VkDescriptorPool pool;
+        if(vkCreateDescriptorPool(device,&poolInfo,nullptr,
+                                  &pool) != VK_SUCCESS){
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        return pool;
+    }
+
+    static const uint32_t MAX_SETS_PER_POOL = 4096;
+
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t setsPerPool = 64;
+    VkDescriptorPoolCreateFlags poolFlags = 0;
+    VkDescriptorPool currentPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> usedPools;//已经分配过描述符集的池
+    std::vector<VkDescriptorPool> freePools;//重置后可以复用的池
+};
+
+//描述符集中一个绑定点引用的资源
+struct DescriptorBinding{
+    uint32_t binding;
+    VkDescriptorType type;
+    VkDescriptorBufferInfo bufferInfo;
+    VkDescriptorImageInfo imageInfo;
+
+    static DescriptorBinding buffer(uint32_t binding,VkDescriptorType type,
+                                    VkBuffer buffer,VkDeviceSize offset,
+                                    VkDeviceSize range){
+        DescriptorBinding b = {};
+        b.binding = binding;
+        b.type = type;
+        b.bufferInfo.buffer = buffer;
+        b.bufferInfo.offset = offset;
+        b.bufferInfo.range = range;
+        return b;
+    }
+    static DescriptorBinding image(uint32_t binding,VkDescriptorType type,
+                                   VkImageView imageView,VkSampler sampler,
+                                   VkImageLayout imageLayout){
+        DescriptorBinding b = {};
+        b.binding = binding;
+        b.type = type;
+        b.imageInfo.imageView = imageView;
+        b.imageInfo.sampler = sampler;
+        b.imageInfo.imageLayout = imageLayout;
+        return b;
+    }
+    bool operator==(const DescriptorBinding& other) const {
+        return binding == other.binding && type == other.type &&
+                bufferInfo.buffer == other.bufferInfo.buffer &&
+                bufferInfo.offset == other.bufferInfo.offset &&
+                bufferInfo.range == other.bufferInfo.range &&
+                imageInfo.imageView == other.imageInfo.imageView &&
+                imageInfo.sampler == other.imageInfo.sampler &&
+                imageInfo.imageLayout == other.imageInfo.imageLayout;
+    }
+    bool isImage() const {
+        return type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+                type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+                type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+                type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+                type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    }
+};
+
+/**
+  描述符集缓存
+  以描述符布局和绑定的资源作为键缓存已经写好的描述符集。
+  重复使用同一组资源时直接返回缓存的描述符集,不再调用 vkUpdateDescriptorSets。
+  被引用的资源销毁后,需要调用 retire 清空缓存,否则可能返回引用已销毁资源的描述符集.
+  分配器只给缓存使用,retire 时才能整个取出分配过描述符集的池回收
+  */
+class DescriptorSetCache{
+public:
+    void init(VkDevice dev,DescriptorAllocator* descriptorAllocator){
+        device = dev;
+        allocator = descriptorAllocator;
+    }
+    VkDescriptorSet get(VkDescriptorSetLayout layout,
+                        const std::vector<DescriptorBinding>& bindings){
+        Key key;
+        key.layout = layout;
+        key.bindings = bindings;
+        auto it = cache.find(key);
+        if(it != cache.end()){
+            hits++;
+            return it->second;
+        }
+        misses++;
+        VkDescriptorSet set = allocator->allocate(layout);
+        //未命中时才写入描述符
+        std::vector<VkWriteDescriptorSet> descriptorWrites(bindings.size());
+        for(size_t i = 0;i < bindings.size();i++){
+            VkWriteDescriptorSet& write = descriptorWrites[i];
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = set;
+            write.dstBinding = bindings[i].binding;
+            write.dstArrayElement = 0;
+            write.descriptorType = bindings[i].type;
+            write.descriptorCount = 1;
+            if(bindings[i].isImage()){
+                write.pImageInfo = &bindings[i].imageInfo;
+            }else{
+                write.pBufferInfo = &bindings[i].bufferInfo;
+            }
+        }
+        vkUpdateDescriptorSets(device,
+                               static_cast<uint32_t>(descriptorWrites.size()),
+                               descriptorWrites.data(),0,nullptr);
+        cache[key] = set;
+        return set;
+    }
+    //清空缓存,描述符集本身由分配器回收
+    void clear(){
+        cache.clear();
+    }
+    /**
+    清空缓存并取出分配这些描述符集的池,等使用它们的帧执行完毕后交给 recyclePools,
+    不然每次清空缓存时分配过的描述符集都会留在池中,池越来越多
+      */
+    std::vector<VkDescriptorPool> retire(){
+        cache.clear();
+        return allocator->detachPools();
+    }
+    void recyclePools(const std::vector<VkDescriptorPool>& pools){
+        allocator->recyclePools(pools);
+    }
+    size_t size() const { return cache.size(); }
+
+    uint64_t hits = 0;//命中次数
+    uint64_t misses = 0;//未命中(需要写入描述符)的次数
+
+private:
+    struct Key{
+        VkDescriptorSetLayout layout;
+        std::vector<DescriptorBinding> bindings;
+        bool operator==(const Key& other) const {
+            return layout == other.layout && bindings == other.bindings;
+        }
+    };
+    struct KeyHash{
+        /**
+        非可分发句柄在 64 位平台上是指针,在 32 位平台上是 uint64_t,
+        统一转换成 64 位整数再求哈希值
+          */
+        template<typename Handle>
+        static size_t handleHash(Handle handle){
+            return std::hash<uint64_t>()((uint64_t)handle);
+        }
+        size_t operator()(const Key& key) const {
+            //逐个字段组合哈希值,不直接对结构体做字节哈希,避免填充字节的影响
+            size_t h = handleHash(key.layout);
+            auto mix = [&h](size_t v){
+                h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+            };
+            for(const DescriptorBinding& b : key.bindings){
+                mix(b.binding);
+                mix(static_cast<size_t>(b.type));
+                mix(handleHash(b.bufferInfo.buffer));
+                mix(std::hash<uint64_t>()(b.bufferInfo.offset));
+                mix(std::hash<uint64_t>()(b.bufferInfo.range));
+                mix(handleHash(b.imageInfo.imageView));
+                mix(handleHash(b.imageInfo.sampler));
+                mix(static_cast<size_t>(b.imageInfo.imageLayout));
+            }
+            return h;
+        }
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    DescriptorAllocator* allocator = nullptr;
+    std::unordered_map<Key,VkDescriptorSet,KeyHash> cache;
+};
+
+#endif // DESCRIPTORALLOCATOR_H
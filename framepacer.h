@@ -0,0 +1,71 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <chrono>
+#include <thread>
+
+#include "framestats.h"
+
+/**
+  面向延迟的帧节奏控制
+  CPU 比显示器刷新快时,提交的帧会在交换链和 GPU 队列中排队,
+  输入在被读取后要等好几帧才能显示出来。这里在读取输入之前让 CPU 睡眠,
+  使每一帧的开始时间间隔固定为目标帧时间,读取的输入尽量新,排队的帧尽量少。
+  睡眠使用 sleep_for 加最后一小段忙等,减小操作系统调度带来的误差。
+  同时统计相邻两次读取输入的间隔,报告帧时间的平均值和方差(抖动)
+  */
+class FramePacer{
+public:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    //目标帧时间(毫秒),0 表示不限制,只做统计
+    void setTargetFrameTime(double ms){
+        targetFrameTime = ms;
+        nextWake = Clock::time_point();
+    }
+    double targetFrameTimeMs() const { return targetFrameTime; }
+
+    //在读取输入之前调用,必要时睡眠到下一帧的开始时间
+    void waitBeforeInput(){
+        Clock::time_point now = Clock::now();
+        if(targetFrameTime > 0.0){
+            const std::chrono::duration<double,std::milli> period(targetFrameTime);
+            if(nextWake == Clock::time_point() ||
+                    now - nextWake > period){
+                //第一帧或者已经落后超过一帧,从现在重新开始计时,不追赶
+                nextWake = now;
+            }else{
+                //提前 1 毫秒醒来,剩下的时间忙等
+                const std::chrono::milliseconds spinMargin(1);
+                if(nextWake - now > spinMargin){
+                    std::this_thread::sleep_for(nextWake - now - spinMargin);
+                }
+                while(Clock::now() < nextWake){
+                    std::this_thread::yield();
+                }
+                now = Clock::now();
+            }
+            nextWake += std::chrono::duration_cast<Clock::duration>(period);
+        }
+        if(lastInput != Clock::time_point()){
+            frameTimes.add(std::chrono::duration<double,std::milli>(
+                               now - lastInput).count());
+        }
+        lastInput = now;
+    }
+    //清空统计,例如切换呈现模式后重新统计
+    void resetStats(){
+        frameTimes.clear();
+        lastInput = Clock::time_point();
+        nextWake = Clock::time_point();
+    }
+    const SampleStats& stats() const { return frameTimes; }
+
+private:
+    double targetFrameTime = 0.0;
+    Clock::time_point nextWake;
+    Clock::time_point lastInput;
+    SampleStats frameTimes;
+};
+
+#endif // FRAMEPACER_H
@@ -0,0 +1,84 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+/**
+  一组时间样本(毫秒)的统计:平均值,标准差和百分位数
+  */
+class SampleStats{
+public:
+    void add(double ms){ samples.push_back(ms); }
+    void clear(){ samples.clear(); }
+    size_t count() const { return samples.size(); }
+    double sum() const {
+        double total = 0.0;
+        for(double s : samples){
+            total += s;
+        }
+        return total;
+    }
+    double mean() const {
+        return samples.empty() ? 0.0 : sum() / samples.size();
+    }
+    double variance() const {
+        if(samples.size() < 2){
+            return 0.0;
+        }
+        double m = mean();
+        double total = 0.0;
+        for(double s : samples){
+            total += (s - m) * (s - m);
+        }
+        return total / (samples.size() - 1);
+    }
+    double stddev() const { return std::sqrt(variance()); }
+    //p 取 0 到 100,使用最近秩方法
+    double percentile(double p) const {
+        if(samples.empty()){
+            return 0.0;
+        }
+        std::vector<double> sorted = samples;
+        std::sort(sorted.begin(),sorted.end());
+        size_t rank = static_cast<size_t>(
+                    std::ceil(p / 100.0 * sorted.size()));
+        rank = std::min(std::max<size_t>(rank,1),sorted.size());
+        return sorted[rank - 1];
+    }
+    const std::vector<double>& values() const { return samples; }
+
+private:
+    std::vector<double> samples;
+};
+
+/**
+  帧时间统计
+  frameTimes:相邻两帧开始绘制的时间间隔,反映吞吐量
+  latencies:从开始绘制一帧(读取输入)到观察到 GPU 执行完这一帧的时间,
+  只在下一次检查完成情况时才能观察到,所以是延迟的上界
+  cpuTimes:绘制一帧时 CPU 的工作时间,不包括等待 GPU 和获取交换链图像的时间
+  gpuTimes:GPU 执行一帧指令的时间,由时间戳查询得到
+  */
+struct FrameStats{
+    SampleStats frameTimes;
+    SampleStats latencies;
+    SampleStats cpuTimes;
+    SampleStats gpuTimes;
+
+    void clear(){
+        frameTimes.clear();
+        latencies.clear();
+        cpuTimes.clear();
+        gpuTimes.clear();
+    }
+    //每秒绘制的帧数
+    double framesPerSecond() const {
+        double total = frameTimes.sum();
+        return total > 0.0 ? frameTimes.count() * 1000.0 / total : 0.0;
+    }
+};
+
+#endif // FRAMESTATS_H
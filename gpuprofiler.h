@@ -0,0 +1,293 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstring>
+#include <ostream>
+#include <functional>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+
+/**
+  GPU 时间戳查询分析器
+  在指令缓冲中用命名的范围(渲染流程,上传,生成细化等)包围需要统计的指令,
+  范围开始和结束时各写入一个时间戳。查询池按帧分成若干段,每一段在对应的帧
+  再次开始时读取,那时这一段的指令已经执行完毕,读取不会等待 GPU。
+  每个范围在写入开始时间戳前在同一个指令缓冲中重置自己的两个查询,
+  所以范围可以记录在任何指令缓冲中(包括一次性提交的指令缓冲),只要它在对应的帧
+  结束前提交到同一个队列。范围必须在渲染流程之外开始和结束。
+  每个名称保留最近 AVERAGE_WINDOW 帧的平均值,每一帧的结果可以写入日志.
+  调用 calibrate 后,结果中还包含换算到 CPU 时钟(steady_clock)的开始时间,
+  用于和 CPU 事件显示在同一条时间线上
+  */
+class GpuProfiler{
+public:
+    //一个范围在一帧中的执行时间
+    struct ScopeResult{
+        const char* name;
+        double ms;
+        int64_t startNs;//CPU 时钟的开始时间,没有校准时为 0
+    };
+    //一个名称最近几帧的时间
+    struct ScopeTiming{
+        std::string name;
+        double lastMs = 0.0;
+        double averageMs = 0.0;
+        uint64_t samples = 0;//累计的样本数
+        std::deque<double> window;
+        double windowSum = 0.0;
+    };
+    static const size_t AVERAGE_WINDOW = 120;
+    static const uint32_t INVALID_SCOPE = ~0u;
+
+    /**
+    queueFamily 为记录范围的队列族,它的 timestampValidBits 为 0 时不支持时间戳,
+    之后的调用什么也不做.frameSlots 为查询池分成的段数,不能少于同时处理的帧数
+      */
+    void init(VkPhysicalDevice physicalDevice,VkDevice dev,uint32_t queueFamily,
+              uint32_t frameSlots,uint32_t maxScopesPerFrame = 32){
+        device = dev;
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                                 &queueFamilyCount,nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                    &queueFamilyCount,queueFamilies.data());
+        uint32_t validBits = queueFamilies[queueFamily].timestampValidBits;
+        if(validBits == 0){
+            return;
+        }
+        timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice,&properties);
+        timestampPeriod = properties.limits.timestampPeriod;
+
+        scopesPerSlot = maxScopesPerFrame;
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        //最后一个查询用于校准时钟
+        poolInfo.queryCount = frameSlots * scopesPerSlot * 2 + 1;
+        if(vkCreateQueryPool(device,&poolInfo,nullptr,&queryPool) != VK_SUCCESS){
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+        slots.assign(frameSlots,Slot());
+    }
+    /**
+    校准 GPU 时间戳和 CPU 时钟的对应关系:提交一个只写入时间戳的指令缓冲并等待完成,
+    认为时间戳对应提交前后两个 CPU 时间的中点,误差为提交延迟的一部分.
+    需要等待队列空闲,只在初始化时调用一次
+      */
+    void calibrate(VkQueue queue,VkCommandPool commandPool){
+        if(!supported()){
+            return;
+        }
+        uint32_t query = static_cast<uint32_t>(slots.size()) * scopesPerSlot * 2;
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device,&allocInfo,&commandBuffer);
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer,&beginInfo);
+        vkCmdResetQueryPool(commandBuffer,queryPool,query,1);
+        vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            queryPool,query);
+        vkEndCommandBuffer(commandBuffer);
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        int64_t before = cpuNowNs();
+        vkQueueSubmit(queue,1,&submitInfo,VK_NULL_HANDLE);
+        vkQueueWaitIdle(queue);
+        int64_t after = cpuNowNs();
+        vkGetQueryPoolResults(device,queryPool,query,1,sizeof(calibrationTicks),
+                              &calibrationTicks,sizeof(calibrationTicks),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        vkFreeCommandBuffers(device,commandPool,1,&commandBuffer);
+        calibrationCpuNs = before + (after - before) / 2;
+        calibrated = true;
+    }
+    void cleanup(){
+        if(queryPool != VK_NULL_HANDLE){
+            vkDestroyQueryPool(device,queryPool,nullptr);
+            queryPool = VK_NULL_HANDLE;
+        }
+        slots.clear();
+    }
+    bool supported() const { return queryPool != VK_NULL_HANDLE; }
+
+    //每一帧读取结果时调用,参数为帧序号和这一帧所有范围的结果
+    void setFrameCallback(std::function<void(uint64_t,
+                          const std::vector<ScopeResult>&)> callback){
+        frameCallback = std::move(callback);
+    }
+    //每一帧的结果以 "frame,scope,ms" 的格式写入 log,为空时不写
+    void setLog(std::ostream* log){
+        logStream = log;
+        if(logStream){
+            *logStream<<"frame,scope,ms\n";
+        }
+    }
+
+    /**
+    开始第 frame 帧,之后的范围都属于这一帧.
+    调用前必须确认使用同一段查询的帧(frame - 段数)已经执行完毕,这里先读取它的结果.
+    第一帧之前记录的范围(初始化时的上传等)和第 0 帧放在同一段中
+      */
+    void beginFrame(uint64_t frame){
+        if(!supported()){
+            return;
+        }
+        currentSlot = static_cast<uint32_t>(frame % slots.size());
+        Slot& slot = slots[currentSlot];
+        if(slot.frame != frame){
+            collect(slot);
+            slot.frame = frame;
+        }
+    }
+    //设备空闲时读取所有还没有读取的结果
+    void collectAll(){
+        for(Slot& slot : slots){
+            collect(slot);
+        }
+    }
+    //在 stage 阶段写入开始时间戳,返回的范围编号用于 endScope.name 必须一直有效
+    uint32_t beginScope(VkCommandBuffer commandBuffer,const char* name,
+                        VkPipelineStageFlagBits stage =
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT){
+        if(!supported()){
+            return INVALID_SCOPE;
+        }
+        Slot& slot = slots[currentSlot];
+        if(slot.names.size() >= scopesPerSlot){
+            return INVALID_SCOPE;//这一帧的范围太多,忽略
+        }
+        uint32_t scope = static_cast<uint32_t>(slot.names.size());
+        uint32_t query = firstQuery(currentSlot,scope);
+        slot.names.push_back(name);
+        vkCmdResetQueryPool(commandBuffer,queryPool,query,2);
+        vkCmdWriteTimestamp(commandBuffer,stage,queryPool,query);
+        return scope;
+    }
+    void endScope(VkCommandBuffer commandBuffer,uint32_t scope,
+                  VkPipelineStageFlagBits stage =
+                  VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT){
+        if(scope == INVALID_SCOPE){
+            return;
+        }
+        vkCmdWriteTimestamp(commandBuffer,stage,queryPool,
+                            firstQuery(currentSlot,scope) + 1);
+    }
+    //所有名称的统计,按第一次出现的顺序
+    const std::vector<ScopeTiming>& timings() const { return scopeTimings; }
+    //输出每个名称的平均时间
+    void report(std::ostream& out) const {
+        for(const ScopeTiming& timing : scopeTimings){
+            out<<"gpu "<<timing.name<<": "<<timing.averageMs<<" ms (last "
+               <<timing.lastMs<<" ms, "<<timing.samples<<" samples)\n";
+        }
+    }
+
+private:
+    //一段查询:所属的帧和这一帧开始的范围的名称
+    struct Slot{
+        uint64_t frame = 0;
+        std::vector<const char*> names;
+    };
+    uint32_t firstQuery(uint32_t slot,uint32_t scope) const {
+        return (slot * scopesPerSlot + scope) * 2;
+    }
+    void collect(Slot& slot){
+        if(slot.names.empty()){
+            return;
+        }
+        uint32_t slotIndex = static_cast<uint32_t>(&slot - slots.data());
+        //每个查询后面跟一个可用标志,还没有执行完的范围不统计
+        std::vector<uint64_t> data(slot.names.size() * 4);
+        vkGetQueryPoolResults(device,queryPool,firstQuery(slotIndex,0),
+                              static_cast<uint32_t>(slot.names.size() * 2),
+                              data.size() * sizeof(uint64_t),data.data(),
+                              2 * sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT |
+                              VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        results.clear();
+        for(size_t i = 0;i < slot.names.size();i++){
+            const uint64_t* pair = &data[i * 4];
+            if(pair[1] == 0 || pair[3] == 0){
+                continue;
+            }
+            uint64_t ticks = (pair[2] - pair[0]) & timestampMask;
+            double ms = ticks * timestampPeriod / 1000000.0;
+            int64_t startNs = 0;
+            if(calibrated){
+                int64_t sinceCalibration = static_cast<int64_t>(
+                            (pair[0] - calibrationTicks) & timestampMask);
+                startNs = calibrationCpuNs +
+                        static_cast<int64_t>(sinceCalibration * timestampPeriod);
+            }
+            results.push_back(ScopeResult{slot.names[i],ms,startNs});
+            record(slot.names[i],ms);
+            if(logStream){
+                *logStream<<slot.frame<<","<<slot.names[i]<<","<<ms<<"\n";
+            }
+        }
+        slot.names.clear();
+        if(frameCallback && !results.empty()){
+            frameCallback(slot.frame,results);
+        }
+    }
+    static int64_t cpuNowNs(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    void record(const char* name,double ms){
+        ScopeTiming* timing = nullptr;
+        for(ScopeTiming& t : scopeTimings){
+            if(t.name == name){
+                timing = &t;
+                break;
+            }
+        }
+        if(timing == nullptr){
+            scopeTimings.push_back(ScopeTiming());
+            timing = &scopeTimings.back();
+            timing->name = name;
+        }
+        timing->lastMs = ms;
+        timing->samples++;
+        timing->window.push_back(ms);
+        timing->windowSum += ms;
+        if(timing->window.size() > AVERAGE_WINDOW){
+            timing->windowSum -= timing->window.front();
+            timing->window.pop_front();
+        }
+        timing->averageMs = timing->windowSum / timing->window.size();
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    float timestampPeriod = 0.0f;//时间戳每增加 1 经过的纳秒数
+    uint64_t timestampMask = 0;//时间戳的有效位
+    uint32_t scopesPerSlot = 0;
+    bool calibrated = false;
+    uint64_t calibrationTicks = 0;
+    int64_t calibrationCpuNs = 0;
+    uint32_t currentSlot = 0;
+    std::vector<Slot> slots;
+    std::vector<ScopeResult> results;
+    std::vector<ScopeTiming> scopeTimings;
+    std::function<void(uint64_t,const std::vector<ScopeResult>&)> frameCallback;
+    std::ostream* logStream = nullptr;
+};
+
+#endif // GPUPROFILER_H
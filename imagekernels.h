@@ -0,0 +1,539 @@
+#ifndef IMAGEKERNELS_H
+#define IMAGEKERNELS_H
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#include "colorspace.h"
+
+/**
+  CPU 上准备纹理使用的图像处理内核:
+  RGB 扩展为 RGBA,sRGB 编码值与线性值的转换,预乘 alpha,sRGB 正确的 2x2 细化缩小.
+  每个内核有一个标量参考实现,SIMD 实现的结果与参考实现逐字节相同(由 --kernel-bench 检查).
+  x86 上用 GCC/Clang 的 target 属性编译 SSE4.1 和 AVX2 版本,不需要额外的编译选项,
+  运行时按 CPU 支持的指令集选择;ARM 上 NEON 是基本指令集,编译时直接启用.
+  查表的内核需要 gather 指令,只有 AVX2 版本,其他指令集使用标量实现.
+  为了让各个实现的结果完全相同,浮点到整数的量化只乘以 2 的幂后截断,
+  不依赖 x87 和 SSE 不同的中间精度
+  */
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__i386__) || defined(__x86_64__))
+#define IMAGEKERNELS_X86 1
+#include <immintrin.h>
+#define IMAGEKERNELS_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define IMAGEKERNELS_X86 1
+#include <immintrin.h>
+#include <intrin.h>
+#define IMAGEKERNELS_TARGET(isa)
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IMAGEKERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+enum class ImageIsa{
+    Scalar,
+    Sse41,
+    Avx2,
+    Neon
+};
+
+inline const char* imageIsaName(ImageIsa isa){
+    switch(isa){
+    case ImageIsa::Scalar: return "scalar";
+    case ImageIsa::Sse41: return "sse4.1";
+    case ImageIsa::Avx2: return "avx2";
+    case ImageIsa::Neon: return "neon";
+    }
+    return "unknown";
+}
+
+//CPU 和操作系统是否支持指令集
+inline bool imageIsaSupported(ImageIsa isa){
+    switch(isa){
+    case ImageIsa::Scalar:
+        return true;
+#if defined(IMAGEKERNELS_X86) && !defined(_MSC_VER)
+    case ImageIsa::Sse41:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1");
+    case ImageIsa::Avx2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#elif defined(IMAGEKERNELS_X86)
+    case ImageIsa::Sse41:{
+        int info[4];
+        __cpuid(info,1);
+        return (info[2] & (1 << 19)) != 0;
+    }
+    case ImageIsa::Avx2:{
+        int info[4];
+        __cpuid(info,1);
+        //还要检查操作系统是否保存 YMM 寄存器
+        bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 &&
+                (_xgetbv(0) & 6) == 6;
+        __cpuidex(info,7,0);
+        return osAvx && (info[1] & (1 << 5)) != 0;
+    }
+#endif
+#if defined(IMAGEKERNELS_NEON)
+    case ImageIsa::Neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+//支持的最快的指令集
+inline ImageIsa bestImageIsa(){
+    const ImageIsa order[] = { ImageIsa::Avx2,ImageIsa::Neon,ImageIsa::Sse41 };
+    for(ImageIsa isa : order){
+        if(imageIsaSupported(isa)){
+            return isa;
+        }
+    }
+    return ImageIsa::Scalar;
+}
+
+namespace imagekernels {
+
+/**
+  查找表.线性值用 16 位定点数表示(乘以 65536),
+  toSrgb8 的第 i 项是线性值区间 [i/65536,(i+1)/65536) 的中点编码后四舍五入的 sRGB 值
+  */
+struct Tables{
+    float toLinear[512];//[0,256) sRGB 编码值到线性值,[256,512) alpha 归一化的值
+    uint32_t toLinear16[256];//sRGB 编码值到 16 位定点线性值
+    //[0,65536) 16 位线性值到 sRGB 编码值,[65536,131072) 16 位 alpha 到 8 位,
+    //最后 4 个字节使 32 位的 gather 读取不越界
+    uint8_t toSrgb8[2 * 65536 + 4];
+
+    Tables(){
+        for(int i = 0;i < 256;i++){
+            float linear = srgbToLinear(i / 255.0f);
+            toLinear[i] = linear;
+            toLinear[256 + i] = static_cast<float>(i) * (1.0f / 255.0f);
+            toLinear16[i] = std::min(65535u,static_cast<uint32_t>(linear * 65536.0f + 0.5f));
+        }
+        for(int i = 0;i < 65536;i++){
+            float mid = (i + 0.5f) / 65536.0f;
+            toSrgb8[i] = quantize(linearToSrgb(mid));
+            toSrgb8[65536 + i] = quantize(mid);
+        }
+        std::memset(toSrgb8 + 2 * 65536,0,4);
+    }
+    static uint8_t quantize(float v){
+        return static_cast<uint8_t>(std::min(255.0f,std::max(0.0f,v * 255.0f + 0.5f)));
+    }
+};
+
+inline const Tables& tables(){
+    static const Tables t;
+    return t;
+}
+
+//round(c * a / 255),对所有 8 位的 c 和 a 都是精确的
+inline uint8_t mulDiv255(unsigned c,unsigned a){
+    unsigned x = c * a + 128;
+    return static_cast<uint8_t>((x + (x >> 8)) >> 8);
+}
+
+//16 位定点的线性值区间的下标,超出 [0,1] 时取最近的端点,NaN 取 0
+inline uint32_t linearIndex(float v){
+    v = v > 0.0f ? v : 0.0f;
+    v = v < 1.0f ? v : 1.0f;
+    return std::min(65535u,static_cast<uint32_t>(v * 65536.0f));
+}
+
+/**
+  标量参考实现,也是 SIMD 实现处理不足一组的剩余像素时使用的代码
+  */
+namespace scalar {
+
+inline void expandRgbToRgba(const uint8_t* rgb,uint8_t* rgba,size_t pixels){
+    for(size_t i = 0;i < pixels;i++){
+        rgba[i * 4] = rgb[i * 3];
+        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+inline void premultiplyAlpha(uint8_t* rgba,size_t pixels){
+    for(size_t i = 0;i < pixels;i++){
+        uint8_t* p = rgba + i * 4;
+        p[0] = mulDiv255(p[0],p[3]);
+        p[1] = mulDiv255(p[1],p[3]);
+        p[2] = mulDiv255(p[2],p[3]);
+    }
+}
+
+//颜色通道转换到线性值,alpha 通道归一化
+inline void srgbToLinear(const uint8_t* rgba,float* linear,size_t pixels){
+    const Tables& t = tables();
+    for(size_t i = 0;i < pixels;i++){
+        linear[i * 4] = t.toLinear[rgba[i * 4]];
+        linear[i * 4 + 1] = t.toLinear[rgba[i * 4 + 1]];
+        linear[i * 4 + 2] = t.toLinear[rgba[i * 4 + 2]];
+        linear[i * 4 + 3] = t.toLinear[256 + rgba[i * 4 + 3]];
+    }
+}
+
+inline void linearToSrgb(const float* linear,uint8_t* rgba,size_t pixels){
+    const Tables& t = tables();
+    for(size_t i = 0;i < pixels;i++){
+        rgba[i * 4] = t.toSrgb8[linearIndex(linear[i * 4])];
+        rgba[i * 4 + 1] = t.toSrgb8[linearIndex(linear[i * 4 + 1])];
+        rgba[i * 4 + 2] = t.toSrgb8[linearIndex(linear[i * 4 + 2])];
+        rgba[i * 4 + 3] = t.toSrgb8[65536 + linearIndex(linear[i * 4 + 3])];
+    }
+}
+
+/**
+  计算缩小后的一个像素.颜色在 16 位定点的线性空间中求平均,alpha 直接求平均.
+  奇数尺寸时最后一行或一列与前一行或一列合并
+  */
+inline void downsamplePixel(const uint8_t* src,uint32_t srcWidth,uint32_t srcHeight,
+                            uint32_t x,uint32_t y,uint8_t* dst){
+    const Tables& t = tables();
+    const uint32_t dstWidth = std::max(1u,srcWidth / 2);
+    const uint32_t dstHeight = std::max(1u,srcHeight / 2);
+    uint32_t y0 = std::min(y * 2,srcHeight - 1);
+    uint32_t y1 = (y == dstHeight - 1) ? srcHeight - 1 : std::min(y0 + 1,srcHeight - 1);
+    uint32_t x0 = std::min(x * 2,srcWidth - 1);
+    uint32_t x1 = (x == dstWidth - 1) ? srcWidth - 1 : std::min(x0 + 1,srcWidth - 1);
+    uint32_t sum[4] = {0,0,0,0};
+    uint32_t count = 0;
+    for(uint32_t sy = y0;sy <= y1;sy++){
+        for(uint32_t sx = x0;sx <= x1;sx++){
+            const uint8_t* p = src + (size_t(sy) * srcWidth + sx) * 4;
+            sum[0] += t.toLinear16[p[0]];
+            sum[1] += t.toLinear16[p[1]];
+            sum[2] += t.toLinear16[p[2]];
+            sum[3] += p[3];
+            count++;
+        }
+    }
+    for(int c = 0;c < 3;c++){
+        dst[c] = t.toSrgb8[(sum[c] + count / 2) / count];
+    }
+    dst[3] = static_cast<uint8_t>((sum[3] + count / 2) / count);
+}
+
+//dst 的大小为 max(1,srcWidth/2) x max(1,srcHeight/2)
+inline void downsampleSrgb(const uint8_t* src,uint32_t srcWidth,uint32_t srcHeight,
+                           uint8_t* dst){
+    const uint32_t dstWidth = std::max(1u,srcWidth / 2);
+    const uint32_t dstHeight = std::max(1u,srcHeight / 2);
+    for(uint32_t y = 0;y < dstHeight;y++){
+        for(uint32_t x = 0;x < dstWidth;x++){
+            downsamplePixel(src,srcWidth,srcHeight,x,y,
+                            dst + (size_t(y) * dstWidth + x) * 4);
+        }
+    }
+}
+
+} // namespace scalar
+
+#if defined(IMAGEKERNELS_X86)
+namespace sse41 {
+
+IMAGEKERNELS_TARGET("sse4.1")
+inline void expandRgbToRgba(const uint8_t* rgb,uint8_t* rgba,size_t pixels){
+    const __m128i shuffle = _mm_setr_epi8(0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+    size_t i = 0;
+    //每次读取 16 个字节,使用其中 4 个像素的 12 个字节
+    for(;i + 6 <= pixels;i += 4){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4),
+                         _mm_or_si128(_mm_shuffle_epi8(v,shuffle),alpha));
+    }
+    scalar::expandRgbToRgba(rgb + i * 3,rgba + i * 4,pixels - i);
+}
+
+IMAGEKERNELS_TARGET("sse4.1")
+inline __m128i mulDiv255(__m128i c,__m128i a){
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(c,a),_mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x,_mm_srli_epi16(x,8)),8);
+}
+
+IMAGEKERNELS_TARGET("sse4.1")
+inline void premultiplyAlpha(uint8_t* rgba,size_t pixels){
+    //把每个像素的 alpha 复制到颜色通道,alpha 通道乘以 255 保持不变
+    const __m128i spread = _mm_setr_epi8(3,3,3,-1,7,7,7,-1,11,11,11,-1,15,15,15,-1);
+    const __m128i one = _mm_set1_epi32(static_cast<int>(0xff000000));
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(;i + 4 <= pixels;i += 4){
+        __m128i* p = reinterpret_cast<__m128i*>(rgba + i * 4);
+        __m128i v = _mm_loadu_si128(p);
+        __m128i a = _mm_or_si128(_mm_shuffle_epi8(v,spread),one);
+        __m128i lo = mulDiv255(_mm_unpacklo_epi8(v,zero),_mm_unpacklo_epi8(a,zero));
+        __m128i hi = mulDiv255(_mm_unpackhi_epi8(v,zero),_mm_unpackhi_epi8(a,zero));
+        _mm_storeu_si128(p,_mm_packus_epi16(lo,hi));
+    }
+    scalar::premultiplyAlpha(rgba + i * 4,pixels - i);
+}
+
+} // namespace sse41
+
+namespace avx2 {
+
+IMAGEKERNELS_TARGET("avx2")
+inline void expandRgbToRgba(const uint8_t* rgb,uint8_t* rgba,size_t pixels){
+    //vpshufb 只在 128 位内重排,两半分别读取 4 个像素
+    const __m256i shuffle = _mm256_setr_epi8(0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1,
+                                             0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000));
+    size_t i = 0;
+    for(;i + 10 <= pixels;i += 8){
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3 + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo),hi,1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i * 4),
+                            _mm256_or_si256(_mm256_shuffle_epi8(v,shuffle),alpha));
+    }
+    sse41::expandRgbToRgba(rgb + i * 3,rgba + i * 4,pixels - i);
+}
+
+IMAGEKERNELS_TARGET("avx2")
+inline __m256i mulDiv255(__m256i c,__m256i a){
+    __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(c,a),_mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x,_mm256_srli_epi16(x,8)),8);
+}
+
+IMAGEKERNELS_TARGET("avx2")
+inline void premultiplyAlpha(uint8_t* rgba,size_t pixels){
+    const __m256i spread = _mm256_setr_epi8(3,3,3,-1,7,7,7,-1,11,11,11,-1,15,15,15,-1,
+                                            3,3,3,-1,7,7,7,-1,11,11,11,-1,15,15,15,-1);
+    const __m256i one = _mm256_set1_epi32(static_cast<int>(0xff000000));
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for(;i + 8 <= pixels;i += 8){
+        __m256i* p = reinterpret_cast<__m256i*>(rgba + i * 4);
+        __m256i v = _mm256_loadu_si256(p);
+        __m256i a = _mm256_or_si256(_mm256_shuffle_epi8(v,spread),one);
+        __m256i lo = mulDiv255(_mm256_unpacklo_epi8(v,zero),_mm256_unpacklo_epi8(a,zero));
+        __m256i hi = mulDiv255(_mm256_unpackhi_epi8(v,zero),_mm256_unpackhi_epi8(a,zero));
+        _mm256_storeu_si256(p,_mm256_packus_epi16(lo,hi));
+    }
+    sse41::premultiplyAlpha(rgba + i * 4,pixels - i);
+}
+
+//8 个 32 位整数的低 8 位写入 dst
+IMAGEKERNELS_TARGET("avx2")
+inline void storeBytes(uint8_t* dst,__m256i v){
+    __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(v),
+                                      _mm256_extracti128_si256(v,1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst),_mm_packus_epi16(packed,packed));
+}
+
+IMAGEKERNELS_TARGET("avx2")
+inline void srgbToLinear(const uint8_t* rgba,float* linear,size_t pixels){
+    const Tables& t = tables();
+    //alpha 通道的下标加 256,从表的后半部分读取归一化的值
+    const __m256i alphaOffset = _mm256_setr_epi32(0,0,0,256,0,0,0,256);
+    size_t i = 0;
+    for(;i + 2 <= pixels;i += 2){
+        __m256i index = _mm256_cvtepu8_epi32(
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rgba + i * 4)));
+        index = _mm256_add_epi32(index,alphaOffset);
+        _mm256_storeu_ps(linear + i * 4,_mm256_i32gather_ps(t.toLinear,index,4));
+    }
+    scalar::srgbToLinear(rgba + i * 4,linear + i * 4,pixels - i);
+}
+
+IMAGEKERNELS_TARGET("avx2")
+inline void linearToSrgb(const float* linear,uint8_t* rgba,size_t pixels){
+    const Tables& t = tables();
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(65536.0f);
+    const __m256i maxIndex = _mm256_set1_epi32(65535);
+    const __m256i alphaOffset = _mm256_setr_epi32(0,0,0,65536,0,0,0,65536);
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const int* table = reinterpret_cast<const int*>(t.toSrgb8);
+    size_t i = 0;
+    for(;i + 2 <= pixels;i += 2){
+        //与 linearIndex 相同:max/min 的参数顺序使 NaN 变为 0
+        __m256 v = _mm256_loadu_ps(linear + i * 4);
+        v = _mm256_min_ps(_mm256_max_ps(v,zero),one);
+        __m256i index = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(v,scale)),
+                                         maxIndex);
+        index = _mm256_add_epi32(index,alphaOffset);
+        __m256i encoded = _mm256_and_si256(_mm256_i32gather_epi32(table,index,1),byteMask);
+        storeBytes(rgba + i * 4,encoded);
+    }
+    scalar::linearToSrgb(linear + i * 4,rgba + i * 4,pixels - i);
+}
+
+//两个相邻像素的 8 个字节,颜色通道转换为 16 位定点的线性值,alpha 不变
+IMAGEKERNELS_TARGET("avx2")
+inline __m256i loadLinear16(const Tables& t,const uint8_t* p){
+    __m256i bytes = _mm256_cvtepu8_epi32(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    __m256i linear = _mm256_i32gather_epi32(
+                reinterpret_cast<const int*>(t.toLinear16),bytes,4);
+    return _mm256_blend_epi32(linear,bytes,0x88);
+}
+
+IMAGEKERNELS_TARGET("avx2")
+inline void downsampleSrgb(const uint8_t* src,uint32_t srcWidth,uint32_t srcHeight,
+                           uint8_t* dst){
+    const Tables& t = tables();
+    const uint32_t dstWidth = std::max(1u,srcWidth / 2);
+    const uint32_t dstHeight = std::max(1u,srcHeight / 2);
+    //只处理恰好覆盖 2x2 个源像素的目标像素,奇数尺寸的最后一行和一列由标量代码处理
+    const uint32_t simdWidth = srcWidth % 2 == 0 ? dstWidth : dstWidth - 1;
+    const uint32_t simdHeight = srcHeight % 2 == 0 ? dstHeight : dstHeight - 1;
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const int* table = reinterpret_cast<const int*>(t.toSrgb8);
+    for(uint32_t y = 0;y < dstHeight;y++){
+        uint8_t* d = dst + size_t(y) * dstWidth * 4;
+        uint32_t x = 0;
+        if(y < simdHeight){
+            const uint8_t* row0 = src + size_t(y) * 2 * srcWidth * 4;
+            const uint8_t* row1 = row0 + size_t(srcWidth) * 4;
+            //每次计算两个目标像素
+            for(;x + 2 <= simdWidth;x += 2){
+                __m256i a = _mm256_add_epi32(loadLinear16(t,row0 + x * 8),
+                                             loadLinear16(t,row1 + x * 8));
+                __m256i b = _mm256_add_epi32(loadLinear16(t,row0 + x * 8 + 8),
+                                             loadLinear16(t,row1 + x * 8 + 8));
+                __m256i sum = _mm256_add_epi32(_mm256_permute2x128_si256(a,b,0x20),
+                                               _mm256_permute2x128_si256(a,b,0x31));
+                __m256i average = _mm256_srli_epi32(_mm256_add_epi32(sum,two),2);
+                __m256i encoded = _mm256_and_si256(
+                            _mm256_i32gather_epi32(table,average,1),byteMask);
+                storeBytes(d + x * 4,_mm256_blend_epi32(encoded,average,0x88));
+            }
+        }
+        for(;x < dstWidth;x++){
+            scalar::downsamplePixel(src,srcWidth,srcHeight,x,y,d + x * 4);
+        }
+    }
+}
+
+} // namespace avx2
+#endif // IMAGEKERNELS_X86
+
+#if defined(IMAGEKERNELS_NEON)
+namespace neon {
+
+inline void expandRgbToRgba(const uint8_t* rgb,uint8_t* rgba,size_t pixels){
+    size_t i = 0;
+    for(;i + 16 <= pixels;i += 16){
+        uint8x16x3_t v = vld3q_u8(rgb + i * 3);
+        uint8x16x4_t out;
+        out.val[0] = v.val[0];
+        out.val[1] = v.val[1];
+        out.val[2] = v.val[2];
+        out.val[3] = vdupq_n_u8(255);
+        vst4q_u8(rgba + i * 4,out);
+    }
+    scalar::expandRgbToRgba(rgb + i * 3,rgba + i * 4,pixels - i);
+}
+
+//(t + ((t + 128) >> 8) + 128) >> 8,与标量的 mulDiv255 相同
+inline uint8x16_t mulDiv255(uint8x16_t c,uint8x16_t a){
+    uint16x8_t lo = vmull_u8(vget_low_u8(c),vget_low_u8(a));
+    uint16x8_t hi = vmull_u8(vget_high_u8(c),vget_high_u8(a));
+    return vcombine_u8(vrshrn_n_u16(vrsraq_n_u16(lo,lo,8),8),
+                       vrshrn_n_u16(vrsraq_n_u16(hi,hi,8),8));
+}
+
+inline void premultiplyAlpha(uint8_t* rgba,size_t pixels){
+    size_t i = 0;
+    for(;i + 16 <= pixels;i += 16){
+        uint8x16x4_t v = vld4q_u8(rgba + i * 4);
+        v.val[0] = mulDiv255(v.val[0],v.val[3]);
+        v.val[1] = mulDiv255(v.val[1],v.val[3]);
+        v.val[2] = mulDiv255(v.val[2],v.val[3]);
+        vst4q_u8(rgba + i * 4,v);
+    }
+    scalar::premultiplyAlpha(rgba + i * 4,pixels - i);
+}
+
+} // namespace neon
+#endif // IMAGEKERNELS_NEON
+
+} // namespace imagekernels
+
+//一组内核的函数指针,同一个指令集没有的内核使用标量实现
+struct ImageKernels{
+    ImageIsa isa;
+    void (*expandRgbToRgba)(const uint8_t* rgb,uint8_t* rgba,size_t pixels);
+    void (*premultiplyAlpha)(uint8_t* rgba,size_t pixels);
+    void (*srgbToLinear)(const uint8_t* rgba,float* linear,size_t pixels);
+    void (*linearToSrgb)(const float* linear,uint8_t* rgba,size_t pixels);
+    void (*downsampleSrgb)(const uint8_t* src,uint32_t srcWidth,uint32_t srcHeight,
+                           uint8_t* dst);
+};
+
+//指定指令集的内核,调用方需要先用 imageIsaSupported 检查
+inline ImageKernels imageKernelsFor(ImageIsa isa){
+    using namespace imagekernels;
+    ImageKernels kernels = {
+        isa,
+        scalar::expandRgbToRgba,
+        scalar::premultiplyAlpha,
+        scalar::srgbToLinear,
+        scalar::linearToSrgb,
+        scalar::downsampleSrgb
+    };
+#if defined(IMAGEKERNELS_X86)
+    if(isa == ImageIsa::Sse41){
+        kernels.expandRgbToRgba = sse41::expandRgbToRgba;
+        kernels.premultiplyAlpha = sse41::premultiplyAlpha;
+    }else if(isa == ImageIsa::Avx2){
+        kernels.expandRgbToRgba = avx2::expandRgbToRgba;
+        kernels.premultiplyAlpha = avx2::premultiplyAlpha;
+        kernels.srgbToLinear = avx2::srgbToLinear;
+        kernels.linearToSrgb = avx2::linearToSrgb;
+        kernels.downsampleSrgb = avx2::downsampleSrgb;
+    }
+#endif
+#if defined(IMAGEKERNELS_NEON)
+    if(isa == ImageIsa::Neon){
+        kernels.expandRgbToRgba = neon::expandRgbToRgba;
+        kernels.premultiplyAlpha = neon::premultiplyAlpha;
+    }
+#endif
+    return kernels;
+}
+
+//当前 CPU 上最快的内核,第一次调用时检测
+inline const ImageKernels& imageKernels(){
+    static const ImageKernels kernels = imageKernelsFor(bestImageIsa());
+    return kernels;
+}
+
+//把 1 到 4 个通道的 8 位图像扩展为 RGBA8,灰度复制到颜色通道,没有 alpha 时为 255
+inline void expandToRgba(const uint8_t* src,int channels,uint8_t* rgba,size_t pixels){
+    switch(channels){
+    case 4:
+        std::memcpy(rgba,src,pixels * 4);
+        break;
+    case 3:
+        imageKernels().expandRgbToRgba(src,rgba,pixels);
+        break;
+    default:
+        for(size_t i = 0;i < pixels;i++){
+            uint8_t gray = src[i * channels];
+            rgba[i * 4] = gray;
+            rgba[i * 4 + 1] = gray;
+            rgba[i * 4 + 2] = gray;
+            rgba[i * 4 + 3] = channels == 2 ? src[i * 2 + 1] : 255;
+        }
+        break;
+    }
+}
+
+#endif // IMAGEKERNELS_H
@@ -0,0 +1,192 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <stb_image_write.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+
+#include "imagekernels.h"
+
+//读回的帧保存的文件格式
+enum class ImageFileFormat{
+    Png,
+    Exr
+};
+
+inline ImageFileFormat parseImageFileFormat(const std::string& name){
+    if(name == "png"){
+        return ImageFileFormat::Png;
+    }else if(name == "exr"){
+        return ImageFileFormat::Exr;
+    }
+    throw std::runtime_error("unsupported image file format: " + name +
+                             " (expected png or exr)");
+}
+
+inline const char* imageFileExtension(ImageFileFormat format){
+    return format == ImageFileFormat::Png ? ".png" : ".exr";
+}
+
+//float 转换为半精度浮点数,舍入到最近的偶数
+inline uint16_t floatToHalf(float value){
+    uint32_t bits;
+    std::memcpy(&bits,&value,sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t rawExponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    if(rawExponent == 0xff){
+        //无穷大和 NaN
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    int32_t exponent = static_cast<int32_t>(rawExponent) - 127 + 15;
+    if(exponent >= 31){
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    if(exponent <= 0){
+        //半精度的非规格化数
+        if(exponent < -10){
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (half & 1))){
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) |
+            (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    //进位到指数时结果仍然正确
+    if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1))){
+        half++;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+//以 RGBA8 保存 PNG 文件
+inline void writePng(const std::string& filename,uint32_t width,
+                     uint32_t height,const uint8_t* rgba){
+    if(!stbi_write_png(filename.c_str(),static_cast<int>(width),
+                       static_cast<int>(height),4,rgba,
+                       static_cast<int>(width * 4))){
+        throw std::runtime_error("failed to write file: " + filename);
+    }
+}
+
+/**
+  以无压缩的扫描线格式保存 OpenEXR 文件,通道为半精度的 A,B,G,R
+  (EXR 要求通道按名称排序).rgba 为线性的浮点颜色,每个像素 4 个值.
+  文件结构:魔数和版本,以空字符串结尾的属性列表,每一行的偏移表,
+  然后是每一行的数据:行号,数据大小,依次存放各个通道这一行的值
+  */
+inline void writeExr(const std::string& filename,uint32_t width,
+                     uint32_t height,const float* rgba){
+    std::vector<uint8_t> out;
+    auto put32 = [&out](uint32_t v){
+        for(int i = 0;i < 4;i++){
+            out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        }
+    };
+    auto put64 = [&out](uint64_t v){
+        for(int i = 0;i < 8;i++){
+            out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        }
+    };
+    auto putString = [&out](const char* s){
+        out.insert(out.end(),s,s + std::strlen(s) + 1);
+    };
+    auto putFloat = [&put32](float f){
+        uint32_t bits;
+        std::memcpy(&bits,&f,sizeof(bits));
+        put32(bits);
+    };
+    auto beginAttribute = [&](const char* name,const char* type,uint32_t size){
+        putString(name);
+        putString(type);
+        put32(size);
+    };
+    const char* channelNames[] = {"A","B","G","R"};
+    const int channelSource[] = {3,2,1,0};
+
+    put32(20000630);//魔数 0x762f3101
+    put32(2);//版本 2,单部分扫描线文件
+    //每个通道:名称,像素类型(1 为半精度),pLinear,3 个保留字节,x/y 采样率
+    beginAttribute("channels","chlist",4 * (2 + 16) + 1);
+    for(const char* name : channelNames){
+        putString(name);
+        put32(1);
+        put32(0);
+        put32(1);
+        put32(1);
+    }
+    out.push_back(0);
+    beginAttribute("compression","compression",1);
+    out.push_back(0);//NO_COMPRESSION
+    beginAttribute("dataWindow","box2i",16);
+    put32(0);put32(0);put32(width - 1);put32(height - 1);
+    beginAttribute("displayWindow","box2i",16);
+    put32(0);put32(0);put32(width - 1);put32(height - 1);
+    beginAttribute("lineOrder","lineOrder",1);
+    out.push_back(0);//INCREASING_Y
+    beginAttribute("pixelAspectRatio","float",4);
+    putFloat(1.0f);
+    beginAttribute("screenWindowCenter","v2f",8);
+    putFloat(0.0f);putFloat(0.0f);
+    beginAttribute("screenWindowWidth","float",4);
+    putFloat(1.0f);
+    out.push_back(0);//属性列表结束
+
+    //无压缩时每一块只有一行
+    const uint32_t lineBytes = width * 4 * sizeof(uint16_t);
+    uint64_t offset = out.size() + uint64_t(height) * sizeof(uint64_t);
+    for(uint32_t y = 0;y < height;y++){
+        put64(offset);
+        offset += 8 + lineBytes;
+    }
+    for(uint32_t y = 0;y < height;y++){
+        put32(y);
+        put32(lineBytes);
+        const float* row = rgba + size_t(y) * width * 4;
+        for(int c = 0;c < 4;c++){
+            for(uint32_t x = 0;x < width;x++){
+                uint16_t h = floatToHalf(row[x * 4 + channelSource[c]]);
+                out.push_back(static_cast<uint8_t>(h));
+                out.push_back(static_cast<uint8_t>(h >> 8));
+            }
+        }
+    }
+
+    std::ofstream file(filename,std::ios::binary);
+    if(!file){
+        throw std::runtime_error("failed to open file: " + filename);
+    }
+    file.write(reinterpret_cast<const char*>(out.data()),out.size());
+    if(!file){
+        throw std::runtime_error("failed to write file: " + filename);
+    }
+}
+
+/**
+  保存 RGBA8 图像.颜色值是显示用的 sRGB 编码值,PNG 直接保存;
+  EXR 保存线性值,所以颜色通道先转换到线性空间,alpha 通道直接归一化
+  */
+inline void writeImage(const std::string& filename,ImageFileFormat format,
+                       uint32_t width,uint32_t height,const uint8_t* rgba){
+    if(format == ImageFileFormat::Png){
+        writePng(filename,width,height,rgba);
+        return;
+    }
+    std::vector<float> pixels(size_t(width) * height * 4);
+    imageKernels().srgbToLinear(rgba,pixels.data(),size_t(width) * height);
+    writeExr(filename,width,height,pixels.data());
+}
+
+#endif // IMAGEWRITER_H
@@ -0,0 +1,143 @@
+#ifndef JOBBENCHMARK_H
+#define JOBBENCHMARK_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+#include "jobsystem.h"
+#include "framestats.h"
+
+/**
+  任务调度器的微基准测试,每项重复多次取中位数:
+  空任务:提交并等待大量空任务,每个任务的平均开销,反映调度本身的代价
+  扇出/扇入:提交一批计算任务,再用依赖提交一个汇总任务,与单线程执行比较
+  嵌套 parallelFor:外层每一项内部再并行循环,与单线程执行比较
+  */
+namespace jobbench {
+
+//一小段不会被优化掉的计算
+inline double work(size_t seed,unsigned iterations){
+    double value = static_cast<double>(seed);
+    for(unsigned i = 0;i < iterations;i++){
+        value = std::sqrt(value + i);
+    }
+    return value;
+}
+
+template<typename F>
+double medianMs(unsigned repeats,F function){
+    SampleStats stats;
+    for(unsigned i = 0;i < repeats;i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        function();
+        stats.add(std::chrono::duration<double,std::milli>(
+                      std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return stats.percentile(50);
+}
+
+} // namespace jobbench
+
+inline void runJobBenchmark(unsigned threadCount){
+    using namespace jobbench;
+    JobSystem jobs(threadCount);
+    const unsigned repeats = 15;
+    std::cout<<"job system: "<<jobs.threadCount()<<" threads"<<std::endl;
+    std::cout<<std::fixed<<std::setprecision(3);
+
+    //空任务的开销
+    const size_t emptyJobs = 100000;
+    double emptyMs = medianMs(repeats,[&](){
+        JobCounter counter;
+        for(size_t i = 0;i < emptyJobs;i++){
+            jobs.run([](){},&counter);
+        }
+        jobs.wait(counter);
+    });
+    std::cout<<"empty jobs:       "<<emptyJobs<<" jobs, "
+             <<emptyMs * 1e6 / emptyJobs<<" ns/job"<<std::endl;
+
+    //扇出/扇入
+    const size_t fanOut = 256;
+    const unsigned fanWork = 20000;
+    std::vector<double> partial(fanOut);
+    double total = 0.0;
+    double fanSerialMs = medianMs(repeats,[&](){
+        for(size_t i = 0;i < fanOut;i++){
+            partial[i] = work(i,fanWork);
+        }
+        total = 0.0;
+        for(double p : partial){
+            total += p;
+        }
+    });
+    double fanMs = medianMs(repeats,[&](){
+        JobCounter produced;
+        JobCounter reduced;
+        for(size_t i = 0;i < fanOut;i++){
+            jobs.run([&partial,i,fanWork](){
+                partial[i] = work(i,fanWork);
+            },&produced);
+        }
+        jobs.runAfter(produced,[&partial,&total](){
+            total = 0.0;
+            for(double p : partial){
+                total += p;
+            }
+        },&reduced);
+        jobs.wait(reduced);
+    });
+    std::cout<<"fan-out/fan-in:   "<<fanOut<<" jobs, "<<fanMs<<" ms (serial "
+             <<fanSerialMs<<" ms, speedup "<<fanSerialMs / fanMs<<"x)"<<std::endl;
+
+    //嵌套 parallelFor
+    const size_t outer = 64;
+    const size_t inner = 4096;
+    const unsigned nestedWork = 64;
+    std::vector<double> rows(outer);
+    double nestedSerialMs = medianMs(repeats,[&](){
+        for(size_t i = 0;i < outer;i++){
+            double sum = 0.0;
+            for(size_t j = 0;j < inner;j++){
+                sum += work(i * inner + j,nestedWork);
+            }
+            rows[i] = sum;
+        }
+    });
+    double nestedMs = medianMs(repeats,[&](){
+        jobs.parallelFor(0,outer,1,[&](size_t first,size_t last){
+            for(size_t i = first;i < last;i++){
+                std::vector<double> chunks(inner / 256);
+                jobs.parallelFor(0,chunks.size(),1,[&](size_t c0,size_t c1){
+                    for(size_t c = c0;c < c1;c++){
+                        double sum = 0.0;
+                        for(size_t j = c * 256;j < (c + 1) * 256;j++){
+                            sum += work(i * inner + j,nestedWork);
+                        }
+                        chunks[c] = sum;
+                    }
+                });
+                double sum = 0.0;
+                for(double chunk : chunks){
+                    sum += chunk;
+                }
+                rows[i] = sum;
+            }
+        });
+    });
+    std::cout<<"nested parallelFor: "<<outer<<"x"<<inner<<" items, "<<nestedMs
+             <<" ms (serial "<<nestedSerialMs<<" ms, speedup "
+             <<nestedSerialMs / nestedMs<<"x)"<<std::endl;
+    //使用结果,避免计算被优化掉
+    double check = total;
+    for(double row : rows){
+        check += row;
+    }
+    std::cout<<"checksum: "<<check<<std::endl;
+}
+
+#endif // JOBBENCHMARK_H
@@ -0,0 +1,280 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+
+/**
+  计数器,记录一组任务中还没有执行完的个数.
+  等待计数器归零就是等待这组任务完成;
+  也可以作为依赖,用 JobSystem::runAfter 提交归零后才开始执行的任务.
+  有任务依赖一个计数器时,不能在它归零之前再向它加入新的任务
+  */
+class JobCounter{
+public:
+    JobCounter(){}
+    //最后一个任务减到零时仍持有锁,等它释放后才能销毁
+    ~JobCounter(){
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool done() const { return value.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> value{0};
+    std::mutex mutex;
+    std::vector<std::function<void()>> continuations;//归零后提交的任务
+};
+
+/**
+  任务窃取的任务调度器.
+  每个线程(包括创建调度器的主线程)有一个自己的任务队列:
+  线程从自己队列的尾部取出最近提交的任务(缓存中的数据还是热的),
+  自己的队列为空时从其他线程队列的头部窃取最早提交的任务(通常是较大的一块工作).
+  wait 等待计数器时当前线程也执行任务,所以任务中可以再提交任务并等待它们
+  (例如嵌套的 parallelFor),不会因为所有线程都在等待而死锁.
+  没有任务时工作线程睡眠,不占用 CPU.
+  任务中抛出的异常会被丢弃,任务需要自己处理错误
+  */
+class JobSystem{
+public:
+    //threadCount 为工作线程数,0 表示硬件线程数减一(主线程也参与执行)
+    explicit JobSystem(unsigned threadCount = 0){
+        if(threadCount == 0){
+            threadCount = std::max(1u,std::thread::hardware_concurrency()) - 1;
+        }
+        //队列 0 属于创建调度器的线程,也给不属于调度器的其他线程提交任务使用
+        queues.resize(threadCount + 1);
+        for(auto& queue : queues){
+            queue.reset(new Queue());
+        }
+        threadOwner() = this;
+        threadIndex() = 0;
+        for(unsigned i = 1;i <= threadCount;i++){
+            threads.emplace_back([this,i](){ workerLoop(i); });
+        }
+    }
+    ~JobSystem(){
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for(auto& thread : threads){
+            thread.join();
+        }
+        if(threadOwner() == this){
+            threadOwner() = nullptr;
+        }
+    }
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    //参与执行任务的线程数,包括主线程
+    size_t threadCount() const { return queues.size(); }
+
+    //提交一个任务,counter 不为空时任务执行完后计数器减一
+    void run(std::function<void()> job,JobCounter* counter = nullptr){
+        if(counter != nullptr){
+            counter->value.fetch_add(1,std::memory_order_relaxed);
+        }
+        push(Job{std::move(job),counter});
+    }
+    //dependency 归零后才提交任务,counter 在调用时就加一
+    void runAfter(JobCounter& dependency,std::function<void()> job,
+                  JobCounter* counter = nullptr){
+        if(counter != nullptr){
+            counter->value.fetch_add(1,std::memory_order_relaxed);
+        }
+        std::function<void()> submit = [this,job,counter](){
+            push(Job{job,counter});
+        };
+        {
+            std::lock_guard<std::mutex> lock(dependency.mutex);
+            if(!dependency.done()){
+                dependency.continuations.push_back(std::move(submit));
+                return;
+            }
+        }
+        submit();
+    }
+    //等待计数器归零,等待时当前线程也执行任务
+    void wait(const JobCounter& counter){
+        unsigned spins = 0;
+        while(!counter.done()){
+            if(tryRunOne()){
+                spins = 0;
+            }else if(++spins > 64){
+                std::this_thread::yield();
+            }
+        }
+    }
+    //执行一个等待中的任务,没有任务时返回 false
+    bool tryRunOne(){
+        Job job;
+        if(!findJob(currentQueue(),job)){
+            return false;
+        }
+        execute(job);
+        return true;
+    }
+    /**
+    把 [begin,end) 分成最多 grain 个元素的块并行执行 body(first,last),返回时全部完成.
+    块由分割任务递归地对半分出,先提交的大块被其他线程窃取后在那里继续分割,
+    这样不需要提交线程一次产生所有的块
+      */
+    void parallelFor(size_t begin,size_t end,size_t grain,
+                     const std::function<void(size_t,size_t)>& body){
+        if(begin >= end){
+            return;
+        }
+        JobCounter counter;
+        split(begin,end,std::max<size_t>(grain,1),body,counter);
+        wait(counter);
+    }
+
+private:
+    struct Job{
+        std::function<void()> function;
+        JobCounter* counter;
+    };
+    struct Queue{
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    //当前线程所属的调度器和队列序号,不属于这个调度器的线程使用队列 0
+    static JobSystem*& threadOwner(){
+        thread_local JobSystem* value = nullptr;
+        return value;
+    }
+    static size_t& threadIndex(){
+        thread_local size_t value = 0;
+        return value;
+    }
+    size_t currentQueue() const {
+        return threadOwner() == this ? threadIndex() : 0;
+    }
+
+    void split(size_t begin,size_t end,size_t grain,
+               const std::function<void(size_t,size_t)>& body,JobCounter& counter){
+        while(end - begin > grain){
+            size_t middle = begin + (end - begin) / 2;
+            run([this,middle,end,grain,&body,&counter](){
+                split(middle,end,grain,body,counter);
+            },&counter);
+            end = middle;
+        }
+        body(begin,end);
+    }
+
+    void push(Job job){
+        //先增加计数,pending 不会因为任务刚放入就被取走而小于 0
+        pending.fetch_add(1);
+        {
+            Queue& queue = *queues[currentQueue()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+        }
+        //睡眠的线程在加锁后检查 pending,这里加锁通知不会丢失唤醒
+        if(sleeping.load() > 0){
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wakeUp.notify_one();
+        }
+    }
+    bool findJob(size_t self,Job& job){
+        if(pending.load(std::memory_order_relaxed) == 0){
+            return false;
+        }
+        {
+            Queue& queue = *queues[self];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if(!queue.jobs.empty()){
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+                pending.fetch_sub(1);
+                return true;
+            }
+        }
+        //从下一个线程开始依次尝试窃取,避免所有线程都先窃取同一个队列
+        for(size_t i = 1;i < queues.size();i++){
+            Queue& victim = *queues[(self + i) % queues.size()];
+            std::unique_lock<std::mutex> lock(victim.mutex,std::try_to_lock);
+            if(lock.owns_lock() && !victim.jobs.empty()){
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                pending.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+    void execute(Job& job){
+        try{
+            job.function();
+        }catch(...){
+        }
+        JobCounter* counter = job.counter;
+        if(counter == nullptr){
+            return;
+        }
+        //计数器归零后等待的线程可能立即销毁它,解锁之后不能再访问
+        std::vector<std::function<void()>> continuations;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            if(counter->value.fetch_sub(1,std::memory_order_acq_rel) == 1){
+                continuations.swap(counter->continuations);
+            }
+        }
+        for(auto& submit : continuations){
+            submit();
+        }
+    }
+    void workerLoop(size_t index){
+        threadOwner() = this;
+        threadIndex() = index;
+        unsigned spins = 0;
+        for(;;){
+            Job job;
+            if(findJob(index,job)){
+                execute(job);
+                spins = 0;
+                continue;
+            }
+            //短暂自旋,新任务通常很快就会到来
+            if(++spins < 64){
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping.fetch_add(1);
+            wakeUp.wait(lock,[this](){ return stopping || pending.load() > 0; });
+            sleeping.fetch_sub(1);
+            if(stopping && pending.load() == 0){
+                return;
+            }
+            spins = 0;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<int> pending{0};//所有队列中的任务数
+    std::atomic<int> sleeping{0};
+    bool stopping = false;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+};
+
+#endif // JOBSYSTEM_H
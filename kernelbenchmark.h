@@ -0,0 +1,281 @@
+#ifndef KERNELBENCHMARK_H
+#define KERNELBENCHMARK_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+
+#include "imagekernels.h"
+#include "colorspace.h"
+#include "framestats.h"
+
+/**
+  图像处理内核的正确性检查和吞吐量测试:
+  1. 参考实现与精确的定义比较:预乘 alpha 对所有 65536 种输入与 round(c*a/255) 相同,
+     sRGB 编码值转换到线性值再转换回来不变,16 位定点的细化缩小与原来的浮点实现最多相差 1
+  2. 每个支持的指令集的 SIMD 实现与参考实现逐字节比较,包括奇数尺寸和超出范围的浮点数
+  3. 每个内核重复多次取中位数,输出每秒处理的输入数据量(GB/s)和相对标量实现的加速比
+  */
+namespace kernelbench {
+
+template<typename F>
+double medianMs(unsigned repeats,F function){
+    SampleStats stats;
+    for(unsigned i = 0;i < repeats;i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        function();
+        stats.add(std::chrono::duration<double,std::milli>(
+                      std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return stats.percentile(50);
+}
+
+inline std::vector<uint8_t> randomBytes(size_t count,uint32_t seed){
+    std::mt19937 random(seed);
+    std::vector<uint8_t> bytes(count);
+    for(uint8_t& b : bytes){
+        b = static_cast<uint8_t>(random() & 0xff);
+    }
+    return bytes;
+}
+
+//包括超出 [0,1] 的值,无穷大和 NaN
+inline std::vector<float> randomLinear(size_t count,uint32_t seed){
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> value(-0.25f,1.25f);
+    std::vector<float> linear(count);
+    for(size_t i = 0;i < count;i++){
+        switch(random() % 64){
+        case 0: linear[i] = std::numeric_limits<float>::quiet_NaN(); break;
+        case 1: linear[i] = std::numeric_limits<float>::infinity(); break;
+        case 2: linear[i] = -std::numeric_limits<float>::infinity(); break;
+        case 3: linear[i] = 1.0f; break;
+        default: linear[i] = value(random); break;
+        }
+    }
+    return linear;
+}
+
+//16 位定点实现之前的浮点实现,作为细化缩小的精度参照
+inline void downsampleSrgbFloat(const uint8_t* src,uint32_t srcWidth,uint32_t srcHeight,
+                                uint8_t* dst){
+    const uint32_t dstWidth = std::max(1u,srcWidth / 2);
+    const uint32_t dstHeight = std::max(1u,srcHeight / 2);
+    for(uint32_t y = 0;y < dstHeight;y++){
+        uint32_t y0 = std::min(y * 2,srcHeight - 1);
+        uint32_t y1 = (y == dstHeight - 1) ? srcHeight - 1 : std::min(y0 + 1,srcHeight - 1);
+        for(uint32_t x = 0;x < dstWidth;x++){
+            uint32_t x0 = std::min(x * 2,srcWidth - 1);
+            uint32_t x1 = (x == dstWidth - 1) ? srcWidth - 1 : std::min(x0 + 1,srcWidth - 1);
+            double sum[4] = {0.0,0.0,0.0,0.0};
+            uint32_t count = 0;
+            for(uint32_t sy = y0;sy <= y1;sy++){
+                for(uint32_t sx = x0;sx <= x1;sx++){
+                    const uint8_t* p = src + (size_t(sy) * srcWidth + sx) * 4;
+                    for(int c = 0;c < 3;c++){
+                        sum[c] += srgbToLinear(p[c] / 255.0f);
+                    }
+                    sum[3] += p[3];
+                    count++;
+                }
+            }
+            uint8_t* d = dst + (size_t(y) * dstWidth + x) * 4;
+            for(int c = 0;c < 3;c++){
+                float v = linearToSrgb(static_cast<float>(sum[c] / count));
+                d[c] = static_cast<uint8_t>(std::min(255.0f,std::max(0.0f,v * 255.0f + 0.5f)));
+            }
+            d[3] = static_cast<uint8_t>(sum[3] / count + 0.5);
+        }
+    }
+}
+
+inline size_t downsampledBytes(uint32_t width,uint32_t height){
+    return size_t(std::max(1u,width / 2)) * std::max(1u,height / 2) * 4;
+}
+
+//SIMD 实现与参考实现的结果是否逐字节相同
+inline bool matchesReference(const ImageKernels& kernels,const ImageKernels& reference){
+    const size_t counts[] = { 0,1,2,3,5,9,17,31,100003 };
+    for(size_t count : counts){
+        std::vector<uint8_t> rgb = randomBytes(count * 3,1);
+        std::vector<uint8_t> a(count * 4),b(count * 4);
+        kernels.expandRgbToRgba(rgb.data(),a.data(),count);
+        reference.expandRgbToRgba(rgb.data(),b.data(),count);
+        if(a != b) return false;
+
+        a = randomBytes(count * 4,2);
+        b = a;
+        kernels.premultiplyAlpha(a.data(),count);
+        reference.premultiplyAlpha(b.data(),count);
+        if(a != b) return false;
+
+        std::vector<float> fa(count * 4),fb(count * 4);
+        kernels.srgbToLinear(a.data(),fa.data(),count);
+        reference.srgbToLinear(a.data(),fb.data(),count);
+        if(fa != fb) return false;
+
+        std::vector<float> linear = randomLinear(count * 4,3);
+        kernels.linearToSrgb(linear.data(),a.data(),count);
+        reference.linearToSrgb(linear.data(),b.data(),count);
+        if(a != b) return false;
+    }
+    const uint32_t sizes[][2] = { {1,1},{1,7},{7,1},{2,2},{3,3},{5,8},{16,9},{1023,517} };
+    for(const auto& size : sizes){
+        std::vector<uint8_t> src = randomBytes(size_t(size[0]) * size[1] * 4,4);
+        std::vector<uint8_t> a(downsampledBytes(size[0],size[1]));
+        std::vector<uint8_t> b(a.size());
+        kernels.downsampleSrgb(src.data(),size[0],size[1],a.data());
+        reference.downsampleSrgb(src.data(),size[0],size[1],b.data());
+        if(a != b) return false;
+    }
+    return true;
+}
+
+//参考实现与精确定义的比较,失败时输出原因
+inline bool checkReference(){
+    using namespace imagekernels;
+    bool ok = true;
+    size_t premultiplyErrors = 0;
+    for(unsigned a = 0;a < 256;a++){
+        for(unsigned c = 0;c < 256;c++){
+            uint8_t p[4] = { static_cast<uint8_t>(c),static_cast<uint8_t>(c),
+                             static_cast<uint8_t>(c),static_cast<uint8_t>(a) };
+            scalar::premultiplyAlpha(p,1);
+            unsigned expected = static_cast<unsigned>(std::floor(c * a / 255.0 + 0.5));
+            if(p[0] != expected || p[3] != a) premultiplyErrors++;
+        }
+    }
+    if(premultiplyErrors > 0){
+        std::cout<<"premultiply reference: "<<premultiplyErrors<<" wrong results"<<std::endl;
+        ok = false;
+    }
+    size_t roundTripErrors = 0;
+    for(unsigned i = 0;i < 256;i++){
+        uint8_t p[4] = { static_cast<uint8_t>(i),static_cast<uint8_t>(i),
+                         static_cast<uint8_t>(i),static_cast<uint8_t>(i) };
+        float linear[4];
+        scalar::srgbToLinear(p,linear,1);
+        uint8_t back[4];
+        scalar::linearToSrgb(linear,back,1);
+        //16 位定点线性值编码回去也必须不变
+        uint8_t box[4];
+        uint8_t block[16];
+        for(int k = 0;k < 16;k++){
+            block[k] = p[k % 4];
+        }
+        scalar::downsampleSrgb(block,2,2,box);
+        for(int c = 0;c < 4;c++){
+            if(back[c] != i || box[c] != i) roundTripErrors++;
+        }
+    }
+    if(roundTripErrors > 0){
+        std::cout<<"sRGB round trip reference: "<<roundTripErrors<<" wrong results"<<std::endl;
+        ok = false;
+    }
+    const uint32_t width = 257,height = 129;
+    std::vector<uint8_t> src = randomBytes(size_t(width) * height * 4,5);
+    std::vector<uint8_t> fixed(downsampledBytes(width,height));
+    std::vector<uint8_t> exact(fixed.size());
+    scalar::downsampleSrgb(src.data(),width,height,fixed.data());
+    downsampleSrgbFloat(src.data(),width,height,exact.data());
+    int maxError = 0;
+    for(size_t i = 0;i < fixed.size();i++){
+        maxError = std::max(maxError,std::abs(int(fixed[i]) - int(exact[i])));
+    }
+    std::cout<<"downsample reference: max difference from float "<<maxError<<std::endl;
+    if(maxError > 1){
+        ok = false;
+    }
+    return ok;
+}
+
+} // namespace kernelbench
+
+/**
+  运行内核测试,megapixels 为测试图像的百万像素数.
+  任何实现的结果与参考实现不同时返回 false
+  */
+inline bool runKernelBenchmark(uint32_t megapixels){
+    using namespace kernelbench;
+    bool ok = checkReference();
+    std::vector<ImageKernels> variants;
+    const ImageIsa isas[] = { ImageIsa::Scalar,ImageIsa::Sse41,ImageIsa::Avx2,ImageIsa::Neon };
+    for(ImageIsa isa : isas){
+        if(imageIsaSupported(isa)){
+            variants.push_back(imageKernelsFor(isa));
+        }
+    }
+    const ImageKernels& reference = variants[0];
+    std::cout<<"image kernels: best "<<imageIsaName(imageKernels().isa)<<std::endl;
+    for(size_t i = 1;i < variants.size();i++){
+        bool exact = matchesReference(variants[i],reference);
+        std::cout<<imageIsaName(variants[i].isa)<<": "
+                 <<(exact ? "matches reference" : "DIFFERS from reference")<<std::endl;
+        ok = ok && exact;
+    }
+
+    const uint32_t side = static_cast<uint32_t>(std::sqrt(megapixels * 1048576.0));
+    const size_t pixels = size_t(side) * side;
+    const unsigned repeats = 9;
+    std::vector<uint8_t> rgb = randomBytes(pixels * 3,6);
+    std::vector<uint8_t> rgba = randomBytes(pixels * 4,7);
+    std::vector<uint8_t> work(pixels * 4);
+    std::vector<float> linear(pixels * 4);
+    std::vector<uint8_t> half(downsampledBytes(side,side));
+    reference.srgbToLinear(rgba.data(),linear.data(),pixels);
+    std::cout<<"throughput on "<<side<<"x"<<side<<" (GB/s of input):"<<std::endl;
+    std::cout<<std::fixed<<std::setprecision(2);
+
+    struct Kernel{
+        const char* name;
+        size_t inputBytes;
+        std::function<void(const ImageKernels&)> run;
+        std::function<bool(const ImageKernels&)> usesScalar;
+    };
+    std::vector<Kernel> kernels = {
+        { "expand rgb->rgba",pixels * 3,
+          [&](const ImageKernels& k){ k.expandRgbToRgba(rgb.data(),work.data(),pixels); },
+          [&](const ImageKernels& k){ return k.expandRgbToRgba == reference.expandRgbToRgba; } },
+        { "premultiply alpha",pixels * 4,
+          [&](const ImageKernels& k){
+              std::copy(rgba.begin(),rgba.end(),work.begin());
+              k.premultiplyAlpha(work.data(),pixels); },
+          [&](const ImageKernels& k){ return k.premultiplyAlpha == reference.premultiplyAlpha; } },
+        { "srgb->linear",pixels * 4,
+          [&](const ImageKernels& k){ k.srgbToLinear(rgba.data(),linear.data(),pixels); },
+          [&](const ImageKernels& k){ return k.srgbToLinear == reference.srgbToLinear; } },
+        { "linear->srgb",pixels * 16,
+          [&](const ImageKernels& k){ k.linearToSrgb(linear.data(),work.data(),pixels); },
+          [&](const ImageKernels& k){ return k.linearToSrgb == reference.linearToSrgb; } },
+        { "downsample srgb",pixels * 4,
+          [&](const ImageKernels& k){ k.downsampleSrgb(rgba.data(),side,side,half.data()); },
+          [&](const ImageKernels& k){ return k.downsampleSrgb == reference.downsampleSrgb; } }
+    };
+    for(const Kernel& kernel : kernels){
+        double scalarMs = 0.0;
+        for(const ImageKernels& variant : variants){
+            if(&variant != &reference && kernel.usesScalar(variant)){
+                continue;//这个指令集没有单独的实现
+            }
+            double ms = medianMs(repeats,[&](){ kernel.run(variant); });
+            if(&variant == &reference){
+                scalarMs = ms;
+            }
+            std::cout<<"  "<<std::left<<std::setw(18)<<kernel.name<<std::setw(8)
+                     <<imageIsaName(variant.isa)<<std::right<<std::setw(8)
+                     <<kernel.inputBytes / (ms * 1e6)<<" GB/s  "
+                     <<std::setw(6)<<scalarMs / ms<<"x"<<std::endl;
+        }
+    }
+    return ok;
+}
+
+#endif // KERNELBENCHMARK_H
@@ -0,0 +1,420 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <cstdint>
+
+#include "mappedfile.h"
+
+/**
+  KTX2 纹理容器的读写
+  文件结构(所有整数为小端序):
+  1. 12 字节标识符
+  2. 文件头:vkFormat,typeSize,宽,高,深度,层数,面数,细化级别数,超压缩方案
+  3. 索引:DFD(数据格式描述)和键值数据的偏移与长度,超压缩全局数据的偏移与长度
+  4. 细化级别索引:每一级的偏移,长度,未压缩长度,第 0 级在最前面
+  5. DFD,键值数据
+  6. 各级图像数据,按从最小的级别到最大的级别的顺序存放
+  这里只支持单层,单面的二维纹理,不支持超压缩
+  */
+static const unsigned char KTX2_IDENTIFIER[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+//一个细化级别在文件中的位置
+struct Ktx2Level{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+struct Ktx2File{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<Ktx2Level> levels;//levels[0] 为原始大小
+    MappedFile file;//loadKtx2 映射的整个文件
+    const unsigned char* base = nullptr;//文件内容的开头,levels 中的偏移相对于它
+
+    const unsigned char* levelData(uint32_t level) const {
+        return base + levels[level].byteOffset;
+    }
+};
+
+namespace ktx2 {
+
+//Khronos 数据格式描述中使用的常量
+enum{
+    KHR_DF_MODEL_RGBSDA = 1,
+    KHR_DF_MODEL_BC1A = 128,
+    KHR_DF_MODEL_BC3 = 130,
+    KHR_DF_MODEL_BC7 = 134,
+    KHR_DF_MODEL_ETC2 = 161,
+    KHR_DF_MODEL_ASTC = 162,
+    KHR_DF_PRIMARIES_BT709 = 1,
+    KHR_DF_TRANSFER_LINEAR = 1,
+    KHR_DF_TRANSFER_SRGB = 2,
+    KHR_DF_CHANNEL_RGBSDA_RED = 0,
+    KHR_DF_CHANNEL_RGBSDA_GREEN = 1,
+    KHR_DF_CHANNEL_RGBSDA_BLUE = 2,
+    KHR_DF_CHANNEL_RGBSDA_ALPHA = 15,
+    KHR_DF_CHANNEL_BLOCK_COLOR = 0,//BC1A,BC3,BC7,ASTC 的颜色数据
+    KHR_DF_CHANNEL_ETC2_COLOR = 2,
+    KHR_DF_CHANNEL_BLOCK_ALPHA = 15,//BC3,ETC2 的 alpha 数据
+    KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10
+};
+
+struct DfdSample{
+    uint32_t channel;//通道类型,高 4 位为限定符
+    uint32_t bitOffset;
+    uint32_t bitLength;
+    uint32_t lower;
+    uint32_t upper;
+};
+
+struct DfdDescription{
+    uint32_t colorModel;
+    uint32_t transfer;
+    uint8_t blockWidth;
+    uint8_t blockHeight;
+    uint8_t bytesPerBlock;
+    std::vector<DfdSample> samples;
+};
+
+inline bool isSrgb(VkFormat format){
+    return format == VK_FORMAT_R8G8B8A8_SRGB ||
+            format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+            format == VK_FORMAT_BC3_SRGB_BLOCK ||
+            format == VK_FORMAT_BC7_SRGB_BLOCK ||
+            format == VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK ||
+            format == VK_FORMAT_ASTC_4x4_SRGB_BLOCK;
+}
+
+//块压缩格式的一个采样,覆盖块中从 bitOffset 开始的 bitLength 位
+inline DfdSample blockSample(uint32_t channel,uint32_t bitOffset,
+                             uint32_t bitLength){
+    DfdSample sample;
+    sample.channel = channel;
+    sample.bitOffset = bitOffset;
+    sample.bitLength = bitLength;
+    sample.lower = 0;
+    sample.upper = 0xFFFFFFFF;
+    return sample;
+}
+
+//返回格式的数据格式描述,不认识的格式抛出异常
+inline DfdDescription describeFormat(VkFormat format){
+    DfdDescription desc;
+    switch(format){
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:{
+        desc.colorModel = KHR_DF_MODEL_RGBSDA;
+        desc.transfer = isSrgb(format) ? KHR_DF_TRANSFER_SRGB
+                                       : KHR_DF_TRANSFER_LINEAR;
+        desc.blockWidth = 1;
+        desc.blockHeight = 1;
+        desc.bytesPerBlock = 4;
+        const uint32_t channels[4] = {
+            KHR_DF_CHANNEL_RGBSDA_RED, KHR_DF_CHANNEL_RGBSDA_GREEN,
+            KHR_DF_CHANNEL_RGBSDA_BLUE, KHR_DF_CHANNEL_RGBSDA_ALPHA
+        };
+        for(uint32_t i = 0;i < 4;i++){
+            DfdSample sample;
+            sample.channel = channels[i];
+            //sRGB 格式的 alpha 通道总是线性的
+            if(i == 3 && isSrgb(format)){
+                sample.channel |= KHR_DF_SAMPLE_DATATYPE_LINEAR;
+            }
+            sample.bitOffset = i * 8;
+            sample.bitLength = 8;
+            sample.lower = 0;
+            sample.upper = 255;
+            desc.samples.push_back(sample);
+        }
+        break;
+    }
+    //4x4 块压缩格式
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        desc.colorModel = KHR_DF_MODEL_BC1A;
+        desc.bytesPerBlock = 8;
+        desc.samples.push_back(blockSample(KHR_DF_CHANNEL_BLOCK_COLOR,0,64));
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        desc.colorModel = KHR_DF_MODEL_BC3;
+        desc.bytesPerBlock = 16;
+        desc.samples.push_back(blockSample(KHR_DF_CHANNEL_BLOCK_ALPHA |
+                                           KHR_DF_SAMPLE_DATATYPE_LINEAR,0,64));
+        desc.samples.push_back(blockSample(KHR_DF_CHANNEL_BLOCK_COLOR,64,64));
+        break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        desc.colorModel = KHR_DF_MODEL_BC7;
+        desc.bytesPerBlock = 16;
+        desc.samples.push_back(blockSample(KHR_DF_CHANNEL_BLOCK_COLOR,0,128));
+        break;
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+        desc.colorModel = KHR_DF_MODEL_ETC2;
+        desc.bytesPerBlock = 16;
+        desc.samples.push_back(blockSample(KHR_DF_CHANNEL_BLOCK_ALPHA |
+                                           KHR_DF_SAMPLE_DATATYPE_LINEAR,0,64));
+        desc.samples.push_back(blockSample(KHR_DF_CHANNEL_ETC2_COLOR,64,64));
+        break;
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        desc.colorModel = KHR_DF_MODEL_ASTC;
+        desc.bytesPerBlock = 16;
+        desc.samples.push_back(blockSample(KHR_DF_CHANNEL_BLOCK_COLOR,0,128));
+        break;
+    default:
+        throw std::runtime_error("ktx2: unsupported vkFormat!");
+    }
+    if(desc.colorModel != KHR_DF_MODEL_RGBSDA){
+        desc.transfer = isSrgb(format) ? KHR_DF_TRANSFER_SRGB
+                                       : KHR_DF_TRANSFER_LINEAR;
+        desc.blockWidth = 4;
+        desc.blockHeight = 4;
+    }
+    return desc;
+}
+
+inline uint32_t bytesPerBlock(VkFormat format){
+    return describeFormat(format).bytesPerBlock;
+}
+
+//一个细化级别的字节数
+inline uint64_t levelSize(VkFormat format,uint32_t width,uint32_t height){
+    DfdDescription desc = describeFormat(format);
+    uint64_t blocksX = (width + desc.blockWidth - 1) / desc.blockWidth;
+    uint64_t blocksY = (height + desc.blockHeight - 1) / desc.blockHeight;
+    return blocksX * blocksY * desc.bytesPerBlock;
+}
+
+inline void put32(std::vector<unsigned char>& out,uint32_t v){
+    for(int i = 0;i < 4;i++){
+        out.push_back(static_cast<unsigned char>(v >> (i*8)));
+    }
+}
+inline void put64(std::vector<unsigned char>& out,uint64_t v){
+    for(int i = 0;i < 8;i++){
+        out.push_back(static_cast<unsigned char>(v >> (i*8)));
+    }
+}
+inline void set64(std::vector<unsigned char>& out,size_t pos,uint64_t v){
+    for(int i = 0;i < 8;i++){
+        out[pos+i] = static_cast<unsigned char>(v >> (i*8));
+    }
+}
+inline uint32_t get32(const unsigned char* p){
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 |
+            uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+inline uint64_t get64(const unsigned char* p){
+    return uint64_t(get32(p)) | uint64_t(get32(p+4)) << 32;
+}
+inline void pad(std::vector<unsigned char>& out,size_t alignment){
+    while(out.size() % alignment != 0){
+        out.push_back(0);
+    }
+}
+
+//生成基本数据格式描述块(包括开头的总长度)
+inline std::vector<unsigned char> buildDfd(VkFormat format){
+    DfdDescription desc = describeFormat(format);
+    uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(desc.samples.size());
+    std::vector<unsigned char> dfd;
+    put32(dfd,4 + blockSize);//dfdTotalSize
+    put32(dfd,0);//vendorId = KHRONOS,descriptorType = BASICFORMAT
+    put32(dfd,2u | (blockSize << 16));//versionNumber = 1.3,descriptorBlockSize
+    //colorModel,colorPrimaries,transferFunction,flags(straight alpha)
+    put32(dfd,desc.colorModel | (KHR_DF_PRIMARIES_BT709 << 8) |
+          (desc.transfer << 16));
+    //texelBlockDimension 中保存的是尺寸减 1
+    put32(dfd,uint32_t(desc.blockWidth - 1) |
+          (uint32_t(desc.blockHeight - 1) << 8));
+    put32(dfd,desc.bytesPerBlock);//bytesPlane0
+    put32(dfd,0);//bytesPlane4-7
+    for(const DfdSample& s : desc.samples){
+        put32(dfd,s.bitOffset | ((s.bitLength - 1) << 16) | (s.channel << 24));
+        put32(dfd,0);//samplePosition
+        put32(dfd,s.lower);
+        put32(dfd,s.upper);
+    }
+    return dfd;
+}
+
+}//namespace ktx2
+
+/**
+  写入 KTX2 文件,levels[i] 为第 i 级细化的数据,第 0 级为原始大小
+  */
+inline void writeKtx2(const std::string& filename,VkFormat format,
+                      uint32_t width,uint32_t height,
+                      const std::vector<std::vector<unsigned char>>& levels){
+    using namespace ktx2;
+    const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+    for(uint32_t i = 0;i < levelCount;i++){
+        uint32_t w = std::max(1u,width >> i);
+        uint32_t h = std::max(1u,height >> i);
+        if(levels[i].size() != levelSize(format,w,h)){
+            throw std::runtime_error("ktx2: mip level size mismatch!");
+        }
+    }
+    std::vector<unsigned char> out(KTX2_IDENTIFIER,KTX2_IDENTIFIER+12);
+    put32(out,format);
+    put32(out,1);//typeSize,8 位分量和块压缩格式都为 1
+    put32(out,width);
+    put32(out,height);
+    put32(out,0);//pixelDepth
+    put32(out,0);//layerCount
+    put32(out,1);//faceCount
+    put32(out,levelCount);
+    put32(out,0);//supercompressionScheme
+
+    std::vector<unsigned char> dfd = buildDfd(format);
+    const uint32_t indexSize = 4*4 + 8*2;
+    const uint32_t levelIndexSize = levelCount * 8 * 3;
+    uint32_t dfdOffset = static_cast<uint32_t>(out.size()) + indexSize +
+            levelIndexSize;
+    put32(out,dfdOffset);
+    put32(out,static_cast<uint32_t>(dfd.size()));
+    put32(out,0);//kvdByteOffset
+    put32(out,0);//kvdByteLength
+    put64(out,0);//sgdByteOffset
+    put64(out,0);//sgdByteLength
+    size_t levelIndexPos = out.size();
+    out.resize(out.size() + levelIndexSize,0);
+    out.insert(out.end(),dfd.begin(),dfd.end());
+
+    //最小的级别在前面,每一级按 lcm(块大小,4) 对齐
+    size_t alignment = bytesPerBlock(format);
+    while(alignment % 4 != 0){
+        alignment += bytesPerBlock(format);
+    }
+    for(int32_t i = static_cast<int32_t>(levelCount) - 1;i >= 0;i--){
+        pad(out,alignment);
+        uint64_t offset = out.size();
+        out.insert(out.end(),levels[i].begin(),levels[i].end());
+        size_t entry = levelIndexPos + static_cast<size_t>(i) * 24;
+        set64(out,entry,offset);
+        set64(out,entry + 8,levels[i].size());
+        set64(out,entry + 16,levels[i].size());
+    }
+
+    std::ofstream file(filename,std::ios::binary);
+    if(!file.is_open()){
+        throw std::runtime_error("failed to open file: " + filename);
+    }
+    file.write(reinterpret_cast<const char*>(out.data()),out.size());
+    if(!file){
+        throw std::runtime_error("failed to write file: " + filename);
+    }
+}
+
+//只读取文件头中的格式,用于在加载前挑选设备支持的文件,失败时返回 VK_FORMAT_UNDEFINED
+inline VkFormat peekKtx2Format(const std::string& filename){
+    std::ifstream file(filename,std::ios::binary);
+    unsigned char header[16];
+    if(!file.is_open() ||
+            !file.read(reinterpret_cast<char*>(header),sizeof(header)) ||
+            memcmp(header,KTX2_IDENTIFIER,12) != 0){
+        return VK_FORMAT_UNDEFINED;
+    }
+    return static_cast<VkFormat>(ktx2::get32(header + 12));
+}
+
+//内存中的 KTX2 文件内容的格式,不是 KTX2 文件时返回 VK_FORMAT_UNDEFINED
+inline VkFormat peekKtx2Format(const unsigned char* data,size_t size){
+    if(size < 16 || memcmp(data,KTX2_IDENTIFIER,12) != 0){
+        return VK_FORMAT_UNDEFINED;
+    }
+    return static_cast<VkFormat>(ktx2::get32(data + 12));
+}
+
+/**
+  校验内存中的 KTX2 文件内容的文件头和细化级别索引.
+  返回的 Ktx2File 引用 data,使用期间 data 需要一直有效
+  */
+inline Ktx2File parseKtx2(const unsigned char* data,size_t fileSize,
+                          const std::string& filename){
+    using namespace ktx2;
+    Ktx2File ktx;
+    ktx.base = data;
+
+    const size_t headerSize = 12 + 9*4 + 4*4 + 8*2;
+    const unsigned char* p = data;
+    if(fileSize < headerSize || memcmp(p,KTX2_IDENTIFIER,12) != 0){
+        throw std::runtime_error("not a ktx2 file: " + filename);
+    }
+    ktx.format = static_cast<VkFormat>(get32(p + 12));
+    ktx.width = get32(p + 20);
+    ktx.height = get32(p + 24);
+    uint32_t depth = get32(p + 28);
+    uint32_t layerCount = get32(p + 32);
+    uint32_t faceCount = get32(p + 36);
+    uint32_t levelCount = get32(p + 40);
+    uint32_t supercompression = get32(p + 44);
+    if(ktx.format == VK_FORMAT_UNDEFINED || ktx.width == 0 ||
+            ktx.height == 0 || depth > 1 || layerCount > 1 ||
+            faceCount != 1){
+        throw std::runtime_error("unsupported ktx2 layout: " + filename);
+    }
+    if(supercompression != 0){
+        throw std::runtime_error("unsupported ktx2 supercompression: " +
+                                 filename);
+    }
+    //levelCount 为 0 表示需要在运行时生成细化级别,这里只有第 0 级
+    if(levelCount == 0){
+        levelCount = 1;
+    }
+    //级数不超过完整细化链的级数,大小的检查都用 64 位整数,不会溢出
+    uint32_t maxLevels = 1;
+    while(maxLevels < 32 &&
+          std::max(ktx.width,ktx.height) >> maxLevels != 0){
+        maxLevels++;
+    }
+    if(levelCount > maxLevels){
+        throw std::runtime_error("invalid ktx2 level count: " + filename);
+    }
+    if(fileSize - headerSize < uint64_t(levelCount) * 24){
+        throw std::runtime_error("truncated ktx2 file: " + filename);
+    }
+    const unsigned char* levelIndex = p + headerSize;
+    for(uint32_t i = 0;i < levelCount;i++){
+        Ktx2Level level;
+        level.byteOffset = get64(levelIndex + i*24);
+        level.byteLength = get64(levelIndex + i*24 + 8);
+        level.uncompressedByteLength = get64(levelIndex + i*24 + 16);
+        if(level.byteOffset > fileSize ||
+                level.byteLength > fileSize - level.byteOffset){
+            throw std::runtime_error("truncated ktx2 file: " + filename);
+        }
+        //没有超压缩,每一级的数据必须正好是这种格式这一级大小的字节数
+        uint64_t expected = levelSize(ktx.format,std::max(1u,ktx.width >> i),
+                                      std::max(1u,ktx.height >> i));
+        if(level.byteLength != expected ||
+                level.uncompressedByteLength != expected){
+            throw std::runtime_error("invalid ktx2 level size: " + filename);
+        }
+        ktx.levels.push_back(level);
+    }
+    return ktx;
+}
+
+//映射 KTX2 文件并校验
+inline Ktx2File loadKtx2(const std::string& filename){
+    MappedFile file(filename);
+    Ktx2File ktx = parseKtx2(file.data(),file.size(),filename);
+    ktx.file = std::move(file);//移动不改变映射的地址,base 仍然有效
+    return ktx;
+}
+
+#endif // KTX2_H
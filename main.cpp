@@ -23,16 +23,46 @@
 #include <glm/gtx/hash.hpp>
 //为了使用计时函数,我们将通过计时函数实现每秒旋转 90 度的效果
 #include <chrono>
+#include <iomanip>
 /**
 默认情况下stb_image.h文件只定义了函数原型，我们需要在包含tb_image.h 文件前
 定义 STB_IMAGE_IMPLEMENTATION 宏，来让它将函数实现包含进来。
   */
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
 #include <unordered_map>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <sstream>
+#include <future>
+
+#include "descriptorallocator.h"
+#include "texturecooker.h"
+#include "deletionqueue.h"
+#include "appconfig.h"
+#include "framestats.h"
+#include "framepacer.h"
+#include "workerpool.h"
+#include "jobsystem.h"
+#include "jobbenchmark.h"
+#include "kernelbenchmark.h"
+#include "meshcooker.h"
+#include "mappedfile.h"
+#include "assetarchive.h"
+#include "virtualtexture.h"
+#include "virtualtexturecooker.h"
+#include "texturestreaming.h"
+#include "imagewriter.h"
+#include "benchmarkreport.h"
+#include "gpuprofiler.h"
+#include "resolutionscaler.h"
+#include "tracer.h"
 //顶点结构体
 struct Vertex{
     glm::vec3 pos;
@@ -75,6 +105,9 @@ struct Vertex{
                 texCoord == other.texCoord;
     }
 };
+//分块网格文件中的顶点数据直接作为 Vertex 使用
+static_assert(sizeof(Vertex) == sizeof(MeshChunkVertex),
+              "mesh chunk vertex layout must match Vertex");
 //对 Vertex 结构体进行哈希的函数
 namespace std {
     template<> struct hash<Vertex> {
@@ -104,23 +137,48 @@ const std::vector<uint16_t> indices = {
     4,5,6,6,7,4
 };
 #endif
-//着色器中使用的 uniform 数据
+//着色器中使用的 uniform 数据,每帧只更新一次
 struct UniformBufferObject{
+    alignas(16) glm::mat4 viewProj;//预先相乘的投影矩阵*视图矩阵
+};
+/**
+  每次绘制使用的推送常量(push constant)数据
+  推送常量直接记录在指令缓冲中,更新它不需要描述符和内存映射操作.
+  规范保证至少有128字节可用,一个mat4占64字节
+  */
+struct PushConstantObject{
     alignas(16) glm::mat4 model;//模型矩阵
-    alignas(16) glm::mat4 view;//视图矩阵
-    alignas(16) glm::mat4 proj;//投影矩阵
+    uint32_t materialIndex;//无绑定纹理数组中的材质索引,只在片段着色器使用
+    uint32_t frameIndex;//帧序号,虚拟纹理的片段着色器用它轮换写入反馈的像素
 };
 
-//可以同时并行处理的帧数--12
-const int MAX_FRAMES_IN_FLIGHT = 2;
+//可以同时并行处理的帧数的上限 MAX_FRAMES_IN_FLIGHT 在 appconfig.h 中定义--12
 
 const int WIDTH = 800;
 const int HEIGHT = 600;
+//基准测试中每一帧场景前进的固定时间(毫秒),与实际经过的时间无关
+const double BENCHMARK_TIMESTEP_MS = 1000.0 / 60.0;
 
 const std::string MODEL_PATH=
         "E:/workspace/Qt5.6/VulkanLearn/models/chalet.obj";
 const std::string TEXTURE_PATH=
         "E:/workspace/Qt5.6/VulkanLearn/models/chalet.jpg";
+//由 --cook-texture 生成的带完整细化链的纹理,存在时优先使用
+const std::string TEXTURE_KTX2_PATH=
+        "E:/workspace/Qt5.6/VulkanLearn/models/chalet.ktx2";
+/**
+烘焙好的块压缩纹理,按优先级排列,使用第一个存在且设备支持其格式的文件.
+BC 格式由 --cook-texture 生成,ETC2/ASTC 格式(移动端 GPU 通常只支持这两种)
+需要用外部工具预先编码成 KTX2 文件,最后退回到未压缩的 RGBA8 纹理
+  */
+const std::vector<std::string> COMPRESSED_TEXTURE_PATHS = {
+    "E:/workspace/Qt5.6/VulkanLearn/models/chalet_bc7.ktx2",
+    "E:/workspace/Qt5.6/VulkanLearn/models/chalet_bc3.ktx2",
+    "E:/workspace/Qt5.6/VulkanLearn/models/chalet_bc1.ktx2",
+    "E:/workspace/Qt5.6/VulkanLearn/models/chalet_astc.ktx2",
+    "E:/workspace/Qt5.6/VulkanLearn/models/chalet_etc2.ktx2",
+    TEXTURE_KTX2_PATH
+};
 //指定校验层的名称--代表隐式地开启所有可用的校验层--1
 const std::vector<const char*> validataionLayers = {
     "VK_LAYER_LUNARG_standard_validation"
@@ -131,6 +189,51 @@ const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+/**
+  无绑定(bindless)纹理需要的可选设备扩展,描述符索引在 Vulkan 1.2 成为核心功能.
+  设备不支持时使用原来的描述符布局,每次绘制绑定一个纹理
+  */
+const std::vector<const char*> bindlessDeviceExtensions = {
+    VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+    VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
+};
+//无绑定纹理数组的最大长度,实际长度还受设备限制
+const uint32_t MAX_BINDLESS_TEXTURES = 1024;
+//流式加载纹理时一开始驻留的最大一级的边长上限
+const uint32_t TEXTURE_STREAMING_FIRST_SIZE = 128;
+//计算着色器一次调度最多生成的细化级数,和 shader_mipgen.comp 中的数组长度一致
+const uint32_t MIPGEN_LEVELS_PER_DISPATCH = 12;
+/**
+  计算着色器生成细化链支持的纹理格式.存储图像的格式写在着色器的 layout 中,
+  每种格式使用单独编译的着色器(compile.bat 中用 -D 选择格式);
+  srgb 为 true 时颜色通道是 sRGB 编码的,转换到线性空间求平均.
+  R32G32B32A32_SFLOAT 不保证支持线性过滤,不能用 blit 生成细化链,
+  但一定支持存储图像,auto 模式下由计算着色器生成
+  */
+struct MipgenVariant{
+    VkFormat format;
+    const char* shader;
+    bool srgb;
+};
+const uint32_t MIPGEN_VARIANT_COUNT = 3;
+const MipgenVariant MIPGEN_VARIANTS[MIPGEN_VARIANT_COUNT] = {
+    { VK_FORMAT_R8G8B8A8_UNORM,
+      "E:/workspace/Qt5.6/VulkanLearn/shaders/comp_mipgen.spv",true },
+    { VK_FORMAT_R16G16B16A16_SFLOAT,
+      "E:/workspace/Qt5.6/VulkanLearn/shaders/comp_mipgen_rgba16f.spv",false },
+    { VK_FORMAT_R32G32B32A32_SFLOAT,
+      "E:/workspace/Qt5.6/VulkanLearn/shaders/comp_mipgen_rgba32f.spv",false }
+};
+//格式对应的着色器在 MIPGEN_VARIANTS 中的序号,不支持时返回 -1
+inline int mipgenVariantIndex(VkFormat format){
+    for(uint32_t i = 0;i < MIPGEN_VARIANT_COUNT;i++){
+        if(MIPGEN_VARIANTS[i].format == format){
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
 //控制是否启用指定的校验层--1
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -138,22 +241,6 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
-//读取编译的二进制着色器文件--9
-static std::vector<char> readFile(const std::string& filename){
-    //ate:从文件尾部开始读取,可以根据读取位置确定文件的大小,分配足够的数组空间来容纳数据
-    //binary：以二进制的形式读取文件 (避免进行诸如行末格式是 \n 还是\r\n 的转换)
-    std::ifstream file(filename,std::ios::ate | std::ios::binary);
-    if(!file.is_open()){
-        throw std::runtime_error("failed to open file!");
-    }
-    //获取文件大小
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(),fileSize);
-    file.close();
-    return buffer;
-}
 //表示满足需求得队列族--2
 struct QueueFamilyIndices{
     //绘制指令的队列族索引
@@ -173,11 +260,24 @@ struct SwapChainSupportDetails {
 
 class HelloTriangle{
 public:
+    explicit HelloTriangle(const AppConfig& appConfig = AppConfig())
+        : config(appConfig) {}
     void run(){
-        initWindow();
+        startupStart = std::chrono::high_resolution_clock::now();
+        if(!config.traceFile.empty()){
+            Tracer::instance().setEnabled(true);
+            Tracer::instance().setThreadName("main");
+        }
+        if(!config.headless){
+            initWindow();
+        }
         initVulkan();
         mainLoop();
         cleanup();
+        if(!config.traceFile.empty()){
+            Tracer::instance().writeChromeTrace(config.traceFile);
+            std::cout<<"trace written to "<<config.traceFile<<std::endl;
+        }
     }
 protected:
     static void mouse_button_callback(GLFWwindow* window, int button,
@@ -212,6 +312,34 @@ protected:
             }
         }
     }
+    /**
+    键盘事件:运行时切换呈现模式
+    F1 自动选择,F2 FIFO(省电,垂直同步),F3 MAILBOX,F4 IMMEDIATE(延迟最低)
+      */
+    static void key_callback(GLFWwindow* window,int key,int /*scancode*/,
+                             int action,int /*mods*/){
+        auto app =
+        reinterpret_cast<HelloTriangle*>(glfwGetWindowUserPointer(window));
+        if(action != GLFW_PRESS){
+            return;
+        }
+        switch (key) {
+        case GLFW_KEY_F1:
+            app->setPresentMode(true,VK_PRESENT_MODE_FIFO_KHR);
+            break;
+        case GLFW_KEY_F2:
+            app->setPresentMode(false,VK_PRESENT_MODE_FIFO_KHR);
+            break;
+        case GLFW_KEY_F3:
+            app->setPresentMode(false,VK_PRESENT_MODE_MAILBOX_KHR);
+            break;
+        case GLFW_KEY_F4:
+            app->setPresentMode(false,VK_PRESENT_MODE_IMMEDIATE_KHR);
+            break;
+        default:
+            break;
+        }
+    }
     static void CursorPos_Callback(GLFWwindow* window, double x, double y){
         auto app =
         reinterpret_cast<HelloTriangle*>(glfwGetWindowUserPointer(window));
@@ -231,9 +359,10 @@ protected:
     }
 
 private:
+    AppConfig config;//命令行指定的运行参数
     bool mouseLeftPress = false;//鼠标左键是否按下
-    int lastPos[2];
-    float offSet[2];
+    int lastPos[2] = {0,0};
+    float offSet[2] = {0.0f,0.0f};
     float campos[3] = {0.0f,4.0f,0.5f};
     float focalpos[3] = {0.0f,0.0f,0.5f};
     float viewup[3] = {0.0f,0.0f,1.0f};
@@ -252,9 +381,11 @@ private:
     //尽管 VkSurfaceKHR 对象是平台无关的，但它的创建依赖窗口系统
     VkSurfaceKHR surface;//窗口表面--4
     VkQueue presentQueue;//呈现队列--4
-    VkSwapchainKHR swapChain;//交换链--4
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;//交换链--4
     //交换链的图像句柄,在交换链清除时自动被清除--4
     std::vector<VkImage> swapChainImages;
+    //无窗口模式下代替交换链图像的离屏颜色图像的内存
+    std::vector<VkDeviceMemory> offscreenImageMemory;
     VkFormat swapChainImageFormat;//交换链图像格式--4
     VkExtent2D swapChainExtent;//交换链图像范围--4
 
@@ -273,10 +404,48 @@ private:
     //存储所有帧缓冲对象--10
     std::vector<VkFramebuffer> swapChainFramebuffers;
 
+    //重建交换链时被替换下来的资源,交给 deletionQueue 延迟销毁
+    struct RetiredSwapChain{
+        VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkFramebuffer> framebuffers;
+        VkImage depthImage = VK_NULL_HANDLE;
+        VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;
+        VkImageView depthImageView = VK_NULL_HANDLE;
+        VkImage msaaColorImage = VK_NULL_HANDLE;
+        VkDeviceMemory msaaColorImageMemory = VK_NULL_HANDLE;
+        VkImageView msaaColorImageView = VK_NULL_HANDLE;
+        VkImage sceneImage = VK_NULL_HANDLE;
+        VkDeviceMemory sceneImageMemory = VK_NULL_HANDLE;
+        VkImageView sceneImageView = VK_NULL_HANDLE;
+        VkDescriptorPool upscaleDescriptorPool = VK_NULL_HANDLE;
+        std::vector<VkFramebuffer> upscaleFramebuffers;
+        //只有交换链图像格式改变时才需要替换渲染流程和管线
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+        VkRenderPass upscaleRenderPass = VK_NULL_HANDLE;
+        VkPipeline upscalePipeline = VK_NULL_HANDLE;
+    };
+    //已经开始绘制的帧数,用来判断替换下来的资源是否还在使用
+    uint64_t frameNumber = 0;
+    //程序开始运行的时间,用来统计启动到提交第一帧所用的时间
+    std::chrono::high_resolution_clock::time_point startupStart;
+    double initMs = 0.0;//initVulkan 所用的时间
+    bool firstFrameReported = false;
+    /**
+    延迟销毁队列.
+    之前提交的帧可能仍在使用被替换下来的资源,所以不等待设备空闲立即销毁,
+    而是记录当前的帧序号,等所有可能使用它们的帧的栅栏发出信号后再销毁
+      */
+    DeletionQueue deletionQueue;
+
     //指令池对象,管理指令缓冲对象使用的内存，并负责指令缓冲对象的分配--11
     VkCommandPool commandPool ;
     //存储创建的指令缓冲对象,指令缓冲对象会在指令池对象被清除时自动被清除--11
     std::vector<VkCommandBuffer> commandBuffers;
+    //每次绘制使用的推送常量数据
+    PushConstantObject pushConstants;
 
     //为每一帧创建属于它们自己的信号量
     //信号量发出图像已经被获取，可以开始渲染的信号--12
@@ -285,30 +454,157 @@ private:
     std::vector<VkSemaphore> renderFinishedSemaphores ;
     //追踪当前渲染的是哪一帧--12
     size_t currentFrame = 0;
+    //同时处理的帧数,1 到 MAX_FRAMES_IN_FLIGHT
+    uint32_t framesInFlight = 2;
     /**
     需要使用栅栏(fence) 来进行 CPU 和 GPU 之间的同步，
-    来防止有超过 MAX_FRAMES_IN_FLIGHT帧的指令同时被提交执行。
+    来防止有超过 framesInFlight 帧的指令同时被提交执行。
     栅栏 (fence) 和信号量 (semaphore) 类似，可以用来发出信号和等待信号
       */
-    //每一帧创建一个VkFence 栅栏对象--12
+    //每一帧创建一个VkFence 栅栏对象,不使用时间线信号量时使用--12
     std::vector<VkFence> inFlightFences ;
+    //每个栅栏最后一次发出信号对应的时间线值
+    std::vector<uint64_t> inFlightFenceValues;
+    /**
+    帧时间线:第 N 帧的指令执行完毕时时间线的值为 N + 1(frameTimelineValue).
+    支持 VK_KHR_timeline_semaphore 时由一个时间线信号量提供,
+    否则由每帧的栅栏推算.上传,延迟销毁,回读等都可以等待某个时间线值
+      */
+    bool timelineSupported = false;
+    bool useTimeline = false;
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
+    uint64_t completedValue = 0;//使用栅栏时已知执行完毕的时间线值
+    //每个交换链图像最后一次被绘制时的时间线值,0 表示还没有使用过
+    std::vector<uint64_t> imageTimelineValues;
+#ifdef VK_KHR_timeline_semaphore
+    PFN_vkWaitSemaphoresKHR pfnWaitSemaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR pfnGetSemaphoreCounterValue = nullptr;
+#endif
+    //帧时间和延迟统计
+    FrameStats frameStats;
+    std::chrono::high_resolution_clock::time_point lastFrameStart;
+    //已提交但还没有观察到执行完毕的帧:时间线值和开始绘制的时间
+    std::deque<std::pair<uint64_t,
+        std::chrono::high_resolution_clock::time_point>> pendingFrames;
+    double frameWaitMs = 0.0;//当前帧等待 GPU 和交换链的时间
+    //GPU 时间戳分析,"frame" 范围的时间计入 frameStats.gpuTimes
+    GpuProfiler gpuProfiler;
+    std::ofstream gpuProfileLog;//每一帧的 GPU 时间日志
 
     //标记窗口大小是否发生改变：
     bool framebufferResized = false;
+    //当前交换链使用的呈现模式
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    //标记呈现模式设置是否改变,改变后在下一次呈现后重建交换链
+    bool presentModeChanged = false;
+    //读取输入前的帧节奏控制
+    FramePacer framePacer;
+
+    /**
+    帧读回使用的一个主机可见缓冲.
+    timelineValue 不为 0 时缓冲中有一帧等待 GPU 写完,
+    busy 为 true 时工作线程还在从缓冲中复制像素,这两种情况下都不能重新使用
+      */
+    struct ReadbackSlot{
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkDeviceSize capacity = 0;
+        uint64_t timelineValue = 0;
+        uint64_t frameIndex = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::atomic<bool> busy{false};
+    };
+    std::vector<std::unique_ptr<ReadbackSlot>> readbackSlots;
+    int recordingReadbackSlot = -1;//正在记录的帧使用的缓冲,-1 表示不读回
+    std::unique_ptr<WorkerPool> readbackWorkers;
+    ImageFileFormat readbackFileFormat = ImageFileFormat::Png;
+    std::atomic<uint32_t> readbackWritten{0};
+    std::atomic<uint32_t> readbackFailed{0};
+    double readbackStallMs = 0.0;//绘制循环等待缓冲可用的时间
+    std::chrono::high_resolution_clock::time_point readbackStart;
 
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
 
-    VkBuffer vertexBuffer;//存储创建的顶点缓冲的句柄
-    VkDeviceMemory vertexBufferMemory ;//顶点缓冲的内存句柄
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;//存储创建的顶点缓冲的句柄
+    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;//顶点缓冲的内存句柄
 
-    VkBuffer indexBuffer ;//存储创建的索引缓冲的句柄
-    VkDeviceMemory indexBufferMemory ;//索引缓冲的内存句柄
+    VkBuffer indexBuffer = VK_NULL_HANDLE;//存储创建的索引缓冲的句柄
+    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;//索引缓冲的内存句柄
+
+    //流式加载的网格块,只保留已经上传的最精细的一级
+    struct StreamedChunk{
+        VkBuffer buffer = VK_NULL_HANDLE;//顶点数据后面紧跟索引数据
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize indexOffset = 0;
+        uint32_t indexCount = 0;
+    };
+    AssetArchive archive;//--archive 指定的资源包,在 streamedMesh 之后析构
+    MeshChunkFile streamedMesh;
+    std::vector<StreamedChunk> streamedChunks;
+    size_t nextStreamBlock = 0;//按文件顺序下一个要上传的数据块
+    VkBuffer meshStagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory meshStagingMemory = VK_NULL_HANDLE;
+    unsigned char* meshStagingMapped = nullptr;
+    VkDeviceSize meshStagingSlice = 0;//每一帧可以使用的暂存空间
+    uint64_t meshStreamedBytes = 0;
+    std::chrono::high_resolution_clock::time_point meshStreamStart;
+
+    //虚拟纹理,只有被采样的页驻留在固定大小的物理缓存中
+    VirtualTextureFile virtualTexture;
+    VirtualTextureCache virtualTextureCache;
+    VkImage pageTableImage = VK_NULL_HANDLE;//每一级一个细化级别,每一页一个纹素
+    VkDeviceMemory pageTableImageMemory = VK_NULL_HANDLE;
+    VkImageView pageTableImageView = VK_NULL_HANDLE;
+    VkSampler pageTableSampler = VK_NULL_HANDLE;
+    VkImage physicalCacheImage = VK_NULL_HANDLE;
+    VkDeviceMemory physicalCacheImageMemory = VK_NULL_HANDLE;
+    VkImageView physicalCacheImageView = VK_NULL_HANDLE;
+    VkSampler physicalCacheSampler = VK_NULL_HANDLE;
+    VkBuffer virtualStagingBuffer = VK_NULL_HANDLE;//每一帧一段,放这一帧加载的页和页表
+    VkDeviceMemory virtualStagingMemory = VK_NULL_HANDLE;
+    unsigned char* virtualStagingMapped = nullptr;
+    VkDeviceSize virtualStagingSlice = 0;
+    VkBuffer feedbackBuffer = VK_NULL_HANDLE;//每一帧一段,片段着色器写入被采样的页
+    VkDeviceMemory feedbackMemory = VK_NULL_HANDLE;
+    unsigned char* feedbackMapped = nullptr;
+    VkDeviceSize feedbackSlice = 0;
+    VkDescriptorSetLayout virtualSetLayout = VK_NULL_HANDLE;//使用虚拟纹理时 set 1 的布局
+    VkDescriptorSet virtualDescriptorSet = VK_NULL_HANDLE;
+    uint64_t virtualUploadedPages = 0;
+
+    //按细化级别流式加载的模型纹理,textureImage 只包含驻留的级别
+    MipStreamingBudget textureBudget;
+    TextureData streamedTexture;//所有级别的数据,提高驻留级别时从这里上传
+    uint32_t streamedTextureId = 0;
+    uint32_t textureFirstLevel = 0;//textureImage 的第 0 级对应的细化级别
+    uint32_t textureSlots[2] = {};//替换纹理时交替使用的两个纹理数组位置
+    uint32_t textureSlot = 0;
+    uint64_t nextTextureChangeFrame = 0;//上一次改变的帧执行完毕之前不再改变
+    glm::vec3 modelCenter = glm::vec3(0.0f);//模型的包围球,用于估计屏幕上的大小
+    float modelRadius = 1.0f;
 
     std::vector<VkBuffer> uniformBuffers;//uniform 缓冲对象集合
     std::vector<VkDeviceMemory> uniformBuffersMemory;//uniform缓冲对象的内存句柄
-    VkDescriptorPool descriptorPool ;//描述符池对象
-    std::vector<VkDescriptorSet> descriptorSets;//描述符集对象集合,自动清除
+    //设备支持时启用各向异性过滤,部分软件实现不支持
+    bool samplerAnisotropyEnabled = false;
+    //是否使用无绑定纹理数组
+    bool bindlessSupported = false;
+    uint32_t bindlessTextureCapacity = 0;//纹理数组的长度
+    uint32_t bindlessTextureCount = 0;//已经写入数组的纹理个数
+    VkDescriptorSetLayout bindlessSetLayout = VK_NULL_HANDLE;//set 1 的布局
+    VkDescriptorPool bindlessDescriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet bindlessDescriptorSet = VK_NULL_HANDLE;
+    uint32_t textureMaterialIndex = 0;//模型纹理在数组中的索引
+    //长期使用的描述符集的分配器,池不够用时自动增加新池
+    DescriptorAllocator descriptorAllocator;
+    //按绑定的资源缓存描述符集,避免每帧调用 vkUpdateDescriptorSets;
+    //缓存的描述符集使用单独的分配器,清空缓存时整个回收它的池
+    DescriptorAllocator cacheDescriptorAllocator;
+    DescriptorSetCache descriptorSetCache;
     /**
     尽管，我们可以在着色器直接访问缓冲中的像素数据，但使用 Vulkan的图像对象会更好。
     Vulkan 的图像对象允许我们使用二维坐标来快速获取颜色数据。
@@ -317,10 +613,17 @@ private:
     VkImage textureImage ;//纹理图像
     //细化级别是在创建 VkImage 对象时设置的，之前，我们一直将其设置为 1
     uint32_t mipLevels;//存储计算出的细化级别个数
+    VkFormat textureFormat = VK_FORMAT_R8G8B8A8_UNORM;//纹理图像的格式
     VkDeviceMemory textureImageMemory ;//纹理图像对象的内存
 
     VkImageView textureImageView ;//纹理图像的图像视图对象
     VkSampler textureSampler ;//采样器对象
+    //用计算着色器生成细化链的管线,每种格式一个,第一次使用时创建;布局和计数器共用
+    VkDescriptorSetLayout mipgenSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout mipgenPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline mipgenPipelines[MIPGEN_VARIANT_COUNT] = {};
+    VkBuffer mipgenCounterBuffer = VK_NULL_HANDLE;//已经完成的工作组个数
+    VkDeviceMemory mipgenCounterMemory = VK_NULL_HANDLE;
 
     /**
     深度附着和颜色附着一样都是基于图像对象。区别是，交换链不会自
@@ -330,6 +633,37 @@ private:
     VkImage depthImage ;
     VkDeviceMemory depthImageMemory ;
     VkImageView depthImageView ;
+    /**
+    多重采样的颜色附着,渲染流程结束时解析(resolve)到交换链图像.
+    它和深度附着的内容在渲染流程之外都不需要,所以作为临时附着创建,
+    分块渲染的 GPU 上只存在于片上内存,不写回显存,也不需要分配实际的内存
+      */
+    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkImage msaaColorImage = VK_NULL_HANDLE;
+    VkDeviceMemory msaaColorImageMemory = VK_NULL_HANDLE;
+    VkImageView msaaColorImageView = VK_NULL_HANDLE;
+    /**
+    动态分辨率.
+    场景渲染到按交换链图像大小分配的内部图像(sceneImage)左上角 renderExtent 的区域,
+    放大流程(upscaleRenderPass)再把这一区域双线性放大到交换链图像.
+    renderExtent 每一帧由 dynamicResolution 根据 GPU 时间决定,只改变视口和渲染区域,
+    内部图像只在交换链重建时重新创建
+      */
+    bool dynamicResEnabled = false;
+    DynamicResolution dynamicResolution;
+    VkExtent2D renderExtent = {};
+    VkImage sceneImage = VK_NULL_HANDLE;
+    VkDeviceMemory sceneImageMemory = VK_NULL_HANDLE;
+    VkImageView sceneImageView = VK_NULL_HANDLE;
+    VkSampler sceneSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout upscaleSetLayout = VK_NULL_HANDLE;
+    //每个内部图像一个描述符池,重建交换链时和图像一起延迟销毁
+    VkDescriptorPool upscaleDescriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet upscaleDescriptorSet = VK_NULL_HANDLE;
+    VkRenderPass upscaleRenderPass = VK_NULL_HANDLE;
+    VkPipelineLayout upscalePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline upscalePipeline = VK_NULL_HANDLE;
+    std::vector<VkFramebuffer> upscaleFramebuffers;
 
     //为静态函数才能将其用作回调函数
     static void framebufferResizeCallback(GLFWwindow* window,int width ,
@@ -362,9 +696,12 @@ private:
         //鼠标事件
         glfwSetMouseButtonCallback(window,mouse_button_callback);
         glfwSetCursorPosCallback(window,CursorPos_Callback);
+        //键盘事件
+        glfwSetKeyCallback(window,key_callback);
     }
     //创建VkInstance实例--1
     void createInstance(){
+        TRACE_FUNCTION();
         //是否启用校验层并检测指定的校验层是否支持
         if(enableValidationLayers && !checkValidationLayerSupport()){
             throw std::runtime_error(
@@ -478,6 +815,7 @@ private:
     }
     //设置调试回调--1
     void setupDebugCallback(){
+        TRACE_FUNCTION();
         //如果未启用校验层直接返回
         if(!enableValidationLayers)
             return;
@@ -528,9 +866,92 @@ private:
         return requiredExtensions.empty();
     }
 
+    //检测设备是否支持某一个扩展
+    bool checkDeviceExtension(VkPhysicalDevice device,const char* name){
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(
+                    device,nullptr,&extensionCount,nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(
+                    device,nullptr,&extensionCount,availableExtensions.data());
+        for(const auto& extension : availableExtensions){
+            if(strcmp(extension.extensionName,name) == 0){
+                return true;
+            }
+        }
+        return false;
+    }
+    /**
+    检测是否可以使用无绑定纹理.
+    需要部分绑定(partially bound),绑定后更新(update after bind)以及
+    运行时数组,材质索引对每次绘制是一致的,只需要动态索引的核心特性
+      */
+    void checkBindlessSupport(){
+        bindlessSupported = false;
+        for(const char* extension : bindlessDeviceExtensions){
+            if(!checkDeviceExtension(physicalDevice,extension)){
+                return;
+            }
+        }
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+        indexingFeatures.sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &indexingFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice,&features2);
+        if(!features2.features.shaderSampledImageArrayDynamicIndexing ||
+                !indexingFeatures.descriptorBindingPartiallyBound ||
+                !indexingFeatures.descriptorBindingSampledImageUpdateAfterBind ||
+                !indexingFeatures.descriptorBindingUpdateUnusedWhilePending ||
+                !indexingFeatures.runtimeDescriptorArray){
+            return;
+        }
+        //绑定后更新的描述符有单独的数量限制
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+        indexingProperties.sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice,&properties2);
+        bindlessTextureCapacity = std::min({MAX_BINDLESS_TEXTURES,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers});
+        bindlessSupported = bindlessTextureCapacity > 0;
+    }
+
+    /**
+    检测是否可以使用时间线信号量.
+    编译使用的 Vulkan 头文件没有 VK_KHR_timeline_semaphore 时总是使用栅栏
+      */
+    void checkTimelineSupport(){
+        timelineSupported = false;
+#ifdef VK_KHR_timeline_semaphore
+        if(!checkDeviceExtension(physicalDevice,
+                                 VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)){
+            return;
+        }
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+        timelineFeatures.sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &timelineFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice,&features2);
+        timelineSupported = timelineFeatures.timelineSemaphore == VK_TRUE;
+#endif
+    }
+
     //检查设备是否满足需求--2
     bool isDeviceSuitable(VkPhysicalDevice device){
         QueueFamilyIndices indices = findQueueFamilies(device);
+        //无窗口模式下不需要交换链,只需要图形队列
+        if(config.headless){
+            return indices.isComplete();
+        }
         //检测交换链是否支持
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
@@ -543,11 +964,9 @@ private:
             swapChainAdequate= !swapChainSupport.formats.empty()
                     && !swapChainSupport.presentModes.empty();
         }
-        //判断是否支持各向异性过滤
-        VkPhysicalDeviceFeatures supportedFeatures ;
-        vkGetPhysicalDeviceFeatures( device , &supportedFeatures );
+        //各向异性过滤不是必需的,在创建逻辑设备时根据设备支持情况启用
         return indices.isComplete() && extensionsSupported &&
-                swapChainAdequate && supportedFeatures.samplerAnisotropy;
+                swapChainAdequate;
 
         //以下代码不使用，仅做了解
         //查询基础设备属性，如名称/类型/支持的vulkan版本
@@ -570,6 +989,7 @@ private:
 
     //选择一个物理设备--2
     void pickPhysicalDevice(){
+        TRACE_FUNCTION();
         //首先需要请求显卡的数量
         uint32_t deviceCount = 0;
         VkResult res = vkEnumeratePhysicalDevices(instance,&deviceCount,nullptr);
@@ -595,6 +1015,7 @@ private:
     }
     //创建一个逻辑设备--3
     void createLogicalDevice(){
+        TRACE_FUNCTION();
         //获取带有图形能力的队列族
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
@@ -619,8 +1040,26 @@ private:
         }
         //指定应用程序使用的设备特性
         VkPhysicalDeviceFeatures deviceFeatures = {};
-        //各向异性过滤实际上是一个非必需的设备特性,这里指定使用
-        deviceFeatures.samplerAnisotropy = VK_TRUE;
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice,&supportedFeatures);
+        //各向异性过滤实际上是一个非必需的设备特性,支持时使用
+        deviceFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+        samplerAnisotropyEnabled = supportedFeatures.samplerAnisotropy == VK_TRUE;
+        //块压缩纹理格式只有在启用对应特性后才能使用,设备支持哪种就启用哪种
+        deviceFeatures.textureCompressionBC =
+                supportedFeatures.textureCompressionBC;
+        deviceFeatures.textureCompressionETC2 =
+                supportedFeatures.textureCompressionETC2;
+        deviceFeatures.textureCompressionASTC_LDR =
+                supportedFeatures.textureCompressionASTC_LDR;
+        //虚拟纹理的片段着色器写入反馈缓冲
+        if(virtualTexturing()){
+            if(!supportedFeatures.fragmentStoresAndAtomics){
+                throw std::runtime_error("virtual texturing requires "
+                                         "fragmentStoresAndAtomics");
+            }
+            deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+        }
         //创建逻辑设备相关信息
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -629,9 +1068,57 @@ private:
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.pEnabledFeatures = &deviceFeatures;
         //启用交换链扩展--4
+        //无窗口模式下不使用交换链扩展
+        std::vector<const char*> extensions;
+        if(!config.headless){
+            extensions = deviceExtensions;
+        }
+        /**
+        支持描述符索引或时间线信号量时,启用扩展,并通过 VkPhysicalDeviceFeatures2 的
+        pNext 链启用扩展特性,此时 pEnabledFeatures 必须为空
+          */
+        checkBindlessSupport();
+        checkTimelineSupport();
+        void* featureChain = nullptr;
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+        VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+        if(bindlessSupported){
+            extensions.insert(extensions.end(),
+                              bindlessDeviceExtensions.begin(),
+                              bindlessDeviceExtensions.end());
+            indexingFeatures.sType =
+              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+            indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind =
+                    VK_TRUE;
+            indexingFeatures.descriptorBindingUpdateUnusedWhilePending =
+                    VK_TRUE;
+            indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+            deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+            indexingFeatures.pNext = featureChain;
+            featureChain = &indexingFeatures;
+        }
+#ifdef VK_KHR_timeline_semaphore
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+        if(timelineSupported){
+            extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            timelineFeatures.sType =
+              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+            timelineFeatures.timelineSemaphore = VK_TRUE;
+            timelineFeatures.pNext = featureChain;
+            featureChain = &timelineFeatures;
+        }
+#endif
+        if(featureChain != nullptr){
+            deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            deviceFeatures2.pNext = featureChain;
+            deviceFeatures2.features = deviceFeatures;
+            createInfo.pNext = &deviceFeatures2;
+            createInfo.pEnabledFeatures = nullptr;
+        }
         createInfo.enabledExtensionCount=
-                static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+                static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
         if(enableValidationLayers){
             //以对设备和 Vulkan 实例使用相同地校验层
             createInfo.enabledLayerCount =
@@ -724,6 +1211,16 @@ private:
     //查找最佳的可用呈现模式--4
     VkPresentModeKHR chooseSwapPresentMode(
             const std::vector<VkPresentModeKHR> availablePresentModes){
+        //优先使用指定的呈现模式,不支持时按默认顺序选择
+        if(!config.autoPresentMode){
+            for(const auto& availablePresentMode : availablePresentModes){
+                if(availablePresentMode == config.presentMode){
+                    return availablePresentMode;
+                }
+            }
+            std::cerr<<"present mode "<<presentModeName(config.presentMode)
+                     <<" is not supported, choosing automatically"<<std::endl;
+        }
         VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
         for(const auto& availablePresentMode : availablePresentModes){
             if(availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR){
@@ -768,6 +1265,7 @@ private:
 
     //创建窗口表面--4
     void createSurface(){
+        TRACE_FUNCTION();
         //hwnd:窗口句柄   hinstance:进程实例句柄
         //通过glfw创建窗口表面
         VkResult res = glfwCreateWindowSurface(instance,window,nullptr,&surface);
@@ -777,12 +1275,12 @@ private:
     }
     //创建交换链--4
     void createSwapChain(){
+        TRACE_FUNCTION();
         SwapChainSupportDetails swapChainSupport =
                 querySwapChainSupport(physicalDevice);
         VkSurfaceFormatKHR surfaceFormat =
                 chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode =
-                chooseSwapPresentMode(swapChainSupport.presentModes);
+        presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
         /**
         设置包括交换链中的图像个数，也就是交换链的队列可以容纳的图像个数。
@@ -806,6 +1304,15 @@ private:
         createInfo.imageArrayLayers = 1;
         //指定我们将在图像上进行怎样的操作--这里是作为传输的目的图像
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        //读回帧时图像还要作为复制操作的源
+        if(readbackEnabled()){
+            if(!(swapChainSupport.capabilities.supportedUsageFlags &
+                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT)){
+                throw std::runtime_error(
+                            "swap chain images cannot be used for readback!");
+            }
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
 
         /**
         指定在多个队列族使用交换链图像的方式。
@@ -855,9 +1362,10 @@ private:
         oldSwapchain需要指定它，是因为应用程序在运行过程中交换链可能会失效。
         比如，改变窗口大小后，交换链需要重建，重建时需要之前的交换链
 
-        可以实现原来的交换链仍在使用时重建新的交换链
+        可以实现原来的交换链仍在使用时重建新的交换链,
+        驱动可以复用旧交换链的资源,旧交换链中已经获取的图像仍然可以呈现
           */
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = swapChain;
         //创建交换链
         if(vkCreateSwapchainKHR(device,&createInfo,nullptr,&swapChain)
                 != VK_SUCCESS){
@@ -871,14 +1379,82 @@ private:
         //获取交换链图像句柄
         vkGetSwapchainImagesKHR(device,swapChain,&imageCount,nullptr);
         swapChainImages.resize(imageCount);
+        //同一索引的 uniform 缓冲在新旧交换链之间共用,保留旧图像的时间线值
+        imageTimelineValues.resize(imageCount,0);
         vkGetSwapchainImagesKHR(device,swapChain,&imageCount,
                                 swapChainImages.data());
         //存储我们设置的交换链图像格式和范围
         swapChainImageFormat = surfaceFormat.format;
         swapChainExtent = extent;
+        updateFramePacing();
+    }
+    /**
+    无窗口模式下创建离屏颜色图像代替交换链图像.
+    之后的图像视图,深度图像,帧缓冲和 uniform 缓冲都按交换链图像的方式创建,
+    所以可以使用同一个渲染流程和图形管线.图像个数等于同时处理的帧数的上限,
+    保证每一帧都有自己的颜色图像
+      */
+    void createOffscreenTargets(){
+        TRACE_FUNCTION();
+        swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        swapChainExtent = {config.width,config.height};
+        swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+        offscreenImageMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        imageTimelineValues.resize(MAX_FRAMES_IN_FLIGHT,0);
+        for(uint32_t i = 0;i < MAX_FRAMES_IN_FLIGHT;i++){
+            //渲染后的图像作为复制操作的源,用于读回
+            createImage(config.width,config.height,1,swapChainImageFormat,
+                        VK_IMAGE_TILING_OPTIMAL,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        swapChainImages[i],offscreenImageMemory[i]);
+        }
+    }
+    /**
+    根据呈现模式设置帧节奏.
+    FIFO 模式下帧率被限制为刷新率,CPU 跑得更快只会让帧在队列中排队,
+    所以默认把读取输入的节奏设为刷新率;MAILBOX 和 IMMEDIATE 模式默认不限制
+      */
+    void updateFramePacing(){
+        double targetFrameTime = 0.0;
+        if(config.paceFps > 0){
+            targetFrameTime = 1000.0 / config.paceFps;
+        }else if(config.paceFps < 0 && presentMode == VK_PRESENT_MODE_FIFO_KHR &&
+                 !config.headless){
+            int refreshRate = 60;
+            GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+            const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+            if(mode && mode->refreshRate > 0){
+                refreshRate = mode->refreshRate;
+            }
+            targetFrameTime = 1000.0 / refreshRate;
+        }
+        framePacer.setTargetFrameTime(targetFrameTime);
+    }
+    //修改呈现模式设置,在下一次呈现后重建交换链
+    void setPresentMode(bool automatic,VkPresentModeKHR mode){
+        config.autoPresentMode = automatic;
+        config.presentMode = mode;
+        presentModeChanged = true;
+    }
+    //输出当前呈现模式下的帧时间统计
+    void reportFramePacing(){
+        const SampleStats& stats = framePacer.stats();
+        if(stats.count() == 0){
+            return;
+        }
+        std::cout<<std::fixed<<std::setprecision(2)
+                 <<"present mode "<<presentModeName(presentMode)
+                 <<", target "<<framePacer.targetFrameTimeMs()<<" ms: "
+                 <<stats.count()<<" frames, mean "<<stats.mean()
+                 <<" ms, stddev "<<stats.stddev()
+                 <<" ms, variance "<<stats.variance()
+                 <<" ms^2, p99 "<<stats.percentile(99)<<" ms"<<std::endl;
     }
     //为交换链中的每一个图像建立图像视图--5
     void createImageViews(){
+        TRACE_FUNCTION();
         //分配足够的数组空间来存储图像视图
         swapChainImageViews.resize(swapChainImages.size());
         //遍历所有交换链图像，创建图像视图
@@ -889,7 +1465,7 @@ private:
         }
     }
     //使用我们读取的着色器字节码数组作为参数来创建 VkShaderModule 对象--9
-    VkShaderModule createShaderModule(const std::vector<char>& code){
+    VkShaderModule createShaderModule(const void* code,size_t size){
         VkShaderModuleCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         /**
@@ -897,10 +1473,10 @@ private:
         需要先将存储字节码的数组指针转换为 const uint32_t* 变量类型，
         来匹配结构体中的字节码指针的变量类型。
         我们指定的指针指向的地址应该符合 uint32_t变量类型的内存对齐方式.
-        使用的 std::vector，它的默认分配器分配的内存的地址符合这一要求.
+        内存映射的起始地址按页对齐,符合这一要求.
         */
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        createInfo.codeSize = size;
+        createInfo.pCode = static_cast<const uint32_t*>(code);
         VkShaderModule shaderModule;
         //创建 VkShaderModule对象
         if(vkCreateShaderModule(device,&createInfo,nullptr,
@@ -909,19 +1485,36 @@ private:
         }
         return shaderModule;
     }
+    /**
+    读取着色器字节码并创建 VkShaderModule.资源包中的字节码解压到 uint32_t 数组,
+    满足对齐要求;磁盘上的文件直接映射,不复制到堆上的缓冲
+      */
+    VkShaderModule loadShaderModule(const std::string& path){
+        const AssetArchive::Entry* entry = archivedAsset(path);
+        if(entry != nullptr){
+            std::vector<uint32_t> code(static_cast<size_t>((entry->size + 3) / 4));
+            archive.read(*entry,code.data());
+            return createShaderModule(code.data(),static_cast<size_t>(entry->size));
+        }
+        MappedFile code(path);
+        return createShaderModule(code.data(),code.size());
+    }
 
     //创建图形管线--9
     void createGraphicsPipeline(){
-        //着色器字节码的读取
-        auto vertShaderCode = readFile(
-                    "E:/workspace/Qt5.6/VulkanLearn/shaders/vert.spv");
-        auto fragShaderCode = readFile(
-                    "E:/workspace/Qt5.6/VulkanLearn/shaders/frag.spv");
+        TRACE_FUNCTION();
         //VkShaderModule是一个对着色器字节码的包装
         VkShaderModule vertShaderModule;
         VkShaderModule fragShaderModule;
-        vertShaderModule = createShaderModule(vertShaderCode);
-        fragShaderModule = createShaderModule(fragShaderCode);
+        vertShaderModule = loadShaderModule(
+                    "E:/workspace/Qt5.6/VulkanLearn/shaders/vert.spv");
+        //使用无绑定纹理时,片段着色器通过材质索引从纹理数组中采样
+        //使用虚拟纹理时,片段着色器通过页表从物理缓存中采样
+        fragShaderModule = loadShaderModule(virtualTexturing() ?
+                    "E:/workspace/Qt5.6/VulkanLearn/shaders/frag_virtual.spv" :
+                    bindlessSupported ?
+                    "E:/workspace/Qt5.6/VulkanLearn/shaders/frag_bindless.spv" :
+                    "E:/workspace/Qt5.6/VulkanLearn/shaders/frag.spv");
         //VkPipelineShaderStageCreateInfo指定着色器哪一阶段被使用
         //点着色器
         VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
@@ -943,6 +1536,41 @@ private:
         fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         fragShaderStageInfo.module = fragShaderModule;
         fragShaderStageInfo.pName = "main";
+        //虚拟纹理的大小和页的划分在运行时不变,作为特化常量传给片段着色器
+        struct VirtualTextureConstants{
+            uint32_t virtualWidth;
+            uint32_t virtualHeight;
+            uint32_t tileSize;
+            uint32_t border;
+            uint32_t levelCount;
+            float cacheSize;
+            float uvScaleX;
+            float uvScaleY;
+        } virtualConstants = {};
+        VkSpecializationMapEntry specializationEntries[8];
+        VkSpecializationInfo specializationInfo = {};
+        if(virtualTexturing()){
+            const VirtualTextureLayout& layout = virtualTexture.layout;
+            virtualConstants.virtualWidth = layout.virtualWidth;
+            virtualConstants.virtualHeight = layout.virtualHeight;
+            virtualConstants.tileSize = layout.tileSize;
+            virtualConstants.border = layout.border;
+            virtualConstants.levelCount = layout.levelCount;
+            virtualConstants.cacheSize =
+                    float(config.virtualCachePages * layout.tileExtent());
+            virtualConstants.uvScaleX = float(layout.width) / layout.virtualWidth;
+            virtualConstants.uvScaleY = float(layout.height) / layout.virtualHeight;
+            for(uint32_t i = 0;i < 8;i++){
+                specializationEntries[i].constantID = i;
+                specializationEntries[i].offset = i * 4;
+                specializationEntries[i].size = 4;
+            }
+            specializationInfo.mapEntryCount = 8;
+            specializationInfo.pMapEntries = specializationEntries;
+            specializationInfo.dataSize = sizeof(virtualConstants);
+            specializationInfo.pData = &virtualConstants;
+            fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
+        }
         /**
           pSpecializationInfo--指定着色器用到的常量,
         我们可以对同一个着色器模块对象指定不同的着色器常量用于管线创建，这
@@ -1002,19 +1630,7 @@ private:
         素实际被存储在帧缓存。任何位于裁剪矩形外的像素都会被光栅化程序丢弃.
           */
         //视口和裁剪
-        VkViewport viewport = {};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)swapChainExtent.width;
-        viewport.height = (float)swapChainExtent.height;
-        //用于指定帧缓冲使用的深度值的范围
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        //裁剪范围设置
-        //这里我们在整个帧缓冲上进行绘制操作,所以将裁剪范围设置为和帧缓冲大小一样
-        VkRect2D scissor = {};
-        scissor.offset = {0,0};
-        scissor.extent = swapChainExtent;
+        //视口和裁剪矩形的大小等于交换链图像的大小,在 recordCommandBuffer 中设置
         /**
         许多显卡可以使用多个视口和裁剪矩形，所以指定视口和裁剪矩形的成员变量
         是一个指向视口和裁剪矩形的结构体数组指针。
@@ -1024,10 +1640,11 @@ private:
         VkPipelineViewportStateCreateInfo viewportState = {};
         viewportState.sType =
                 VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        //视口和裁剪矩形使用动态状态,在记录指令时设置,这里只指定个数
         viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
+        viewportState.pViewports = nullptr;
         viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
+        viewportState.pScissors = nullptr;
         /**
         光栅化程序将来自顶点着色器的顶点构成的几何图元转换为片段交由片段着色器着色。
         深度测试，背面剔除和裁剪测试如何开启了，也由光栅化程序执行。
@@ -1123,7 +1740,7 @@ private:
         multisampling.sType =
                 VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        multisampling.rasterizationSamples = msaaSamples;
         //multisampling.minSampleShading = 1.0f;
         multisampling.pSampleMask = nullptr;//进行深度测试和模板测试
         multisampling.alphaToCoverageEnable = VK_FALSE;
@@ -1168,12 +1785,12 @@ private:
         colorBlending.blendConstants[1] = 0.0f;
         colorBlending.blendConstants[2] = 0.0f;
         colorBlending.blendConstants[3] = 0.0f;
-#if 0
         //动态状态
         //只有非常有限的管线状态可以在不重建管线的情况下进行动态修改。
         //这包括视口大小，线宽和混合常量
+        //视口和裁剪矩形使用动态状态,窗口大小改变时不需要重建管线
         VkDynamicState dynamicStates[] ={
-            VK_DYNAMIC_STATE_VIEWPORT,VK_DYNAMIC_STATE_LINE_WIDTH
+            VK_DYNAMIC_STATE_VIEWPORT,VK_DYNAMIC_STATE_SCISSOR
         };
         //指定需要动态修改的状态
         VkPipelineDynamicStateCreateInfo dynamicState = {};
@@ -1181,7 +1798,6 @@ private:
                 VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
         dynamicState.dynamicStateCount = 2;
         dynamicState.pDynamicStates = dynamicStates;
-#endif
         /**
         我们可以在着色器中使用 uniform 变量，它可以在管线建立后动态地
         被应用程序修改，实现对着色器进行一定程度的动态配置。uniform 变量经
@@ -1194,10 +1810,23 @@ private:
         pipelineLayoutInfo.sType =
                 VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         //设置描述符布局
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+        //set 0 为每帧的uniform数据,使用无绑定纹理时 set 1 为纹理数组,
+        //使用虚拟纹理时 set 1 为页表,物理缓存和反馈缓冲
+        VkDescriptorSetLayout setLayouts[] = {
+            descriptorSetLayout,
+            virtualTexturing() ? virtualSetLayout : bindlessSetLayout
+        };
+        pipelineLayoutInfo.setLayoutCount =
+                virtualTexturing() || bindlessSupported ? 2 : 1;
+        pipelineLayoutInfo.pSetLayouts = setLayouts;
+        //推送常量范围,模型矩阵在顶点着色器中使用,材质索引在片段着色器中使用
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags =
+                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(PushConstantObject);
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
         //VkPipelineLayout 结构体指定可以在着色器中使用的常量值
         if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,
                                   &pipelineLayout) != VK_SUCCESS){
@@ -1220,7 +1849,7 @@ private:
         //如果渲染流程包含了深度模板附着，那就必须指定深度模板状态信息。
         pipelineInfo.pDepthStencilState = &depthStencil;
         pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = nullptr;
+        pipelineInfo.pDynamicState = &dynamicState;
         //指定之前创建的管线布局
         pipelineInfo.layout = pipelineLayout;
         //引用之前创建的渲染流程对象和图形管线使用的子流程在子流程数组中的索引
@@ -1265,11 +1894,12 @@ private:
       */
     //创建渲染流程对象--9
     void createRenderPass(){
+        TRACE_FUNCTION();
         //设置深度附着信息
         VkAttachmentDescription depthAttachment = {};
         //format成员变量的值的设置应该和深度图像的图像数据格式相同
         depthAttachment.format = findDepthFormat();
-        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.samples = msaaSamples;
         depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         //绘制结束后不需要从深度缓冲中复制深度数据,所以设备为此值,
         //这样可以让驱动进行一定程度的优化
@@ -1290,8 +1920,8 @@ private:
         VkAttachmentDescription colorAttachment = {};
         //format指定颜色缓冲附着的格式
         colorAttachment.format = swapChainImageFormat;
-        //samples指定采样数,这里我们没有使用多重采样，所以将采样数设置为 1。
-        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        //samples指定采样数,和管线的 rasterizationSamples 一致
+        colorAttachment.samples = msaaSamples;
         /**
         loadOp 和 storeOp 成员变量用于指定在渲染之前和渲染之后对附着中的数据进行的操作.
         loadOp可以设置为下面这些值：
@@ -1323,7 +1953,24 @@ private:
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         //于指定渲染流程结束后的图像布局方式
         //这里设置使得渲染后的图像可以被交换链呈现。
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        //无窗口模式或读回帧时图像之后用于复制读回,
+        //使用动态分辨率时渲染到内部图像,之后由放大流程采样
+        colorAttachment.finalLayout = presentLayout();
+        if(dynamicResEnabled){
+            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+        /**
+        使用多重采样时颜色附着是多重采样的图像,子流程结束时解析到交换链图像.
+        多重采样的数据不保存(STORE_OP_DONT_CARE),交换链图像的内容全部由解析写入,
+        不需要加载
+          */
+        VkAttachmentDescription resolveAttachment = colorAttachment;
+        resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        if(msaaSamples != VK_SAMPLE_COUNT_1_BIT){
+            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
         /**
         一个渲染流程可以包含多个子流程。子流程依赖于上一流程处理后的
         帧缓冲内容。比如，许多叠加的后期处理效果就是在上一次的处理结果上
@@ -1360,6 +2007,13 @@ private:
         subpass.pColorAttachments = &colorAttachmentRef;
         //为我们仅有的子流程添加对深度附着的引用
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
+        //解析附着放在颜色和深度附着之后,清除值的下标不变
+        VkAttachmentReference resolveAttachmentRef = {};
+        resolveAttachmentRef.attachment = 2;
+        resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        if(msaaSamples != VK_SAMPLE_COUNT_1_BIT){
+            subpass.pResolveAttachments = &resolveAttachmentRef;
+        }
 
         //配置子流程依赖
         VkSubpassDependency dependency = {};
@@ -1380,6 +2034,10 @@ private:
           */
         dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         dependency.srcAccessMask = 0;
+        //内部图像在所有帧之间共用,写入前要等之前的帧的放大流程读取完毕
+        if(dynamicResEnabled){
+            dependency.srcStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        }
         /**
         dstStageMask 和 dstAccessMask 成员变量用于指定需要等待的管线阶
         段和子流程将进行的操作类型。在这里，我们的设置为等待颜色附着的输
@@ -1396,20 +2054,38 @@ private:
         一般而言，也很少有需要多个深度附着的情况
           */
         //更新 VkRenderPassCreateInfo 结构体信息引用深度附着
-        std::array<VkAttachmentDescription,2> attachments = {
-                            colorAttachment, depthAttachment};
+        std::array<VkAttachmentDescription,3> attachments = {
+                            colorAttachment, depthAttachment, resolveAttachment};
         //创建渲染流程对象相关信息
         VkRenderPassCreateInfo renderPassInfo = {};
         renderPassInfo.sType =
                 VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         renderPassInfo.attachmentCount =
-                static_cast<uint32_t>(attachments.size());
+                msaaSamples != VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
         renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
+        /**
+        读回帧时,渲染流程结束后要复制颜色附着,
+        需要等颜色附着写入完成(以及布局变换完成)后才能开始复制
+          */
+        std::array<VkSubpassDependency,2> dependencies = {dependency,{}};
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask =
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        //使用动态分辨率时读回在放大流程之后,这里改为等待写入完成后由片段着色器采样
+        if(dynamicResEnabled){
+            dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
         //指定渲染流程使用的依赖信息
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.dependencyCount =
+                readbackEnabled() || dynamicResEnabled ? 2 : 1;
+        renderPassInfo.pDependencies = dependencies.data();
         //创建渲染流程对象
         if(vkCreateRenderPass(device,&renderPassInfo,nullptr,
                               &renderPass) != VK_SUCCESS){
@@ -1419,6 +2095,7 @@ private:
     }
     //帧缓冲对象的创建--10
     void createFramebuffers(){
+        TRACE_FUNCTION();
         //分配足够的空间来存储所有帧缓冲对象
         swapChainFramebuffers.resize(swapChainImageViews.size());
         for(size_t i = 0;i<swapChainImageViews.size();i++){
@@ -1428,9 +2105,16 @@ private:
             设置，同时只会有一个子流程在执行，所以，这里我们只需要使用一个深度附着即可
               */
             //指定深度图像视图对象作为帧缓冲的第二个附着
-            std::array<VkImageView,2> attachments = {
-                swapChainImageViews[i],depthImageView
+            //使用多重采样时第一个附着是多重采样的颜色图像,交换链图像作为解析附着
+            //使用动态分辨率时场景渲染到内部图像,代替交换链图像
+            VkImageView target = dynamicResEnabled ?
+                        sceneImageView : swapChainImageViews[i];
+            std::array<VkImageView,3> attachments = {
+                target,depthImageView,VK_NULL_HANDLE
             };
+            if(msaaSamples != VK_SAMPLE_COUNT_1_BIT){
+                attachments = {{ msaaColorImageView,depthImageView,target }};
+            }
             VkFramebufferCreateInfo framebufferInfo = {};
             framebufferInfo.sType =
                     VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -1442,7 +2126,7 @@ private:
             framebufferInfo.renderPass = renderPass;
             //指定附着个数
             framebufferInfo.attachmentCount =
-                    static_cast<uint32_t>(attachments.size());
+                    msaaSamples != VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
             //指定渲染流程对象用于描述附着信息的 pAttachment 数组
             framebufferInfo.pAttachments = attachments.data();
             //指定帧缓冲的大小
@@ -1456,9 +2140,13 @@ private:
                 throw std::runtime_error("failed to create framebuffer!");
             }
         }
+        if(dynamicResEnabled){
+            createUpscaleFramebuffers();
+        }
     }
     //创建指令池--11
     void createCommandPool(){
+        TRACE_FUNCTION();
         /**
         指令缓冲对象在被提交给我们之前获取的队列后，被 Vulkan 执行。每
         个指令池对象分配的指令缓冲对象只能提交给一个特定类型的队列。在这
@@ -1473,15 +2161,16 @@ private:
         指令缓冲对象之间相互独立，不会被一起重置。
         不使用这一标记，指令缓冲对象会被放在一起重置
 
-        这里我们只在程序初始化时记录指令到指令缓冲对象，
-        然后在程序的主循环中执行指令，所以，我们不使用上面这两个标记
+        模型矩阵通过推送常量传递,需要每一帧重新记录指令缓冲,
+        所以这里使用VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT标记,
+        让每一帧的指令缓冲可以单独重置
          */
         QueueFamilyIndices queueFamilyIndices =
                 findQueueFamilies(physicalDevice);
         VkCommandPoolCreateInfo poolInfo = {};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-        poolInfo.flags = 0;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
         //指令池对象的创建
         if(vkCreateCommandPool(device,&poolInfo,nullptr,
                                &commandPool) != VK_SUCCESS){
@@ -1490,15 +2179,13 @@ private:
     }
     /**
     指令缓冲对象，用来记录绘制指令
-    由于绘制操作是在帧缓冲上进行的，我们需要为交换链中的每一个图像分配一个指令缓冲对象
+    模型矩阵通过推送常量传递,每一帧都要重新记录指令,
+    所以我们为每一个并行处理的帧分配一个指令缓冲对象,而不是为每一个交换链图像分配
       */
     //创建指令缓冲对象--11
     void createCommandBuffers(){
-        std::array<VkClearValue,2> clearValues = {};
-        clearValues[0].color = {0.0f , 0.0f , 0.0f , 1.0f};
-        //深度缓冲的初始值应该设置为远平面的深度值,也就是1.0
-        clearValues[1].depthStencil = {1.0f, 0};
-        commandBuffers.resize(swapChainFramebuffers.size());
+        TRACE_FUNCTION();
+        commandBuffers.resize(framesInFlight);
         //指定分配使用的指令池和需要分配的指令缓冲对象个数
         VkCommandBufferAllocateInfo allocInfo = {};
         allocInfo.sType =
@@ -1522,135 +2209,232 @@ private:
                                     commandBuffers.data())!= VK_SUCCESS){
             throw std::runtime_error("failed to allocate command buffers!");
         }
-        //记录指令到指令缓冲
-        for(size_t i=0;i<commandBuffers.size();i++){
-            //指定一些有关指令缓冲的使用细节
-            VkCommandBufferBeginInfo beginInfo = {};
-            beginInfo.sType =
-                    VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            /**
-            flags 成员变量用于指定我们将要怎样使用指令缓冲。它的值可以是下面这些:
-            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT：
-            指令缓冲在执行一次后，就被用来记录新的指令.
-            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT：
-            这是一个只在一个渲染流程内使用的辅助指令缓冲.
-            VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT：
-            在指令缓冲等待执行时，仍然可以提交这一指令缓冲
-              */
-            beginInfo.flags =
-                    VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-            //用于辅助指令缓冲，可以用它来指定从调用它的主要指令缓冲继承的状态
-            beginInfo.pInheritanceInfo = nullptr;
-            //指令缓冲对象记录指令后，调用vkBeginCommandBuffer函数会重置指令缓冲对象
-            //开始指令缓冲的记录操作
-            if(vkBeginCommandBuffer(commandBuffers[i],&beginInfo)!=VK_SUCCESS){
-                throw std::runtime_error(
-                            "failed to begin recording command buffer.");
-            }
-            //指定使用的渲染流程对象
-            VkRenderPassBeginInfo renderPassInfo = {};
-            renderPassInfo.sType =VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            //指定使用的渲染流程对象
-            renderPassInfo.renderPass = renderPass;
-            //指定使用的帧缓冲对象
-            renderPassInfo.framebuffer = swapChainFramebuffers[i];
-            /**
-            renderArea指定用于渲染的区域。位于这一区域外的像素数据会处于未定义状态。
-            通常，我们将这一区域设置为和我们使用的附着大小完全一样.
-              */
-            renderPassInfo.renderArea.offset = {0,0};
-            renderPassInfo.renderArea.extent = swapChainExtent;
-            VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
-            //指定标记后，使用的清除值
-            /**
-            我们使用了多个使用 VK_ATTACHMENT_LOAD_OP_CLEAR
-            标记的附着，这也意味着我们需要设置多个清除值
-              */
-            renderPassInfo.clearValueCount =
-                    static_cast<uint32_t>(clearValues.size());
-            renderPassInfo.pClearValues = clearValues.data();
-            /**
-            所有可以记录指令到指令缓冲的函数的函数名都带有一个 vkCmd 前缀，
-            并且这些函数的返回值都是 void，也就是说在指令记录操作完全结束前，
-            不用进行任何错误处理。
-            这类函数的第一个参数是用于记录指令的指令缓冲对象。第二个参数
-            是使用的渲染流程的信息。最后一个参数是用来指定渲染流程如何提供绘
-            制指令的标记，它可以是下面这两个值之一：
-            VK_SUBPASS_CONTENTS_INLINE：
-            所有要执行的指令都在主要指令缓冲中，没有辅助指令缓冲需要执行
-            VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS：
-            有来自辅助指令缓冲的指令需要执行。
-              */
-            //开始一个渲染流程
-            vkCmdBeginRenderPass( commandBuffers[i], &renderPassInfo,
-                                   VK_SUBPASS_CONTENTS_INLINE) ;
-            //绑定图形管线,第二个参数用于指定管线对象是图形管线还是计算管线
-            vkCmdBindPipeline(commandBuffers[i],VK_PIPELINE_BIND_POINT_GRAPHICS,
-                              graphicsPipeline ) ;
+    }
+    //记录绘制指令到指令缓冲,imageIndex为要渲染的交换链图像索引
+    void recordCommandBuffer(VkCommandBuffer commandBuffer,uint32_t imageIndex){
+        TRACE_FUNCTION();
+        std::array<VkClearValue,2> clearValues = {};
+        clearValues[0].color = {0.0f , 0.0f , 0.0f , 1.0f};
+        //深度缓冲的初始值应该设置为远平面的深度值,也就是1.0
+        clearValues[1].depthStencil = {1.0f, 0};
+        //指定一些有关指令缓冲的使用细节
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType =
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        /**
+        flags 成员变量用于指定我们将要怎样使用指令缓冲。它的值可以是下面这些:
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT：
+        指令缓冲在执行一次后，就被用来记录新的指令.
+        VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT：
+        这是一个只在一个渲染流程内使用的辅助指令缓冲.
+        VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT：
+        在指令缓冲等待执行时，仍然可以提交这一指令缓冲
+          */
+        beginInfo.flags =
+                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        //用于辅助指令缓冲，可以用它来指定从调用它的主要指令缓冲继承的状态
+        beginInfo.pInheritanceInfo = nullptr;
+        //指令缓冲对象记录指令后，调用vkBeginCommandBuffer函数会重置指令缓冲对象
+        //开始指令缓冲的记录操作
+        if(vkBeginCommandBuffer(commandBuffer,&beginInfo)!=VK_SUCCESS){
+            throw std::runtime_error(
+                        "failed to begin recording command buffer.");
+        }
+        uint32_t frameScope = gpuProfiler.beginScope(commandBuffer,"frame");
+        if(meshStreaming()){
+            streamMeshChunks(commandBuffer);//在渲染流程之外上传这一帧的网格数据块
+        }
+        if(virtualTexturing()){
+            streamVirtualTexture(commandBuffer);//加载上一次使用这一帧的反馈请求的页
+        }
+        if(textureStreaming()){
+            streamTextureMips(commandBuffer);//在预算内提高或降低纹理的驻留级别
+        }
+        //使用动态分辨率时只渲染内部图像左上角这一帧的缩放比例对应的区域
+        renderExtent = swapChainExtent;
+        if(dynamicResEnabled){
+            double scale = dynamicResolution.beginFrame(frameNumber);
+            renderExtent.width = DynamicResolution::scaledSize(
+                        swapChainExtent.width,scale);
+            renderExtent.height = DynamicResolution::scaledSize(
+                        swapChainExtent.height,scale);
+        }
+        //指定使用的渲染流程对象
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType =VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        //指定使用的渲染流程对象
+        renderPassInfo.renderPass = renderPass;
+        //指定使用的帧缓冲对象
+        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        /**
+        renderArea指定用于渲染的区域。位于这一区域外的像素数据会处于未定义状态。
+        通常，我们将这一区域设置为和我们使用的附着大小完全一样.
+          */
+        renderPassInfo.renderArea.offset = {0,0};
+        renderPassInfo.renderArea.extent = renderExtent;
+        VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+        //指定标记后，使用的清除值
+        /**
+        我们使用了多个使用 VK_ATTACHMENT_LOAD_OP_CLEAR
+        标记的附着，这也意味着我们需要设置多个清除值
+          */
+        renderPassInfo.clearValueCount =
+                static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        /**
+        所有可以记录指令到指令缓冲的函数的函数名都带有一个 vkCmd 前缀，
+        并且这些函数的返回值都是 void，也就是说在指令记录操作完全结束前，
+        不用进行任何错误处理。
+        这类函数的第一个参数是用于记录指令的指令缓冲对象。第二个参数
+        是使用的渲染流程的信息。最后一个参数是用来指定渲染流程如何提供绘
+        制指令的标记，它可以是下面这两个值之一：
+        VK_SUBPASS_CONTENTS_INLINE：
+        所有要执行的指令都在主要指令缓冲中，没有辅助指令缓冲需要执行
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS：
+        有来自辅助指令缓冲的指令需要执行。
+          */
+        //开始一个渲染流程
+        uint32_t renderPassScope =
+                gpuProfiler.beginScope(commandBuffer,"render pass");
+        vkCmdBeginRenderPass( commandBuffer, &renderPassInfo,
+                               VK_SUBPASS_CONTENTS_INLINE) ;
+        //绑定图形管线,第二个参数用于指定管线对象是图形管线还是计算管线
+        vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          graphicsPipeline ) ;
+        //设置动态的视口和裁剪矩形,与渲染区域一致
+        //这里我们在整个渲染区域上进行绘制操作,所以将裁剪范围设置为和渲染区域一样
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float)renderExtent.width;
+        viewport.height = (float)renderExtent.height;
+        //用于指定帧缓冲使用的深度值的范围
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer,0,1,&viewport);
+        VkRect2D scissor = {};
+        scissor.offset = {0,0};
+        scissor.extent = renderExtent;
+        vkCmdSetScissor(commandBuffer,0,1,&scissor);
 
-            /**
-            至此，我们已经提交了需要图形管线执行的指令，以及片段着色器使用的附着
-            */
-            VkBuffer vertexBuffers[] = { vertexBuffer };
-            VkDeviceSize offset[] = {0};
-            /**
-            vkCmdBindVertexBuffers第二,三个参数指定偏移值和我们要绑定的顶点缓冲的数量。
-            最后两个参数用于指定需要绑定的顶点缓冲数组以及顶点数据在顶点缓冲中的偏移值数组
-              */
-            //绑定顶点缓冲
-            vkCmdBindVertexBuffers(commandBuffers[i],0,1,vertexBuffers,offset);
+        /**
+        至此，我们已经提交了需要图形管线执行的指令，以及片段着色器使用的附着
+        */
+        VkBuffer vertexBuffers[] = { vertexBuffer };
+        VkDeviceSize offset[] = {0};
+        /**
+        vkCmdBindVertexBuffers第二,三个参数指定偏移值和我们要绑定的顶点缓冲的数量。
+        最后两个参数用于指定需要绑定的顶点缓冲数组以及顶点数据在顶点缓冲中的偏移值数组
+          */
+        //绑定顶点缓冲,流式加载的网格每一块绘制前绑定自己的缓冲
+        if(!meshStreaming()){
+            vkCmdBindVertexBuffers(commandBuffer,0,1,vertexBuffers,offset);
+        }
 
-            /**
-              只能绑定一个索引缓冲对象.
-            我们不能为每个顶点属性使用不同的索引，所以即使只有一个顶点属性不同，
-            也要在顶点缓冲中多出一个顶点的数据
-              */
-            //绑定顶点缓冲到指令缓冲对象--第三个参数为索引数据的类型
-            vkCmdBindIndexBuffer(commandBuffers[i],indexBuffer,0,
+        /**
+          只能绑定一个索引缓冲对象.
+        我们不能为每个顶点属性使用不同的索引，所以即使只有一个顶点属性不同，
+        也要在顶点缓冲中多出一个顶点的数据
+          */
+        //绑定顶点缓冲到指令缓冲对象--第三个参数为索引数据的类型
+        if(!meshStreaming()){
+            vkCmdBindIndexBuffer(commandBuffer,indexBuffer,0,
                                  VK_INDEX_TYPE_UINT32);
-            //为每个交换链图像绑定对应的描述符集
-            vkCmdBindDescriptorSets(commandBuffers[i] ,
+        }
+        //为每个交换链图像绑定对应的描述符集,缓存命中时不会更新描述符
+        VkDescriptorSet descriptorSet = getDescriptorSet(imageIndex);
+        vkCmdBindDescriptorSets(commandBuffer ,
+                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipelineLayout,0,1,&descriptorSet,0,nullptr);
+        if(virtualTexturing()){
+            //动态偏移选择这一帧的反馈缓冲段
+            uint32_t feedbackOffset =
+                    static_cast<uint32_t>(currentFrame * feedbackSlice);
+            vkCmdBindDescriptorSets(commandBuffer,
                             VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout,0,1,&descriptorSets[i],0,nullptr);
-            /**
-              vkCmdDraw参数：
-              1.记录有要执行的指令的指令缓冲对象
-              2. vertexCount：顶点缓冲中的顶点个数
-                尽管这里我们没有使用顶点缓冲，但仍然需要指定三个顶点用于三角形的绘制。
-              3.instanceCount：用于实例渲染，为 1 时表示不进行实例渲染
-              4.firstVertex：用于定义着色器变量 gl_VertexIndex 的值
-              5.firstInstance：用于定义着色器变量 gl_InstanceIndex 的值
-              */
-            //开始调用指令进行三角形的绘制操作--使用顶点绘制
-            /*vkCmdDraw( commandBuffers [ i ] ,
-                       static_cast<uint32_t>(vertices.size()) , 1 , 0 , 0);*/
-            /**
-              vkCmdDrawIndexed参数：
-              1.指令缓冲对象
-              2.指定索引的个数
-              3.实例的个数 -- 这里没有使用实例渲染，所以将实例个数设置为 1
-              4.偏移值用于指定显卡开始读取索引的位置,偏移值为1对应索引数据中的第二个索引。
-              5.检索顶点数据前加到顶点索引上的数值
-              6.第一个被渲染的实例的 ID -- 这里没有使用
-              */
-            //使用索引绘制
-            vkCmdDrawIndexed(commandBuffers[i],
+                            pipelineLayout,1,1,&virtualDescriptorSet,
+                            1,&feedbackOffset);
+        }else if(bindlessSupported){
+            //纹理数组每帧只绑定一次,不同材质的绘制之间不需要切换描述符集
+            vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout,1,1,&bindlessDescriptorSet,0,nullptr);
+        }
+        //更新推送常量,直接写入指令缓冲,不需要描述符更新和内存映射
+        pushConstants.materialIndex = textureMaterialIndex;
+        pushConstants.frameIndex = static_cast<uint32_t>(frameNumber);
+        vkCmdPushConstants(commandBuffer,pipelineLayout,
+                           VK_SHADER_STAGE_VERTEX_BIT |
+                           VK_SHADER_STAGE_FRAGMENT_BIT,0,
+                           sizeof(PushConstantObject),&pushConstants);
+        /**
+          vkCmdDraw参数：
+          1.记录有要执行的指令的指令缓冲对象
+          2. vertexCount：顶点缓冲中的顶点个数
+            尽管这里我们没有使用顶点缓冲，但仍然需要指定三个顶点用于三角形的绘制。
+          3.instanceCount：用于实例渲染，为 1 时表示不进行实例渲染
+          4.firstVertex：用于定义着色器变量 gl_VertexIndex 的值
+          5.firstInstance：用于定义着色器变量 gl_InstanceIndex 的值
+          */
+        //开始调用指令进行三角形的绘制操作--使用顶点绘制
+        /*vkCmdDraw( commandBuffer ,
+                   static_cast<uint32_t>(vertices.size()) , 1 , 0 , 0);*/
+        /**
+          vkCmdDrawIndexed参数：
+          1.指令缓冲对象
+          2.指定索引的个数
+          3.实例的个数 -- 这里没有使用实例渲染，所以将实例个数设置为 1
+          4.偏移值用于指定显卡开始读取索引的位置,偏移值为1对应索引数据中的第二个索引。
+          5.检索顶点数据前加到顶点索引上的数值
+          6.第一个被渲染的实例的 ID -- 这里没有使用
+          */
+        //使用索引绘制
+        if(meshStreaming()){
+            drawStreamedMesh(commandBuffer);
+        }else{
+            vkCmdDrawIndexed(commandBuffer,
                        static_cast<uint32_t>(indices.size()),1,0,0,0);
+        }
 
-            //结束渲染流程
-            vkCmdEndRenderPass( commandBuffers [ i ] ) ;
-            //结束记录指令到指令缓冲
-            if(vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS){
-                throw std::runtime_error("failed to record command buffer!");
-            }
+        //结束渲染流程
+        vkCmdEndRenderPass( commandBuffer ) ;
+        gpuProfiler.endScope(commandBuffer,renderPassScope);
+        if(dynamicResEnabled){
+            uint32_t upscaleScope = gpuProfiler.beginScope(commandBuffer,"upscale");
+            recordUpscale(commandBuffer,imageIndex);
+            gpuProfiler.endScope(commandBuffer,upscaleScope);
+        }
+        if(virtualTexturing()){
+            //反馈在这一帧执行完毕后由主机读取
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_HOST_BIT,0,
+                                 1,&barrier,0,nullptr,0,nullptr);
+        }
+        if(recordingReadbackSlot >= 0){
+            uint32_t readbackScope =
+                    gpuProfiler.beginScope(commandBuffer,"readback");
+            recordReadback(commandBuffer,imageIndex,
+                           *readbackSlots[recordingReadbackSlot]);
+            gpuProfiler.endScope(commandBuffer,readbackScope);
+        }
+        gpuProfiler.endScope(commandBuffer,frameScope);
+        //结束记录指令到指令缓冲
+        if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+            throw std::runtime_error("failed to record command buffer!");
         }
     }
     //创建信号量和VkFence--12
     void createSyncObjects(){
+        TRACE_FUNCTION();
         //创建每一帧需要的信号量对象
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT) ;
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT) ;
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT) ;
+        imageAvailableSemaphores.resize(framesInFlight) ;
+        renderFinishedSemaphores.resize(framesInFlight) ;
+        inFlightFences.resize(framesInFlight) ;
+        inFlightFenceValues.assign(framesInFlight,0);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType =
@@ -1667,7 +2451,7 @@ private:
           */
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for( size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++){
+        for( size_t i = 0; i < framesInFlight; i++){
             //创建信号量和VkFence 对象
             if(vkCreateSemaphore(device,&semaphoreInfo,nullptr,
                                  &imageAvailableSemaphores[i]) != VK_SUCCESS ||
@@ -1681,39 +2465,531 @@ private:
 
         }
     }
-    //初始化 Vulkan 对象。
-    void initVulkan(){
-        createInstance();//创建vulkan实例
-        setupDebugCallback();//调试回调
-        createSurface();//创建窗口表面
-        pickPhysicalDevice();//选择一个物理设备
-        createLogicalDevice();//创建逻辑设备
-        createSwapChain();//创建交换链
-        createImageViews();//为交换链中的每一个图像建立图像视图
-        createRenderPass();
-        createDescriptorSetLayout();//提供着色器使用的每一个描述符绑定信息
-        createGraphicsPipeline();//创建图形管线
-        createCommandPool();//创建指令池
-        createDepthResources();//创建深度图像相关的对象
-        createFramebuffers();
-        createTextureImage();//加载图像数据到一个Vulkan 图像对象
-        createTextureImageView();//创建纹理图像的图像视图对象
-        createTextureSampler();//创建采样器对象
-        loadModel();//载入模型文件
-        createVertexBuffer();//创建顶点缓冲
-        createIndexBuffer();//创建索引缓冲
-        createUniformBuffer();//创建uniform 缓冲对象
-        createDescriptorPool();//描述符池的创建
-        createDescriptorSets();//创建描述符集对象
-        createCommandBuffers();
-        createSyncObjects();
+    /**
+    创建帧时间线信号量,初始值为已经执行完毕的帧对应的时间线值.
+    不支持时间线信号量时退回到每帧一个栅栏
+      */
+    void createFrameTimeline(){
+        TRACE_FUNCTION();
+        useTimeline = false;
+#ifdef VK_KHR_timeline_semaphore
+        if(!timelineSupported || !config.useTimelineSemaphore){
+            return;
+        }
+        pfnWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+                    vkGetDeviceProcAddr(device,"vkWaitSemaphoresKHR"));
+        pfnGetSemaphoreCounterValue =
+                reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+                    vkGetDeviceProcAddr(device,"vkGetSemaphoreCounterValueKHR"));
+        if(!pfnWaitSemaphores || !pfnGetSemaphoreCounterValue){
+            return;
+        }
+        VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        typeInfo.initialValue = completedValue;
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+        if(vkCreateSemaphore(device,&semaphoreInfo,nullptr,
+                             &frameTimeline) != VK_SUCCESS){
+            throw std::runtime_error("failed to create timeline semaphore!");
+        }
+        useTimeline = true;
+#endif
+    }
+    //销毁每一帧的同步对象和指令缓冲
+    void destroyFrameResources(){
+        for(size_t i = 0; i < imageAvailableSemaphores.size(); i++){
+            //所有它所同步的指令执行结束后，对它进行清除
+            vkDestroySemaphore(device,renderFinishedSemaphores[i],nullptr);
+            vkDestroySemaphore(device,imageAvailableSemaphores[i],nullptr);
+            vkDestroyFence(device ,inFlightFences[i], nullptr);
+        }
+        imageAvailableSemaphores.clear();
+        renderFinishedSemaphores.clear();
+        inFlightFences.clear();
+        if(frameTimeline != VK_NULL_HANDLE){
+            vkDestroySemaphore(device,frameTimeline,nullptr);
+            frameTimeline = VK_NULL_HANDLE;
+        }
+        if(!commandBuffers.empty()){
+            vkFreeCommandBuffers(device,commandPool,
+                                 static_cast<uint32_t>(commandBuffers.size()),
+                                 commandBuffers.data());
+            commandBuffers.clear();
+        }
     }
     /**
-     * @brief drawFrame
-     * 1.从交换链获取一张图像
-     * 2.对帧缓冲附着执行指令缓冲中的渲染指令
-     * 3.返回渲染后的图像到交换链进行呈现操作
-    上面这些操作每一个都是通过一个函数调用设置的, 但每个操作的实际
+    创建 GPU 分析器.查询池分成 MAX_FRAMES_IN_FLIGHT 段,每一帧开始时读取的那一段
+    属于 MAX_FRAMES_IN_FLIGHT 帧之前的帧,它一定已经执行完毕
+      */
+    void createGpuProfiler(){
+        TRACE_FUNCTION();
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        gpuProfiler.init(physicalDevice,device,indices.graphicsFamily,
+                         MAX_FRAMES_IN_FLIGHT);
+        if(!gpuProfiler.supported()){
+            std::cout<<"timestamp queries not supported, gpu time disabled"
+                     <<std::endl;
+            return;
+        }
+        //记录时间线时把 GPU 时间戳换算到 CPU 时钟,GPU 范围和 CPU 事件显示在一起
+        bool tracing = Tracer::instance().enabled();
+        if(tracing){
+            gpuProfiler.calibrate(graphicsQueue,commandPool);
+        }
+        gpuProfiler.setFrameCallback([this,tracing](uint64_t frame,
+                const std::vector<GpuProfiler::ScopeResult>& results){
+            double frameMs = -1.0;
+            double sceneMs = -1.0;
+            for(const auto& result : results){
+                if(std::strcmp(result.name,"frame") == 0){
+                    frameStats.gpuTimes.add(result.ms);
+                    frameMs = result.ms;
+                }else if(std::strcmp(result.name,"render pass") == 0){
+                    sceneMs = result.ms;
+                }
+                if(tracing){
+                    Tracer::instance().addEvent(
+                                result.name,"gpu",result.startNs,
+                                static_cast<int64_t>(result.ms * 1000000.0),true);
+                }
+            }
+            //场景渲染流程的时间随渲染区域变化,其余部分(包括放大)不随比例变化
+            if(dynamicResEnabled && frameMs >= 0.0 && sceneMs >= 0.0){
+                dynamicResolution.update(frame,sceneMs,frameMs);
+            }
+        });
+        if(!config.gpuProfileLog.empty()){
+            gpuProfileLog.open(config.gpuProfileLog);
+            if(!gpuProfileLog){
+                throw std::runtime_error("failed to open file: " +
+                                         config.gpuProfileLog);
+            }
+            gpuProfiler.setLog(&gpuProfileLog);
+        }
+    }
+    static double millisecondsSince(
+            std::chrono::high_resolution_clock::time_point start){
+        return std::chrono::duration<double,std::milli>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+    }
+    /**
+    修改同时处理的帧数和同步方式.
+    只在基准测试切换设置时调用,需要等待设备空闲后重建每一帧的资源
+      */
+    void configureFrames(uint32_t count,bool timeline){
+        vkDeviceWaitIdle(device);
+        //设备空闲,所有已提交的帧都已执行完毕
+        completedValue = frameTimelineValue(frameNumber) - 1;
+        deletionQueue.collect(completedValue);
+        pendingFrames.clear();
+        destroyFrameResources();
+        framesInFlight = std::min(std::max(count,1u),MAX_FRAMES_IN_FLIGHT);
+        config.useTimelineSemaphore = timeline;
+        currentFrame = 0;
+        createCommandBuffers();
+        createSyncObjects();
+        createFrameTimeline();
+    }
+    /**
+    异步帧读回.
+    每一帧在渲染流程结束后把颜色附着复制到一个主机可见缓冲中,缓冲组成一个环,
+    个数多于同时处理的帧数,工作线程读取较早的帧时绘制循环可以继续使用其他缓冲.
+    每一帧开始时查询时间线(或栅栏)得到已经执行完毕的帧,
+    把它们的缓冲交给工作线程:复制像素后立即释放缓冲,再并行编码保存文件.
+    绘制循环只在缓冲都还没有释放时才等待,保存的帧率因此接近绘制的帧率
+      */
+    bool readbackEnabled() const {
+        return !config.readbackDir.empty();
+    }
+    //交换链图像在最后一个渲染流程结束后的布局,无窗口模式或读回帧时之后用于复制读回
+    VkImageLayout presentLayout() const {
+        return config.headless || readbackEnabled() ?
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL :
+                    VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
+    void createReadbackResources(){
+        TRACE_FUNCTION();
+        readbackFileFormat = parseImageFileFormat(config.readbackFormat);
+        //同时处理的帧占用的缓冲之外,再留出同样多的缓冲给工作线程
+        for(uint32_t i = 0;i < 2 * MAX_FRAMES_IN_FLIGHT;i++){
+            readbackSlots.emplace_back(new ReadbackSlot());
+        }
+        readbackWorkers.reset(new WorkerPool(config.readbackThreads));
+        readbackStart = std::chrono::high_resolution_clock::now();
+        std::cout<<"readback: writing frames to "<<config.readbackDir
+                 <<" with "<<readbackWorkers->threadCount()
+                 <<" worker threads"<<std::endl;
+    }
+    /**
+    创建读回缓冲,优先使用带缓存的主机可见内存(GPU 写,CPU 读),
+    CPU 读取非缓存的内存非常慢.非一致的内存在读取前需要使其失效
+      */
+    void createReadbackBuffer(ReadbackSlot& slot,VkDeviceSize size){
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if(vkCreateBuffer(device,&bufferInfo,nullptr,&slot.buffer) != VK_SUCCESS){
+            throw std::runtime_error("failed to create readback buffer!");
+        }
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device,slot.buffer,&memRequirements);
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        try{
+            allocInfo.memoryTypeIndex = findMemoryType(
+                        memRequirements.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                        VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        }catch(const std::runtime_error&){
+            allocInfo.memoryTypeIndex = findMemoryType(
+                        memRequirements.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        }
+        if(vkAllocateMemory(device,&allocInfo,nullptr,&slot.memory) != VK_SUCCESS){
+            throw std::runtime_error("failed to allocate readback buffer memory!");
+        }
+        vkBindBufferMemory(device,slot.buffer,slot.memory,0);
+        vkMapMemory(device,slot.memory,0,VK_WHOLE_SIZE,0,&slot.mapped);
+        slot.capacity = size;
+    }
+    void destroyReadbackBuffer(ReadbackSlot& slot){
+        if(slot.buffer == VK_NULL_HANDLE){
+            return;
+        }
+        vkUnmapMemory(device,slot.memory);
+        vkDestroyBuffer(device,slot.buffer,nullptr);
+        vkFreeMemory(device,slot.memory,nullptr);
+        slot.buffer = VK_NULL_HANDLE;
+        slot.memory = VK_NULL_HANDLE;
+        slot.mapped = nullptr;
+        slot.capacity = 0;
+    }
+    /**
+    为当前帧选择读回缓冲,在记录指令缓冲之前调用.
+    缓冲中还有没交出去的帧时先等它执行完毕并交给工作线程,然后等工作线程复制完像素
+      */
+    void beginReadback(){
+        if(swapChainImageFormat != VK_FORMAT_R8G8B8A8_UNORM &&
+                swapChainImageFormat != VK_FORMAT_R8G8B8A8_SRGB &&
+                swapChainImageFormat != VK_FORMAT_B8G8R8A8_UNORM &&
+                swapChainImageFormat != VK_FORMAT_B8G8R8A8_SRGB){
+            throw std::runtime_error("readback: unsupported color format!");
+        }
+        int index = static_cast<int>(frameNumber % readbackSlots.size());
+        ReadbackSlot& slot = *readbackSlots[index];
+        TRACE_SCOPE("readback slot");
+        auto waitStart = std::chrono::high_resolution_clock::now();
+        if(slot.timelineValue != 0){
+            waitTimelineValue(slot.timelineValue);
+            handOffReadback(slot);
+        }
+        while(slot.busy.load()){
+            std::this_thread::yield();
+        }
+        readbackStallMs += std::chrono::duration<double,std::milli>(
+                    std::chrono::high_resolution_clock::now() - waitStart).count();
+        VkDeviceSize size = VkDeviceSize(swapChainExtent.width) *
+                swapChainExtent.height * 4;
+        if(slot.capacity < size){
+            //缓冲既不被 GPU 也不被工作线程使用,可以直接销毁
+            destroyReadbackBuffer(slot);
+            createReadbackBuffer(slot,size);
+        }
+        slot.timelineValue = frameTimelineValue(frameNumber);
+        slot.frameIndex = frameNumber;
+        slot.width = swapChainExtent.width;
+        slot.height = swapChainExtent.height;
+        slot.format = swapChainImageFormat;
+        recordingReadbackSlot = index;
+    }
+    /**
+    在渲染流程结束后记录复制指令.渲染流程结束时图像已经变换为
+    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,有窗口时复制后再变换为呈现使用的布局
+      */
+    void recordReadback(VkCommandBuffer commandBuffer,uint32_t imageIndex,
+                        const ReadbackSlot& slot){
+        VkBufferImageCopy region = {};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0,0,0};
+        region.imageExtent = {slot.width,slot.height,1};
+        vkCmdCopyImageToBuffer(commandBuffer,swapChainImages[imageIndex],
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               slot.buffer,1,&region);
+        //复制结果对主机读取可见
+        VkBufferMemoryBarrier bufferBarrier = {};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = slot.buffer;
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT,0,0,nullptr,
+                             1,&bufferBarrier,0,nullptr);
+        if(config.headless){
+            return;
+        }
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = swapChainImages[imageIndex];
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,0,0,nullptr,
+                             0,nullptr,1,&barrier);
+    }
+    //把已经执行完毕的帧交给工作线程
+    void pollReadback(uint64_t completed){
+        for(auto& slot : readbackSlots){
+            if(slot->timelineValue != 0 && slot->timelineValue <= completed){
+                handOffReadback(*slot);
+            }
+        }
+    }
+    /**
+    GPU 已经写完缓冲,交给工作线程.工作线程先把像素复制出来(BGRA 格式时交换通道),
+    然后释放缓冲,最后编码保存文件
+      */
+    void handOffReadback(ReadbackSlot& slot){
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot.memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device,1,&range);
+        slot.timelineValue = 0;
+        slot.busy = true;
+        ReadbackSlot* source = &slot;
+        ImageFileFormat format = readbackFileFormat;
+        std::ostringstream name;
+        name<<config.readbackDir<<"/frame_"<<std::setw(6)<<std::setfill('0')
+            <<slot.frameIndex<<imageFileExtension(format);
+        std::string filename = name.str();
+        readbackWorkers->submit([this,source,format,filename](){
+            TRACE_SCOPE("write frame");
+            uint32_t width = source->width;
+            uint32_t height = source->height;
+            bool bgra = source->format == VK_FORMAT_B8G8R8A8_UNORM ||
+                    source->format == VK_FORMAT_B8G8R8A8_SRGB;
+            std::vector<uint8_t> pixels(size_t(width) * height * 4);
+            std::memcpy(pixels.data(),source->mapped,pixels.size());
+            source->busy = false;
+            if(bgra){
+                for(size_t i = 0;i < pixels.size();i += 4){
+                    std::swap(pixels[i],pixels[i + 2]);
+                }
+            }
+            try{
+                writeImage(filename,format,width,height,pixels.data());
+                readbackWritten++;
+            }catch(const std::exception& e){
+                if(readbackFailed++ == 0){
+                    std::cerr<<"readback: "<<e.what()<<std::endl;
+                }
+            }
+        });
+    }
+    //设备空闲后交出所有剩余的帧,等待文件保存完毕并报告
+    void finishReadback(){
+        if(!readbackWorkers){
+            return;
+        }
+        for(auto& slot : readbackSlots){
+            if(slot->timelineValue != 0){
+                handOffReadback(*slot);
+            }
+        }
+        readbackWorkers->wait();
+        double seconds = std::chrono::duration<double>(
+                    std::chrono::high_resolution_clock::now() -
+                    readbackStart).count();
+        std::cout<<std::fixed<<std::setprecision(2)
+                 <<"readback: "<<readbackWritten.load()<<" frames written in "
+                 <<seconds * 1000.0<<" ms ("<<readbackWritten.load() / seconds
+                 <<" fps), render loop stalled "<<readbackStallMs<<" ms";
+        if(readbackFailed.load() > 0){
+            std::cout<<", "<<readbackFailed.load()<<" frames failed";
+        }
+        std::cout<<std::endl;
+        readbackWorkers.reset();
+        for(auto& slot : readbackSlots){
+            destroyReadbackBuffer(*slot);
+        }
+        readbackSlots.clear();
+    }
+    //初始化 Vulkan 对象。
+    void initVulkan(){
+        TRACE_FUNCTION();
+        framesInFlight = config.framesInFlight;
+        /**
+        启动时各个步骤的依赖关系:
+          loadModel        解析模型文件,不依赖其他步骤
+          loadTextureData  解码纹理,需要物理设备来选择支持的压缩格式
+          上传纹理,创建顶点和索引缓冲  需要对应的数据,逻辑设备和指令池
+        模型解析和纹理解码作为任务在调度器的工作线程上进行,同时主线程创建设备,
+        交换链和管线,之后哪个资源的数据先准备好就先上传哪个.
+        任务只写入自己的结果,主线程在 future 就绪之后才读取.
+        资源包在启动任务之前打开,之后只读,可以在多个线程中同时读取
+          */
+        if(!config.archiveFile.empty()){
+            archive.open(config.archiveFile);
+            std::cout<<"archive: "<<config.archiveFile<<", "
+                     <<archive.list().size()<<" assets"<<std::endl;
+        }
+        if(virtualTexturing()){
+            openVirtualTexture();//管线的特化常量需要虚拟纹理的大小
+        }
+        std::future<void> model;
+        if(!meshStreaming()){
+            model = startLoad([this](){
+                loadModel();//载入模型文件
+            });
+        }
+        createInstance();//创建vulkan实例
+        setupDebugCallback();//调试回调
+        if(!config.headless){
+            createSurface();//创建窗口表面
+        }
+        pickPhysicalDevice();//选择一个物理设备
+        chooseMsaaSamples();//渲染流程和管线需要采样数
+        std::future<TextureData> texture = startLoad([this](){
+            return loadTextureData();//加载图像数据
+        });
+        createLogicalDevice();//创建逻辑设备
+        if(config.headless){
+            createOffscreenTargets();//无窗口模式下用离屏图像代替交换链
+        }else{
+            createSwapChain();//创建交换链
+        }
+        createImageViews();//为交换链中的每一个图像建立图像视图
+        chooseDynamicResolution();//渲染流程需要知道是否渲染到内部图像
+        createRenderPass();
+        createDescriptorSetLayout();//提供着色器使用的每一个描述符绑定信息
+        createGraphicsPipeline();//创建图形管线
+        if(dynamicResEnabled){
+            createUpscalePipeline();//把内部图像放大到交换链图像的管线
+        }
+        createCommandPool();//创建指令池
+        createGpuProfiler();//支持时创建统计 GPU 时间的时间戳查询池
+        createColorResources();//使用多重采样时创建多重采样的颜色图像
+        createDepthResources();//创建深度图像相关的对象
+        createSceneResources();//使用动态分辨率时创建内部渲染目标
+        createFramebuffers();
+        uploadLoadedAssets(model,texture);//上传纹理和模型数据
+        if(config.mipgen == MipGenMode::Compare){
+            //比较两种生成细化链的方式的 GPU 时间;RGBA32F 不保证支持线性 blit,
+            //用它检查计算着色器的结果,每个纹素 16 字节,用较小的图像
+            compareMipGeneration(VK_FORMAT_R8G8B8A8_UNORM,4096);
+            compareMipGeneration(VK_FORMAT_R32G32B32A32_SFLOAT,2048);
+        }
+        if(meshStreaming()){
+            createMeshStreaming();//网格数据块在绘制时逐帧上传
+        }
+        computeModelBounds();
+        createTextureImageView();//创建纹理图像的图像视图对象
+        createTextureSampler();//创建采样器对象
+        createUniformBuffer();//创建uniform 缓冲对象
+        createDescriptorAllocators();//描述符分配器的创建
+        createDescriptorSets();//预先创建描述符集对象
+        createBindlessDescriptorSet();//创建无绑定纹理数组
+        if(virtualTexturing()){
+            createVirtualTexturing();//页表,物理缓存和反馈缓冲
+        }
+        createCommandBuffers();
+        createSyncObjects();
+        createFrameTimeline();//支持时创建帧时间线信号量
+        if(readbackEnabled()){
+            createReadbackResources();//创建帧读回的缓冲和工作线程
+        }
+        initMs = millisecondsSince(startupStart);
+    }
+    /**
+    开始一个加载任务.
+    --serial-init 时返回延迟执行的 future,任务在主线程第一次等待结果时才执行,
+    和原来依次加载的顺序一样不与设备的创建重叠
+      */
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> startLoad(F function){
+        typedef typename std::result_of<F()>::type Result;
+        if(config.serialInit){
+            return std::async(std::launch::deferred,std::move(function));
+        }
+        auto task = std::make_shared<std::packaged_task<Result()>>(
+                    std::move(function));
+        std::future<Result> result = task->get_future();
+        jobs.run([task](){ (*task)(); });
+        return result;
+    }
+    //future 的结果是否可以不等待地取得,延迟执行的任务也视为就绪
+    template<typename T>
+    static bool loadReady(const std::future<T>& result){
+        return result.wait_for(std::chrono::seconds(0)) !=
+                std::future_status::timeout;
+    }
+    /**
+    上传工作线程加载的资源,先准备好的先上传.
+    都没有准备好时主线程也执行加载任务,没有可以执行的任务时短暂等待,
+    这样一个资源的上传不必等另一个资源加载完
+      */
+    void uploadLoadedAssets(std::future<void>& model,
+                            std::future<TextureData>& texture){
+        TRACE_FUNCTION();
+        while(model.valid() || texture.valid()){
+            if(texture.valid() && loadReady(texture)){
+                TextureData data = texture.get();//重新抛出加载时的异常
+                if(textureStreaming()){
+                    createTextureStreaming(std::move(data));//先只上传最小的几级
+                }else{
+                    uploadTexture(data);//上传到一个Vulkan 图像对象
+                }
+            }else if(model.valid() && loadReady(model)){
+                model.get();
+                createVertexBuffer();//创建顶点缓冲
+                createIndexBuffer();//创建索引缓冲
+            }else{
+                if(jobs.tryRunOne()){
+                    continue;
+                }
+                TRACE_SCOPE("wait loaders");
+                const std::chrono::milliseconds poll(1);
+                if(texture.valid()){
+                    texture.wait_for(poll);
+                }else{
+                    model.wait_for(poll);
+                }
+            }
+        }
+    }
+    /**
+     * @brief drawFrame
+     * 1.从交换链获取一张图像
+     * 2.对帧缓冲附着执行指令缓冲中的渲染指令
+     * 3.返回渲染后的图像到交换链进行呈现操作
+    上面这些操作每一个都是通过一个函数调用设置的, 但每个操作的实际
     执行却是异步进行的。函数调用会在操作实际结束前返回，并且操作的实
     际执行顺序也是不确定的。而我们需要操作的执行能按照一定的顺序，所
     以就需要进行同步操作。
@@ -1728,6 +3004,7 @@ private:
      */
     //绘制图像--12
     void drawFrame(){
+        TRACE_FUNCTION();
         /**
         vkWaitForFences 函数可以用来等待一组栅栏 (fence) 中的一个或
         全部栅栏 (fence) 发出信号。上面代码中我们对它使用的 VK_TRUE
@@ -1737,10 +3014,34 @@ private:
         参数。和信号量不同，等待栅栏发出信号后，我们需要调用 vkResetFences
         函数手动将栅栏 (fence) 重置为未发出信号的状态。
           */
-        //等待我们当前帧所使用的指令缓冲结束执行
-        vkWaitForFences(device,1,&inFlightFences[currentFrame],
-                        VK_TRUE,std::numeric_limits<uint64_t>::max());
-        vkResetFences(device , 1 , &inFlightFences[currentFrame]);
+        auto frameStart = std::chrono::high_resolution_clock::now();
+        if(frameNumber > 0){
+            frameStats.frameTimes.add(std::chrono::duration<double,std::milli>(
+                                          frameStart - lastFrameStart).count());
+        }
+        lastFrameStart = frameStart;
+        frameWaitMs = 0.0;
+        /**
+        等待我们当前帧所使用的指令缓冲结束执行,也就是 framesInFlight 帧之前的那一帧.
+        使用时间线信号量时等待时间线值,否则等待这一帧的栅栏.
+        栅栏只在提交前重置,获取图像失败直接返回时栅栏仍然处于发出信号的状态
+          */
+        if(frameNumber >= framesInFlight){
+            waitTimelineValue(frameTimelineValue(frameNumber - framesInFlight));
+        }
+        //这一帧上一次使用的指令已经执行结束,可以读取它的时间戳
+        gpuProfiler.beginFrame(frameNumber);
+        //销毁已经没有帧在使用的资源,记录观察到执行完毕的帧的延迟
+        uint64_t completed = completedTimelineValue();
+        deletionQueue.collect(completed);
+        if(readbackEnabled()){
+            pollReadback(completed);
+        }
+        while(!pendingFrames.empty() && pendingFrames.front().first <= completed){
+            frameStats.latencies.add(std::chrono::duration<double,std::milli>(
+                            frameStart - pendingFrames.front().second).count());
+            pendingFrames.pop_front();
+        }
 
         uint32_t imageIndex;
         /**
@@ -1757,10 +3058,20 @@ private:
           */
         //从交换链获取一张图像
         //交换链是一个扩展特性，所以与它相关的操作都会有 KHR 这一扩展后缀
-        VkResult result =vkAcquireNextImageKHR(device,swapChain,
+        //无窗口模式下没有交换链,依次使用离屏图像
+        VkResult result = VK_SUCCESS;
+        if(config.headless){
+            imageIndex = static_cast<uint32_t>(
+                        frameNumber % swapChainImages.size());
+        }else{
+            TRACE_SCOPE("vkAcquireNextImageKHR");
+            auto acquireStart = std::chrono::high_resolution_clock::now();
+            result = vkAcquireNextImageKHR(device,swapChain,
                               std::numeric_limits<uint64_t>::max(),
                               imageAvailableSemaphores[currentFrame],
                               VK_NULL_HANDLE,&imageIndex);
+            frameWaitMs += millisecondsSince(acquireStart);
+        }
         if(result == VK_ERROR_OUT_OF_DATE_KHR){
             recreateSwapChain();
             return;
@@ -1768,7 +3079,20 @@ private:
             throw std::runtime_error("failed to acquire swap chain image!");
         }
 
+        //交换链图像个数少于同时处理的帧数时,图像可能仍被之前的帧使用
+        if(imageTimelineValues[imageIndex] != 0){
+            waitTimelineValue(imageTimelineValues[imageIndex]);
+        }
+        imageTimelineValues[imageIndex] = frameTimelineValue(frameNumber);
+
         updateUniformBuffer(imageIndex);//更新 uniform 数据
+        if(readbackEnabled()){
+            beginReadback();
+        }
+        //重新记录当前帧的指令缓冲,写入本帧的推送常量
+        vkResetCommandBuffer(commandBuffers[currentFrame],0);
+        recordCommandBuffer(commandBuffers[currentFrame],imageIndex);
+        recordingReadbackSlot = -1;
 
         //提交信息给指令队列
         VkSubmitInfo submitInfo = {};
@@ -1781,19 +3105,37 @@ private:
         waitSemaphoreCount、pWaitSemaphores 和pWaitDstStageMask 成员变量用于指定
         队列开始执行前需要等待的信号量，以及需要等待的管线阶段
           */
-        submitInfo.waitSemaphoreCount = 1;
+        //无窗口模式下没有需要等待的图像获取操作
+        submitInfo.waitSemaphoreCount = config.headless ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         //waitStages 数组中的条目和 pWaitSemaphores 中相同索引的信号量相对应。
         submitInfo.pWaitDstStageMask = waitStages;
         //指定实际被提交执行的指令缓冲对象
-        //我们应该提交和我们刚刚获取的交换链图像相对应的指令缓冲对象
+        //提交当前帧刚刚记录的指令缓冲对象
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
         VkSemaphore signalSemaphores [ ] = {
-            renderFinishedSemaphores[currentFrame]};
+            renderFinishedSemaphores[currentFrame],frameTimeline};
         //指定在指令缓冲执行结束后发出信号的信号量对象
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
+        //无窗口模式下没有呈现操作,不需要渲染结束信号量,只发出时间线信号
+        uint32_t firstSignal = config.headless ? 1 : 0;
+        submitInfo.signalSemaphoreCount = 1 - firstSignal;
+        submitInfo.pSignalSemaphores = signalSemaphores + firstSignal;
+        VkFence submitFence = VK_NULL_HANDLE;
+        uint64_t timelineValue = frameTimelineValue(frameNumber);
+#ifdef VK_KHR_timeline_semaphore
+        //使用时间线信号量时同时发出帧时间线信号,二值信号量的值被忽略
+        uint64_t signalValues[] = {0,timelineValue};
+        VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+        if(useTimeline){
+            timelineInfo.sType =
+                    VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+            timelineInfo.signalSemaphoreValueCount = 2 - firstSignal;
+            timelineInfo.pSignalSemaphoreValues = signalValues + firstSignal;
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.signalSemaphoreCount = 2 - firstSignal;
+        }
+#endif
         /**
         vkQueueSubmit 函数使用vkQueueSubmit结构体数组作为参数,可以同时大批量提交数.。
         vkQueueSubmit 函数的最后一个参数是一个可选的栅栏对象，
@@ -1802,14 +3144,26 @@ private:
           */
         /**
          * @brief vkResetFences
-         * 在重建交换链时，重置栅栏 (fence) 对象,
-         * 以防导致我们使用的栅栏 (fence) 处于我们不能确定得状态
+         * 只在提交前重置栅栏 (fence) 对象,
+         * 以防获取图像失败返回后栅栏处于永远不会发出信号的状态
          */
-        vkResetFences(device,1,&inFlightFences[currentFrame]);
+        if(!useTimeline){
+            vkResetFences(device,1,&inFlightFences[currentFrame]);
+            inFlightFenceValues[currentFrame] = timelineValue;
+            submitFence = inFlightFences[currentFrame];
+        }
         //提交指令缓冲给图形指令队列
-        if(vkQueueSubmit(graphicsQueue,1,&submitInfo,
-                         inFlightFences[currentFrame])!= VK_SUCCESS){
-            throw std::runtime_error("failed to submit draw command buffer!");
+        {
+            TRACE_SCOPE("vkQueueSubmit");
+            if(vkQueueSubmit(graphicsQueue,1,&submitInfo,
+                             submitFence)!= VK_SUCCESS){
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
+        }
+        pendingFrames.emplace_back(timelineValue,frameStart);
+        if(config.headless){
+            endFrame(frameStart);
+            return;
         }
 
         /**
@@ -1838,11 +3192,20 @@ private:
             VK_SUBOPTIMAL_KHR：交换链仍然可以使用，但表面属性已经不能准确匹配
           */
         //请求交换链进行图像呈现操作
-        result = vkQueuePresentKHR( presentQueue , &presentInfo ) ;
+        {
+            TRACE_SCOPE("vkQueuePresentKHR");
+            result = vkQueuePresentKHR( presentQueue , &presentInfo ) ;
+        }
         if(result == VK_ERROR_OUT_OF_DATE_KHR ||
-                result == VK_SUBOPTIMAL_KHR || framebufferResized){
-            //交换链不完全匹配时也重建交换链
+                result == VK_SUBOPTIMAL_KHR || framebufferResized ||
+                presentModeChanged){
+            //交换链不完全匹配或者呈现模式改变时也重建交换链
+            if(presentModeChanged){
+                reportFramePacing();
+                framePacer.resetStats();
+            }
             framebufferResized = false;
+            presentModeChanged = false;
             recreateSwapChain();
         }else if(result != VK_SUCCESS){
             throw std::runtime_error("failed to present swap chain image!");
@@ -1863,14 +3226,43 @@ private:
         //等待一个特定指令队列结束执行
         //vkQueueWaitIdle ( presentQueue ) ;
 
-        //更新currentFrame
-        currentFrame = (currentFrame+1) %MAX_FRAMES_IN_FLIGHT;
+        endFrame(frameStart);
+    }
+    //记录这一帧的 CPU 时间,更新currentFrame
+    void endFrame(std::chrono::high_resolution_clock::time_point frameStart){
+        frameStats.cpuTimes.add(millisecondsSince(frameStart) - frameWaitMs);
+        if(!firstFrameReported){
+            firstFrameReported = true;
+            std::cout<<std::fixed<<std::setprecision(2)
+                     <<"time to first frame: "<<millisecondsSince(startupStart)
+                     <<" ms (init "<<initMs<<" ms, "
+                     <<(config.serialInit ? "serial" : "parallel")
+                     <<" loading)"<<std::endl;
+        }
+        currentFrame = (currentFrame+1) %framesInFlight;
+        frameNumber++;
     }
     //设置主循环
     void mainLoop(){
+        if(config.frameBenchFrames > 0){
+            runFrameBenchmark();
+            vkDeviceWaitIdle(device);
+            return;
+        }
+        if(config.benchmarkFrames > 0){
+            runBenchmark();
+            return;
+        }
+        if(config.headless){
+            runHeadless();
+            vkDeviceWaitIdle(device);
+            return;
+        }
         //添加事件循环
         //glfwWindowShouldClose检测窗口是否关闭
         while(!glfwWindowShouldClose(window)){
+            //在读取输入之前睡眠,让读取的输入尽量新
+            framePacer.waitBeforeInput();
             glfwPollEvents();//执行事件处理
             /**
               drawFrame 函数中的操作是异步执行的:
@@ -1881,10 +3273,142 @@ private:
         }
         //等待逻辑设备的操作结束执行才能销毁窗口
         vkDeviceWaitIdle(device);
+        reportFramePacing();
+    }
+    //无窗口模式:绘制 config.headlessFrames 帧到离屏图像,报告帧率
+    void runHeadless(){
+        auto start = std::chrono::high_resolution_clock::now();
+        for(uint32_t i = 0;i < config.headlessFrames;i++){
+            drawFrame();
+        }
+        waitTimelineValue(frameTimelineValue(frameNumber - 1));
+        double seconds = std::chrono::duration<double>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+        std::cout<<std::fixed<<std::setprecision(2)
+                 <<"headless: "<<config.headlessFrames<<" frames at "
+                 <<swapChainExtent.width<<"x"<<swapChainExtent.height
+                 <<" in "<<seconds * 1000.0<<" ms ("
+                 <<config.headlessFrames / seconds<<" fps)"<<std::endl;
+    }
+    /**
+    基准测试:场景按固定时间步长前进,相机沿固定路径移动(见 updateUniformBuffer),
+    不受鼠标和实际经过的时间影响,同样的设置每次绘制的画面相同.
+    先绘制 config.benchmarkWarmup 帧不计入统计,再绘制 config.benchmarkFrames 帧,
+    输出 CPU 时间,帧时间和 GPU 时间的百分位数
+      */
+    void runBenchmark(){
+        for(uint32_t i = 0;i < config.benchmarkWarmup && !windowShouldClose();i++){
+            pollEvents();
+            drawFrame();
+        }
+        frameStats.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        uint32_t frames = 0;
+        for(;frames < config.benchmarkFrames && !windowShouldClose();frames++){
+            pollEvents();
+            drawFrame();
+        }
+        //等待最后几帧执行完毕,读取它们的时间戳
+        vkDeviceWaitIdle(device);
+        double totalMs = millisecondsSince(start);
+        gpuProfiler.collectAll();
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice,&properties);
+        BenchmarkReport report;
+        report.device = properties.deviceName;
+        report.width = swapChainExtent.width;
+        report.height = swapChainExtent.height;
+        report.presentMode = config.headless ? "headless" :
+                                               presentModeName(presentMode);
+        report.sync = useTimeline ? "timeline" : "binary";
+        report.framesInFlight = framesInFlight;
+        report.msaaSamples = msaaSamples;
+        report.warmupFrames = config.benchmarkWarmup;
+        report.frames = frames;
+        report.timestepMs = BENCHMARK_TIMESTEP_MS;
+        report.totalMs = totalMs;
+        report.gpuTimingAvailable = gpuProfiler.supported();
+        report.stats = frameStats;
+        if(config.benchmarkOut.empty()){
+            writeBenchmarkReport(std::cout,report);
+            return;
+        }
+        std::ofstream file(config.benchmarkOut);
+        if(!file){
+            throw std::runtime_error("failed to open file: " + config.benchmarkOut);
+        }
+        writeBenchmarkReport(file,report);
+        std::cout<<"benchmark report written to "<<config.benchmarkOut<<std::endl;
+    }
+    //处理窗口事件,无窗口模式下什么也不做
+    void pollEvents(){
+        if(!config.headless){
+            glfwPollEvents();
+        }
+    }
+    bool windowShouldClose(){
+        return !config.headless && glfwWindowShouldClose(window);
+    }
+    /**
+    帧同步基准测试.
+    依次使用时间线信号量和栅栏,同时处理 1 到 MAX_FRAMES_IN_FLIGHT 帧,
+    每种设置绘制 config.frameBenchFrames 帧,报告吞吐量(帧率,帧时间)和延迟.
+    呈现模式为 FIFO 时帧率受垂直同步限制,比较的主要是延迟
+      */
+    void runFrameBenchmark(){
+        std::vector<bool> modes;
+        if(timelineSupported){
+            modes.push_back(true);
+        }
+        modes.push_back(false);
+        std::cout<<"sync      frames  fps      frame ms (mean/p95)  "
+                 <<"latency ms (mean/p95)"<<std::endl;
+        std::cout<<std::fixed<<std::setprecision(2);
+        for(bool timeline : modes){
+            for(uint32_t count = 1;count <= MAX_FRAMES_IN_FLIGHT;count++){
+                configureFrames(count,timeline);
+                //先绘制几帧填满流水线,不计入统计
+                for(uint32_t i = 0;i < framesInFlight + 2;i++){
+                    pollEvents();
+                    drawFrame();
+                }
+                frameStats.clear();
+                for(uint32_t i = 0;i < config.frameBenchFrames &&
+                    !windowShouldClose();i++){
+                    pollEvents();
+                    drawFrame();
+                }
+                std::cout<<std::left<<std::setw(10)
+                         <<(useTimeline ? "timeline" : "binary")
+                         <<std::setw(8)<<framesInFlight
+                         <<std::setw(9)<<frameStats.framesPerSecond()
+                         <<frameStats.frameTimes.mean()<<" / "
+                         <<std::setw(14)<<frameStats.frameTimes.percentile(95)
+                         <<frameStats.latencies.mean()<<" / "
+                         <<frameStats.latencies.percentile(95)<<std::endl;
+            }
+        }
     }
     //清理资源
     void cleanup(){
+        //设备已经空闲,所有延迟销毁的资源都可以销毁
+        deletionQueue.flush();
+        finishReadback();
+        //输出各个范围最近几帧的平均 GPU 时间
+        gpuProfiler.collectAll();
+        gpuProfiler.report(std::cout);
         cleanupSwapChain();//释放交换链相关
+        //销毁管线对象
+        vkDestroyPipeline ( device , graphicsPipeline , nullptr );
+        //销毁管线布局对象
+        vkDestroyPipelineLayout ( device , pipelineLayout , nullptr);
+        //销毁渲染流程对象
+        vkDestroyRenderPass ( device , renderPass , nullptr );
+        if(dynamicResEnabled){
+            dynamicResolution.report(std::cout);
+            destroyUpscalePipeline();
+        }
         //清除采样器对象
         vkDestroySampler(device,textureSampler,nullptr);
         //清除纹理图像的图像视图对象，
@@ -1893,12 +3417,19 @@ private:
         vkDestroyImage(device,textureImage,nullptr);
         //释放纹理对象内存
         vkFreeMemory(device,textureImageMemory,nullptr);
-        //销毁描述符池对象
-        vkDestroyDescriptorPool(device,descriptorPool,nullptr);
+        destroyMipgenPipeline();
+        //销毁描述符池对象,分配的描述符集随池一起释放
+        descriptorSetCache.clear();
+        cacheDescriptorAllocator.cleanup();
+        descriptorAllocator.cleanup();
         //销毁描述符对象
         vkDestroyDescriptorSetLayout(device,descriptorSetLayout,nullptr);
+        if(bindlessSupported){
+            vkDestroyDescriptorPool(device,bindlessDescriptorPool,nullptr);
+            vkDestroyDescriptorSetLayout(device,bindlessSetLayout,nullptr);
+        }
         //释放uniform 缓冲对象
-        for(size_t i=0;i<swapChainImages.size();i++){
+        for(size_t i=0;i<uniformBuffers.size();i++){
             vkDestroyBuffer(device,uniformBuffers[i],nullptr);
             vkFreeMemory(device,uniformBuffersMemory[i],nullptr);
         }
@@ -1910,16 +3441,17 @@ private:
         vkDestroyBuffer(device,indexBuffer,nullptr);
         //释放索引缓冲缓冲的内存
         vkFreeMemory(device,indexBufferMemory,nullptr);
+        destroyMeshStreaming();
+        destroyVirtualTexturing();
+        if(textureStreaming()){
+            reportTextureStreaming();
+        }
 
         //清除为每一帧创建的信号量和VkFence 对象--12
-        for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++){
-            //所有它所同步的指令执行结束后，对它进行清除
-            vkDestroySemaphore(device,renderFinishedSemaphores[i],nullptr);
-            vkDestroySemaphore(device,imageAvailableSemaphores[i],nullptr);
-            vkDestroyFence(device ,inFlightFences[i], nullptr);
-        }
+        destroyFrameResources();
         //销毁指令池对象--11
         vkDestroyCommandPool(device,commandPool,nullptr);
+        gpuProfiler.cleanup();
 
         vkDestroyDevice(device,nullptr);//销毁逻辑设备对象--3
         if(enableValidationLayers){
@@ -1927,17 +3459,21 @@ private:
             DestroyDebugUtilsMessengerEXT(instance,callback,nullptr);
         }
         //销毁窗口表面对象，表面对象的清除需要在 Vulkan 实例被清除之前完成
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        if(!config.headless){
+            vkDestroySurfaceKHR(instance, surface, nullptr);
+        }
         /**
         Vulkan 中创建和销毁对象的函数都有一个 VkAllocationCallbacks 参数,
         可以被用来自定义内存分配器,本教程也不使用
          */
         //销毁vulkan实例--1
         vkDestroyInstance(instance,nullptr);
-        //销毁窗口--1
-        glfwDestroyWindow(window);
-        //结束glfw--1
-        glfwTerminate();
+        if(!config.headless){
+            //销毁窗口--1
+            glfwDestroyWindow(window);
+            //结束glfw--1
+            glfwTerminate();
+        }
     }
     //请求所有可用的校验层--1
     bool checkValidationLayerSupport(){
@@ -1964,12 +3500,15 @@ private:
     }
     //根据是否启用校验层，返回所需的扩展列表--1
     std::vector<const char*> getRequiredExtensions(){
-        uint32_t glfwExtensionCount =0;
-        const char** glfwExtensions;
-        glfwExtensions=glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char*> extensions(glfwExtensions,
-                                            glfwExtensions+glfwExtensionCount);
+        std::vector<const char*> extensions;
+        //无窗口模式下不创建表面,不需要 GLFW 要求的表面扩展
+        if(!config.headless){
+            uint32_t glfwExtensionCount =0;
+            const char** glfwExtensions;
+            glfwExtensions=glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions,
+                              glfwExtensions+glfwExtensionCount);
+        }
         if(enableValidationLayers){
             //需要使用 VK_EXT_debug_utils 扩展，设置回调函数来接受调试信息
             //如果启用校验层,添加调试报告相关的扩展
@@ -2039,6 +3578,15 @@ private:
                     queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT){
                 indices.graphicsFamily = i;
             }
+            //无窗口模式下没有表面,不需要呈现队列,使用图形队列代替
+            if(config.headless){
+                indices.presentFamily = indices.graphicsFamily;
+                if(indices.isComplete()){
+                    break;
+                }
+                i++;
+                continue;
+            }
             //查找带有呈现图像到窗口表面能力的队列族
             vkGetPhysicalDeviceSurfaceSupportKHR(
                         device,i,surface,&presentSupport);
@@ -2096,32 +3644,175 @@ private:
 
         return details;
     }
-    //重建交换链
+    /**
+    重建交换链.
+    不再等待设备空闲:旧的交换链作为 oldSwapchain 传给新交换链,
+    旧的图像视图,深度资源和帧缓冲交给 deletionQueue 延迟销毁.
+    管线使用动态视口和裁剪矩形,交换链图像格式不变时渲染流程和管线都不需要重建
+      */
     void recreateSwapChain(){
+        TRACE_FUNCTION();
         //设置应用程序在窗口最小化后停止渲染，直到窗口重新可见时重建交换链
         int width=0,height = 0;
         while(width == 0 || height == 0){
             glfwGetFramebufferSize(window,&width,&height);
             glfwWaitEvents();
         }
-        //等待设备处于空闲状态，避免在对象的使用过程中将其清除重建
-        vkDeviceWaitIdle(device);
-
-        cleanupSwapChain();//清除交换链相关
-
-        //重新创建了交换链
+        RetiredSwapChain retired;
+        retired.swapChain = swapChain;
+        retired.imageViews = std::move(swapChainImageViews);
+        retired.framebuffers = std::move(swapChainFramebuffers);
+        retired.depthImage = depthImage;
+        retired.depthImageMemory = depthImageMemory;
+        retired.depthImageView = depthImageView;
+        retired.msaaColorImage = msaaColorImage;
+        retired.msaaColorImageMemory = msaaColorImageMemory;
+        retired.msaaColorImageView = msaaColorImageView;
+        retired.sceneImage = sceneImage;
+        retired.sceneImageMemory = sceneImageMemory;
+        retired.sceneImageView = sceneImageView;
+        retired.upscaleDescriptorPool = upscaleDescriptorPool;
+        retired.upscaleFramebuffers = std::move(upscaleFramebuffers);
+        swapChainImageViews.clear();
+        swapChainFramebuffers.clear();
+        upscaleFramebuffers.clear();
+        VkFormat oldFormat = swapChainImageFormat;
+
+        //重新创建了交换链,旧交换链作为 oldSwapchain
         createSwapChain();
         //图形视图是直接依赖于交换链图像的，所以也需要被重建
         createImageViews();
-        //渲染流程依赖于交换链图像的格式,窗口大小改变不会引起使用的交换链图像格式改变
-        createRenderPass();
-        //视口和裁剪矩形在管线创建时被指定，窗口大小改变，这些设置也需要修改
-        //我们可以通过使用动态状态来设置视口和裁剪矩形来避免重建管线
-        createGraphicsPipeline();
+        //渲染流程依赖于交换链图像的格式,通常窗口大小改变不会引起格式改变
+        if(swapChainImageFormat != oldFormat){
+            retired.renderPass = renderPass;
+            retired.pipelineLayout = pipelineLayout;
+            retired.graphicsPipeline = graphicsPipeline;
+            createRenderPass();
+            //管线与渲染流程相关,格式改变时需要使用新的渲染流程重建
+            createGraphicsPipeline();
+            if(dynamicResEnabled){
+                retired.upscaleRenderPass = upscaleRenderPass;
+                retired.upscalePipeline = upscalePipeline;
+                createUpscalePipeline();
+            }
+        }
+        createColorResources();
         createDepthResources();
-        //帧缓冲和指令缓冲直接依赖于交换链图像
+        //内部图像按新的交换链图像大小重新创建,之后每一帧只改变渲染区域
+        createSceneResources();
+        //帧缓冲直接依赖于交换链图像,指令缓冲每一帧重新记录,不需要重建
         createFramebuffers();
-        createCommandBuffers();
+        //交换链图像个数增加时补充 uniform 缓冲
+        createUniformBuffer();
+        deferDestroy([this,retired](){
+            destroyRetiredSwapChain(retired);
+        });
+    }
+    //第 frame 帧的指令执行完毕时帧时间线的值
+    uint64_t frameTimelineValue(uint64_t frame) const {
+        return frame + 1;
+    }
+    /**
+    已经执行完毕的时间线值.
+    使用栅栏时,vkQueueSubmit 的栅栏发出信号说明同一队列上更早提交的指令也都已经执行完毕,
+    所以已经发出信号的栅栏中最大的时间线值就是执行完毕的时间线值
+      */
+    uint64_t completedTimelineValue(){
+#ifdef VK_KHR_timeline_semaphore
+        if(useTimeline){
+            uint64_t value = 0;
+            pfnGetSemaphoreCounterValue(device,frameTimeline,&value);
+            return value;
+        }
+#endif
+        for(size_t i = 0;i < inFlightFences.size();i++){
+            if(inFlightFenceValues[i] > completedValue &&
+                    vkGetFenceStatus(device,inFlightFences[i]) == VK_SUCCESS){
+                completedValue = inFlightFenceValues[i];
+            }
+        }
+        return completedValue;
+    }
+    //等待帧时间线到达 value,value 对应的帧必须已经提交
+    void waitTimelineValue(uint64_t value){
+        if(value <= completedValue){
+            return;
+        }
+        TRACE_SCOPE("wait timeline");
+        auto waitStart = std::chrono::high_resolution_clock::now();
+#ifdef VK_KHR_timeline_semaphore
+        if(useTimeline){
+            VkSemaphoreWaitInfoKHR waitInfo = {};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &frameTimeline;
+            waitInfo.pValues = &value;
+            pfnWaitSemaphores(device,&waitInfo,
+                              std::numeric_limits<uint64_t>::max());
+            completedValue = value;
+            frameWaitMs += millisecondsSince(waitStart);
+            return;
+        }
+#endif
+        //等待时间线值不小于 value 的栅栏中最早提交的一个
+        size_t slot = inFlightFences.size();
+        for(size_t i = 0;i < inFlightFences.size();i++){
+            if(inFlightFenceValues[i] >= value &&
+                    (slot == inFlightFences.size() ||
+                     inFlightFenceValues[i] < inFlightFenceValues[slot])){
+                slot = i;
+            }
+        }
+        if(slot == inFlightFences.size()){
+            throw std::runtime_error("waiting for a frame that was not submitted!");
+        }
+        vkWaitForFences(device,1,&inFlightFences[slot],
+                        VK_TRUE,std::numeric_limits<uint64_t>::max());
+        completedValue = inFlightFenceValues[slot];
+        frameWaitMs += millisecondsSince(waitStart);
+    }
+    //在当前帧及之前提交的指令执行完毕后执行 destroy,不需要等待设备空闲
+    void deferDestroy(std::function<void()> destroy){
+        deletionQueue.push(frameTimelineValue(frameNumber),std::move(destroy));
+    }
+    //延迟销毁一个缓冲和它的内存
+    void deferDestroyBuffer(VkBuffer buffer,VkDeviceMemory memory){
+        deferDestroy([this,buffer,memory](){
+            vkDestroyBuffer(device,buffer,nullptr);
+            vkFreeMemory(device,memory,nullptr);
+        });
+    }
+    //销毁替换下来的交换链资源
+    void destroyRetiredSwapChain(const RetiredSwapChain& retired){
+        vkDestroyImageView(device,retired.depthImageView,nullptr);
+        vkDestroyImage(device,retired.depthImage,nullptr);
+        vkFreeMemory(device,retired.depthImageMemory,nullptr);
+        vkDestroyImageView(device,retired.msaaColorImageView,nullptr);
+        vkDestroyImage(device,retired.msaaColorImage,nullptr);
+        vkFreeMemory(device,retired.msaaColorImageMemory,nullptr);
+        for(auto framebuffer : retired.framebuffers){
+            vkDestroyFramebuffer(device,framebuffer,nullptr);
+        }
+        for(auto framebuffer : retired.upscaleFramebuffers){
+            vkDestroyFramebuffer(device,framebuffer,nullptr);
+        }
+        vkDestroyDescriptorPool(device,retired.upscaleDescriptorPool,nullptr);
+        vkDestroyImageView(device,retired.sceneImageView,nullptr);
+        vkDestroyImage(device,retired.sceneImage,nullptr);
+        vkFreeMemory(device,retired.sceneImageMemory,nullptr);
+        for(auto imageView : retired.imageViews){
+            vkDestroyImageView(device,imageView,nullptr);
+        }
+        if(retired.graphicsPipeline != VK_NULL_HANDLE){
+            vkDestroyPipeline(device,retired.graphicsPipeline,nullptr);
+            vkDestroyPipelineLayout(device,retired.pipelineLayout,nullptr);
+            vkDestroyRenderPass(device,retired.renderPass,nullptr);
+        }
+        if(retired.upscalePipeline != VK_NULL_HANDLE){
+            vkDestroyPipeline(device,retired.upscalePipeline,nullptr);
+            vkDestroyRenderPass(device,retired.upscaleRenderPass,nullptr);
+        }
+        vkDestroySwapchainKHR(device,retired.swapChain,nullptr);
     }
     //清除交换链相关
     void cleanupSwapChain(){
@@ -2131,28 +3822,40 @@ private:
         vkDestroyImage(device, depthImage, nullptr);
         //释放深度图像内存
         vkFreeMemory(device, depthImageMemory, nullptr);
+        //销毁多重采样的颜色图像,没有使用多重采样时为空句柄
+        vkDestroyImageView(device, msaaColorImageView, nullptr);
+        vkDestroyImage(device, msaaColorImage, nullptr);
+        vkFreeMemory(device, msaaColorImageMemory, nullptr);
+        //销毁动态分辨率的内部图像,没有使用动态分辨率时为空句柄
+        vkDestroyDescriptorPool(device, upscaleDescriptorPool, nullptr);
+        vkDestroyImageView(device, sceneImageView, nullptr);
+        vkDestroyImage(device, sceneImage, nullptr);
+        vkFreeMemory(device, sceneImageMemory, nullptr);
         //销毁帧缓冲对象
         for(auto framebuffer : swapChainFramebuffers){
             vkDestroyFramebuffer(device,framebuffer,nullptr);
         }
-        //清除分配的指令缓冲对象
-        vkFreeCommandBuffers(device,commandPool ,
-           static_cast<uint32_t>(commandBuffers.size()),commandBuffers.data());
-        //销毁管线对象
-        vkDestroyPipeline ( device , graphicsPipeline , nullptr );
-        //销毁管线布局对象
-        vkDestroyPipelineLayout ( device , pipelineLayout , nullptr);
-        //销毁渲染流程对象
-        vkDestroyRenderPass ( device , renderPass , nullptr );
+        for(auto framebuffer : upscaleFramebuffers){
+            vkDestroyFramebuffer(device,framebuffer,nullptr);
+        }
         //销毁图像视图
         for(auto imageView : swapChainImageViews){
             vkDestroyImageView(device,imageView,nullptr);
         }
+        //无窗口模式下销毁离屏图像
+        for(size_t i = 0;i < offscreenImageMemory.size();i++){
+            vkDestroyImage(device,swapChainImages[i],nullptr);
+            vkFreeMemory(device,offscreenImageMemory[i],nullptr);
+        }
+        offscreenImageMemory.clear();
         //销毁交换链对象，在逻辑设备被清除前调用
-        vkDestroySwapchainKHR(device,swapChain,nullptr);
+        if(swapChain != VK_NULL_HANDLE){
+            vkDestroySwapchainKHR(device,swapChain,nullptr);
+        }
     }
     //创建顶点缓冲
     void createVertexBuffer(){
+        TRACE_FUNCTION();
         VkDeviceSize bufferSize = sizeof(vertices[0])*vertices.size();
         //使用 CPU 可见的缓冲作为临时缓冲，使用显卡读取较快的缓冲作为真正的顶点缓冲
         VkBuffer stagingBuffer ;//缓冲对象存放 CPU 加载的顶点数据
@@ -2204,9 +3907,8 @@ private:
         我们需要使用标记指明我们使用缓冲进行传输操作.
           */
         copyBuffer(stagingBuffer , vertexBuffer , bufferSize ) ;
-        //清除我们使用的缓冲对象和它关联的内存对象
-        vkDestroyBuffer(device , stagingBuffer , nullptr ) ;
-        vkFreeMemory(device , stagingBufferMemory , nullptr ) ;
+        //复制指令执行完毕后再清除我们使用的缓冲对象和它关联的内存对象
+        deferDestroyBuffer(stagingBuffer,stagingBufferMemory);
     }
     /**
      * @brief findMemoryType
@@ -2238,6 +3940,19 @@ private:
         }
         throw std::runtime_error("failed to find a suitable memory type!");
     }
+    //是否有满足要求的内存类型,用于选择可选的内存属性
+    bool hasMemoryType(uint32_t typeFilter,VkMemoryPropertyFlags properties){
+        VkPhysicalDeviceMemoryProperties memProperties ;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice ,&memProperties);
+        for(uint32_t i=0;i<memProperties.memoryTypeCount;i++){
+            if((typeFilter & (1 << i )) &&
+               (memProperties.memoryTypes[i].propertyFlags & properties) ==
+                    properties){
+                return true;
+            }
+        }
+        return false;
+    }
     //创建缓冲--方便地使用不同的缓冲大小，内存类型来创建我们需要的缓冲
     //最后两个参数用于返回创建的缓冲对象和它关联的内存对象
     void createBuffer(VkDeviceSize size,VkBufferUsageFlags usage,
@@ -2292,10 +4007,735 @@ private:
         //将分配的内存和缓冲对象进行关联
         vkBindBufferMemory(device,buffer,bufferMemory,0);
     }
+    //资源包中与 path 同名的资源,没有打开资源包或包中没有时返回 nullptr
+    const AssetArchive::Entry* archivedAsset(const std::string& path) const {
+        return archive.isOpen() ? archive.find(assetName(path)) : nullptr;
+    }
+    //解压资源包使用的任务调度器,--serial-init 时在当前线程上解压
+    JobSystem* archiveJobs(){
+        return config.serialInit ? nullptr : &jobs;
+    }
+    bool meshStreaming() const {
+        return !config.meshFile.empty();
+    }
+    /**
+    打开分块网格文件,创建每一帧上传数据块使用的暂存缓冲.
+    暂存缓冲按同时处理的帧数的上限分成几段,每一帧只写入自己的一段,
+    这一段上一次被使用的帧已经执行完毕,所以主机内存占用与模型大小无关
+      */
+    void createMeshStreaming(){
+        TRACE_FUNCTION();
+        //资源包中不压缩存放时直接从资源包的映射中读取,压缩存放时先整个解压到内存
+        const AssetArchive::Entry* entry = archivedAsset(config.meshFile);
+        if(entry != nullptr && archive.storedData(*entry) != nullptr){
+            streamedMesh.open(archive.storedData(*entry),
+                              static_cast<size_t>(entry->size),entry->name);
+        }else if(entry != nullptr){
+            streamedMesh.open(archive.read(*entry,archiveJobs()),entry->name);
+        }else{
+            streamedMesh.open(config.meshFile);
+        }
+        streamedChunks.assign(streamedMesh.chunks.size(),StreamedChunk());
+        //每一段至少能放下最大的数据块
+        meshStagingSlice = std::max<VkDeviceSize>(
+                    VkDeviceSize(config.meshStreamBudgetKb) * 1024,
+                    streamedMesh.maxBlockBytes);
+        createBuffer(meshStagingSlice * MAX_FRAMES_IN_FLIGHT,
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     meshStagingBuffer,meshStagingMemory);
+        void* data;
+        vkMapMemory(device,meshStagingMemory,0,VK_WHOLE_SIZE,0,&data);
+        meshStagingMapped = static_cast<unsigned char*>(data);
+        meshStreamStart = std::chrono::high_resolution_clock::now();
+        std::cout<<"streaming "<<config.meshFile<<": "
+                 <<streamedChunks.size()<<" chunks, "<<streamedMesh.lodCount
+                 <<" LODs, "<<meshStagingSlice / 1024<<" KB staging per frame"
+                 <<std::endl;
+    }
+    /**
+    按文件顺序读取数据块到这一帧的暂存空间,直到暂存空间用完,
+    记录复制到每一块新的设备缓冲的指令.新的一级替换这一块之前的一级,
+    旧的缓冲在这一帧执行完毕后销毁.
+    每一块都是独立的缓冲,块数需要远小于 maxMemoryAllocationCount
+      */
+    void streamMeshChunks(VkCommandBuffer commandBuffer){
+        const size_t chunkCount = streamedChunks.size();
+        const size_t totalBlocks = chunkCount * streamedMesh.lodCount;
+        if(nextStreamBlock >= totalBlocks){
+            return;
+        }
+        TRACE_FUNCTION();
+        uint32_t scope = gpuProfiler.beginScope(commandBuffer,"mesh stream");
+        const VkDeviceSize sliceOffset = currentFrame * meshStagingSlice;
+        VkDeviceSize used = 0;
+        while(nextStreamBlock < totalBlocks){
+            uint32_t chunkIndex = static_cast<uint32_t>(nextStreamBlock % chunkCount);
+            uint32_t lod = streamedMesh.lodCount - 1 -
+                    static_cast<uint32_t>(nextStreamBlock / chunkCount);
+            const MeshChunkLod& block = streamedMesh.chunks[chunkIndex].lods[lod];
+            VkDeviceSize bytes = block.bytes();
+            if(used + bytes > meshStagingSlice){
+                break;//留到下一帧
+            }
+            nextStreamBlock++;
+            if(block.indexCount == 0){
+                continue;//这一级简化后没有三角形,保留之前的一级
+            }
+            streamedMesh.readBlock(chunkIndex,lod,
+                                   meshStagingMapped + sliceOffset + used);
+            StreamedChunk& chunk = streamedChunks[chunkIndex];
+            if(chunk.buffer != VK_NULL_HANDLE){
+                deferDestroyBuffer(chunk.buffer,chunk.memory);
+            }
+            createBuffer(bytes,VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                         VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                         chunk.buffer,chunk.memory);
+            VkBufferCopy region = {};
+            region.srcOffset = sliceOffset + used;
+            region.dstOffset = 0;
+            region.size = bytes;
+            vkCmdCopyBuffer(commandBuffer,meshStagingBuffer,chunk.buffer,1,&region);
+            chunk.indexOffset = VkDeviceSize(block.vertexCount) * sizeof(Vertex);
+            chunk.indexCount = block.indexCount;
+            used += bytes;
+        }
+        if(used > 0){
+            //复制完成后才能作为顶点和索引读取
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                    VK_ACCESS_INDEX_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,0,
+                                 1,&barrier,0,nullptr,0,nullptr);
+        }
+        gpuProfiler.endScope(commandBuffer,scope);
+        meshStreamedBytes += used;
+        if(nextStreamBlock >= totalBlocks){
+            streamedMesh.close();
+            std::cout<<"mesh streamed: "<<meshStreamedBytes / (1024.0 * 1024.0)
+                     <<" MB in "<<millisecondsSince(meshStreamStart)<<" ms"
+                     <<std::endl;
+        }
+    }
+    //绘制每一块已经上传的最精细的一级
+    void drawStreamedMesh(VkCommandBuffer commandBuffer){
+        for(const StreamedChunk& chunk : streamedChunks){
+            if(chunk.buffer == VK_NULL_HANDLE){
+                continue;
+            }
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer,0,1,&chunk.buffer,&offset);
+            vkCmdBindIndexBuffer(commandBuffer,chunk.buffer,chunk.indexOffset,
+                                 VK_INDEX_TYPE_UINT32);
+            vkCmdDrawIndexed(commandBuffer,chunk.indexCount,1,0,0,0);
+        }
+    }
+    void destroyMeshStreaming(){
+        for(StreamedChunk& chunk : streamedChunks){
+            vkDestroyBuffer(device,chunk.buffer,nullptr);
+            vkFreeMemory(device,chunk.memory,nullptr);
+        }
+        streamedChunks.clear();
+        vkDestroyBuffer(device,meshStagingBuffer,nullptr);
+        vkFreeMemory(device,meshStagingMemory,nullptr);
+    }
+    bool virtualTexturing() const {
+        return !config.virtualTextureFile.empty();
+    }
+    //打开虚拟纹理的分页文件,资源包中不压缩存放时直接从资源包的映射中读取
+    void openVirtualTexture(){
+        TRACE_FUNCTION();
+        const AssetArchive::Entry* entry = archivedAsset(config.virtualTextureFile);
+        if(entry != nullptr && archive.storedData(*entry) != nullptr){
+            virtualTexture.open(archive.storedData(*entry),
+                                static_cast<size_t>(entry->size),entry->name);
+        }else{
+            virtualTexture.open(config.virtualTextureFile);
+        }
+        virtualTextureCache.init(virtualTexture.layout,config.virtualCachePages);
+    }
+    /**
+    使用虚拟纹理时 set 1 的布局:
+    binding 0 页表,binding 1 物理缓存,binding 2 反馈缓冲(动态偏移选择这一帧的一段)
+      */
+    void createVirtualSetLayout(){
+        VkDescriptorSetLayoutBinding bindings[3] = {};
+        for(uint32_t i = 0;i < 3;i++){
+            bindings[i].binding = i;
+            bindings[i].descriptorCount = 1;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
+        bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = bindings;
+        if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,
+                                       &virtualSetLayout)!= VK_SUCCESS){
+            throw std::runtime_error(
+                        "failed to create virtual texture descriptor set layout");
+        }
+    }
+    /**
+    创建虚拟纹理使用的 Vulkan 对象:
+    页表图像(R8G8B8A8_UINT,细化链与页的级别对应),固定大小的物理缓存图像,
+    每一帧一段的暂存缓冲和反馈缓冲,以及 set 1 的描述符集.
+    显存占用由 --vt-cache 决定,与虚拟纹理的大小无关,只有页表和反馈缓冲随页数增长
+      */
+    void createVirtualTexturing(){
+        TRACE_FUNCTION();
+        const VirtualTextureLayout& layout = virtualTexture.layout;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice,&properties);
+        uint32_t cacheSize = config.virtualCachePages * layout.tileExtent();
+        if(cacheSize > properties.limits.maxImageDimension2D ||
+                layout.pagesX(0) > properties.limits.maxImageDimension2D ||
+                layout.pagesY(0) > properties.limits.maxImageDimension2D){
+            throw std::runtime_error("virtual texture cache or page table "
+                                     "exceeds maxImageDimension2D");
+        }
+        createImage(layout.pagesX(0),layout.pagesY(0),layout.levelCount,
+                    VK_FORMAT_R8G8B8A8_UINT,VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    pageTableImage,pageTableImageMemory);
+        createImage(cacheSize,cacheSize,1,VK_FORMAT_R8G8B8A8_UNORM,
+                    VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    physicalCacheImage,physicalCacheImageMemory);
+        //内容在第一帧上传页表和页之后才被采样,这里只变换布局
+        VkImage images[] = { pageTableImage,physicalCacheImage };
+        VkFormat formats[] = { VK_FORMAT_R8G8B8A8_UINT,VK_FORMAT_R8G8B8A8_UNORM };
+        uint32_t levels[] = { layout.levelCount,1 };
+        for(int i = 0;i < 2;i++){
+            transitionImageLayout(images[i],formats[i],VK_IMAGE_LAYOUT_UNDEFINED,
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,levels[i]);
+            transitionImageLayout(images[i],formats[i],
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,levels[i]);
+        }
+        pageTableImageView = createImageView(pageTableImage,VK_FORMAT_R8G8B8A8_UINT,
+                                             VK_IMAGE_ASPECT_COLOR_BIT,layout.levelCount);
+        physicalCacheImageView = createImageView(physicalCacheImage,
+                                                 VK_FORMAT_R8G8B8A8_UNORM,
+                                                 VK_IMAGE_ASPECT_COLOR_BIT,1);
+        //页表用 texelFetch 读取,整数格式只能使用最近点过滤;
+        //物理缓存没有细化链,页的边框保证双线性过滤不会越过页的边界
+        VkSamplerCreateInfo samplerInfo = {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = static_cast<float>(layout.levelCount);
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        if(vkCreateSampler(device,&samplerInfo,nullptr,
+                           &pageTableSampler) != VK_SUCCESS){
+            throw std::runtime_error("failed to create page table sampler!");
+        }
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.maxLod = 0.0f;
+        if(vkCreateSampler(device,&samplerInfo,nullptr,
+                           &physicalCacheSampler) != VK_SUCCESS){
+            throw std::runtime_error("failed to create physical cache sampler!");
+        }
+
+        //暂存缓冲的每一段放得下一帧最多加载的页和整个页表
+        virtualStagingSlice = VkDeviceSize(config.virtualUploadsPerFrame) *
+                layout.tileBytes() + VkDeviceSize(layout.pageCount()) * 4;
+        createBuffer(virtualStagingSlice * MAX_FRAMES_IN_FLIGHT,
+                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     virtualStagingBuffer,virtualStagingMemory);
+        void* data;
+        vkMapMemory(device,virtualStagingMemory,0,VK_WHOLE_SIZE,0,&data);
+        virtualStagingMapped = static_cast<unsigned char*>(data);
+        //反馈缓冲的每一段按动态偏移的对齐要求对齐
+        VkDeviceSize alignment = std::max<VkDeviceSize>(
+                    properties.limits.minStorageBufferOffsetAlignment,4);
+        feedbackSlice = (VkDeviceSize(layout.pageCount()) * 4 + alignment - 1) /
+                alignment * alignment;
+        createBuffer(feedbackSlice * MAX_FRAMES_IN_FLIGHT,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     feedbackBuffer,feedbackMemory);
+        vkMapMemory(device,feedbackMemory,0,VK_WHOLE_SIZE,0,&data);
+        feedbackMapped = static_cast<unsigned char*>(data);
+        std::memset(feedbackMapped,0,static_cast<size_t>(feedbackSlice *
+                                                         MAX_FRAMES_IN_FLIGHT));
+        //第一帧请求最粗糙的一级,之后由反馈驱动
+        reinterpret_cast<uint32_t*>(feedbackMapped)[layout.pageCount() - 1] = 1;
+
+        virtualDescriptorSet = descriptorAllocator.allocate(virtualSetLayout);
+        VkDescriptorImageInfo imageInfos[2] = {};
+        imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfos[0].imageView = pageTableImageView;
+        imageInfos[0].sampler = pageTableSampler;
+        imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfos[1].imageView = physicalCacheImageView;
+        imageInfos[1].sampler = physicalCacheSampler;
+        VkDescriptorBufferInfo bufferInfo = {};
+        bufferInfo.buffer = feedbackBuffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = VkDeviceSize(layout.pageCount()) * 4;
+        VkWriteDescriptorSet writes[3] = {};
+        for(uint32_t i = 0;i < 3;i++){
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = virtualDescriptorSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        }
+        writes[0].pImageInfo = &imageInfos[0];
+        writes[1].pImageInfo = &imageInfos[1];
+        writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        writes[2].pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(device,3,writes,0,nullptr);
+
+        std::cout<<"virtual texture: "<<config.virtualTextureFile<<", "
+                 <<layout.width<<"x"<<layout.height<<", "<<layout.levelCount
+                 <<" levels, "<<layout.pageCount()<<" pages, cache "
+                 <<cacheSize<<"x"<<cacheSize<<" ("
+                 <<config.virtualCachePages * config.virtualCachePages<<" pages, "
+                 <<VkDeviceSize(cacheSize) * cacheSize * 4 / (1024 * 1024)<<" MB)"
+                 <<std::endl;
+    }
+    /**
+    读取这一段反馈缓冲(上一次使用它的帧已经执行完毕),分配物理缓存的槽,
+    在任务调度器上并行解压请求的页到这一帧的暂存空间,记录复制到物理缓存
+    和页表的指令,最后清零反馈缓冲供这一帧写入.
+    被淘汰的页可能还被之前的帧采样,复制前的屏障等待之前提交的片段着色器执行完毕
+      */
+    void streamVirtualTexture(VkCommandBuffer commandBuffer){
+        TRACE_FUNCTION();
+        uint32_t scope = gpuProfiler.beginScope(commandBuffer,"virtual texture");
+        const VirtualTextureLayout& layout = virtualTexture.layout;
+        const VkDeviceSize feedbackOffset = currentFrame * feedbackSlice;
+        const VkDeviceSize sliceOffset = currentFrame * virtualStagingSlice;
+        std::vector<uint32_t> requests = virtualTextureCache.collectRequests(
+                    reinterpret_cast<const uint32_t*>(feedbackMapped + feedbackOffset),
+                    frameNumber,config.virtualUploadsPerFrame);
+        std::vector<uint32_t> pages;
+        std::vector<VkBufferImageCopy> tileCopies;
+        for(uint32_t page : requests){
+            uint32_t slot = virtualTextureCache.allocate(page,frameNumber);
+            if(slot == vtex::NO_SLOT){
+                break;//缓存中的页这一帧都在使用,剩下的请求以后再加载
+            }
+            VkBufferImageCopy region = {};
+            region.bufferOffset = sliceOffset + pages.size() * layout.tileBytes();
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {
+                static_cast<int32_t>(virtualTextureCache.slotX(slot) * layout.tileExtent()),
+                static_cast<int32_t>(virtualTextureCache.slotY(slot) * layout.tileExtent()),
+                0
+            };
+            region.imageExtent = { layout.tileExtent(),layout.tileExtent(),1 };
+            tileCopies.push_back(region);
+            pages.push_back(page);
+        }
+        std::atomic<bool> failed(false);
+        unsigned char* tiles = virtualStagingMapped + sliceOffset;
+        jobs.parallelFor(0,pages.size(),1,[&](size_t first,size_t last){
+            for(size_t i = first;i < last;i++){
+                if(!virtualTexture.readTile(pages[i],tiles + i * layout.tileBytes())){
+                    failed = true;
+                }
+            }
+        });
+        if(failed){
+            throw std::runtime_error("corrupt virtual texture page in " +
+                                     config.virtualTextureFile);
+        }
+        //页表改变时整个上传,每一级复制到对应的细化级别
+        std::vector<VkBufferImageCopy> tableCopies;
+        if(virtualTextureCache.pageTableDirty()){
+            const std::vector<uint32_t>& table = virtualTextureCache.pageTable();
+            VkDeviceSize tableOffset = sliceOffset +
+                    VkDeviceSize(config.virtualUploadsPerFrame) * layout.tileBytes();
+            std::memcpy(virtualStagingMapped + tableOffset,table.data(),
+                        table.size() * sizeof(uint32_t));
+            for(uint32_t level = 0;level < layout.levelCount;level++){
+                VkBufferImageCopy region = {};
+                region.bufferOffset = tableOffset +
+                        VkDeviceSize(layout.firstPage[level]) * 4;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = level;
+                region.imageSubresource.layerCount = 1;
+                region.imageExtent = { layout.pagesX(level),layout.pagesY(level),1 };
+                tableCopies.push_back(region);
+            }
+        }
+
+        //复制前:之前的帧对图像的采样完成,变换为传输目标布局
+        VkImageMemoryBarrier barriers[2] = {};
+        uint32_t barrierCount = 0;
+        auto addBarrier = [&](VkImage image,uint32_t levels){
+            VkImageMemoryBarrier& barrier = barriers[barrierCount++];
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = levels;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        };
+        if(!tileCopies.empty()){
+            addBarrier(physicalCacheImage,1);
+        }
+        if(!tableCopies.empty()){
+            addBarrier(pageTableImage,layout.levelCount);
+        }
+        if(barrierCount > 0){
+            vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,0,0,nullptr,0,nullptr,
+                                 barrierCount,barriers);
+        }
+        if(!tileCopies.empty()){
+            vkCmdCopyBufferToImage(commandBuffer,virtualStagingBuffer,physicalCacheImage,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(tileCopies.size()),
+                                   tileCopies.data());
+        }
+        if(!tableCopies.empty()){
+            vkCmdCopyBufferToImage(commandBuffer,virtualStagingBuffer,pageTableImage,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(tableCopies.size()),
+                                   tableCopies.data());
+        }
+        //这一帧的反馈从零开始
+        vkCmdFillBuffer(commandBuffer,feedbackBuffer,feedbackOffset,
+                        VkDeviceSize(layout.pageCount()) * 4,0);
+        //复制后:变换回着色器读取布局;清零完成后片段着色器才能写入反馈
+        for(uint32_t i = 0;i < barrierCount;i++){
+            std::swap(barriers[i].oldLayout,barriers[i].newLayout);
+            barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        VkMemoryBarrier fillBarrier = {};
+        fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        fillBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,0,
+                             1,&fillBarrier,0,nullptr,barrierCount,barriers);
+        gpuProfiler.endScope(commandBuffer,scope);
+        virtualUploadedPages += pages.size();
+    }
+    void destroyVirtualTexturing(){
+        if(!virtualTexturing()){
+            return;
+        }
+        std::cout<<"virtual texture: "<<virtualUploadedPages<<" pages uploaded, "
+                 <<virtualTextureCache.evictedPages()<<" evicted, "
+                 <<virtualTextureCache.residentPages()<<" resident"<<std::endl;
+        vkDestroySampler(device,pageTableSampler,nullptr);
+        vkDestroySampler(device,physicalCacheSampler,nullptr);
+        vkDestroyImageView(device,pageTableImageView,nullptr);
+        vkDestroyImageView(device,physicalCacheImageView,nullptr);
+        vkDestroyImage(device,pageTableImage,nullptr);
+        vkFreeMemory(device,pageTableImageMemory,nullptr);
+        vkDestroyImage(device,physicalCacheImage,nullptr);
+        vkFreeMemory(device,physicalCacheImageMemory,nullptr);
+        vkDestroyBuffer(device,virtualStagingBuffer,nullptr);
+        vkFreeMemory(device,virtualStagingMemory,nullptr);
+        vkDestroyBuffer(device,feedbackBuffer,nullptr);
+        vkFreeMemory(device,feedbackMemory,nullptr);
+        vkDestroyDescriptorSetLayout(device,virtualSetLayout,nullptr);
+    }
+    bool textureStreaming() const {
+        return config.textureBudgetKb > 0;
+    }
+    /**
+    开始流式加载纹理:只上传最大边不超过 TEXTURE_STREAMING_FIRST_SIZE 的几级
+    (预算放不下时更少),纹理立即可以显示,之后由 streamTextureMips 逐级提高.
+    所有级别的数据保留在内存中(KTX2 纹理保留文件的映射),作为之后上传的来源
+      */
+    void createTextureStreaming(TextureData texture){
+        TRACE_FUNCTION();
+        streamedTexture = std::move(texture);
+        textureFormat = streamedTexture.format;
+        const std::vector<TextureLevel>& levels = streamedTexture.levels;
+        const uint32_t lastLevel = static_cast<uint32_t>(levels.size()) - 1;
+        std::vector<uint64_t> levelBytes;
+        for(const TextureLevel& level : levels){
+            levelBytes.push_back(level.size);
+        }
+        const uint64_t budget = uint64_t(config.textureBudgetKb) * 1024;
+        uint32_t first = 0;
+        uint64_t tailBytes = 0;
+        for(uint64_t bytes : levelBytes){
+            tailBytes += bytes;
+        }
+        while(first < lastLevel &&
+              (std::max(levels[first].width,levels[first].height) >
+               TEXTURE_STREAMING_FIRST_SIZE || tailBytes > budget)){
+            tailBytes -= levelBytes[first++];
+        }
+        textureBudget.setBudget(budget);
+        streamedTextureId = textureBudget.add(levelBytes,first);
+
+        mipLevels = lastLevel + 1 - first;
+        textureFirstLevel = first;
+        createImage(levels[first].width,levels[first].height,mipLevels,textureFormat,
+                    VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    textureImage,textureImageMemory);
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        std::vector<TextureLevel> staged = stageTextureLevels(
+                    first,lastLevel + 1,stagingBuffer,stagingBufferMemory);
+        transitionImageLayout(textureImage,textureFormat,
+                              VK_IMAGE_LAYOUT_UNDEFINED,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,mipLevels);
+        copyBufferToImage(stagingBuffer,textureImage,staged);
+        deferDestroyBuffer(stagingBuffer,stagingBufferMemory);
+        transitionImageLayout(textureImage,textureFormat,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,mipLevels);
+        std::cout<<"texture streaming: "<<streamedTexture.width<<"x"
+                 <<streamedTexture.height<<", "<<levels.size()<<" levels, budget "
+                 <<config.textureBudgetKb<<" KB, starting at level "<<first<<" ("
+                 <<levels[first].width<<"x"<<levels[first].height<<", "
+                 <<tailBytes / 1024<<" KB)"<<std::endl;
+    }
+    /**
+    把流式纹理的 [first,end) 级复制到新建的暂存缓冲,
+    返回的级别中的偏移相对于暂存缓冲,按块压缩格式最大的块对齐
+      */
+    std::vector<TextureLevel> stageTextureLevels(uint32_t first,uint32_t end,
+                                                 VkBuffer& buffer,
+                                                 VkDeviceMemory& memory){
+        std::vector<TextureLevel> staged(streamedTexture.levels.begin() + first,
+                                         streamedTexture.levels.begin() + end);
+        VkDeviceSize size = 0;
+        for(TextureLevel& level : staged){
+            size = (size + 15) & ~VkDeviceSize(15);
+            level.offset = static_cast<size_t>(size);
+            size += level.size;
+        }
+        createBuffer(size,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     buffer,memory);
+        void* data;
+        vkMapMemory(device,memory,0,size,0,&data);
+        for(size_t i = 0;i < staged.size();i++){
+            std::memcpy(static_cast<unsigned char*>(data) + staged[i].offset,
+                        streamedTexture.bytes() + streamedTexture.levels[first + i].offset,
+                        staged[i].size);
+        }
+        vkUnmapMemory(device,memory);
+        return staged;
+    }
+    /**
+    由模型在屏幕上的大小估计需要的纹理细化级别.
+    假设纹理大致覆盖模型一次,包围球投影后的直径(像素)与纹理最大边之比
+    就是一个像素对应的纹素数,以 2 为底的对数向下取整得到级别
+      */
+    uint32_t textureDemandLevel(const glm::mat4& view,float fovY) const {
+        const glm::mat4& model = pushConstants.model;
+        glm::vec3 center = glm::vec3(view * model * glm::vec4(modelCenter,1.0f));
+        float scale = std::max(std::max(glm::length(glm::vec3(model[0])),
+                                        glm::length(glm::vec3(model[1]))),
+                               glm::length(glm::vec3(model[2])));
+        float radius = modelRadius * scale;
+        float distance = glm::length(center);
+        if(distance <= radius){
+            return 0;//相机在包围球内
+        }
+        float pixels = radius / (distance * std::tan(fovY * 0.5f)) *
+                swapChainExtent.height;
+        float texels = static_cast<float>(std::max(streamedTexture.width,
+                                                   streamedTexture.height));
+        float level = std::floor(std::log2(texels / std::max(pixels,1.0f)));
+        return static_cast<uint32_t>(std::max(level,0.0f));
+    }
+    //模型的包围球,流式加载纹理时用于估计模型在屏幕上的大小
+    void computeModelBounds(){
+        glm::vec3 boundsMin,boundsMax;
+        if(meshStreaming()){
+            boundsMin = glm::vec3(streamedMesh.boundsMin[0],streamedMesh.boundsMin[1],
+                                  streamedMesh.boundsMin[2]);
+            boundsMax = glm::vec3(streamedMesh.boundsMax[0],streamedMesh.boundsMax[1],
+                                  streamedMesh.boundsMax[2]);
+        }else if(!vertices.empty()){
+            boundsMin = boundsMax = vertices[0].pos;
+            for(const Vertex& vertex : vertices){
+                boundsMin = glm::min(boundsMin,vertex.pos);
+                boundsMax = glm::max(boundsMax,vertex.pos);
+            }
+        }else{
+            return;
+        }
+        modelCenter = (boundsMin + boundsMax) * 0.5f;
+        modelRadius = std::max(glm::length(boundsMax - boundsMin) * 0.5f,1e-4f);
+    }
+    /**
+    每一帧最多改变一次纹理的驻留级别.
+    使用无绑定纹理时新图像写入另一个数组位置,执行中的帧使用的位置不能更新,
+    所以改变之后等这一帧执行完毕(framesInFlight 帧之后)才能再次改变
+      */
+    void streamTextureMips(VkCommandBuffer commandBuffer){
+        TRACE_FUNCTION();
+        if(frameNumber < nextTextureChangeFrame){
+            return;
+        }
+        MipStreamingBudget::Change change;
+        if(!textureBudget.nextChange(change)){
+            return;
+        }
+        uint32_t scope = gpuProfiler.beginScope(commandBuffer,"texture streaming");
+        resizeStreamedTexture(commandBuffer,change.level);
+        gpuProfiler.endScope(commandBuffer,scope);
+        textureBudget.commit(change);
+        nextTextureChangeFrame = frameNumber + framesInFlight;
+    }
+    /**
+    把纹理的驻留级别改为 level:创建只包含 level 到最小一级的新图像,
+    两个图像都有的级别在 GPU 上从旧图像复制,新增的级别从暂存缓冲上传,
+    然后用新图像替换旧图像.之前的帧仍在采样旧图像,旧图像在这一帧执行完毕后销毁.
+    图像视图只包含驻留的级别,采样时的级别相对于驻留的最大一级,
+    着色器不需要知道驻留了哪些级别
+      */
+    void resizeStreamedTexture(VkCommandBuffer commandBuffer,uint32_t level){
+        const std::vector<TextureLevel>& levels = streamedTexture.levels;
+        const uint32_t levelCount = static_cast<uint32_t>(levels.size()) - level;
+        VkImage image;
+        VkDeviceMemory memory;
+        createImage(levels[level].width,levels[level].height,levelCount,textureFormat,
+                    VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,image,memory);
+
+        //旧图像在之前的帧采样完毕后作为复制源,新图像不需要保留内容
+        VkImageMemoryBarrier barriers[2] = {};
+        for(VkImageMemoryBarrier& barrier : barriers){
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.layerCount = 1;
+        }
+        barriers[0].image = textureImage;
+        barriers[0].subresourceRange.levelCount = mipLevels;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].srcAccessMask = 0;
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[1].image = image;
+        barriers[1].subresourceRange.levelCount = levelCount;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].srcAccessMask = 0;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,0,0,nullptr,0,nullptr,
+                             2,barriers);
+
+        std::vector<VkImageCopy> copies;
+        for(uint32_t i = std::max(level,textureFirstLevel);i < levels.size();i++){
+            VkImageCopy copy = {};
+            copy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copy.srcSubresource.mipLevel = i - textureFirstLevel;
+            copy.srcSubresource.layerCount = 1;
+            copy.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copy.dstSubresource.mipLevel = i - level;
+            copy.dstSubresource.layerCount = 1;
+            copy.extent = { levels[i].width,levels[i].height,1 };
+            copies.push_back(copy);
+        }
+        vkCmdCopyImage(commandBuffer,textureImage,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       image,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       static_cast<uint32_t>(copies.size()),copies.data());
+        if(level < textureFirstLevel){
+            VkBuffer stagingBuffer;
+            VkDeviceMemory stagingBufferMemory;
+            std::vector<TextureLevel> staged = stageTextureLevels(
+                        level,textureFirstLevel,stagingBuffer,stagingBufferMemory);
+            std::vector<VkBufferImageCopy> regions(staged.size());
+            for(size_t i = 0;i < staged.size();i++){
+                regions[i] = {};
+                regions[i].bufferOffset = staged[i].offset;
+                regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                regions[i].imageSubresource.mipLevel = static_cast<uint32_t>(i);
+                regions[i].imageSubresource.layerCount = 1;
+                regions[i].imageExtent = { staged[i].width,staged[i].height,1 };
+            }
+            vkCmdCopyBufferToImage(commandBuffer,stagingBuffer,image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(regions.size()),
+                                   regions.data());
+            deferDestroyBuffer(stagingBuffer,stagingBufferMemory);
+        }
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,0,0,nullptr,
+                             0,nullptr,1,&barriers[1]);
+
+        VkImage oldImage = textureImage;
+        VkDeviceMemory oldMemory = textureImageMemory;
+        VkImageView oldView = textureImageView;
+        deferDestroy([this,oldImage,oldMemory,oldView](){
+            vkDestroyImageView(device,oldView,nullptr);
+            vkDestroyImage(device,oldImage,nullptr);
+            vkFreeMemory(device,oldMemory,nullptr);
+        });
+        textureImage = image;
+        textureImageMemory = memory;
+        textureImageView = createImageView(image,textureFormat,
+                                           VK_IMAGE_ASPECT_COLOR_BIT,levelCount);
+        mipLevels = levelCount;
+        textureFirstLevel = level;
+        if(bindlessSupported){
+            textureSlot ^= 1;
+            textureMaterialIndex = textureSlots[textureSlot];
+            updateBindlessTexture(textureMaterialIndex,textureImageView,textureSampler);
+        }else{
+            //缓存的描述符集引用旧的图像视图,记录这一帧时重新写入;
+            //旧的描述符集所在的池在之前的帧执行完毕后重置复用
+            std::vector<VkDescriptorPool> pools = descriptorSetCache.retire();
+            deferDestroy([this,pools](){
+                descriptorSetCache.recyclePools(pools);
+            });
+        }
+    }
+    void reportTextureStreaming(){
+        std::cout<<"texture streaming: "<<textureBudget.raised<<" levels raised, "
+                 <<textureBudget.dropped<<" dropped, resident from level "
+                 <<textureFirstLevel<<" ("<<textureBudget.residentBytes() / 1024
+                 <<" of "<<config.textureBudgetKb<<" KB)"<<std::endl;
+    }
     //用于在缓冲之间复制数据
     void copyBuffer( VkBuffer srcBuffer , VkBuffer dstBuffer,
                       VkDeviceSize size){
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        uint32_t scope = gpuProfiler.beginScope(commandBuffer,"upload");
 
         //指定了复制操作的源缓冲位置偏移，目的缓冲位置偏移，以及要复制的数据长度
         VkBufferCopy copyRegion = {};
@@ -2304,11 +4744,13 @@ private:
         copyRegion.size = size;//指定要复制的数据长度
         //进行缓冲的复制
         vkCmdCopyBuffer(commandBuffer,srcBuffer,dstBuffer,1,&copyRegion);
+        gpuProfiler.endScope(commandBuffer,scope);
 
         endSingleTimeCommands(commandBuffer) ;
     }
     //创建索引缓冲--同创建顶点缓冲方式相同
     void createIndexBuffer(){
+        TRACE_FUNCTION();
         VkDeviceSize bufferSize = sizeof(indices[0])*indices.size();
         VkBuffer stagingBuffer ;//缓冲对象存放 CPU 加载的数据
         VkDeviceMemory stagingBufferMemory ;//缓冲对象内存
@@ -2331,11 +4773,11 @@ private:
 
         copyBuffer(stagingBuffer , indexBuffer , bufferSize ) ;
 
-        vkDestroyBuffer(device , stagingBuffer , nullptr ) ;
-        vkFreeMemory(device , stagingBufferMemory , nullptr ) ;
+        deferDestroyBuffer(stagingBuffer,stagingBufferMemory);
     }
     //提供着色器使用的每一个描述符绑定信息
     void createDescriptorSetLayout(){
+        TRACE_FUNCTION();
         //描述每一个绑定
         VkDescriptorSetLayoutBinding uboLayoutBinding = {};
         //指定着色器使用的描述符绑定
@@ -2364,9 +4806,13 @@ private:
           */
         samplerLayoutBinding.stageFlags =  VK_SHADER_STAGE_FRAGMENT_BIT;
 
-        std::array<VkDescriptorSetLayoutBinding,2> bindings = {
-            uboLayoutBinding,samplerLayoutBinding
+        std::vector<VkDescriptorSetLayoutBinding> bindings = {
+            uboLayoutBinding
         };
+        //使用无绑定纹理时,纹理放在 set 1 的纹理数组中
+        if(!bindlessSupported){
+            bindings.push_back(samplerLayoutBinding);
+        }
 
         //创建描述符布局相关信息
         VkDescriptorSetLayoutCreateInfo layoutInfo = {};
@@ -2377,13 +4823,129 @@ private:
                                        &descriptorSetLayout)!= VK_SUCCESS){
             throw std::runtime_error("failed to create descriptor set layout");
         }
+        if(bindlessSupported){
+            createBindlessSetLayout();
+        }
+        if(virtualTexturing()){
+            createVirtualSetLayout();
+        }
+    }
+    /**
+    无绑定纹理数组的描述符布局.
+    PARTIALLY_BOUND:数组中没有写入的元素只要不被访问就是合法的.
+    UPDATE_AFTER_BIND:描述符集绑定到指令缓冲后仍然可以写入新的纹理.
+    UPDATE_UNUSED_WHILE_PENDING:指令缓冲执行时可以写入没有被使用的元素
+      */
+    void createBindlessSetLayout(){
+        VkDescriptorSetLayoutBinding textureBinding = {};
+        textureBinding.binding = 0;
+        textureBinding.descriptorType =
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        textureBinding.descriptorCount = bindlessTextureCapacity;
+        textureBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        textureBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorBindingFlagsEXT bindingFlags =
+                VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+        bindingFlagsInfo.sType =
+          VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        bindingFlagsInfo.bindingCount = 1;
+        bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags =
+                VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &textureBinding;
+        if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,
+                                       &bindlessSetLayout)!= VK_SUCCESS){
+            throw std::runtime_error(
+                        "failed to create bindless descriptor set layout");
+        }
+    }
+    //创建无绑定纹理数组的描述符集,并写入模型纹理
+    void createBindlessDescriptorSet(){
+        TRACE_FUNCTION();
+        if(!bindlessSupported){
+            return;
+        }
+        //绑定后更新的描述符集需要从带有 UPDATE_AFTER_BIND 标记的池中分配
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = bindlessTextureCapacity;
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if(vkCreateDescriptorPool(device,&poolInfo,nullptr,
+                                  &bindlessDescriptorPool) != VK_SUCCESS){
+            throw std::runtime_error(
+                        "failed to create bindless descriptor pool!");
+        }
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = bindlessDescriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &bindlessSetLayout;
+        if(vkAllocateDescriptorSets(device,&allocInfo,
+                                    &bindlessDescriptorSet) != VK_SUCCESS){
+            throw std::runtime_error(
+                        "failed to allocate bindless descriptor set!");
+        }
+        textureMaterialIndex =
+                registerBindlessTexture(textureImageView,textureSampler);
+        if(textureStreaming()){
+            //替换纹理时写入另一个位置,不更新之前的帧仍在使用的位置
+            textureSlots[0] = textureMaterialIndex;
+            textureSlots[1] = registerBindlessTexture(textureImageView,textureSampler);
+        }
+    }
+    //把纹理写入纹理数组的下一个空位,返回着色器中使用的材质索引
+    uint32_t registerBindlessTexture(VkImageView imageView,VkSampler sampler){
+        if(bindlessTextureCount >= bindlessTextureCapacity){
+            throw std::runtime_error("bindless texture array is full!");
+        }
+        uint32_t index = bindlessTextureCount++;
+        updateBindlessTexture(index,imageView,sampler);
+        return index;
+    }
+    //替换纹理数组中指定位置的纹理
+    void updateBindlessTexture(uint32_t index,VkImageView imageView,
+                               VkSampler sampler){
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = imageView;
+        imageInfo.sampler = sampler;
+        VkWriteDescriptorSet descriptorWrite = {};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = bindlessDescriptorSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = index;
+        descriptorWrite.descriptorType =
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(device,1,&descriptorWrite,0,nullptr);
     }
     //分配uniform 缓冲对象
     void createUniformBuffer(){
+        TRACE_FUNCTION();
         VkDeviceSize buffersize = sizeof(UniformBufferObject);
+        //重建交换链后图像个数可能增加,只创建缺少的缓冲
+        size_t existing = uniformBuffers.size();
+        if(existing >= swapChainImages.size()){
+            return;
+        }
         uniformBuffers.resize(swapChainImages.size());
         uniformBuffersMemory.resize(swapChainImages.size());
-        for(size_t i=0;i<swapChainImages.size();i++){
+        for(size_t i=existing;i<swapChainImages.size();i++){
             createBuffer(buffersize,VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -2391,7 +4953,22 @@ private:
         }
     }
     //更新uniform 缓冲对象--可以在每一帧产生一个新的变换矩阵
+    /**
+    基准测试使用的相机路径,只由场景时间 seconds 决定:
+    模型绕向上方向每秒旋转 30 度,相机在 2.5 到 5.5 之间推近拉远,同时上下移动
+      */
+    void applyScriptedCamera(double seconds){
+        float t = static_cast<float>(seconds);
+        pushConstants.model = glm::rotate(glm::mat4(1.0f),
+                                          glm::radians(30.0f) * t,
+                                glm::vec3(viewup[0],viewup[1],viewup[2]));
+        float distance = 4.0f + 1.5f * std::sin(t * 0.5f);
+        campos[0] = focalpos[0];
+        campos[1] = focalpos[1] + distance;
+        campos[2] = focalpos[2] + 1.5f * std::sin(t * 0.3f);
+    }
     void updateUniformBuffer(uint32_t currentImage){
+        TRACE_FUNCTION();
         static auto startTime = std::chrono::high_resolution_clock::now();
         auto currentTime = std::chrono::high_resolution_clock::now() ;
         float time = std::chrono::duration<float,std::chrono::seconds::period>(
@@ -2404,14 +4981,20 @@ private:
           glm::mat4(1.0f)用于构造单位矩阵
           通过 time * glm::radians(90.0f) 完成每秒旋转 90 度的操作。
           */
-        ubo.model = glm::rotate(compositeMatrix,glm::radians(offSet[0]),
+        //模型矩阵通过推送常量在记录指令时传递给着色器
+        if(config.benchmarkFrames > 0){
+            applyScriptedCamera(frameNumber * BENCHMARK_TIMESTEP_MS / 1000.0);
+        }else{
+            pushConstants.model = glm::rotate(compositeMatrix,
+                                              glm::radians(offSet[0]),
                                 glm::vec3(viewup[0],viewup[1],viewup[2]));
-        compositeMatrix = ubo.model;
+            compositeMatrix = pushConstants.model;
+        }
         /**
          视图变换矩阵
         glm::lookAt 函数以观察者位置，视点坐标和向上向量为参数生成视图变换矩阵
          */
-        ubo.view = glm::lookAt(glm::vec3(campos[0],campos[1],campos[2]),
+        glm::mat4 view = glm::lookAt(glm::vec3(campos[0],campos[1],campos[2]),
                         glm::vec3(focalpos[0],focalpos[1],focalpos[2]),
                                glm::vec3(viewup[0],viewup[1],viewup[2]));
         /**
@@ -2420,15 +5003,21 @@ private:
             视域的宽高比以及近平面和远平面距离为参数生成透视变换矩阵
         注意：窗口大小改变后应该使用当前交换链范围来重新计算宽高比
           */
-        ubo.proj = glm::perspective(glm::radians(45.0f),
+        const float fovY = glm::radians(45.0f);
+        glm::mat4 proj = glm::perspective(fovY,
                         swapChainExtent.width/(float)swapChainExtent.height,
                                     0.1f,10.0f);
+        if(textureStreaming()){
+            textureBudget.request(streamedTextureId,textureDemandLevel(view,fovY));
+        }
         /**
         GLM 库最初是为 OpenGL 设计的，它的裁剪坐标的 Y 轴和 Vulkan是相反的。
         我们可以通过将投影矩阵的 Y 轴缩放系数符号取反来使投影矩阵和 Vulkan 的要求一致。
         如果不这样做，渲染出来的图像会被倒置.
           */
-        ubo.proj[1][1] *= -1;
+        proj[1][1] *= -1;
+        //在CPU端预先相乘,顶点着色器中每个顶点只需要做一次矩阵乘法
+        ubo.viewProj = proj * view;
         //将最后的变换矩阵数据复制到当前帧对应的 uniform 缓冲中
         void* data ;
         vkMapMemory( device , uniformBuffersMemory[currentImage],0,
@@ -2437,190 +5026,210 @@ private:
         vkUnmapMemory( device , uniformBuffersMemory[currentImage]);
         /**
         对于在着色器中使用的需要频繁修改的数据，这样使用 UBO 并非最佳方式。
-        还有一种更加高效的传递少量数据到着色器的方法,之后说
+        每次绘制都会变化的模型矩阵使用推送常量传递,见recordCommandBuffer
           */
     }
     /**
-     * @brief createDescriptorPool
-     *描述符集不能被直接创建，需要通过描述符池来分配
+     * @brief createDescriptorAllocators
+     *描述符集不能被直接创建，需要通过描述符池来分配.
+     *池的管理交给DescriptorAllocator,不再按交换链图像个数固定池的大小
      */
-    //描述符池的创建
-    void createDescriptorPool(){
-        //添加一个用于组合图像采样器描述符的VkDescriptorPoolSize 结构体信息
-        std::array<VkDescriptorPoolSize,2> poolSizes = {};
-        //指定描述符池可以分配的描述符集
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount =
-                static_cast<uint32_t>(swapChainImages.size());
-
-        //添加图像采样器描述符
-        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount =
-                static_cast<uint32_t>(swapChainImages.size());
-
-        //指定描述符池的大小，我们会在每一帧分配一个描述符
-        VkDescriptorPoolCreateInfo poolInfo = {};
-        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        poolInfo.poolSizeCount =
-                static_cast<uint32_t>(poolSizes.size());//最大独立描述符个数外
-        poolInfo.pPoolSizes = poolSizes.data();
-        //指定可以分配的最大描述符集个数
-        poolInfo.maxSets =
-                static_cast<uint32_t>(swapChainImages.size());;
-
-        if(vkCreateDescriptorPool(device,&poolInfo,nullptr,
-                                  &descriptorPool) != VK_SUCCESS){
-            throw std::runtime_error("failed to create descriptor pool!");
+    void createDescriptorAllocators(){
+        TRACE_FUNCTION();
+        descriptorAllocator.init(device);
+        cacheDescriptorAllocator.init(device);
+        descriptorSetCache.init(device,&cacheDescriptorAllocator);
+    }
+    //获取交换链图像对应的描述符集,绑定的资源相同时直接返回缓存的描述符集
+    VkDescriptorSet getDescriptorSet(uint32_t imageIndex){
+        /**
+        在这里，我们将 uniform 缓冲绑定到索引 0,图像和采样器绑定到索引 1.
+        需要使用整个缓冲时，可以将range设置为 VK_WHOLE_SIZE
+          */
+        std::vector<DescriptorBinding> bindings = {
+            DescriptorBinding::buffer(0,VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                      uniformBuffers[imageIndex],0,
+                                      sizeof(UniformBufferObject))
+        };
+        //使用无绑定纹理时纹理在 set 1 中,这里只绑定uniform缓冲
+        if(!bindlessSupported){
+            bindings.push_back(DescriptorBinding::image(1,
+                                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                textureImageView,textureSampler,
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
         }
+        return descriptorSetCache.get(descriptorSetLayout,bindings);
     }
     //创建描述符集对象
     void createDescriptorSets(){
-        std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(),
-                                                   descriptorSetLayout);
-        //创建描述符集相关信息
-        VkDescriptorSetAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        //指定分配描述符集对象的描述符池
-        allocInfo.descriptorPool = descriptorPool;
-        //分配的描述符集数量
-        allocInfo.descriptorSetCount =
-                static_cast<uint32_t>(swapChainImages.size());
-        //使用的描述符布局
-        allocInfo.pSetLayouts = layouts.data();
-
-        /**
-        在这里，我们为每一个交换链图像使用相同的描述符布局创建对应的描述符集。
-        但由于描述符布局对象个数要匹配描述符集对象个数，所以，
-        我们还是需要使用多个相同的描述符布局对象。
-          */
-        descriptorSets.resize(swapChainImages.size());
-        //分配地描述符集对象，每一个都带有一个 uniform 缓冲描述符
-        if(vkAllocateDescriptorSets( device , &allocInfo,
-                                     descriptorSets.data()) != VK_SUCCESS){
-            throw std::runtime_error("failed to allocate descriptor sets!");
-        }
-        //配置描述符集对象
+        TRACE_FUNCTION();
+        /**
+        为每一个交换链图像预先创建描述符集并写入缓存,
+        主循环中记录指令时只需要查找缓存，不会调用 vkUpdateDescriptorSets
+          */
         for(size_t i =0;i<swapChainImages.size();i++){
-            //配置描述符引用的缓冲对象
-            VkDescriptorBufferInfo bufferInfo = {};
-            //以指定缓冲对象
-            bufferInfo.buffer = uniformBuffers[i];
-            bufferInfo.offset = 0;
-            //可以访问的数据范围,
-            //需要使用整个缓冲，可以将range成员变量的值设置为 VK_WHOLE_SIZE
-            bufferInfo.range = sizeof(UniformBufferObject);
-
-            //绑定图像和采样器到描述符集中的描述符
-            VkDescriptorImageInfo imageInfo = {};
-            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageInfo.imageView =  textureImageView;
-            imageInfo.sampler = textureSampler;
-            std::array<VkWriteDescriptorSet , 2> descriptorWrites = {};
-
-            //更新描述符的配置
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            //指定要更新的描述符集对象
-            descriptorWrites[0].dstSet = descriptorSets[i];
-            /**
-            在这里，我们将 uniform 缓冲绑定到索引 0。需要注意描述符可以是数组，
-            所以我们还需要指定数组的第一个元素的索引，在这里，我们
-            没有使用数组作为描述符，将索引指定为 0 即可
-              */
-            //缓冲绑定
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].dstArrayElement = 0;
-            //指定描述符的类型
-            descriptorWrites[0].descriptorType =
-                    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].descriptorCount = 1;//指定描述符的数量
-            //指定描述符引用的缓冲数据
-            descriptorWrites[0].pBufferInfo = &bufferInfo;
-            //指定描述符引用的图像数据
-            descriptorWrites[0].pImageInfo = nullptr;
-            //指定描述符引用的缓冲视图
-            descriptorWrites[0].pTexelBufferView = nullptr;
-
-            //更新图像和采样器到描述符配置
-            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[1].dstSet = descriptorSets[i];
-            descriptorWrites[1].dstBinding = 1;
-            descriptorWrites[1].dstArrayElement = 0;
-            descriptorWrites[1].descriptorType =
-                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptorWrites[1].descriptorCount = 1;//指定描述符的数量
-            descriptorWrites[1].pImageInfo = &imageInfo;
-            /**
-             * @brief vkUpdateDescriptorSets
-             * 函数可以接受两个数组作为参数：
-             * VkWriteDescriptorSet 结构体数组和 VkCopyDescriptorSet 结构体数组。
-             * 后者被用来复制描述符对象
-             */
-            vkUpdateDescriptorSets(device,
-                    static_cast<uint32_t>(descriptorWrites.size()),
-                                   descriptorWrites.data(),0,nullptr);
-            //更新描述符需要使用图像资源信息。至此，我们就可以在着色器中使用描述符了
+            getDescriptorSet(static_cast<uint32_t>(i));
         }
     }
+    //从缓冲复制纹理的所有细化级别到图像,每一级对应一个复制区域
     void copyBufferToImage(VkBuffer buffer , VkImage image ,
-                             uint32_t width , uint32_t height ){
+                           const std::vector<TextureLevel>& levels){
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-        //指定将数据复制到图像的哪一部分
-        VkBufferImageCopy region = {};
-        //指定要复制的数据在缓冲中的偏移位置
-        region.bufferOffset = 0;
-        /**
-        bufferRowLength 和 bufferImageHeight 成员变量用于指定数据在内存中的存放方式.
-        通过这两个成员变量我们可以对每行图像数据使用额外的空间进行对齐。
-        将这两个成员变量的值都设置为 0，数据将会在内存中被紧凑存放
-          */
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        //imageSubresource、imageOffset 和 imageExtent 成员变量用于指定
-        //数据被复制到图像的哪一部分
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-
-        region.imageOffset = {0,0,0};
-        region.imageExtent = {width,height,1};
+        uint32_t scope = gpuProfiler.beginScope(commandBuffer,"upload");
+        std::vector<VkBufferImageCopy> regions(levels.size());
+        for(size_t i = 0;i < levels.size();i++){
+            //指定将数据复制到图像的哪一部分
+            VkBufferImageCopy& region = regions[i];
+            //指定要复制的数据在缓冲中的偏移位置
+            region.bufferOffset = levels[i].offset;
+            /**
+            bufferRowLength 和 bufferImageHeight 成员变量用于指定数据在内存中的存放方式.
+            通过这两个成员变量我们可以对每行图像数据使用额外的空间进行对齐。
+            将这两个成员变量的值都设置为 0，数据将会在内存中被紧凑存放
+              */
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            //imageSubresource、imageOffset 和 imageExtent 成员变量用于指定
+            //数据被复制到图像的哪一部分
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+
+            region.imageOffset = {0,0,0};
+            region.imageExtent = {levels[i].width,levels[i].height,1};
+        }
         /**
         vkCmdCopyBufferToImage 函数的第 4 个参数用于指定目的图像当前使用的图像布局。
         这里我们假设图像已经被变换为最适合作为复制目的的布局。
-        我们只复制了一张图像，实际上是可以指定一个 VkBufferImageCopy 数组来一次从
-        一个缓冲复制数据到多个不同的图像对象
+        通过一个 VkBufferImageCopy 数组,一次调用就可以从一个缓冲
+        复制所有细化级别的数据
           */
         //从缓冲复制数据到图像
         vkCmdCopyBufferToImage(commandBuffer,buffer,image,
-                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,1,&region);
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(regions.size()),
+                               regions.data());
+        gpuProfiler.endScope(commandBuffer,scope);
 
         endSingleTimeCommands( commandBuffer );
     }
 
-    //加载图像数据到一个Vulkan 图像对象,用指令缓冲来完成加载
-    void createTextureImage(){
-        int texWidth , texHeight , texChannels ;
+    //检查格式在优化 tiling 模式下是否支持线性过滤的 blit 操作
+    bool supportsLinearBlit(VkFormat format){
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice,
+                                            format, &formatProperties);
+        //块压缩格式不能作为 blit 的目标,不能在 GPU 上生成细化链
+        const VkFormatFeatureFlags required =
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+                VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                VK_FORMAT_FEATURE_BLIT_DST_BIT;
+        return (formatProperties.optimalTilingFeatures & required) == required;
+    }
+    /**
+    检查能否用计算着色器生成细化链:着色器以存储图像读写各级,
+    不需要线性过滤和 blit 特性,但要有这种格式的着色器(MIPGEN_VARIANTS),
+    格式要支持存储图像,图形队列要支持计算
+      */
+    bool supportsComputeMipmaps(VkFormat format){
+        if(mipgenVariantIndex(format) < 0){
+            return false;
+        }
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice,
+                                            format, &formatProperties);
+        if(!(formatProperties.optimalTilingFeatures &
+             VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)){
+            return false;
+        }
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                                 &queueFamilyCount,nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                    &queueFamilyCount,queueFamilies.data());
+        return (queueFamilies[indices.graphicsFamily].queueFlags &
+                VK_QUEUE_COMPUTE_BIT) != 0;
+    }
+    //按 --mipgen 选择是否用计算着色器生成细化链,auto 只在格式不支持线性 blit 时使用
+    bool useComputeMipmaps(VkFormat format){
+        if(config.mipgen == MipGenMode::Blit || !supportsComputeMipmaps(format)){
+            return false;
+        }
+        return config.mipgen != MipGenMode::Auto || !supportsLinearBlit(format);
+    }
+    //能否在 GPU 上生成细化链,不能时由 CPU 生成
+    bool supportsGpuMipmaps(VkFormat format){
+        return useComputeMipmaps(format) || supportsLinearBlit(format);
+    }
+    //检查格式在优化 tiling 模式下是否可以作为纹理线性过滤采样
+    bool supportsSampledFormat(VkFormat format){
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice,
+                                            format, &formatProperties);
+        const VkFormatFeatureFlags required =
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (formatProperties.optimalTilingFeatures & required) == required;
+    }
+    /**
+    读取纹理数据.
+    优先使用离线烘焙的 KTX2 文件,它已经包含完整的细化链,不需要解码 JPEG.
+    块压缩格式的显存占用和采样带宽是 RGBA8 的 1/4 到 1/8,
+    所以按优先级选择第一个设备支持其格式的压缩纹理.
+    没有 KTX2 文件时解码原始图像,不能在 GPU 上生成细化链时在 CPU 上生成
+      */
+    TextureData loadTextureData(){
+        TRACE_FUNCTION();
+        for(const std::string& path : COMPRESSED_TEXTURE_PATHS){
+            //资源包中的纹理只解压文件头来判断格式,选中后再并行解压整个文件
+            const AssetArchive::Entry* entry = archivedAsset(path);
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            if(entry != nullptr){
+                unsigned char header[16];
+                format = peekKtx2Format(header,archive.readPrefix(
+                                            *entry,header,sizeof(header)));
+            }else{
+                format = peekKtx2Format(path);
+            }
+            if(format == VK_FORMAT_UNDEFINED || !supportsSampledFormat(format)){
+                continue;
+            }
+            TextureData texture = entry != nullptr ?
+                        loadKtx2Texture(archive.read(*entry,archiveJobs()),entry->name) :
+                        loadKtx2Texture(path);
+            std::cout<<"texture: "<<path<<", vkFormat "<<texture.format
+                     <<", "<<texture.levels.size()<<" mip levels"<<std::endl;
+            return texture;
+        }
         /**
-        以图像文件路径和需要加载的颜色通道作为参数来加载图像文件
-        使用 STBI_rgb_alpha 通道参数可以强制载入 alpha 通道，
+        stbi_load 使用 STBI_rgb_alpha 通道参数可以强制载入 alpha 通道，
         即使图像数据不包含这一通道，也会被添加上一个默认的alpha值作为alpha
-        通道的图像数据，这为我们的处理带来了方便。
-        stbi_load 函数还可以返回图像的宽度，高度和图像数据实际存在的颜色通
-        道。stbi_load 函数的返回值是一个指向解析后的图像像素数据的指针。使
-        用 STBI_rgba_alpha 作为通道参数，每个像素需要 4 个字节存储，所有
-        像素按照行的方式依次存储.
-          */
-        stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(),
-                                   &texWidth,&texHeight,&texChannels,
-                                   STBI_rgb_alpha);
-        //图像需要的总字节数
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-        if(!pixels){
-            throw std::runtime_error("failed to load texture image!");
+        通道的图像数据，每个像素需要 4 个字节存储，所有像素按照行的方式依次存储.
+          */
+        //流式加载时每一级都要从内存上传,总是在 CPU 上生成细化链
+        bool buildMips = textureStreaming() ||
+                !supportsGpuMipmaps(VK_FORMAT_R8G8B8A8_UNORM);
+        const AssetArchive::Entry* entry = archivedAsset(TEXTURE_PATH);
+        if(entry != nullptr){
+            std::vector<unsigned char> encoded = archive.read(*entry,archiveJobs());
+            return decodeTexture(encoded.data(),encoded.size(),buildMips);
         }
+        return decodeTexture(TEXTURE_PATH,buildMips);
+    }
+    //把纹理数据上传到纹理图像,只有第 0 级数据时使用 GPU 生成细化链
+    void uploadTexture(const TextureData& texture){
+        textureFormat = texture.format;
+        bool generateOnGpu = texture.levels.size() == 1 &&
+                supportsGpuMipmaps(textureFormat);
         //计算细化级别个数
-        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(
-                                          texWidth,texHeight))))+1;
+        mipLevels = generateOnGpu ?
+                    fullMipCount(texture.width,texture.height) :
+                    static_cast<uint32_t>(texture.levels.size());
+        //所有细化级别的数据一次复制到暂存缓冲
+        VkDeviceSize imageSize = texture.byteCount();
 
         //同创建顶点缓冲步骤相同
         //使用 CPU 可见的缓冲作为临时缓冲,才能映射内存
@@ -2635,23 +5244,20 @@ private:
         void* data;
         //vkMapMemory将缓冲关联的内存映射到 CPU 可以访问的内存
         vkMapMemory(device,stagingBufferMemory,0,imageSize,0,&data);
-        //将顶点数据复制到映射后的内存
-        memcpy(data,pixels,static_cast<size_t>(imageSize));
+        memcpy(data,texture.bytes(),static_cast<size_t>(imageSize));
         //结束内存映射
         vkUnmapMemory(device,stagingBufferMemory);
 
-        //清除图像像素数据
-        stbi_image_free( pixels) ;
-
-        /*createImage(texWidth,texHeight,mipLevels,VK_FORMAT_R8G8B8A8_UNORM,
-                    VK_IMAGE_TILING_OPTIMAL,
-                    VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_SAMPLED_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    textureImage,textureImageMemory);--old*/
-        createImage(texWidth,texHeight,mipLevels,VK_FORMAT_R8G8B8A8_UNORM,
-                    VK_IMAGE_TILING_OPTIMAL,
-                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT|
-                    VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_SAMPLED_BIT,
+        //使用 vkCmdBlitImage 生成细化链时图像需要作为传输源,
+        //使用计算着色器时各级作为存储图像读写
+        VkImageUsageFlags usage =
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_SAMPLED_BIT;
+        if(generateOnGpu){
+            usage |= useComputeMipmaps(textureFormat) ?
+                        VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+        createImage(texture.width,texture.height,mipLevels,textureFormat,
+                    VK_IMAGE_TILING_OPTIMAL,usage,
                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                     textureImage,textureImageMemory);
         /**
@@ -2663,38 +5269,32 @@ private:
         所以转换图像布局时应该将 VK_IMAGE_LAYOUT_UNDEFINED指定为旧布局。
         需要注意的是我们之所以这样设置是因为我们不需要读取复制操作之前的图像内容。
           */
-        transitionImageLayout(textureImage,VK_FORMAT_R8G8B8A8_UNORM,
+        transitionImageLayout(textureImage,textureFormat,
             VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                               mipLevels);
 
-        copyBufferToImage(stagingBuffer, textureImage,
-                          static_cast<uint32_t>(texWidth),
-                          static_cast<uint32_t>(texHeight));
-
-        //为了能够在着色器中采样纹理图像数据,我们还需要进行一次图像布局变换
-        /*transitionImageLayout(textureImage,VK_FORMAT_R8G8B8A8_UNORM,
-                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                              mipLevels);*/
-        /**
-          注意：如果在开启校验层的情况下运行程序，会发现校验层报告
-        transitionImageLayout 中使用的访问掩码和管线阶段是无效的。
-        我们需要根据布局变换设置 transitionImageLayout。我们需要处理两种变换：
-        1. 未定义 -> 传输目的：传输操作的数据写入不需要等待
-        2. 传输目的 -> 着色器读取：着色器读取图像数据需要等待传输操作的写入结束。
-          */
+        copyBufferToImage(stagingBuffer, textureImage, texture.levels);
 
-        //清除我们使用的缓冲对象和它关联的内存对象
-        vkDestroyBuffer(device , stagingBuffer , nullptr ) ;
-        vkFreeMemory(device , stagingBufferMemory , nullptr ) ;
-        generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-                        texWidth, texHeight, mipLevels);
+        //复制指令执行完毕后再清除我们使用的缓冲对象和它关联的内存对象
+        deferDestroyBuffer(stagingBuffer,stagingBufferMemory);
+        if(generateOnGpu){
+            //生成细化链的同时把每一级变换到着色器读取布局
+            generateMipmaps(textureImage, textureFormat,
+                            texture.width, texture.height, mipLevels);
+        }else{
+            //为了能够在着色器中采样纹理图像数据,我们还需要进行一次图像布局变换
+            transitionImageLayout(textureImage,textureFormat,
+                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                  mipLevels);
+        }
     }
     //创建图像
     void createImage(uint32_t width , uint32_t height ,uint32_t mipLevels,
                      VkFormat format ,VkImageTiling tiling ,
                      VkImageUsageFlags usage,VkMemoryPropertyFlags properties,
-                     VkImage& image ,VkDeviceMemory& imageMemory){
+                     VkImage& image ,VkDeviceMemory& imageMemory,
+                     VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT){
 
         VkImageCreateInfo imageInfo = {};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -2750,11 +5350,11 @@ private:
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         /**
         samples 成员变量用于设置多重采样。这一设置只对用作附着的图像对
-        象有效，我们的图像不用于附着，将其设置为采样 1 次。有许多用于稀疏
+        象有效，纹理等不用于附着的图像采样 1 次。有许多用于稀疏
         图像的优化标记可以使用。稀疏图像是一种离散存储图像数据的方法。比
         如，我们可以使用稀疏图像来存储体素地形，避免为“空气”部分分配内存.
           */
-        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.samples = samples;
         //没有使用 flags 标记,所以设为0
         imageInfo.flags = 0;
         //创建图像对象
@@ -2769,6 +5369,11 @@ private:
         VkMemoryAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;//内存大小
+        //桌面 GPU 通常没有惰性分配的内存类型,这时使用普通的内存
+        if((properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) &&
+                !hasMemoryType(memRequirements.memoryTypeBits,properties)){
+            properties &= ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        }
         allocInfo.memoryTypeIndex = findMemoryType(
                     memRequirements.memoryTypeBits,properties);
         //分配内存
@@ -2816,6 +5421,20 @@ private:
     }
     //结束记录传输指令到指令缓冲
     void endSingleTimeCommands(VkCommandBuffer commandBuffer){
+        /**
+        不再等待传输操作完成,之后提交的指令可能马上读取传输的数据.
+        管线屏障的第二个同步范围包括同一队列上之后提交的所有指令,
+        所以在结尾插入一个内存屏障,让传输写入的数据对之后的所有读写可见
+          */
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask =
+                VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,0,
+                             1,&barrier,0,nullptr,0,nullptr);
         //结束指令缓冲的记录操作，提交指令缓冲完成传输操作的执行
         vkEndCommandBuffer( commandBuffer ) ;
         VkSubmitInfo submitInfo = {};
@@ -2828,11 +5447,12 @@ private:
          有两种等待内存传输操作完成的方法：
          1.一种是使用栅栏 (fence)，通过 vkWaitForFences函数等待。
          2.通过 vkQueueWaitIdle 函数等待。
-         使用栅栏 (fence) 可以同步多个不同的内存传输操作，给驱动程序的优化空间也更大
+         这里两种都不使用:之后绘制帧时的栅栏发出信号,说明这里提交的指令也已经执行完毕,
+         指令缓冲和暂存缓冲交给 deletionQueue 在那时再清除
           */
-        vkQueueWaitIdle( graphicsQueue ) ;//等待传输操作完成
-        //清除我们使用的指令缓冲对象
-        vkFreeCommandBuffers( device ,commandPool ,1 ,&commandBuffer);
+        deferDestroy([this,commandBuffer](){
+            vkFreeCommandBuffers(device,commandPool,1,&commandBuffer);
+        });
     }
     /**
     如果我们使用的是缓冲对象而不是图像对象，那么就可以记录传输指
@@ -2970,13 +5590,15 @@ private:
     }
     //创建纹理图像的图像视图对象
     void createTextureImageView(){
+        TRACE_FUNCTION();
         textureImageView = createImageView(textureImage,
-                                           VK_FORMAT_R8G8B8A8_UNORM,
+                                           textureFormat,
                                            VK_IMAGE_ASPECT_COLOR_BIT,mipLevels);
     }
     //创建图像视图对象
     VkImageView createImageView(VkImage image , VkFormat format,
-                           VkImageAspectFlags aspectFlags,uint32_t mipLevels){
+                           VkImageAspectFlags aspectFlags,uint32_t mipLevels,
+                           uint32_t baseMipLevel = 0){
         //设置图像视图结构体相关信息
         VkImageViewCreateInfo viewInfo = {};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -2997,7 +5619,7 @@ private:
         //subresourceRange用于指定图像的用途和图像的哪一部分可以被访问
         //在这里，我们的图像被用作渲染目标，并且没有细分级别，只存在一个图层
         viewInfo.subresourceRange.aspectMask = aspectFlags;
-        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
         viewInfo.subresourceRange.levelCount = mipLevels;
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
@@ -3016,6 +5638,7 @@ private:
     }
     //创建采样器对象
     void createTextureSampler(){
+        TRACE_FUNCTION();
         //我们会在着色器中使用创建的采样器对象采样纹理数据
         VkSamplerCreateInfo samplerInfo = {};
         samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -3054,7 +5677,8 @@ private:
         没有图形硬件能够使用超过 16 个样本，同时即使可以使用超过 16 个样本，
         采样效果的增强也开始变得微乎其微。
           */
-        samplerInfo.anisotropyEnable = VK_TRUE;
+        samplerInfo.anisotropyEnable = samplerAnisotropyEnabled ?
+                    VK_TRUE : VK_FALSE;
         samplerInfo.maxAnisotropy = 16;
         /**
         borderColor 成员变量用于指定使用 VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
@@ -3085,6 +5709,11 @@ private:
         samplerInfo.mipLodBias = 0.0f;
         samplerInfo.minLod = static_cast<float>(mipLevels/2);
         samplerInfo.maxLod = static_cast<float>(mipLevels);
+        if(textureStreaming()){
+            //图像视图只包含驻留的级别,级别相对于驻留的最大一级,不能限制最精细的一级
+            samplerInfo.minLod = 0.0f;
+            samplerInfo.maxLod = static_cast<float>(streamedTexture.levels.size());
+        }
         /**
         需要注意，采样器对象并不引用特定的 VkImage 对象，它是一个用于
         访问纹理数据的接口。我们可以使用它来访问任意不同的图像，不管图像
@@ -3096,19 +5725,403 @@ private:
             throw std::runtime_error("failed to create texture sampler!");
         }
     }
+    /**
+    选择多重采样的采样数:不超过 --msaa 指定的值,
+    并且颜色和深度附着都支持(framebufferColorSampleCounts & framebufferDepthSampleCounts)
+      */
+    void chooseMsaaSamples(){
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice,&properties);
+        VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts &
+                properties.limits.framebufferDepthSampleCounts;
+        msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+        for(uint32_t samples = config.msaaSamples;samples > 1;samples /= 2){
+            if(counts & samples){
+                msaaSamples = static_cast<VkSampleCountFlagBits>(samples);
+                break;
+            }
+        }
+        if(msaaSamples != config.msaaSamples){
+            std::cout<<"msaa "<<config.msaaSamples<<"x not supported, using "
+                     <<msaaSamples<<"x"<<std::endl;
+        }
+    }
+    /**
+    创建多重采样的颜色图像,只在渲染流程中使用,结束时解析到交换链图像.
+    支持时使用惰性分配的内存,分块渲染的 GPU 上多重采样的数据只存在于片上内存
+      */
+    void createColorResources(){
+        if(msaaSamples == VK_SAMPLE_COUNT_1_BIT){
+            msaaColorImage = VK_NULL_HANDLE;
+            msaaColorImageMemory = VK_NULL_HANDLE;
+            msaaColorImageView = VK_NULL_HANDLE;
+            return;
+        }
+        TRACE_FUNCTION();
+        createImage(swapChainExtent.width,swapChainExtent.height,1,
+                    swapChainImageFormat,VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                    msaaColorImage,msaaColorImageMemory,msaaSamples);
+        msaaColorImageView = createImageView(msaaColorImage,swapChainImageFormat,
+                                             VK_IMAGE_ASPECT_COLOR_BIT,1);
+        //只在启动时输出一次,重建交换链时不再输出
+        if(frameNumber == 0){
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device,msaaColorImage,&memRequirements);
+            bool lazy = hasMemoryType(memRequirements.memoryTypeBits,
+                                      VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+            std::cout<<"msaa "<<msaaSamples<<"x, transient attachments in "
+                     <<(lazy ? "lazily allocated" : "device local")<<" memory"
+                     <<std::endl;
+        }
+    }
+    /**
+    按 --dynamic-res 决定是否使用动态分辨率.
+    缩放比例由 GPU 时间戳控制,队列不支持时间戳时不使用;
+    内部图像和交换链图像格式相同,需要支持作为颜色附着和线性过滤采样
+      */
+    void chooseDynamicResolution(){
+        dynamicResEnabled = false;
+        if(config.dynamicResTargetUs == 0){
+            return;
+        }
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                                 &queueFamilyCount,nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                    &queueFamilyCount,queueFamilies.data());
+        if(queueFamilies[indices.graphicsFamily].timestampValidBits == 0){
+            std::cout<<"timestamp queries not supported, dynamic resolution disabled"
+                     <<std::endl;
+            return;
+        }
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice,
+                                            swapChainImageFormat,&formatProperties);
+        VkFormatFeatureFlags features = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if((formatProperties.optimalTilingFeatures & features) != features){
+            std::cout<<"swap chain format can not be sampled linearly, "
+                       "dynamic resolution disabled"<<std::endl;
+            return;
+        }
+        dynamicResEnabled = true;
+        dynamicResolution.init(config.dynamicResTargetUs / 1000.0,
+                               config.resScaleMinPercent / 100.0);
+        std::cout<<"dynamic resolution: target gpu time "
+                 <<config.dynamicResTargetUs / 1000.0<<" ms, minimum scale "
+                 <<config.resScaleMinPercent<<"%"<<std::endl;
+    }
+    /**
+    创建动态分辨率的内部渲染目标,按交换链图像的大小(最大的渲染区域)分配,
+    每一帧只使用左上角的一部分,所以缩放比例改变时不需要重新创建.
+    放大流程采样它的描述符集从这个图像自己的描述符池分配,重建交换链时一起延迟销毁,
+    不会更新仍被之前的帧使用的描述符集
+      */
+    void createSceneResources(){
+        if(!dynamicResEnabled){
+            return;
+        }
+        TRACE_FUNCTION();
+        createImage(swapChainExtent.width,swapChainExtent.height,1,
+                    swapChainImageFormat,VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    sceneImage,sceneImageMemory);
+        sceneImageView = createImageView(sceneImage,swapChainImageFormat,
+                                         VK_IMAGE_ASPECT_COLOR_BIT,1);
+
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = 1;
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if(vkCreateDescriptorPool(device,&poolInfo,nullptr,
+                                  &upscaleDescriptorPool) != VK_SUCCESS){
+            throw std::runtime_error("failed to create upscale descriptor pool!");
+        }
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = upscaleDescriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &upscaleSetLayout;
+        if(vkAllocateDescriptorSets(device,&allocInfo,
+                                    &upscaleDescriptorSet) != VK_SUCCESS){
+            throw std::runtime_error("failed to allocate upscale descriptor set!");
+        }
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = sceneImageView;
+        imageInfo.sampler = sceneSampler;
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = upscaleDescriptorSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(device,1,&write,0,nullptr);
+    }
+    /**
+    创建放大流程和它的管线(shader_upscale.vert/frag).
+    放大流程只有交换链图像一个附着,全屏三角形覆盖所有像素,所以不需要加载和清除;
+    之后的布局和原来的渲染流程一样,读回帧时等待写入完成后再复制.
+    采样器,描述符布局和管线布局与交换链图像格式无关,只在第一次调用时创建
+      */
+    void createUpscalePipeline(){
+        TRACE_FUNCTION();
+        if(upscaleSetLayout == VK_NULL_HANDLE){
+            VkSamplerCreateInfo samplerInfo = {};
+            samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerInfo.magFilter = VK_FILTER_LINEAR;
+            samplerInfo.minFilter = VK_FILTER_LINEAR;
+            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+            if(vkCreateSampler(device,&samplerInfo,nullptr,
+                               &sceneSampler) != VK_SUCCESS){
+                throw std::runtime_error("failed to create upscale sampler!");
+            }
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.binding = 0;
+            binding.descriptorCount = 1;
+            binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = 1;
+            layoutInfo.pBindings = &binding;
+            if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,
+                                           &upscaleSetLayout) != VK_SUCCESS){
+                throw std::runtime_error(
+                            "failed to create upscale descriptor set layout!");
+            }
+            //推送常量为渲染区域占内部图像的比例和最后一个纹素中心的纹理坐标
+            VkPushConstantRange pushConstantRange = {};
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = 4 * sizeof(float);
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &upscaleSetLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+            if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,
+                                      &upscalePipelineLayout) != VK_SUCCESS){
+                throw std::runtime_error("failed to create upscale pipeline layout!");
+            }
+        }
+
+        VkAttachmentDescription colorAttachment = {};
+        colorAttachment.format = swapChainImageFormat;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = presentLayout();
+        VkAttachmentReference colorAttachmentRef = {};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        //和场景的渲染流程一样,等交换链结束对图像的读取后再写入;读回时写入完成后再复制
+        std::array<VkSubpassDependency,2> dependencies = {};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = readbackEnabled() ? 2 : 1;
+        renderPassInfo.pDependencies = dependencies.data();
+        if(vkCreateRenderPass(device,&renderPassInfo,nullptr,
+                              &upscaleRenderPass) != VK_SUCCESS){
+            throw std::runtime_error("failed to create upscale render pass!");
+        }
+
+        VkShaderModule vertShaderModule = loadShaderModule(
+                    "E:/workspace/Qt5.6/VulkanLearn/shaders/vert_upscale.spv");
+        VkShaderModule fragShaderModule = loadShaderModule(
+                    "E:/workspace/Qt5.6/VulkanLearn/shaders/frag_upscale.spv");
+        VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[0].module = vertShaderModule;
+        shaderStages[0].pName = "main";
+        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        shaderStages[1].module = fragShaderModule;
+        shaderStages[1].pName = "main";
+        //顶点由 gl_VertexIndex 生成,没有顶点输入
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+        vertexInputInfo.sType =
+                VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        inputAssembly.sType =
+                VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        //视口和裁剪矩形在记录指令时设置为整个交换链图像
+        VkPipelineViewportStateCreateInfo viewportState = {};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+        VkPipelineRasterizationStateCreateInfo rasterizer = {};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = VK_CULL_MODE_NONE;
+        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        VkPipelineMultisampleStateCreateInfo multisampling = {};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+                VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+                VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+        VkPipelineColorBlendStateCreateInfo colorBlending = {};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+        VkDynamicState dynamicStates[] = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR
+        };
+        VkPipelineDynamicStateCreateInfo dynamicState = {};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = upscalePipelineLayout;
+        pipelineInfo.renderPass = upscaleRenderPass;
+        pipelineInfo.subpass = 0;
+        VkResult result = vkCreateGraphicsPipelines(device,VK_NULL_HANDLE,1,
+                                                    &pipelineInfo,nullptr,
+                                                    &upscalePipeline);
+        vkDestroyShaderModule(device,fragShaderModule,nullptr);
+        vkDestroyShaderModule(device,vertShaderModule,nullptr);
+        if(result != VK_SUCCESS){
+            throw std::runtime_error("failed to create upscale pipeline!");
+        }
+    }
+    void destroyUpscalePipeline(){
+        vkDestroyPipeline(device,upscalePipeline,nullptr);
+        vkDestroyRenderPass(device,upscaleRenderPass,nullptr);
+        vkDestroyPipelineLayout(device,upscalePipelineLayout,nullptr);
+        vkDestroyDescriptorSetLayout(device,upscaleSetLayout,nullptr);
+        vkDestroySampler(device,sceneSampler,nullptr);
+    }
+    //放大流程的帧缓冲,每个交换链图像一个
+    void createUpscaleFramebuffers(){
+        upscaleFramebuffers.resize(swapChainImageViews.size());
+        for(size_t i = 0;i < swapChainImageViews.size();i++){
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = upscaleRenderPass;
+            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.pAttachments = &swapChainImageViews[i];
+            framebufferInfo.width = swapChainExtent.width;
+            framebufferInfo.height = swapChainExtent.height;
+            framebufferInfo.layers = 1;
+            if(vkCreateFramebuffer(device,&framebufferInfo,nullptr,
+                                   &upscaleFramebuffers[i]) != VK_SUCCESS){
+                throw std::runtime_error("failed to create upscale framebuffer!");
+            }
+        }
+    }
+    /**
+    把内部图像左上角 renderExtent 的区域双线性放大到整个交换链图像.
+    纹理坐标限制在最后一个纹素的中心以内,过滤时不会混入区域外之前的帧留下的内容
+      */
+    void recordUpscale(VkCommandBuffer commandBuffer,uint32_t imageIndex){
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = upscaleRenderPass;
+        renderPassInfo.framebuffer = upscaleFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = {0,0};
+        renderPassInfo.renderArea.extent = swapChainExtent;
+        vkCmdBeginRenderPass(commandBuffer,&renderPassInfo,
+                             VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          upscalePipeline);
+        VkViewport viewport = {};
+        viewport.width = (float)swapChainExtent.width;
+        viewport.height = (float)swapChainExtent.height;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer,0,1,&viewport);
+        VkRect2D scissor = {};
+        scissor.extent = swapChainExtent;
+        vkCmdSetScissor(commandBuffer,0,1,&scissor);
+        vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                upscalePipelineLayout,0,1,&upscaleDescriptorSet,
+                                0,nullptr);
+        float width = static_cast<float>(swapChainExtent.width);
+        float height = static_cast<float>(swapChainExtent.height);
+        float constants[4] = {
+            renderExtent.width / width,renderExtent.height / height,
+            (renderExtent.width - 0.5f) / width,(renderExtent.height - 0.5f) / height
+        };
+        vkCmdPushConstants(commandBuffer,upscalePipelineLayout,
+                           VK_SHADER_STAGE_FRAGMENT_BIT,0,sizeof(constants),constants);
+        vkCmdDraw(commandBuffer,3,1,0,0);
+        vkCmdEndRenderPass(commandBuffer);
+    }
     //配置深度图像需要的资源
     void createDepthResources(){
+        TRACE_FUNCTION();
         //找一个可用的深度图像数据格式
         VkFormat depthFormat = findDepthFormat();
         /**
          * 我们已经具有足够的信息来创建深度图像对象，
          * 可以开始调用createImage 和 createImageView 函数来创建图像资源：
          */
+        //深度数据在渲染流程之外不被使用(STORE_OP_DONT_CARE),作为临时附着创建
         createImage(swapChainExtent.width, swapChainExtent.height ,1,
                     depthFormat , VK_IMAGE_TILING_OPTIMAL,
-                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage ,
-                    depthImageMemory);
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, depthImage ,
+                    depthImageMemory, msaaSamples);
         depthImageView = createImageView(depthImage , depthFormat,
                                          VK_IMAGE_ASPECT_DEPTH_BIT,1) ;
         /**
@@ -3174,6 +6187,7 @@ private:
     }
     //载入模型文件,填充模型数据到 vertices 和 indices
     void loadModel(){
+        TRACE_FUNCTION();
         /**
         一个 OBJ 模型文件包含了模型的位置、法线、纹理坐标和表面数据。
         表面数据包含了构成表面的多个顶点数据的索引。
@@ -3194,8 +6208,22 @@ private:
         std::vector<tinyobj::material_t> materials;
         std::string warn;
         std::string err;
-        if(!tinyobj::LoadObj(&attrib,&shapes,&materials,&err,&warn,
-                             MODEL_PATH.c_str())){
+        const AssetArchive::Entry* entry = archivedAsset(MODEL_PATH);
+        if(entry != nullptr){
+            //从资源包解压的内容直接作为输入流,不再复制一次
+            struct MemoryBuffer : std::streambuf{
+                MemoryBuffer(char* data,size_t size){
+                    setg(data,data,data + size);
+                }
+            };
+            std::vector<unsigned char> text = archive.read(*entry,archiveJobs());
+            MemoryBuffer buffer(reinterpret_cast<char*>(text.data()),text.size());
+            std::istream stream(&buffer);
+            if(!tinyobj::LoadObj(&attrib,&shapes,&materials,&err,&warn,&stream)){
+                throw std::runtime_error(warn+err);
+            }
+        }else if(!tinyobj::LoadObj(&attrib,&shapes,&materials,&err,&warn,
+                                   MODEL_PATH.c_str())){
             throw std::runtime_error(warn+err);
         }
         /**
@@ -3249,9 +6277,29 @@ private:
             }
         }
     }
-    //生成原始纹理图像不同细化级别
+    /**
+    生成原始纹理图像不同细化级别.
+    调用时所有级别处于传输目的布局,第 0 级已经写入;完成后所有级别处于着色器读取布局
+      */
     void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth,
                          int32_t texHeight, uint32_t mipLevels){
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        uint32_t scope = gpuProfiler.beginScope(commandBuffer,"mipmaps");
+        if(useComputeMipmaps(imageFormat)){
+            recordComputeMipmaps(commandBuffer,image,imageFormat,
+                                 static_cast<uint32_t>(texWidth),
+                                 static_cast<uint32_t>(texHeight),mipLevels);
+        }else{
+            recordBlitMipmaps(commandBuffer,image,imageFormat,
+                              texWidth,texHeight,mipLevels);
+        }
+        gpuProfiler.endScope(commandBuffer,scope);
+        endSingleTimeCommands( commandBuffer );
+    }
+    //记录逐级使用 vkCmdBlitImage 生成细化链的指令,每一级一次 blit 和两个屏障
+    void recordBlitMipmaps(VkCommandBuffer commandBuffer, VkImage image,
+                           VkFormat imageFormat, int32_t texWidth,
+                           int32_t texHeight, uint32_t mipLevels){
         VkFormatProperties formatProperties;
         //查询指定的纹理图像格式的属性
         vkGetPhysicalDeviceFormatProperties(physicalDevice,
@@ -3269,7 +6317,6 @@ private:
             throw std::runtime_error(
                     "texture image format does not support linear blitting!");
         }
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
         //对多次图像布局变换进行同步
         VkImageMemoryBarrier barrier = {};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -3368,14 +6415,542 @@ private:
             0, nullptr,
             0, nullptr,
             1, &barrier);
+    }
+    /**
+    创建各种格式共用的计算着色器生成细化链的管线布局(shader_mipgen.comp):
+    set 0 的 binding 0 为源级别,binding 1 为之后的 12 级,binding 2 为工作组计数器;
+    推送常量为源级别的大小,生成的级数和是否在线性空间求平均
+      */
+    void createMipgenLayout(){
+        TRACE_FUNCTION();
+        VkDescriptorSetLayoutBinding bindings[3] = {};
+        for(uint32_t i = 0;i < 3;i++){
+            bindings[i].binding = i;
+            bindings[i].descriptorCount = 1;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        bindings[1].descriptorCount = MIPGEN_LEVELS_PER_DISPATCH;
+        bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = bindings;
+        if(vkCreateDescriptorSetLayout(device,&layoutInfo,nullptr,
+                                       &mipgenSetLayout)!= VK_SUCCESS){
+            throw std::runtime_error("failed to create mipgen descriptor set layout!");
+        }
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = 4 * sizeof(uint32_t);
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &mipgenSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if(vkCreatePipelineLayout(device,&pipelineLayoutInfo,nullptr,
+                                  &mipgenPipelineLayout) != VK_SUCCESS){
+            throw std::runtime_error("failed to create mipgen pipeline layout!");
+        }
+        createBuffer(sizeof(uint32_t),VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     mipgenCounterBuffer,mipgenCounterMemory);
+    }
+    //返回 MIPGEN_VARIANTS 中第 variant 种格式的管线,第一次使用时创建
+    VkPipeline mipgenPipeline(int variant){
+        if(mipgenPipelines[variant] != VK_NULL_HANDLE){
+            return mipgenPipelines[variant];
+        }
+        if(mipgenPipelineLayout == VK_NULL_HANDLE){
+            createMipgenLayout();
+        }
+        VkShaderModule compShaderModule = loadShaderModule(
+                    MIPGEN_VARIANTS[variant].shader);
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = compShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = mipgenPipelineLayout;
+        VkResult result = vkCreateComputePipelines(device,VK_NULL_HANDLE,1,
+                                                   &pipelineInfo,nullptr,
+                                                   &mipgenPipelines[variant]);
+        vkDestroyShaderModule(device,compShaderModule,nullptr);
+        if(result != VK_SUCCESS){
+            throw std::runtime_error("failed to create mipgen pipeline!");
+        }
+        return mipgenPipelines[variant];
+    }
+    void destroyMipgenPipeline(){
+        if(mipgenPipelineLayout == VK_NULL_HANDLE){
+            return;
+        }
+        for(VkPipeline pipeline : mipgenPipelines){
+            if(pipeline != VK_NULL_HANDLE){
+                vkDestroyPipeline(device,pipeline,nullptr);
+            }
+        }
+        vkDestroyPipelineLayout(device,mipgenPipelineLayout,nullptr);
+        vkDestroyDescriptorSetLayout(device,mipgenSetLayout,nullptr);
+        vkDestroyBuffer(device,mipgenCounterBuffer,nullptr);
+        vkFreeMemory(device,mipgenCounterMemory,nullptr);
+    }
+    /**
+    记录用计算着色器生成细化链的指令,不需要格式支持线性过滤和 blit.
+    每次调度从一个源级别生成之后最多 12 级,源级别大于 4096 时一个工作组放不下
+    它的第 6 级,这次调度只生成 6 级,所以通常一次调度就生成整个细化链.
+    使用格式对应的着色器,sRGB 编码的格式和 CPU 生成的细化链一样在线性空间求平均.
+    每一级的存储图像视图和描述符池在指令执行完毕后销毁
+      */
+    void recordComputeMipmaps(VkCommandBuffer commandBuffer,VkImage image,
+                              VkFormat format,uint32_t width,uint32_t height,
+                              uint32_t mipLevels){
+        int variant = mipgenVariantIndex(format);
+        if(variant < 0){
+            throw std::runtime_error("no mipgen shader for the texture format!");
+        }
+        VkPipeline pipeline = mipgenPipeline(variant);
+        bool srgb = MIPGEN_VARIANTS[variant].srgb;
+        //每次调度的源级别和生成的级数
+        std::vector<std::pair<uint32_t,uint32_t>> dispatches;
+        for(uint32_t base = 0;base + 1 < mipLevels;){
+            uint32_t count = std::min(mipLevels - 1 - base,MIPGEN_LEVELS_PER_DISPATCH);
+            if(std::max(width >> base,height >> base) > 4096){
+                count = std::min(count,MIPGEN_LEVELS_PER_DISPATCH / 2);
+            }
+            dispatches.push_back(std::make_pair(base,count));
+            base += count;
+        }
+        std::vector<VkImageView> views(mipLevels);
+        for(uint32_t i = 0;i < mipLevels;i++){
+            views[i] = createImageView(image,format,VK_IMAGE_ASPECT_COLOR_BIT,1,i);
+        }
+        //每次调度一个描述符集,只有一级时没有调度,池的大小不能为 0
+        uint32_t setCount = std::max<uint32_t>(1,static_cast<uint32_t>(dispatches.size()));
+        VkDescriptorPoolSize poolSizes[2] = {};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        poolSizes[0].descriptorCount = setCount * (1 + MIPGEN_LEVELS_PER_DISPATCH);
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[1].descriptorCount = setCount;
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = setCount;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        VkDescriptorPool pool;
+        if(vkCreateDescriptorPool(device,&poolInfo,nullptr,&pool) != VK_SUCCESS){
+            throw std::runtime_error("failed to create mipgen descriptor pool!");
+        }
+        deferDestroy([this,pool,views](){
+            vkDestroyDescriptorPool(device,pool,nullptr);
+            for(VkImageView view : views){
+                vkDestroyImageView(device,view,nullptr);
+            }
+        });
+
+        //计数器清零;第 0 级保留传输写入的内容,其余各级的内容丢弃,都变换到通用布局
+        vkCmdFillBuffer(commandBuffer,mipgenCounterBuffer,0,sizeof(uint32_t),0);
+        VkBufferMemoryBarrier counterBarrier = {};
+        counterBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        counterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        counterBarrier.dstAccessMask =
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        counterBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        counterBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        counterBarrier.buffer = mipgenCounterBuffer;
+        counterBarrier.offset = 0;
+        counterBarrier.size = VK_WHOLE_SIZE;
+        VkImageMemoryBarrier barriers[2] = {};
+        for(int i = 0;i < 2;i++){
+            barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].image = image;
+            barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barriers[i].subresourceRange.layerCount = 1;
+            barriers[i].dstAccessMask =
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        }
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[0].subresourceRange.baseMipLevel = 0;
+        barriers[0].subresourceRange.levelCount = 1;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].srcAccessMask = 0;
+        barriers[1].subresourceRange.baseMipLevel = 1;
+        barriers[1].subresourceRange.levelCount = mipLevels - 1;
+        vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,0,nullptr,
+                             1,&counterBarrier,mipLevels > 1 ? 2 : 1,barriers);
+
+        vkCmdBindPipeline(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,pipeline);
+        for(size_t d = 0;d < dispatches.size();d++){
+            uint32_t base = dispatches[d].first;
+            uint32_t count = dispatches[d].second;
+            if(d > 0){
+                //这次调度的源级别由上一次调度写入
+                VkMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barrier.dstAccessMask =
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                vkCmdPipelineBarrier(commandBuffer,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,
+                                     1,&barrier,0,nullptr,0,nullptr);
+            }
+            VkDescriptorSetAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorPool = pool;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &mipgenSetLayout;
+            VkDescriptorSet set;
+            if(vkAllocateDescriptorSets(device,&allocInfo,&set) != VK_SUCCESS){
+                throw std::runtime_error("failed to allocate mipgen descriptor set!");
+            }
+            //不生成的级别绑定最后一个生成的级别,着色器不会访问它们
+            VkDescriptorImageInfo imageInfos[1 + MIPGEN_LEVELS_PER_DISPATCH] = {};
+            for(uint32_t i = 0;i <= MIPGEN_LEVELS_PER_DISPATCH;i++){
+                imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                imageInfos[i].imageView = views[base + std::min(i,count)];
+            }
+            VkDescriptorBufferInfo bufferInfo = {};
+            bufferInfo.buffer = mipgenCounterBuffer;
+            bufferInfo.offset = 0;
+            bufferInfo.range = sizeof(uint32_t);
+            VkWriteDescriptorSet writes[3] = {};
+            for(uint32_t i = 0;i < 3;i++){
+                writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[i].dstSet = set;
+                writes[i].dstBinding = i;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            }
+            writes[0].pImageInfo = &imageInfos[0];
+            writes[1].descriptorCount = MIPGEN_LEVELS_PER_DISPATCH;
+            writes[1].pImageInfo = &imageInfos[1];
+            writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[2].pBufferInfo = &bufferInfo;
+            vkUpdateDescriptorSets(device,3,writes,0,nullptr);
+            vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    mipgenPipelineLayout,0,1,&set,0,nullptr);
+            uint32_t srcWidth = std::max(1u,width >> base);
+            uint32_t srcHeight = std::max(1u,height >> base);
+            uint32_t constants[4] = { srcWidth,srcHeight,count,srgb ? 1u : 0u };
+            vkCmdPushConstants(commandBuffer,mipgenPipelineLayout,
+                               VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(constants),
+                               constants);
+            //每个工作组生成下一级的 32x32 个纹素
+            vkCmdDispatch(commandBuffer,(std::max(1u,srcWidth / 2) + 31) / 32,
+                          (std::max(1u,srcHeight / 2) + 31) / 32,1);
+        }
 
-        endSingleTimeCommands( commandBuffer );
+        //所有级别变换到着色器读取布局
+        VkImageMemoryBarrier barrier = barriers[0];
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.subresourceRange.levelCount = mipLevels;
+        vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,0,0,nullptr,
+                             0,nullptr,1,&barrier);
+    }
+    /**
+    --mipgen compare:交替用 vkCmdBlitImage 和计算着色器为 size x size 的图像
+    生成完整的细化链,输出两种方式的平均 GPU 时间;格式不支持线性 blit 时只测计算着色器.
+    第 0 级为伪随机的内容,避免驱动对均匀的内容做压缩影响结果.
+    在线性空间求平均的格式最后读回计算着色器生成的 1x1 级,
+    大小为 2 的幂时它应该等于第 0 级所有纹素的平均值
+      */
+    void compareMipGeneration(VkFormat format,uint32_t size){
+        TRACE_FUNCTION();
+        const uint32_t runs = 10;
+        bool floatTexels = format == VK_FORMAT_R32G32B32A32_SFLOAT;
+        const char* formatName = floatTexels ? "rgba32f" : "rgba8";
+        if(!gpuProfiler.supported() || !supportsComputeMipmaps(format)){
+            std::cout<<"mipgen compare "<<formatName<<": needs timestamp queries "
+                       "and storage image support, skipped"<<std::endl;
+            return;
+        }
+        const VkDeviceSize texelSize = floatTexels ? 16 : 4;
+        bool blit = supportsLinearBlit(format);
+        uint32_t levels = fullMipCount(size,size);
+        VkImage image;
+        VkDeviceMemory imageMemory;
+        createImage(size,size,levels,format,VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                    VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,image,imageMemory);
+        VkDeviceSize imageSize = VkDeviceSize(size) * size * texelSize;
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createBuffer(imageSize,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     stagingBuffer,stagingBufferMemory);
+        void* data;
+        vkMapMemory(device,stagingBufferMemory,0,imageSize,0,&data);
+        //浮点格式每个分量为 [0,1) 的伪随机数,同时累加每个分量的平均值
+        double expected[4] = { 0.0,0.0,0.0,0.0 };
+        uint32_t state = 0x9e3779b9u;
+        size_t count = size_t(size) * size * (floatTexels ? 4 : 1);
+        for(size_t i = 0;i < count;i++){
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            if(floatTexels){
+                float value = (state >> 8) * (1.0f / 16777216.0f);
+                static_cast<float*>(data)[i] = value;
+                expected[i % 4] += value;
+            }else{
+                static_cast<uint32_t*>(data)[i] = state;
+            }
+        }
+        vkUnmapMemory(device,stagingBufferMemory);
+        transitionImageLayout(image,format,VK_IMAGE_LAYOUT_UNDEFINED,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,levels);
+        TextureLevel level = { size,size,0,static_cast<size_t>(imageSize) };
+        copyBufferToImage(stagingBuffer,image,std::vector<TextureLevel>(1,level));
+        deferDestroyBuffer(stagingBuffer,stagingBufferMemory);
+        //先读取之前记录的范围(纹理上传等),比较使用的范围不会超过一段查询的容量
+        vkQueueWaitIdle(graphicsQueue);
+        gpuProfiler.collectAll();
+
+        //范围的名称在读取结果前必须一直有效
+        const char* names[2] = {
+            floatTexels ? "mipgen blit rgba32f" : "mipgen blit rgba8",
+            floatTexels ? "mipgen compute rgba32f" : "mipgen compute rgba8"
+        };
+        int firstMethod = blit ? 0 : 1;
+        for(uint32_t run = 0;run < runs;run++){
+            for(int method = firstMethod;method < 2;method++){
+                VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+                if(run > 0 || method > firstMethod){
+                    //第 0 级保留内容,其余各级丢弃,都变换回传输目的布局
+                    VkImageMemoryBarrier barriers[2] = {};
+                    for(int i = 0;i < 2;i++){
+                        barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                        barriers[i].oldLayout = i == 0 ?
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL :
+                                    VK_IMAGE_LAYOUT_UNDEFINED;
+                        barriers[i].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                        barriers[i].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                        barriers[i].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT |
+                                VK_ACCESS_TRANSFER_WRITE_BIT;
+                        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                        barriers[i].image = image;
+                        barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                        barriers[i].subresourceRange.baseMipLevel = i == 0 ? 0 : 1;
+                        barriers[i].subresourceRange.levelCount = i == 0 ? 1 : levels - 1;
+                        barriers[i].subresourceRange.layerCount = 1;
+                    }
+                    vkCmdPipelineBarrier(commandBuffer,
+                                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                         VK_PIPELINE_STAGE_TRANSFER_BIT,0,0,nullptr,
+                                         0,nullptr,2,barriers);
+                }
+                uint32_t scope = gpuProfiler.beginScope(commandBuffer,names[method]);
+                if(method == 0){
+                    recordBlitMipmaps(commandBuffer,image,format,size,size,levels);
+                }else{
+                    recordComputeMipmaps(commandBuffer,image,format,size,size,levels);
+                }
+                gpuProfiler.endScope(commandBuffer,scope);
+                endSingleTimeCommands(commandBuffer);
+            }
+        }
+        vkQueueWaitIdle(graphicsQueue);
+        gpuProfiler.collectAll();
+        double ms[2] = { 0.0,0.0 };
+        for(const GpuProfiler::ScopeTiming& timing : gpuProfiler.timings()){
+            for(int method = 0;method < 2;method++){
+                if(timing.name == names[method]){
+                    ms[method] = timing.averageMs;
+                }
+            }
+        }
+        std::cout<<"mipgen "<<formatName<<" "<<size<<"x"<<size<<", "<<levels
+                 <<" levels, "<<runs<<" runs: blit ";
+        if(blit){
+            std::cout<<ms[0]<<" ms";
+        }else{
+            std::cout<<"unsupported (no linear filtering)";
+        }
+        std::cout<<", compute "<<ms[1]<<" ms";
+        if(blit && ms[1] > 0.0){
+            std::cout<<" ("<<ms[0] / ms[1]<<"x)";
+        }
+        std::cout<<std::endl;
+        //最后一次运行的是计算着色器,读回它生成的 1x1 级和平均值比较
+        if(floatTexels){
+            VkBuffer readbackBuffer;
+            VkDeviceMemory readbackMemory;
+            createBuffer(texelSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         readbackBuffer,readbackMemory);
+            VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = levels - 1;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+            vkCmdPipelineBarrier(commandBuffer,VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,0,0,nullptr,
+                                 0,nullptr,1,&barrier);
+            VkBufferImageCopy region = {};
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = levels - 1;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = { 1,1,1 };
+            vkCmdCopyImageToBuffer(commandBuffer,image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                   readbackBuffer,1,&region);
+            endSingleTimeCommands(commandBuffer);
+            vkQueueWaitIdle(graphicsQueue);
+            vkMapMemory(device,readbackMemory,0,texelSize,0,&data);
+            double maxError = 0.0;
+            for(int c = 0;c < 4;c++){
+                double mean = expected[c] / (double(size) * size);
+                maxError = std::max(maxError,std::fabs(
+                                        static_cast<float*>(data)[c] - mean));
+            }
+            vkUnmapMemory(device,readbackMemory);
+            deferDestroyBuffer(readbackBuffer,readbackMemory);
+            std::cout<<"mipgen "<<formatName<<" check: 1x1 level differs from the "
+                       "level 0 mean by "<<maxError
+                     <<(maxError < 1e-3 ? ", ok" : ", FAILED")<<std::endl;
+        }
+        deferDestroy([this,image,imageMemory](){
+            vkDestroyImage(device,image,nullptr);
+            vkFreeMemory(device,imageMemory,nullptr);
+        });
     }
+
+    /**
+    任务调度器,用于启动时的并行加载.
+    放在最后,最先析构:析构时等待未完成的任务,这些任务可能还在写入其他成员
+      */
+    JobSystem jobs;
 };
 
 int main(int argc, char *argv[])
 {
-    HelloTriangle hello;
+    //离线烘焙纹理:VulkanLearn --cook-texture chalet.jpg chalet_bc7.ktx2 bc7
+    if(argc >= 2 && std::string(argv[1]) == "--cook-texture"){
+        if(argc < 4){
+            std::cerr<<"usage: "<<argv[0]
+                     <<" --cook-texture <input image> <output.ktx2>"
+                     <<" [rgba8|bc1|bc3|bc7]"<<std::endl;
+            return EXIT_FAILURE;
+        }
+        try{
+            cookTexture(argv[2],argv[3],
+                        parseCookFormat(argc >= 5 ? argv[4] : "rgba8"));
+        }catch(const std::exception& e){
+            std::cerr<<e.what()<<std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    //离线切分网格:VulkanLearn --cook-mesh chalet.obj chalet.vmesh 8
+    if(argc >= 2 && std::string(argv[1]) == "--cook-mesh"){
+        if(argc < 4){
+            std::cerr<<"usage: "<<argv[0]
+                     <<" --cook-mesh <input.obj> <output.vmesh> [cells per axis]"
+                     <<std::endl;
+            return EXIT_FAILURE;
+        }
+        try{
+            cookMesh(argv[2],argv[3],argc >= 5 ?
+                         parseUintArgument(argv[1],argv[4],1,64) : 8);
+        }catch(const std::exception& e){
+            std::cerr<<e.what()<<std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    //离线切分虚拟纹理:VulkanLearn --cook-vt huge.png huge.vtex 128
+    if(argc >= 2 && std::string(argv[1]) == "--cook-vt"){
+        if(argc < 4){
+            std::cerr<<"usage: "<<argv[0]
+                     <<" --cook-vt <input image> <output.vtex> [tile size]"
+                     <<std::endl;
+            return EXIT_FAILURE;
+        }
+        try{
+            cookVirtualTexture(argv[2],argv[3],argc >= 5 ?
+                                   parseUintArgument(argv[1],argv[4],16,1024) : 128);
+        }catch(const std::exception& e){
+            std::cerr<<e.what()<<std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    //打包资源:VulkanLearn --pack-archive assets.vlpk lz4 chalet.obj chalet.jpg vert.spv ...
+    if(argc >= 2 && std::string(argv[1]) == "--pack-archive"){
+        if(argc < 5){
+            std::cerr<<"usage: "<<argv[0]
+                     <<" --pack-archive <output.vlpk> <none|lz4|zstd> <files...>"
+                     <<std::endl;
+            return EXIT_FAILURE;
+        }
+        try{
+            packArchive(argv[2],parseAssetCodec(argv[3]),
+                        std::vector<std::string>(argv + 4,argv + argc));
+        }catch(const std::exception& e){
+            std::cerr<<e.what()<<std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    //任务调度器的微基准测试:VulkanLearn --job-bench [threads]
+    if(argc >= 2 && std::string(argv[1]) == "--job-bench"){
+        try{
+            runJobBenchmark(argc >= 3 ? parseUintArgument(argv[1],argv[2],0,256)
+                                      : 0);
+        }catch(const std::exception& e){
+            std::cerr<<e.what()<<std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    //图像处理内核的正确性检查和吞吐量测试:VulkanLearn --kernel-bench [megapixels]
+    if(argc >= 2 && std::string(argv[1]) == "--kernel-bench"){
+        try{
+            if(!runKernelBenchmark(argc >= 3 ? parseUintArgument(argv[1],argv[2],1,64)
+                                             : 4)){
+                return EXIT_FAILURE;
+            }
+        }catch(const std::exception& e){
+            std::cerr<<e.what()<<std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    AppConfig config;
+    try{
+        config = parseAppConfig(argc,argv);
+    }catch(const std::exception& e){
+        std::cerr<<e.what()<<std::endl;
+        return EXIT_FAILURE;
+    }
+    HelloTriangle hello(config);
     try{
         hello.run();
     }catch(const std::exception& e){
@@ -0,0 +1,160 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <stdexcept>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+  只读的内存映射文件.
+  文件内容直接从页缓存映射到进程的地址空间,读取时不需要先复制到堆上的缓冲,
+  可以直接 memcpy 到映射的暂存缓冲,或者直接作为解码器的输入.
+  映射的起始地址按页对齐,可以直接作为 SPIR-V 代码(要求 4 字节对齐).
+  对象可以移动,不能复制,析构时解除映射
+  */
+class MappedFile{
+public:
+    MappedFile(){}
+    explicit MappedFile(const std::string& filename){
+        open(filename);
+    }
+    ~MappedFile(){
+        close();
+    }
+    MappedFile(MappedFile&& other){
+        swap(other);
+    }
+    MappedFile& operator=(MappedFile&& other){
+        if(this != &other){
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    void open(const std::string& filename){
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename.c_str(),GENERIC_READ,FILE_SHARE_READ,
+                                  nullptr,OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL,nullptr);
+        if(file == INVALID_HANDLE_VALUE){
+            throw std::runtime_error("failed to open file: " + filename);
+        }
+        LARGE_INTEGER fileSize;
+        if(!GetFileSizeEx(file,&fileSize)){
+            CloseHandle(file);
+            throw std::runtime_error("failed to open file: " + filename);
+        }
+        if(!fitsAddressSpace(static_cast<uint64_t>(fileSize.QuadPart))){
+            CloseHandle(file);
+            throw std::runtime_error("file too large to map: " + filename);
+        }
+        length = static_cast<size_t>(fileSize.QuadPart);
+        if(length > 0){
+            HANDLE mapping = CreateFileMappingA(file,nullptr,PAGE_READONLY,
+                                                0,0,nullptr);
+            if(mapping != nullptr){
+                address = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+                CloseHandle(mapping);//映射视图保持映射对象有效
+            }
+        }
+        CloseHandle(file);
+        if(length > 0 && address == nullptr){
+            length = 0;
+            throw std::runtime_error("failed to map file: " + filename);
+        }
+#else
+        int fd = ::open(filename.c_str(),O_RDONLY);
+        if(fd < 0){
+            throw std::runtime_error("failed to open file: " + filename);
+        }
+        struct stat info;
+        if(fstat(fd,&info) != 0){
+            ::close(fd);
+            throw std::runtime_error("failed to open file: " + filename);
+        }
+        if(!fitsAddressSpace(static_cast<uint64_t>(info.st_size))){
+            ::close(fd);
+            throw std::runtime_error("file too large to map: " + filename);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if(length > 0){
+            void* mapped = mmap(nullptr,length,PROT_READ,MAP_PRIVATE,fd,0);
+            address = mapped == MAP_FAILED ? nullptr : mapped;
+        }
+        ::close(fd);//映射建立后不再需要文件描述符
+        if(length > 0 && address == nullptr){
+            length = 0;
+            throw std::runtime_error("failed to map file: " + filename);
+        }
+#endif
+        name = filename;
+    }
+    void close(){
+        if(address != nullptr){
+#ifdef _WIN32
+            UnmapViewOfFile(address);
+#else
+            munmap(address,length);
+#endif
+        }
+        address = nullptr;
+        length = 0;
+        name.clear();
+    }
+    /**
+    提示系统文件将按顺序读取,可以更积极地预读并尽早回收读过的页.
+    只是提示,不支持时忽略
+      */
+    void adviseSequential(){
+#if !defined(_WIN32) && defined(MADV_SEQUENTIAL)
+        if(address != nullptr){
+            madvise(address,length,MADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    bool isOpen() const { return !name.empty(); }
+    const unsigned char* data() const {
+        return static_cast<const unsigned char*>(address);
+    }
+    size_t size() const { return length; }
+    const std::string& filename() const { return name; }
+
+private:
+    //32 位进程中 size_t 放不下超过 4GB 的文件大小,截断后只会映射文件的一部分
+    static bool fitsAddressSpace(uint64_t size){
+        return size <= static_cast<uint64_t>(SIZE_MAX);
+    }
+    void swap(MappedFile& other){
+        std::swap(address,other.address);
+        std::swap(length,other.length);
+        std::swap(name,other.name);
+    }
+
+    void* address = nullptr;
+    size_t length = 0;
+    std::string name;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,348 @@
+#ifndef MESHCHUNKS_H
+#define MESHCHUNKS_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+
+#include "mappedfile.h"
+
+/**
+  分块网格文件,用于流式加载大模型
+  模型按空间网格分成若干块,每一块有多个细节级别(LOD),第 0 级为原始网格.
+  文件结构(所有整数和浮点数为小端序):
+  1. 文件头:魔数 "VMSH",版本,顶点大小,块数,LOD 数,整个模型的包围盒,最大的数据块字节数
+  2. 块表:每一块的包围盒,以及每一级 LOD 数据块的偏移,顶点数和索引数
+  3. 数据块:顶点数据后面紧跟 32 位索引,索引相对于这一块的顶点.
+     所有块最粗糙的一级放在最前面,然后是次粗糙的一级,依次到第 0 级,
+     按文件顺序读取就是先显示整个模型的轮廓再逐渐细化
+  */
+static const char MESH_CHUNKS_MAGIC[4] = {'V','M','S','H'};
+const uint32_t MESH_CHUNKS_VERSION = 1;
+const uint32_t MESH_MAX_LODS = 4;
+
+//与程序中的 Vertex 结构体布局相同
+struct MeshChunkVertex{
+    float pos[3];
+    float color[3];
+    float texCoord[2];
+};
+
+//一级 LOD 的数据块
+struct MeshChunkLod{
+    uint64_t offset = 0;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+
+    uint64_t bytes() const {
+        return uint64_t(vertexCount) * sizeof(MeshChunkVertex) +
+                uint64_t(indexCount) * sizeof(uint32_t);
+    }
+};
+
+struct MeshChunk{
+    float boundsMin[3];
+    float boundsMax[3];
+    MeshChunkLod lods[MESH_MAX_LODS];
+};
+
+namespace meshchunks {
+
+inline void put32(std::ostream& out,uint32_t v){
+    unsigned char bytes[4];
+    for(int i = 0;i < 4;i++){
+        bytes[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+    out.write(reinterpret_cast<const char*>(bytes),4);
+}
+inline void put64(std::ostream& out,uint64_t v){
+    put32(out,static_cast<uint32_t>(v));
+    put32(out,static_cast<uint32_t>(v >> 32));
+}
+inline void putFloat(std::ostream& out,float f){
+    uint32_t bits;
+    std::memcpy(&bits,&f,sizeof(bits));
+    put32(out,bits);
+}
+inline uint32_t get32(const unsigned char* p){
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) |
+            (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+inline uint64_t get64(const unsigned char* p){
+    return uint64_t(get32(p)) | (uint64_t(get32(p + 4)) << 32);
+}
+inline float getFloat(const unsigned char* p){
+    uint32_t bits = get32(p);
+    float f;
+    std::memcpy(&f,&bits,sizeof(f));
+    return f;
+}
+
+//文件头的字节数
+inline uint64_t headerSize(){
+    return 4 + 4 * 4 + 6 * 4 + 8;
+}
+//块表中一项的字节数
+inline uint64_t chunkEntrySize(uint32_t lodCount){
+    return 6 * 4 + uint64_t(lodCount) * 16;
+}
+//检查数据块中的索引都小于这一块的顶点数,block 为数据块的开头
+inline bool validIndices(const unsigned char* block,const MeshChunkLod& entry){
+    const unsigned char* p = block + uint64_t(entry.vertexCount) * sizeof(MeshChunkVertex);
+    for(uint32_t i = 0;i < entry.indexCount;i++){
+        if(get32(p + uint64_t(i) * 4) >= entry.vertexCount){
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace meshchunks
+
+/**
+  写入分块网格文件.先写入文件头和块表的占位,
+  依次调用 writeBlock 写入数据块(从最粗糙的一级开始),最后 finish 回填块表
+  */
+class MeshChunkWriter{
+public:
+    MeshChunkWriter(const std::string& filename,uint32_t chunkCount,
+                    uint32_t lodCount,const float boundsMin[3],
+                    const float boundsMax[3])
+        : filename(filename),chunks(chunkCount),lodCount(lodCount),
+          out(filename,std::ios::binary){
+        if(!out){
+            throw std::runtime_error("failed to open file: " + filename);
+        }
+        if(lodCount == 0 || lodCount > MESH_MAX_LODS){
+            throw std::runtime_error("invalid mesh LOD count");
+        }
+        std::copy(boundsMin,boundsMin + 3,this->boundsMin);
+        std::copy(boundsMax,boundsMax + 3,this->boundsMax);
+        std::vector<char> placeholder(meshchunks::headerSize() +
+                                      chunkCount * meshchunks::chunkEntrySize(lodCount));
+        out.write(placeholder.data(),placeholder.size());
+    }
+    MeshChunk& chunk(uint32_t index){ return chunks[index]; }
+    void writeBlock(uint32_t chunkIndex,uint32_t lod,
+                    const std::vector<MeshChunkVertex>& vertices,
+                    const std::vector<uint32_t>& indices){
+        for(uint32_t index : indices){
+            if(index >= vertices.size()){
+                throw std::runtime_error("mesh chunk index out of range: " + filename);
+            }
+        }
+        MeshChunkLod& entry = chunks[chunkIndex].lods[lod];
+        entry.offset = static_cast<uint64_t>(out.tellp());
+        entry.vertexCount = static_cast<uint32_t>(vertices.size());
+        entry.indexCount = static_cast<uint32_t>(indices.size());
+        for(const MeshChunkVertex& v : vertices){
+            for(float f : v.pos) meshchunks::putFloat(out,f);
+            for(float f : v.color) meshchunks::putFloat(out,f);
+            for(float f : v.texCoord) meshchunks::putFloat(out,f);
+        }
+        for(uint32_t index : indices){
+            meshchunks::put32(out,index);
+        }
+        maxBlockBytes = std::max(maxBlockBytes,entry.bytes());
+    }
+    void finish(){
+        using namespace meshchunks;
+        out.seekp(0);
+        out.write(MESH_CHUNKS_MAGIC,4);
+        put32(out,MESH_CHUNKS_VERSION);
+        put32(out,sizeof(MeshChunkVertex));
+        put32(out,static_cast<uint32_t>(chunks.size()));
+        put32(out,lodCount);
+        for(float f : boundsMin) putFloat(out,f);
+        for(float f : boundsMax) putFloat(out,f);
+        put64(out,maxBlockBytes);
+        for(const MeshChunk& c : chunks){
+            for(float f : c.boundsMin) putFloat(out,f);
+            for(float f : c.boundsMax) putFloat(out,f);
+            for(uint32_t lod = 0;lod < lodCount;lod++){
+                put64(out,c.lods[lod].offset);
+                put32(out,c.lods[lod].vertexCount);
+                put32(out,c.lods[lod].indexCount);
+            }
+        }
+        out.close();
+        if(!out){
+            throw std::runtime_error("failed to write file: " + filename);
+        }
+    }
+
+private:
+    std::string filename;
+    std::vector<MeshChunk> chunks;
+    uint32_t lodCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t maxBlockBytes = 0;
+    std::ofstream out;
+};
+
+/**
+  读取分块网格文件.打开时映射整个文件,只解析文件头和块表,
+  数据块由 readBlock 从映射直接复制到调用方提供的内存(例如映射的暂存缓冲),
+  没有中间的堆缓冲,占用的内存与文件大小无关,读过的页由系统按需回收.
+  超过 MESH_CHUNKS_MAP_LIMIT 的文件不映射(32 位进程的地址空间放不下),
+  只读入文件头和块表,readBlock 定位到数据块从文件读取.
+  数据块不经转换直接复制,要求主机为小端序
+  */
+const uint64_t MESH_CHUNKS_MAP_LIMIT = uint64_t(256) << 20;
+
+class MeshChunkFile{
+public:
+    void open(const std::string& filename){
+        close();
+        stream.open(filename,std::ios::binary);
+        if(!stream){
+            throw std::runtime_error("failed to open file: " + filename);
+        }
+        stream.seekg(0,std::ios::end);
+        uint64_t fileSize = static_cast<uint64_t>(stream.tellg());
+        if(fileSize <= MESH_CHUNKS_MAP_LIMIT){
+            stream.close();
+            file.open(filename);
+            file.adviseSequential();//数据块按文件顺序读取
+            open(file.data(),file.size(),filename);
+            return;
+        }
+        using namespace meshchunks;
+        std::vector<unsigned char> table(static_cast<size_t>(headerSize()));
+        readAt(0,table.data(),table.size(),filename);
+        uint64_t tableBytes = parseHeader(table.data(),fileSize,filename);
+        table.resize(static_cast<size_t>(headerSize() + tableBytes));
+        readAt(headerSize(),table.data() + headerSize(),
+               static_cast<size_t>(tableBytes),filename);
+        parseChunks(table.data() + headerSize(),fileSize,filename);
+        name = filename;
+    }
+    //使用解压到内存中的文件内容(例如资源包中压缩存放的数据),由对象保存
+    void open(std::vector<unsigned char> data,const std::string& filename){
+        close();
+        owned = std::move(data);
+        open(owned.data(),owned.size(),filename);
+    }
+    //使用内存中的文件内容(例如资源包中不压缩存放的数据),使用期间 data 需要一直有效
+    void open(const unsigned char* data,size_t size,const std::string& filename){
+        using namespace meshchunks;
+        if(size < headerSize()){
+            throw std::runtime_error("not a mesh chunk file: " + filename);
+        }
+        parseHeader(data,size,filename);
+        parseChunks(data + headerSize(),size,filename);
+        base = data;
+        name = filename;
+    }
+    bool isOpen() const { return base != nullptr || stream.is_open(); }
+    void close(){
+        file.close();
+        owned.clear();
+        owned.shrink_to_fit();
+        stream.close();
+        stream.clear();
+        scratch.clear();
+        scratch.shrink_to_fit();
+        name.clear();
+        base = nullptr;
+    }
+    /**
+    把一个数据块复制到 dst,dst 至少有 lods[lod].bytes() 字节.
+    越界的索引会让 GPU 读取顶点缓冲之外的内存,复制前检查索引.
+    dst 通常是映射的暂存缓冲,读取很慢,所以不映射的大文件先读到 scratch 中检查
+      */
+    void readBlock(uint32_t chunk,uint32_t lod,void* dst){
+        const MeshChunkLod& entry = chunks[chunk].lods[lod];
+        const size_t bytes = static_cast<size_t>(entry.bytes());
+        const unsigned char* src;
+        if(base != nullptr){
+            src = base + entry.offset;
+        }else{
+            scratch.resize(bytes);
+            readAt(entry.offset,scratch.data(),bytes,name);
+            src = scratch.data();
+        }
+        if(!meshchunks::validIndices(src,entry)){
+            throw std::runtime_error("mesh chunk index out of range in " + name);
+        }
+        std::memcpy(dst,src,bytes);
+    }
+
+    std::vector<MeshChunk> chunks;
+    uint32_t lodCount = 0;
+    float boundsMin[3] = {};
+    float boundsMax[3] = {};
+    uint64_t maxBlockBytes = 0;
+
+private:
+    //解析文件头(p 至少有 headerSize() 字节),返回块表的字节数
+    uint64_t parseHeader(const unsigned char* p,uint64_t fileSize,
+                         const std::string& filename){
+        using namespace meshchunks;
+        if(std::memcmp(p,MESH_CHUNKS_MAGIC,4) != 0 ||
+                get32(p + 4) != MESH_CHUNKS_VERSION){
+            throw std::runtime_error("not a mesh chunk file: " + filename);
+        }
+        if(get32(p + 8) != sizeof(MeshChunkVertex)){
+            throw std::runtime_error("unsupported vertex size in " + filename);
+        }
+        uint32_t chunkCount = get32(p + 12);
+        lodCount = get32(p + 16);
+        if(lodCount == 0 || lodCount > MESH_MAX_LODS){
+            throw std::runtime_error("invalid mesh LOD count in " + filename);
+        }
+        p += 20;
+        for(float& f : boundsMin){ f = getFloat(p); p += 4; }
+        for(float& f : boundsMax){ f = getFloat(p); p += 4; }
+        maxBlockBytes = get64(p);
+        uint64_t tableBytes = chunkCount * chunkEntrySize(lodCount);
+        if(fileSize - headerSize() < tableBytes){
+            throw std::runtime_error("truncated mesh chunk file: " + filename);
+        }
+        chunks.resize(chunkCount);
+        return tableBytes;
+    }
+    //解析块表,检查每个数据块都在文件范围内
+    void parseChunks(const unsigned char* p,uint64_t fileSize,
+                     const std::string& filename){
+        using namespace meshchunks;
+        for(MeshChunk& c : chunks){
+            for(float& f : c.boundsMin){ f = getFloat(p); p += 4; }
+            for(float& f : c.boundsMax){ f = getFloat(p); p += 4; }
+            for(uint32_t lod = 0;lod < lodCount;lod++){
+                c.lods[lod].offset = get64(p);
+                c.lods[lod].vertexCount = get32(p + 8);
+                c.lods[lod].indexCount = get32(p + 12);
+                p += 16;
+                if(c.lods[lod].offset > fileSize ||
+                        c.lods[lod].bytes() > fileSize - c.lods[lod].offset){
+                    throw std::runtime_error("truncated mesh chunk file: " +
+                                             filename);
+                }
+            }
+        }
+    }
+    //不映射的大文件从 offset 处读取 size 字节
+    void readAt(uint64_t offset,void* dst,size_t size,const std::string& filename){
+        stream.seekg(static_cast<std::streamoff>(offset));
+        stream.read(static_cast<char*>(dst),static_cast<std::streamsize>(size));
+        if(!stream){
+            throw std::runtime_error("failed to read mesh chunk file: " + filename);
+        }
+    }
+
+    MappedFile file;//从文件打开时的映射
+    std::vector<unsigned char> owned;//从压缩的数据打开时解压后的内容
+    std::ifstream stream;//超过 MESH_CHUNKS_MAP_LIMIT 的文件不映射,按块读取
+    std::vector<unsigned char> scratch;//不映射时读取的数据块
+    std::string name;
+    const unsigned char* base = nullptr;
+};
+
+#endif // MESHCHUNKS_H
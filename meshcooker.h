@@ -0,0 +1,224 @@
+#ifndef MESHCOOKER_H
+#define MESHCOOKER_H
+
+#include <tiny_obj_loader.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+
+#include "meshchunks.h"
+
+namespace meshcook {
+
+//一个三角形的三个顶点在 OBJ 中的索引
+struct Triangle{
+    tinyobj::index_t corners[3];
+};
+
+//把坐标量化到 [0,resolution) 的网格中
+inline uint32_t gridCoord(float value,float minValue,float maxValue,
+                          uint32_t resolution){
+    float extent = maxValue - minValue;
+    if(extent <= 0.0f){
+        return 0;
+    }
+    float t = (value - minValue) / extent;
+    int cell = static_cast<int>(t * resolution);
+    return static_cast<uint32_t>(std::min(std::max(cell,0),
+                                          static_cast<int>(resolution) - 1));
+}
+
+/**
+  生成一块的一级 LOD.
+  clusterResolution 为 0 时是原始网格:相同的位置和纹理坐标只保留一个顶点.
+  否则使用顶点聚类简化:把块的包围盒分成 clusterResolution^3 个格子,
+  同一格子中的顶点合并为一个(位置取平均,纹理坐标取第一个),
+  有两个顶点合并到一起的三角形退化,被丢弃
+  */
+inline void buildLod(const tinyobj::attrib_t& attrib,
+                     const std::vector<Triangle>& triangles,
+                     const MeshChunk& chunk,uint32_t clusterResolution,
+                     std::vector<MeshChunkVertex>& vertices,
+                     std::vector<uint32_t>& indices){
+    vertices.clear();
+    indices.clear();
+    std::unordered_map<uint64_t,uint32_t> unique;
+    std::vector<uint32_t> weights;
+    for(const Triangle& triangle : triangles){
+        uint32_t corner[3];
+        for(int c = 0;c < 3;c++){
+            const tinyobj::index_t& index = triangle.corners[c];
+            const float* p = &attrib.vertices[3 * index.vertex_index];
+            uint64_t key;
+            if(clusterResolution == 0){
+                key = (uint64_t(uint32_t(index.vertex_index)) << 32) |
+                        uint32_t(index.texcoord_index);
+            }else{
+                key = 0;
+                for(int axis = 0;axis < 3;axis++){
+                    key = key * clusterResolution +
+                            gridCoord(p[axis],chunk.boundsMin[axis],
+                                      chunk.boundsMax[axis],clusterResolution);
+                }
+            }
+            auto found = unique.find(key);
+            if(found != unique.end()){
+                corner[c] = found->second;
+                if(clusterResolution != 0){
+                    MeshChunkVertex& v = vertices[found->second];
+                    for(int axis = 0;axis < 3;axis++){
+                        v.pos[axis] += p[axis];
+                    }
+                    weights[found->second]++;
+                }
+                continue;
+            }
+            MeshChunkVertex v = {};
+            for(int axis = 0;axis < 3;axis++){
+                v.pos[axis] = p[axis];
+                v.color[axis] = 1.0f;
+            }
+            //Vulkan 的纹理坐标原点在左上角,OBJ 在左下角
+            if(index.texcoord_index >= 0){
+                v.texCoord[0] = attrib.texcoords[2 * index.texcoord_index];
+                v.texCoord[1] = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
+            }
+            corner[c] = static_cast<uint32_t>(vertices.size());
+            unique[key] = corner[c];
+            vertices.push_back(v);
+            weights.push_back(1);
+        }
+        if(corner[0] == corner[1] || corner[1] == corner[2] ||
+                corner[0] == corner[2]){
+            continue;
+        }
+        indices.insert(indices.end(),corner,corner + 3);
+    }
+    if(clusterResolution != 0){
+        for(size_t i = 0;i < vertices.size();i++){
+            for(int axis = 0;axis < 3;axis++){
+                vertices[i].pos[axis] /= weights[i];
+            }
+        }
+    }
+}
+
+} // namespace meshcook
+
+/**
+  离线把 OBJ 模型切分为流式加载用的分块网格文件.
+  按三角形重心把三角形分到 cellsPerAxis^3 个空间格子中,空的格子不写入.
+  每一块生成 lodCount 级 LOD:第 0 级为原始网格,之后每一级的聚类格子边长为上一级的 4 倍.
+  烘焙时整个 OBJ 仍由 tinyobjloader 读入内存;运行时读取分块文件占用的内存是有上限的
+  */
+inline void cookMesh(const std::string& srcFilename,const std::string& dstFilename,
+                     uint32_t cellsPerAxis = 8,uint32_t lodCount = 3){
+    using namespace meshcook;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    if(lodCount == 0 || lodCount > MESH_MAX_LODS){
+        throw std::runtime_error("mesh LOD count must be between 1 and " +
+                                 std::to_string(MESH_MAX_LODS));
+    }
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+    if(!tinyobj::LoadObj(&attrib,&shapes,&materials,&err,&warn,
+                         srcFilename.c_str())){
+        throw std::runtime_error(warn+err);
+    }
+    if(attrib.vertices.empty()){
+        throw std::runtime_error("model has no vertices: " + srcFilename);
+    }
+    float boundsMin[3] = {attrib.vertices[0],attrib.vertices[1],attrib.vertices[2]};
+    float boundsMax[3] = {boundsMin[0],boundsMin[1],boundsMin[2]};
+    for(size_t i = 0;i < attrib.vertices.size();i += 3){
+        for(int axis = 0;axis < 3;axis++){
+            boundsMin[axis] = std::min(boundsMin[axis],attrib.vertices[i + axis]);
+            boundsMax[axis] = std::max(boundsMax[axis],attrib.vertices[i + axis]);
+        }
+    }
+
+    //按重心所在的格子分组三角形
+    std::unordered_map<uint32_t,std::vector<Triangle>> cells;
+    size_t triangleCount = 0;
+    for(const auto& shape : shapes){
+        const auto& meshIndices = shape.mesh.indices;
+        for(size_t i = 0;i + 2 < meshIndices.size();i += 3){
+            Triangle triangle;
+            uint32_t cell = 0;
+            for(int axis = 0;axis < 3;axis++){
+                float centroid = 0.0f;
+                for(int c = 0;c < 3;c++){
+                    triangle.corners[c] = meshIndices[i + c];
+                    centroid += attrib.vertices[
+                            3 * meshIndices[i + c].vertex_index + axis];
+                }
+                cell = cell * cellsPerAxis +
+                        gridCoord(centroid / 3.0f,boundsMin[axis],
+                                  boundsMax[axis],cellsPerAxis);
+            }
+            cells[cell].push_back(triangle);
+            triangleCount++;
+        }
+    }
+    std::vector<uint32_t> cellIds;
+    for(const auto& cell : cells){
+        cellIds.push_back(cell.first);
+    }
+    std::sort(cellIds.begin(),cellIds.end());
+
+    MeshChunkWriter writer(dstFilename,static_cast<uint32_t>(cellIds.size()),
+                           lodCount,boundsMin,boundsMax);
+    //块的包围盒取它的三角形的包围盒,聚类格子按它划分
+    for(uint32_t i = 0;i < cellIds.size();i++){
+        MeshChunk& chunk = writer.chunk(i);
+        bool first = true;
+        for(const Triangle& triangle : cells[cellIds[i]]){
+            for(const tinyobj::index_t& index : triangle.corners){
+                const float* p = &attrib.vertices[3 * index.vertex_index];
+                for(int axis = 0;axis < 3;axis++){
+                    chunk.boundsMin[axis] = first ? p[axis] :
+                            std::min(chunk.boundsMin[axis],p[axis]);
+                    chunk.boundsMax[axis] = first ? p[axis] :
+                            std::max(chunk.boundsMax[axis],p[axis]);
+                }
+                first = false;
+            }
+        }
+    }
+    //从最粗糙的一级开始写入,运行时按文件顺序读取
+    std::vector<MeshChunkVertex> vertices;
+    std::vector<uint32_t> indices;
+    size_t fullTriangles = 0;
+    for(uint32_t lod = lodCount;lod-- > 0;){
+        uint32_t clusterResolution = lod == 0 ? 0 : 64u >> (2 * (lod - 1));
+        size_t lodTriangles = 0;
+        for(uint32_t i = 0;i < cellIds.size();i++){
+            buildLod(attrib,cells[cellIds[i]],writer.chunk(i),clusterResolution,
+                     vertices,indices);
+            writer.writeBlock(i,lod,vertices,indices);
+            lodTriangles += indices.size() / 3;
+        }
+        std::cout<<"LOD "<<lod<<": "<<lodTriangles<<" triangles"<<std::endl;
+        if(lod == 0){
+            fullTriangles = lodTriangles;
+        }
+    }
+    writer.finish();
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout<<"cooked "<<srcFilename<<" -> "<<dstFilename<<": "
+             <<triangleCount<<" triangles ("<<fullTriangles<<" non-degenerate), "
+             <<cellIds.size()<<" chunks, "<<lodCount<<" LODs, "
+             <<std::chrono::duration<double,std::milli>(
+                   endTime - startTime).count()<<" ms"<<std::endl;
+}
+
+#endif // MESHCOOKER_H
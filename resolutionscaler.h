@@ -0,0 +1,111 @@
+#ifndef RESOLUTIONSCALER_H
+#define RESOLUTIONSCALER_H
+
+#include <deque>
+#include <utility>
+#include <algorithm>
+#include <ostream>
+#include <cmath>
+#include <cstdint>
+
+/**
+  动态分辨率的缩放比例控制.
+  内部渲染目标按最大大小(交换链图像的大小)分配,每一帧只渲染其中 scale x scale 的区域.
+  GPU 时间在 framesInFlight 帧之后才能读到,这时已经用别的比例绘制了几帧,
+  所以记录每一帧使用的比例,用那一帧的比例把场景渲染的时间换算到全分辨率下的时间
+  (时间近似与像素数成正比),帧内其余的时间(上传,放大等)不随比例变化,
+  平滑后求出使整帧时间等于目标的比例:
+  1. 换算后的时间用指数移动平均平滑,单独一帧的波动不会改变比例
+  2. 降低比例比提高比例快,超出目标时尽快恢复帧率,有余量时慢慢提高,避免来回振荡
+  3. 变化小于 deadband 时不改变比例
+  */
+class DynamicResolution{
+public:
+    void init(double targetMs,double minScale){
+        target = targetMs;
+        minimum = std::min(std::max(minScale,0.1),1.0);
+        current = 1.0;
+    }
+    //开始记录第 frame 帧时调用,返回这一帧使用的比例
+    double beginFrame(uint64_t frame){
+        history.push_back(std::make_pair(frame,current));
+        //结果读取前最多保留同时处理的帧数加上没有结果的几帧
+        while(history.size() > 16){
+            history.pop_front();
+        }
+        return current;
+    }
+    //读到第 frame 帧的 GPU 时间后调用,sceneMs 为按比例渲染的部分,frameMs 为整帧
+    void update(uint64_t frame,double sceneMs,double frameMs){
+        double scale = current;
+        while(!history.empty() && history.front().first <= frame){
+            if(history.front().first == frame){
+                scale = history.front().second;
+            }
+            history.pop_front();
+        }
+        double fullMs = sceneMs / (scale * scale);
+        double fixedMs = std::max(frameMs - sceneMs,0.0);
+        if(samples == 0){
+            smoothedMs = fullMs;
+            smoothedFixedMs = fixedMs;
+        }else{
+            smoothedMs += smoothing * (fullMs - smoothedMs);
+            smoothedFixedMs += smoothing * (fixedMs - smoothedFixedMs);
+        }
+        samples++;
+        scaleSum += scale;
+        minSeen = std::min(minSeen,scale);
+        maxSeen = std::max(maxSeen,scale);
+
+        //固定的部分已经超过目标时使用最小比例
+        double budget = std::max(target - smoothedFixedMs,0.0);
+        double wanted = std::sqrt(budget / std::max(smoothedMs,1e-6));
+        wanted = std::min(std::max(wanted,minimum),1.0);
+        double step = wanted - current;
+        if(std::fabs(step) < deadband){
+            return;
+        }
+        step = std::min(std::max(step,-maxStepDown),maxStepUp);
+        current = std::min(std::max(current + step,minimum),1.0);
+        changes++;
+    }
+    //比例对应的渲染区域大小,不小于 1 个像素
+    static uint32_t scaledSize(uint32_t size,double scale){
+        return std::max(1u,static_cast<uint32_t>(size * scale + 0.5));
+    }
+
+    double scale() const { return current; }
+    double targetMs() const { return target; }
+
+    void report(std::ostream& out) const {
+        if(samples == 0){
+            return;
+        }
+        out<<"dynamic resolution: target "<<target<<" ms, scale "
+           <<minSeen<<"-"<<maxSeen<<" (average "<<scaleSum / samples
+           <<"), "<<changes<<" changes, estimated full resolution gpu time "
+           <<smoothedMs + smoothedFixedMs<<" ms"<<std::endl;
+    }
+
+private:
+    const double smoothing = 0.1;
+    const double deadband = 0.02;
+    const double maxStepDown = 0.1;
+    const double maxStepUp = 0.02;
+
+    double target = 16.0;
+    double minimum = 0.5;
+    double current = 1.0;
+    double smoothedMs = 0.0;//全分辨率下场景渲染的时间
+    double smoothedFixedMs = 0.0;//不随比例变化的时间
+    std::deque<std::pair<uint64_t,double>> history;//帧序号和这一帧使用的比例
+
+    uint64_t samples = 0;
+    uint64_t changes = 0;
+    double scaleSum = 0.0;
+    double minSeen = 1.0;
+    double maxSeen = 0.0;
+};
+
+#endif // RESOLUTIONSCALER_H
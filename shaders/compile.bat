@@ -1,3 +1,10 @@
 D:/VulkanSDK/1.1.77.0/Bin32/glslangValidator.exe -V shader.vert
 D:/VulkanSDK/1.1.77.0/Bin32/glslangValidator.exe -V shader.frag
+D:/VulkanSDK/1.1.77.0/Bin32/glslangValidator.exe -V shader_bindless.frag -o frag_bindless.spv
+D:/VulkanSDK/1.1.77.0/Bin32/glslangValidator.exe -V shader_virtual.frag -o frag_virtual.spv
+D:/VulkanSDK/1.1.77.0/Bin32/glslangValidator.exe -V shader_mipgen.comp -o comp_mipgen.spv
+D:/VulkanSDK/1.1.77.0/Bin32/glslangValidator.exe -V -DFORMAT_RGBA16F shader_mipgen.comp -o comp_mipgen_rgba16f.spv
+D:/VulkanSDK/1.1.77.0/Bin32/glslangValidator.exe -V -DFORMAT_RGBA32F shader_mipgen.comp -o comp_mipgen_rgba32f.spv
+D:/VulkanSDK/1.1.77.0/Bin32/glslangValidator.exe -V shader_upscale.vert -o vert_upscale.spv
+D:/VulkanSDK/1.1.77.0/Bin32/glslangValidator.exe -V shader_upscale.frag -o frag_upscale.spv
 pause
\ No newline at end of file
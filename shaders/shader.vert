@@ -1,11 +1,13 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
+    mat4 viewProj;
 } ubo;
 
+layout(push_constant) uniform PushConstantObject {
+    mat4 model;
+} pc;
+
 layout(location = 0) in vec3 inPostion;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
@@ -18,7 +20,7 @@ out gl_PerVertex{
 };
 
 void main(){
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPostion,1.0);
+    gl_Position = ubo.viewProj * (pc.model * vec4(inPostion,1.0));
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+//无绑定纹理数组,所有材质的纹理都在这里
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+//模型矩阵占用前 64 个字节,材质索引紧随其后
+layout(push_constant) uniform PushConstantObject {
+    layout(offset = 64) uint materialIndex;
+} pc;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main(){
+    outColor = texture(textures[pc.materialIndex],fragTexCoord);
+}
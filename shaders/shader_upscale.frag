@@ -0,0 +1,18 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//内部渲染目标按最大大小分配,只有左上角 uvScale 的区域是这一帧渲染的内容
+layout(binding = 0) uniform sampler2D sceneSampler;
+
+layout(push_constant) uniform PushConstantObject {
+    vec2 uvScale;//渲染区域占整个图像的比例
+    vec2 uvMax;//渲染区域最后一个纹素的中心,双线性过滤不读取区域外的纹素
+} pc;
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main(){
+    outColor = texture(sceneSampler,min(fragTexCoord * pc.uvScale,pc.uvMax));
+}
@@ -0,0 +1,11 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//不使用顶点缓冲,由顶点序号生成覆盖整个屏幕的三角形
+layout(location = 0) out vec2 fragTexCoord;
+
+void main(){
+    vec2 p = vec2((gl_VertexIndex << 1) & 2,gl_VertexIndex & 2);
+    fragTexCoord = p;
+    gl_Position = vec4(p * 2.0 - 1.0,0.0,1.0);
+}
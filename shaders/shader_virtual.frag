@@ -0,0 +1,77 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//虚拟纹理的参数,创建管线时通过特化常量指定
+layout(constant_id = 0) const uint VIRTUAL_WIDTH = 128;//第 0 级的虚拟大小
+layout(constant_id = 1) const uint VIRTUAL_HEIGHT = 128;
+layout(constant_id = 2) const uint TILE_SIZE = 128;//页的大小,不包括边框
+layout(constant_id = 3) const uint TILE_BORDER = 1;
+layout(constant_id = 4) const uint LEVEL_COUNT = 1;
+layout(constant_id = 5) const float CACHE_SIZE = 130.0;//物理缓存的纹素数
+layout(constant_id = 6) const float UV_SCALE_X = 1.0;//源图像占虚拟大小的比例
+layout(constant_id = 7) const float UV_SCALE_Y = 1.0;
+
+//页表:每一级的每一页一个纹素,r,g 为物理缓存中的槽,b 为驻留的级别,a 为是否有效
+layout(set = 1, binding = 0) uniform usampler2D pageTable;
+//物理缓存:驻留的页,每一页带有边框
+layout(set = 1, binding = 1) uniform sampler2D physicalCache;
+//反馈:每一页一项,被采样的页写入 1,由 CPU 读回决定加载哪些页
+layout(set = 1, binding = 2) buffer Feedback {
+    uint requested[];
+} feedback;
+
+//模型矩阵和材质索引之后是帧序号
+layout(push_constant) uniform PushConstantObject {
+    layout(offset = 68) uint frameIndex;
+} pc;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+uvec2 levelSize(uint level){
+    return max(uvec2(VIRTUAL_WIDTH,VIRTUAL_HEIGHT) >> level,uvec2(1));
+}
+uvec2 levelPages(uint level){
+    return max(uvec2(VIRTUAL_WIDTH,VIRTUAL_HEIGHT) / TILE_SIZE >> level,uvec2(1));
+}
+//纹素坐标所在的页
+uvec2 pageOf(vec2 texel,uint level){
+    return min(uvec2(texel) / TILE_SIZE,levelPages(level) - 1);
+}
+
+void main(){
+    vec2 uv = clamp(fragTexCoord,0.0,1.0) * vec2(UV_SCALE_X,UV_SCALE_Y);
+    //按第 0 级纹素坐标的导数选择需要的级别
+    vec2 texel0 = uv * vec2(levelSize(0));
+    vec2 dx = dFdx(texel0);
+    vec2 dy = dFdy(texel0);
+    float lod = 0.5 * log2(max(max(dot(dx,dx),dot(dy,dy)),1e-8));
+    uint level = uint(clamp(floor(lod),0.0,float(LEVEL_COUNT - 1)));
+    uvec2 page = pageOf(uv * vec2(levelSize(level)),level);
+
+    //每个 4x4 像素块每帧只有一个像素写入反馈,16 帧覆盖所有像素
+    uvec2 pixel = uvec2(gl_FragCoord.xy) & 3u;
+    if(pixel.x + pixel.y * 4u == (pc.frameIndex & 15u)){
+        uint first = 0u;
+        for(uint i = 0u;i < level;i++){
+            uvec2 pages = levelPages(i);
+            first += pages.x * pages.y;
+        }
+        feedback.requested[first + page.y * levelPages(level).x + page.x] = 1u;
+    }
+
+    uvec4 entry = texelFetch(pageTable,ivec2(page),int(level));
+    if(entry.a == 0u){
+        outColor = vec4(0.5,0.5,0.5,1.0);//最粗糙的一级还没有加载
+        return;
+    }
+    //在驻留的级别中定位纹素,加上槽的位置和边框得到物理缓存中的坐标
+    uint resident = entry.b;
+    vec2 texel = uv * vec2(levelSize(resident));
+    vec2 inPage = texel - vec2(pageOf(texel,resident) * TILE_SIZE);
+    vec2 cacheTexel = vec2(entry.rg) * float(TILE_SIZE + 2u * TILE_BORDER) +
+            float(TILE_BORDER) + inPage;
+    outColor = textureLod(physicalCache,cacheTexel / CACHE_SIZE,0.0);
+}
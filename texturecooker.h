@@ -0,0 +1,263 @@
+#ifndef TEXTURECOOKER_H
+#define TEXTURECOOKER_H
+
+#include <vulkan/vulkan.h>
+#include <stb_image.h>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <cstdint>
+
+#include "imagekernels.h"
+#include "ktx2.h"
+#include "bcencoder.h"
+#include "tracer.h"
+#include "mappedfile.h"
+
+//纹理的一个细化级别,offset 为在 TextureData::bytes() 中的偏移
+struct TextureLevel{
+    uint32_t width;
+    uint32_t height;
+    size_t offset;
+    size_t size;
+};
+
+/**
+  解码后的纹理数据,与上传到 GPU 的操作分开。
+  解码的图像在 pixels 中依次存放所有细化级别的数据;
+  KTX2 文件不复制到 pixels,而是保留文件的映射,levels 中的偏移直接指向文件中的图像数据,
+  上传时从页缓存直接复制到暂存缓冲
+  */
+struct TextureData{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<TextureLevel> levels;
+    std::vector<unsigned char> pixels;
+    std::shared_ptr<MappedFile> file;//不为空时数据在映射的文件中
+
+    const unsigned char* bytes() const {
+        return file ? file->data() : pixels.data();
+    }
+    size_t byteCount() const {
+        return file ? file->size() : pixels.size();
+    }
+};
+
+//完整细化链的级别个数
+inline uint32_t fullMipCount(uint32_t width,uint32_t height){
+    return static_cast<uint32_t>(std::floor(std::log2(
+                                     std::max(width,height)))) + 1;
+}
+
+/**
+  在 CPU 上生成 RGBA8 图像的细化链。
+  颜色值是 sRGB 编码的,直接对编码值求平均会让缩小后的图像偏暗,
+  所以先转换到线性空间做 2x2 盒式滤波,再编码回 sRGB;alpha 通道直接线性平均。
+  奇数尺寸时最后一行或一列与前一行或一列合并,返回的第 0 级为原图。
+  每一级由 imageKernels().downsampleSrgb 计算,CPU 支持时使用 SIMD 实现
+  */
+inline std::vector<std::vector<unsigned char>> buildMipChain(
+        const unsigned char* rgba,uint32_t width,uint32_t height){
+    const ImageKernels& kernels = imageKernels();
+    std::vector<std::vector<unsigned char>> levels;
+    levels.emplace_back(rgba,rgba + size_t(width) * height * 4);
+    uint32_t srcWidth = width;
+    uint32_t srcHeight = height;
+    while(srcWidth > 1 || srcHeight > 1){
+        uint32_t dstWidth = std::max(1u,srcWidth / 2);
+        uint32_t dstHeight = std::max(1u,srcHeight / 2);
+        std::vector<unsigned char> dst(size_t(dstWidth) * dstHeight * 4);
+        kernels.downsampleSrgb(levels.back().data(),srcWidth,srcHeight,dst.data());
+        levels.push_back(std::move(dst));
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
+    }
+    return levels;
+}
+
+//把分开存放的各级数据合并到一个 TextureData 中
+inline TextureData makeTextureData(VkFormat format,uint32_t width,
+                                   uint32_t height,
+                          const std::vector<std::vector<unsigned char>>& levels){
+    TextureData texture;
+    texture.format = format;
+    texture.width = width;
+    texture.height = height;
+    size_t totalSize = 0;
+    for(const auto& level : levels){
+        totalSize += level.size();
+    }
+    texture.pixels.reserve(totalSize);
+    for(size_t i = 0;i < levels.size();i++){
+        TextureLevel level;
+        level.width = std::max(1u,width >> i);
+        level.height = std::max(1u,height >> i);
+        level.offset = texture.pixels.size();
+        level.size = levels[i].size();
+        texture.pixels.insert(texture.pixels.end(),
+                              levels[i].begin(),levels[i].end());
+        texture.levels.push_back(level);
+    }
+    return texture;
+}
+
+/**
+  解码内存中的 jpg/png 等图像文件内容为 RGBA8。
+  stb_image 按源图像的通道数解码,RGB 图像再由 SIMD 内核补上 alpha,
+  比让 stb_image 逐像素转换快
+  */
+inline std::vector<unsigned char> decodeRgba8(const unsigned char* data,size_t size,
+                                              uint32_t& width,uint32_t& height){
+    int texWidth,texHeight,texChannels;
+    stbi_uc* pixels = nullptr;
+    {
+        TRACE_SCOPE("stbi_load");
+        pixels = stbi_load_from_memory(data,static_cast<int>(size),
+                                       &texWidth,&texHeight,&texChannels,0);
+    }
+    if(!pixels){
+        throw std::runtime_error("failed to load texture image!");
+    }
+    width = static_cast<uint32_t>(texWidth);
+    height = static_cast<uint32_t>(texHeight);
+    std::vector<unsigned char> rgba(size_t(width) * height * 4);
+    expandToRgba(pixels,texChannels,rgba.data(),size_t(width) * height);
+    stbi_image_free(pixels);
+    return rgba;
+}
+
+/**
+  解码内存中的 jpg/png 等图像文件内容,buildMips 为 true 时在 CPU 上生成完整的细化链,
+  否则只有第 0 级,由 GPU 生成细化链
+  */
+inline TextureData decodeTexture(const unsigned char* data,size_t size,
+                                 bool buildMips){
+    TRACE_FUNCTION();
+    uint32_t width,height;
+    std::vector<unsigned char> pixels = decodeRgba8(data,size,width,height);
+    std::vector<std::vector<unsigned char>> levels;
+    if(buildMips){
+        levels = buildMipChain(pixels.data(),width,height);
+    }else{
+        levels.push_back(std::move(pixels));
+    }
+    return makeTextureData(VK_FORMAT_R8G8B8A8_UNORM,width,height,levels);
+}
+//从映射的文件解码,不经过 stdio 的缓冲
+inline TextureData decodeTexture(const std::string& filename,bool buildMips){
+    MappedFile file(filename);
+    return decodeTexture(file.data(),file.size(),buildMips);
+}
+
+//KTX2 文件中各级数据的位置,数据本身由调用方设置
+inline TextureData makeKtx2Texture(const Ktx2File& ktx){
+    TextureData texture;
+    texture.format = ktx.format;
+    texture.width = ktx.width;
+    texture.height = ktx.height;
+    for(size_t i = 0;i < ktx.levels.size();i++){
+        TextureLevel level;
+        level.width = std::max(1u,ktx.width >> i);
+        level.height = std::max(1u,ktx.height >> i);
+        level.offset = static_cast<size_t>(ktx.levels[i].byteOffset);
+        level.size = static_cast<size_t>(ktx.levels[i].byteLength);
+        texture.levels.push_back(level);
+    }
+    return texture;
+}
+//读取烘焙好的 KTX2 纹理,映射的文件内容直接作为上传数据
+inline TextureData loadKtx2Texture(const std::string& filename){
+    Ktx2File ktx = loadKtx2(filename);
+    TextureData texture = makeKtx2Texture(ktx);
+    texture.file = std::make_shared<MappedFile>(std::move(ktx.file));
+    return texture;
+}
+//内存中的 KTX2 文件内容(例如从资源包解压的数据)直接作为上传数据
+inline TextureData loadKtx2Texture(std::vector<unsigned char> bytes,
+                                   const std::string& name){
+    TextureData texture = makeKtx2Texture(parseKtx2(bytes.data(),bytes.size(),name));
+    texture.pixels = std::move(bytes);//移动不改变数据的地址
+    return texture;
+}
+
+//烘焙命令行中的格式名,不认识的名字抛出异常
+inline VkFormat parseCookFormat(const std::string& name){
+    if(name == "rgba8"){
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    }else if(name == "bc1"){
+        return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    }else if(name == "bc3"){
+        return VK_FORMAT_BC3_UNORM_BLOCK;
+    }else if(name == "bc7"){
+        return VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    throw std::runtime_error("unknown texture format: " + name +
+                             " (expected rgba8, bc1, bc3 or bc7)");
+}
+
+/**
+  离线烘焙纹理:解码一次源图像,生成高质量的细化链并写入 KTX2 文件,
+  运行时直接上传,不再需要解码 JPEG 和使用 vkCmdBlitImage 生成细化链。
+  format 为块压缩格式时在 CPU 上压缩每一级,并报告第 0 级的 PSNR 和编码吞吐量
+  */
+inline void cookTexture(const std::string& srcFilename,
+                        const std::string& dstFilename,
+                        VkFormat format = VK_FORMAT_R8G8B8A8_UNORM){
+    auto startTime = std::chrono::high_resolution_clock::now();
+    uint32_t width,height;
+    std::vector<std::vector<unsigned char>> levels;
+    {
+        MappedFile file(srcFilename);
+        std::vector<unsigned char> pixels =
+                decodeRgba8(file.data(),file.size(),width,height);
+        levels = buildMipChain(pixels.data(),width,height);
+    }
+
+    size_t uncompressedSize = 0;
+    for(const auto& level : levels){
+        uncompressedSize += level.size();
+    }
+    if(bc::isBlockCompressed(format)){
+        auto encodeStart = std::chrono::high_resolution_clock::now();
+        std::vector<std::vector<unsigned char>> blocks;
+        for(size_t i = 0;i < levels.size();i++){
+            blocks.push_back(bc::compressImage(format,levels[i].data(),
+                                               std::max(1u,width >> i),
+                                               std::max(1u,height >> i)));
+        }
+        auto encodeEnd = std::chrono::high_resolution_clock::now();
+        double encodeSeconds = std::chrono::duration<double>(
+                    encodeEnd - encodeStart).count();
+        std::vector<unsigned char> decoded =
+                bc::decompressImage(format,blocks[0].data(),width,height);
+        double psnr = bc::computePsnr(levels[0].data(),decoded.data(),
+                                      size_t(width) * height);
+        size_t compressedSize = 0;
+        for(const auto& level : blocks){
+            compressedSize += level.size();
+        }
+        std::cout<<"encoded "<<compressedSize<<" bytes ("
+                 <<double(uncompressedSize) / compressedSize<<"x smaller), PSNR "
+                 <<psnr<<" dB, "
+                 <<uncompressedSize / (1024.0 * 1024.0) / encodeSeconds
+                 <<" MB/s"<<std::endl;
+        levels = std::move(blocks);
+    }
+    //渲染时仍按 UNORM 采样,与直接加载源图像的结果保持一致
+    writeKtx2(dstFilename,format,width,height,levels);
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout<<"cooked "<<srcFilename<<" -> "<<dstFilename<<": "
+             <<width<<"x"<<height<<", "<<levels.size()<<" mip levels, "
+             <<std::chrono::duration<double,std::milli>(
+                   endTime - startTime).count()<<" ms"<<std::endl;
+}
+
+#endif // TEXTURECOOKER_H
@@ -0,0 +1,167 @@
+#ifndef TEXTURESTREAMING_H
+#define TEXTURESTREAMING_H
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+/**
+  按细化级别流式加载纹理的显存预算.
+  每个纹理驻留从 resident 级到最小一级的连续细化级别,开始时只驻留最小的几级,
+  所以纹理在加载后立即可以显示.调用方每一帧由物体在屏幕上的大小估计需要的级别(wanted),
+  nextChange 在全局预算内选出一个纹理,把它的驻留级别提高或降低一级:
+  1. 超出预算时,降低细节比需要多得最多的纹理,都不多时降低最大的纹理
+  2. 细节比需要多两级以上时降低一级,只多一级时保留,避免在两级之间来回切换
+  3. 需要更多细节的纹理中差距最大的提高一级,预算放不下时先降低其他细节多余的纹理
+  这里只决定驻留哪些级别,创建图像和复制数据由调用方完成后调用 commit
+  */
+class MipStreamingBudget{
+public:
+    struct Change{
+        uint32_t texture;
+        uint32_t level;//新的驻留级别
+    };
+
+    void setBudget(uint64_t bytes){ budgetBytes = bytes; }
+    uint64_t budget() const { return budgetBytes; }
+    //登记一个纹理,levelBytes 为从第 0 级开始每一级的字节数,返回纹理的编号
+    uint32_t add(const std::vector<uint64_t>& levelBytes,uint32_t initialLevel){
+        if(levelBytes.empty() || initialLevel >= levelBytes.size()){
+            throw std::runtime_error("invalid streamed texture levels");
+        }
+        Texture texture;
+        texture.levelBytes = levelBytes;
+        texture.resident = initialLevel;
+        texture.wanted = initialLevel;
+        textures.push_back(texture);
+        return static_cast<uint32_t>(textures.size() - 1);
+    }
+    //设置纹理这一帧需要的级别
+    void request(uint32_t texture,uint32_t level){
+        Texture& t = textures[texture];
+        t.wanted = std::min(level,t.lastLevel());
+    }
+    //选出下一个要改变驻留级别的纹理,没有需要改变的纹理时返回 false
+    bool nextChange(Change& change) const {
+        const uint64_t total = residentBytes();
+        int best = -1;
+        if(total > budgetBytes){
+            for(size_t i = 0;i < textures.size();i++){
+                const Texture& t = textures[i];
+                if(t.resident < t.lastLevel() &&
+                        (best < 0 || dropsBefore(t,textures[best]))){
+                    best = static_cast<int>(i);
+                }
+            }
+            return select(best,+1,change);
+        }
+        for(size_t i = 0;i < textures.size();i++){
+            const Texture& t = textures[i];
+            if(t.wanted >= t.resident + 2 &&
+                    (best < 0 || surplus(t) > surplus(textures[best]))){
+                best = static_cast<int>(i);
+            }
+        }
+        if(best >= 0){
+            return select(best,+1,change);
+        }
+        for(size_t i = 0;i < textures.size();i++){
+            const Texture& t = textures[i];
+            if(t.resident > t.wanted &&
+                    (best < 0 || deficit(t) > deficit(textures[best]))){
+                best = static_cast<int>(i);
+            }
+        }
+        if(best < 0){
+            return false;
+        }
+        const Texture& raise = textures[best];
+        if(total + raise.levelBytes[raise.resident - 1] <= budgetBytes){
+            return select(best,-1,change);
+        }
+        //放不下时从细节多余的纹理中腾出空间,下一次再提高
+        int donor = -1;
+        for(size_t i = 0;i < textures.size();i++){
+            const Texture& t = textures[i];
+            if(t.resident < t.wanted &&
+                    (donor < 0 || surplus(t) > surplus(textures[donor]))){
+                donor = static_cast<int>(i);
+            }
+        }
+        return select(donor,+1,change);
+    }
+    void commit(const Change& change){
+        Texture& t = textures[change.texture];
+        if(change.level < t.resident){
+            raised++;
+        }else if(change.level > t.resident){
+            dropped++;
+        }
+        t.resident = change.level;
+    }
+
+    uint32_t residentLevel(uint32_t texture) const {
+        return textures[texture].resident;
+    }
+    uint32_t wantedLevel(uint32_t texture) const {
+        return textures[texture].wanted;
+    }
+    //从 level 到最小一级的字节数
+    uint64_t bytesFrom(uint32_t texture,uint32_t level) const {
+        const Texture& t = textures[texture];
+        uint64_t bytes = 0;
+        for(size_t i = level;i < t.levelBytes.size();i++){
+            bytes += t.levelBytes[i];
+        }
+        return bytes;
+    }
+    uint64_t residentBytes() const {
+        uint64_t bytes = 0;
+        for(size_t i = 0;i < textures.size();i++){
+            bytes += bytesFrom(static_cast<uint32_t>(i),textures[i].resident);
+        }
+        return bytes;
+    }
+
+    uint64_t raised = 0;//提高驻留级别的次数
+    uint64_t dropped = 0;//降低驻留级别的次数
+
+private:
+    struct Texture{
+        std::vector<uint64_t> levelBytes;
+        uint32_t resident = 0;//驻留的最大一级
+        uint32_t wanted = 0;
+
+        uint32_t lastLevel() const {
+            return static_cast<uint32_t>(levelBytes.size() - 1);
+        }
+    };
+    static int64_t surplus(const Texture& t){
+        return int64_t(t.wanted) - int64_t(t.resident);
+    }
+    static int64_t deficit(const Texture& t){
+        return int64_t(t.resident) - int64_t(t.wanted);
+    }
+    //超出预算时先降低细节多余最多的纹理,相同时降低最大一级最大的纹理
+    static bool dropsBefore(const Texture& a,const Texture& b){
+        if(surplus(a) != surplus(b)){
+            return surplus(a) > surplus(b);
+        }
+        return a.levelBytes[a.resident] > b.levelBytes[b.resident];
+    }
+    bool select(int texture,int step,Change& change) const {
+        if(texture < 0){
+            return false;
+        }
+        change.texture = static_cast<uint32_t>(texture);
+        change.level = static_cast<uint32_t>(
+                    int64_t(textures[texture].resident) + step);
+        return true;
+    }
+
+    std::vector<Texture> textures;
+    uint64_t budgetBytes = 0;
+};
+
+#endif // TEXTURESTREAMING_H
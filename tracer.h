@@ -0,0 +1,142 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+
+/**
+  轻量的时间线事件记录器,输出 Chrome trace 格式(chrome://tracing 或 Perfetto 打开).
+  每个线程第一次记录事件时注册一个自己的缓冲(只有这一次加锁),
+  之后记录事件只是向本线程的缓冲追加一项,不加锁.
+  GPU 事件由主线程把时间戳换算到 CPU 时钟后加入,显示在单独的 GPU 轨道上.
+  写出文件时其他线程不能再记录事件(例如工作线程已经结束)。
+  没有启用时 TraceScope 只检查一个标志
+  */
+class Tracer{
+public:
+    struct Event{
+        const char* name;//必须一直有效,例如字符串常量或 __func__
+        const char* category;
+        int64_t startNs;
+        int64_t durationNs;
+        bool gpu;
+    };
+
+    static Tracer& instance(){
+        static Tracer tracer;
+        return tracer;
+    }
+    //在创建其他线程之前设置
+    void setEnabled(bool value){
+        enabledFlag = value;
+        if(value){
+            epochNs = nowNs();
+        }
+    }
+    bool enabled() const { return enabledFlag; }
+    //CPU 事件和换算后的 GPU 事件共用的时钟
+    static int64_t nowNs(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    void addEvent(const char* name,const char* category,
+                  int64_t startNs,int64_t durationNs,bool gpu = false){
+        threadBuffer().events.push_back(
+                    Event{name,category,startNs,durationNs,gpu});
+    }
+    //给当前线程命名,显示在轨道标题上
+    void setThreadName(const char* name){
+        threadBuffer().name = name;
+    }
+    void writeChromeTrace(const std::string& filename){
+        std::ofstream out(filename);
+        if(!out){
+            throw std::runtime_error("failed to open file: " + filename);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        out<<"{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        out<<"{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+           <<"\"args\": {\"name\": \"CPU\"}},\n";
+        out<<"{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 2, "
+           <<"\"args\": {\"name\": \"GPU\"}}";
+        for(const auto& buffer : buffers){
+            out<<",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+               <<"\"tid\": "<<buffer->tid<<", \"args\": {\"name\": \""
+               <<buffer->name<<"\"}}";
+            for(const Event& event : buffer->events){
+                //时间单位为微秒
+                out<<",\n{\"name\": \""<<event.name<<"\", \"cat\": \""
+                   <<event.category<<"\", \"ph\": \"X\", \"ts\": "
+                   <<(event.startNs - epochNs) / 1000.0<<", \"dur\": "
+                   <<event.durationNs / 1000.0<<", \"pid\": "
+                   <<(event.gpu ? 2 : 1)<<", \"tid\": "
+                   <<(event.gpu ? 0 : buffer->tid)<<"}";
+            }
+        }
+        out<<"\n]}\n";
+        if(!out){
+            throw std::runtime_error("failed to write file: " + filename);
+        }
+    }
+
+private:
+    struct ThreadBuffer{
+        uint32_t tid = 0;
+        std::string name;
+        std::vector<Event> events;
+    };
+    Tracer(){}
+    ThreadBuffer& threadBuffer(){
+        thread_local ThreadBuffer* buffer = nullptr;
+        if(buffer == nullptr){
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.emplace_back(new ThreadBuffer());
+            buffer = buffers.back().get();
+            buffer->tid = static_cast<uint32_t>(buffers.size());
+            buffer->name = "thread " + std::to_string(buffer->tid);
+            buffer->events.reserve(4096);
+        }
+        return *buffer;
+    }
+
+    bool enabledFlag = false;
+    int64_t epochNs = 0;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+//记录从构造到析构的一段时间
+class TraceScope{
+public:
+    explicit TraceScope(const char* name,const char* category = "cpu")
+        : name(name),category(category),
+          startNs(Tracer::instance().enabled() ? Tracer::nowNs() : 0){}
+    ~TraceScope(){
+        if(startNs != 0){
+            Tracer::instance().addEvent(name,category,startNs,
+                                        Tracer::nowNs() - startNs);
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    int64_t startNs;
+};
+
+#define TRACE_CONCAT_INNER(a,b) a##b
+#define TRACE_CONCAT(a,b) TRACE_CONCAT_INNER(a,b)
+//记录所在作用域的时间,name 必须一直有效
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope,__LINE__)(name)
+//记录所在函数的时间
+#define TRACE_FUNCTION() TRACE_SCOPE(__func__)
+
+#endif // TRACER_H
@@ -0,0 +1,340 @@
+#ifndef VIRTUALTEXTURE_H
+#define VIRTUALTEXTURE_H
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+
+#include "assetarchive.h"
+#include "mappedfile.h"
+
+/**
+  虚拟纹理的分页文件,用于比显存大得多的纹理.
+  纹理的每一个细化级别切分为 tileSize x tileSize 的页,每一页四周各多存 border 个纹素
+  (取自相邻的页),这样在物理缓存中双线性过滤不会采样到其他页.
+  第 0 级的页数在两个方向上都向上取整到 2 的幂,之后每一级减半直到只有一页,
+  页表图像的细化链与页的层级一一对应;超出源图像的部分重复边缘的纹素.
+  文件结构(所有整数为小端序):
+  1. 文件头:魔数 "VTEX",版本,源图像宽高,虚拟纹理宽高(第 0 级页数乘以页大小),
+     页大小,边框宽度,级别数
+  2. 页表:按级别从第 0 级开始,每一级按行排列,每一页为偏移和存放的大小,
+     大小的最高位为 1 表示这一页没有压缩
+  3. 页数据:每一页为 RGBA8 像素,单独用 LZ4 压缩
+  */
+static const char VIRTUAL_TEXTURE_MAGIC[4] = {'V','T','E','X'};
+const uint32_t VIRTUAL_TEXTURE_VERSION = 1;
+
+namespace vtex {
+
+const uint32_t STORED_TILE = 0x80000000u;//页没有压缩
+const uint32_t HEADER_SIZE = 4 * 9;
+const uint32_t TABLE_ENTRY_SIZE = 12;
+const uint32_t NO_SLOT = 0xffffffffu;
+
+inline uint32_t get32(const unsigned char* p){
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) |
+            (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+inline uint64_t get64(const unsigned char* p){
+    return uint64_t(get32(p)) | (uint64_t(get32(p + 4)) << 32);
+}
+inline uint32_t nextPowerOfTwo(uint32_t v){
+    uint32_t p = 1;
+    while(p < v){
+        p <<= 1;
+    }
+    return p;
+}
+
+} // namespace vtex
+
+/**
+  虚拟纹理的页的划分,烘焙,读取,缓存管理和着色器使用同样的计算.
+  所有级别的页按级别和行依次编号,这个编号同时是文件中页表,
+  反馈缓冲和 CPU 端页表中的下标
+  */
+struct VirtualTextureLayout{
+    uint32_t width = 0;//源图像大小
+    uint32_t height = 0;
+    uint32_t virtualWidth = 0;//第 0 级的页数乘以页大小
+    uint32_t virtualHeight = 0;
+    uint32_t tileSize = 0;
+    uint32_t border = 0;
+    uint32_t levelCount = 0;
+    std::vector<uint32_t> firstPage;//每一级第一页的编号,最后一项为总页数
+
+    static VirtualTextureLayout create(uint32_t width,uint32_t height,
+                                       uint32_t tileSize,uint32_t border){
+        if(width == 0 || height == 0 || tileSize == 0 || border >= tileSize){
+            throw std::runtime_error("invalid virtual texture layout");
+        }
+        VirtualTextureLayout layout;
+        layout.width = width;
+        layout.height = height;
+        layout.tileSize = tileSize;
+        layout.border = border;
+        uint32_t pagesX = vtex::nextPowerOfTwo((width + tileSize - 1) / tileSize);
+        uint32_t pagesY = vtex::nextPowerOfTwo((height + tileSize - 1) / tileSize);
+        layout.virtualWidth = pagesX * tileSize;
+        layout.virtualHeight = pagesY * tileSize;
+        layout.levelCount = 1;
+        while((std::max(pagesX,pagesY) >> (layout.levelCount - 1)) > 1){
+            layout.levelCount++;
+        }
+        layout.computePages();
+        return layout;
+    }
+    void computePages(){
+        firstPage.assign(levelCount + 1,0);
+        for(uint32_t level = 0;level < levelCount;level++){
+            firstPage[level + 1] = firstPage[level] + pagesX(level) * pagesY(level);
+        }
+    }
+
+    uint32_t pagesX(uint32_t level) const {
+        return std::max(virtualWidth / tileSize >> level,1u);
+    }
+    uint32_t pagesY(uint32_t level) const {
+        return std::max(virtualHeight / tileSize >> level,1u);
+    }
+    //一级的虚拟大小,最粗糙的几级可能小于一页
+    uint32_t levelWidth(uint32_t level) const {
+        return std::max(virtualWidth >> level,1u);
+    }
+    uint32_t levelHeight(uint32_t level) const {
+        return std::max(virtualHeight >> level,1u);
+    }
+    uint32_t pageCount() const { return firstPage.back(); }
+    uint32_t pageIndex(uint32_t level,uint32_t x,uint32_t y) const {
+        return firstPage[level] + y * pagesX(level) + x;
+    }
+    uint32_t pageLevel(uint32_t page) const {
+        return static_cast<uint32_t>(std::upper_bound(firstPage.begin(),
+                                                      firstPage.end(),page) -
+                                     firstPage.begin()) - 1;
+    }
+    //包括边框的页大小和一页 RGBA8 像素的字节数
+    uint32_t tileExtent() const { return tileSize + 2 * border; }
+    size_t tileBytes() const { return size_t(tileExtent()) * tileExtent() * 4; }
+};
+
+/**
+  读取虚拟纹理的分页文件.打开时映射整个文件并解析页表,
+  readTile 解压一页到调用方提供的内存(例如映射的暂存缓冲).
+  readTile 只读取映射,可以在多个线程中同时调用
+  */
+class VirtualTextureFile{
+public:
+    void open(const std::string& filename){
+        file.open(filename);
+        open(file.data(),file.size(),filename);
+    }
+    //使用内存中的文件内容(例如资源包中不压缩存放的数据),使用期间 data 需要一直有效
+    void open(const unsigned char* data,size_t size,const std::string& filename){
+        using namespace vtex;
+        base = data;
+        if(size < HEADER_SIZE || std::memcmp(data,VIRTUAL_TEXTURE_MAGIC,4) != 0 ||
+                get32(data + 4) != VIRTUAL_TEXTURE_VERSION){
+            throw std::runtime_error("not a virtual texture file: " + filename);
+        }
+        layout = VirtualTextureLayout::create(get32(data + 8),get32(data + 12),
+                                              get32(data + 24),get32(data + 28));
+        if(layout.virtualWidth != get32(data + 16) ||
+                layout.virtualHeight != get32(data + 20) ||
+                layout.levelCount != get32(data + 32)){
+            throw std::runtime_error("invalid virtual texture header: " + filename);
+        }
+        uint32_t pageCount = layout.pageCount();
+        if((size - HEADER_SIZE) / TABLE_ENTRY_SIZE < pageCount){
+            throw std::runtime_error("truncated virtual texture file: " + filename);
+        }
+        offsets.resize(pageCount);
+        packedSizes.resize(pageCount);
+        const unsigned char* p = data + HEADER_SIZE;
+        for(uint32_t i = 0;i < pageCount;i++){
+            offsets[i] = get64(p);
+            packedSizes[i] = get32(p + 8);
+            p += TABLE_ENTRY_SIZE;
+            uint32_t stored = packedSizes[i] & ~STORED_TILE;
+            if(offsets[i] > size || stored > size - offsets[i]){
+                throw std::runtime_error("truncated virtual texture file: " + filename);
+            }
+        }
+    }
+    bool isOpen() const { return base != nullptr; }
+    void close(){
+        file.close();
+        base = nullptr;
+    }
+    //把一页的像素写入 dst(layout.tileBytes() 字节),数据损坏时返回 false
+    bool readTile(uint32_t page,unsigned char* dst) const {
+        const unsigned char* src = base + offsets[page];
+        uint32_t stored = packedSizes[page] & ~vtex::STORED_TILE;
+        if(packedSizes[page] & vtex::STORED_TILE){
+            if(stored != layout.tileBytes()){
+                return false;
+            }
+            std::memcpy(dst,src,stored);
+            return true;
+        }
+        return lz4::decompress(src,stored,dst,layout.tileBytes());
+    }
+
+    VirtualTextureLayout layout;
+
+private:
+    MappedFile file;//从文件打开时的映射
+    const unsigned char* base = nullptr;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> packedSizes;
+};
+
+/**
+  虚拟纹理的物理缓存和页表(只有 CPU 端的管理,不涉及 Vulkan 对象).
+  物理缓存是 slotsPerSide x slotsPerSide 个槽的纹理,每个槽放一页,
+  占用的显存与虚拟纹理的大小无关.缓存满时淘汰最久没有被请求的页,
+  最粗糙一级的页不会被淘汰,保证任何位置都有可以显示的数据.
+  页表每一页一项(RGBA8):所在的槽的坐标,实际驻留的级别,是否有效.
+  没有驻留的页使用最近的驻留的上级页,所以细节在页加载后逐渐出现
+  */
+class VirtualTextureCache{
+public:
+    void init(const VirtualTextureLayout& layout,uint32_t slotsPerSide){
+        if(slotsPerSide == 0 || slotsPerSide > 255){
+            throw std::runtime_error("virtual texture cache must have 1-255 slots per side");
+        }
+        this->layout = layout;
+        this->slotsPerSide = slotsPerSide;
+        uint32_t slotCount = slotsPerSide * slotsPerSide;
+        if(slotCount < layout.pageCount() - layout.firstPage[layout.levelCount - 1] + 1){
+            throw std::runtime_error("virtual texture cache is too small");
+        }
+        slotPages.assign(slotCount,vtex::NO_SLOT);
+        slotLastUsed.assign(slotCount,0);
+        freeSlots.clear();
+        for(uint32_t slot = slotCount;slot-- > 0;){
+            freeSlots.push_back(slot);
+        }
+        pageSlots.assign(layout.pageCount(),vtex::NO_SLOT);
+        pageQueued.assign(layout.pageCount(),~uint64_t(0));
+        entries.assign(layout.pageCount(),0);
+        dirty = true;
+        evictions = 0;
+    }
+    /**
+    处理一帧的反馈:requested 每一页一项,非 0 表示这一页被采样.
+    被请求的页和它的各级上级页都更新使用时间,没有驻留的页按从粗糙到精细的顺序返回,
+    最多 maxLoads 页,剩下的等以后的帧再请求
+      */
+    std::vector<uint32_t> collectRequests(const uint32_t* requested,uint64_t frame,
+                                          size_t maxLoads){
+        std::vector<uint32_t> missing;
+        for(uint32_t page = 0;page < layout.pageCount();page++){
+            if(requested[page] == 0){
+                continue;
+            }
+            uint32_t level = layout.pageLevel(page);
+            uint32_t x = (page - layout.firstPage[level]) % layout.pagesX(level);
+            uint32_t y = (page - layout.firstPage[level]) / layout.pagesX(level);
+            for(;level < layout.levelCount;level++,x >>= 1,y >>= 1){
+                uint32_t ancestor = layout.pageIndex(level,x,y);
+                if(pageSlots[ancestor] != vtex::NO_SLOT){
+                    slotLastUsed[pageSlots[ancestor]] = frame;
+                }else if(pageQueued[ancestor] != frame){
+                    pageQueued[ancestor] = frame;
+                    missing.push_back(ancestor);
+                }
+            }
+        }
+        //编号大的页级别更粗糙
+        std::sort(missing.begin(),missing.end(),std::greater<uint32_t>());
+        if(missing.size() > maxLoads){
+            missing.resize(maxLoads);
+        }
+        return missing;
+    }
+    /**
+    为一页分配一个槽,没有空闲的槽时淘汰最久没有使用的页.
+    这一帧请求过的页不会被淘汰,都在使用时返回 NO_SLOT
+      */
+    uint32_t allocate(uint32_t page,uint64_t frame){
+        uint32_t slot = vtex::NO_SLOT;
+        if(!freeSlots.empty()){
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }else{
+            uint32_t coarsest = layout.firstPage[layout.levelCount - 1];
+            uint64_t oldest = frame;
+            for(uint32_t i = 0;i < slotPages.size();i++){
+                if(slotPages[i] < coarsest && slotLastUsed[i] < oldest){
+                    oldest = slotLastUsed[i];
+                    slot = i;
+                }
+            }
+            if(slot == vtex::NO_SLOT){
+                return slot;
+            }
+            pageSlots[slotPages[slot]] = vtex::NO_SLOT;
+            evictions++;
+        }
+        slotPages[slot] = page;
+        slotLastUsed[slot] = frame;
+        pageSlots[page] = slot;
+        dirty = true;
+        return slot;
+    }
+    //槽在物理缓存中的位置(以槽为单位)
+    uint32_t slotX(uint32_t slot) const { return slot % slotsPerSide; }
+    uint32_t slotY(uint32_t slot) const { return slot / slotsPerSide; }
+
+    /**
+    重新计算页表,从最粗糙的一级开始,没有驻留的页继承上一级的项.
+    返回的数据与页的编号顺序相同,每一级可以直接复制到页表图像对应的细化级别
+      */
+    const std::vector<uint32_t>& pageTable(){
+        if(!dirty){
+            return entries;
+        }
+        for(uint32_t level = layout.levelCount;level-- > 0;){
+            for(uint32_t y = 0;y < layout.pagesY(level);y++){
+                for(uint32_t x = 0;x < layout.pagesX(level);x++){
+                    uint32_t page = layout.pageIndex(level,x,y);
+                    uint32_t slot = pageSlots[page];
+                    if(slot != vtex::NO_SLOT){
+                        entries[page] = slotX(slot) | (slotY(slot) << 8) |
+                                (level << 16) | 0xff000000u;
+                    }else if(level + 1 < layout.levelCount){
+                        entries[page] = entries[layout.pageIndex(level + 1,x >> 1,y >> 1)];
+                    }else{
+                        entries[page] = 0;
+                    }
+                }
+            }
+        }
+        dirty = false;
+        return entries;
+    }
+    bool pageTableDirty() const { return dirty; }
+    size_t residentPages() const {
+        return slotPages.size() - freeSlots.size();
+    }
+    uint64_t evictedPages() const { return evictions; }
+
+private:
+    VirtualTextureLayout layout;
+    uint32_t slotsPerSide = 0;
+    std::vector<uint32_t> slotPages;//每个槽中的页
+    std::vector<uint64_t> slotLastUsed;//每个槽的页最后一次被请求的帧
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> pageSlots;//每一页所在的槽
+    std::vector<uint64_t> pageQueued;//每一页最后一次被加入请求列表的帧
+    std::vector<uint32_t> entries;
+    bool dirty = true;
+    uint64_t evictions = 0;
+};
+
+#endif // VIRTUALTEXTURE_H
@@ -0,0 +1,161 @@
+#ifndef VIRTUALTEXTURECOOKER_H
+#define VIRTUALTEXTURECOOKER_H
+
+#include <stb_image.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "virtualtexture.h"
+
+namespace vtexcook {
+
+inline void put32(std::ostream& out,uint32_t v){
+    unsigned char bytes[4];
+    for(int i = 0;i < 4;i++){
+        bytes[i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+    out.write(reinterpret_cast<const char*>(bytes),4);
+}
+inline void put64(std::ostream& out,uint64_t v){
+    put32(out,static_cast<uint32_t>(v));
+    put32(out,static_cast<uint32_t>(v >> 32));
+}
+
+//把一级缩小一半,奇数大小时边缘的纹素重复使用
+inline std::vector<unsigned char> halve(const std::vector<unsigned char>& src,
+                                        uint32_t width,uint32_t height){
+    uint32_t w = std::max(1u,(width + 1) / 2);
+    uint32_t h = std::max(1u,(height + 1) / 2);
+    std::vector<unsigned char> dst(size_t(w) * h * 4);
+    for(uint32_t y = 0;y < h;y++){
+        uint32_t y0 = std::min(2 * y,height - 1);
+        uint32_t y1 = std::min(2 * y + 1,height - 1);
+        for(uint32_t x = 0;x < w;x++){
+            uint32_t x0 = std::min(2 * x,width - 1);
+            uint32_t x1 = std::min(2 * x + 1,width - 1);
+            for(int c = 0;c < 4;c++){
+                unsigned sum = src[(size_t(y0) * width + x0) * 4 + c] +
+                        src[(size_t(y0) * width + x1) * 4 + c] +
+                        src[(size_t(y1) * width + x0) * 4 + c] +
+                        src[(size_t(y1) * width + x1) * 4 + c];
+                dst[(size_t(y) * w + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+} // namespace vtexcook
+
+/**
+  离线把图像切分为虚拟纹理的分页文件.
+  逐级生成细化链,每一级切分为带边框的页,超出图像的纹素取最近的边缘纹素,
+  每一页单独用 LZ4 压缩.烘焙时整张源图像和当前一级在内存中;
+  运行时只有被采样的页被读取和上传,显存占用由物理缓存的大小决定
+  */
+inline void cookVirtualTexture(const std::string& srcFilename,
+                               const std::string& dstFilename,
+                               uint32_t tileSize = 128,uint32_t border = 1){
+    using namespace vtexcook;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    int texWidth,texHeight,texChannels;
+    stbi_uc* pixels = stbi_load(srcFilename.c_str(),&texWidth,&texHeight,
+                                &texChannels,STBI_rgb_alpha);
+    if(!pixels){
+        throw std::runtime_error("failed to load texture image: " + srcFilename);
+    }
+    VirtualTextureLayout layout = VirtualTextureLayout::create(
+                static_cast<uint32_t>(texWidth),static_cast<uint32_t>(texHeight),
+                tileSize,border);
+    std::vector<unsigned char> level(pixels,pixels + size_t(texWidth) * texHeight * 4);
+    stbi_image_free(pixels);
+
+    std::ofstream out(dstFilename,std::ios::binary);
+    if(!out){
+        throw std::runtime_error("failed to open file: " + dstFilename);
+    }
+    std::vector<char> placeholder(vtex::HEADER_SIZE +
+                                  size_t(layout.pageCount()) * vtex::TABLE_ENTRY_SIZE);
+    out.write(placeholder.data(),placeholder.size());
+    std::vector<uint64_t> offsets(layout.pageCount());
+    std::vector<uint32_t> packedSizes(layout.pageCount());
+
+    const uint32_t extent = layout.tileExtent();
+    std::vector<unsigned char> tile(layout.tileBytes());
+    std::vector<unsigned char> packed;
+    uint64_t storedBytes = 0;
+    //当前一级中有数据的部分,之外的纹素取最近的边缘纹素
+    uint32_t dataWidth = layout.width;
+    uint32_t dataHeight = layout.height;
+    for(uint32_t lod = 0;lod < layout.levelCount;lod++){
+        for(uint32_t py = 0;py < layout.pagesY(lod);py++){
+            for(uint32_t px = 0;px < layout.pagesX(lod);px++){
+                for(uint32_t y = 0;y < extent;y++){
+                    int64_t sy = int64_t(py) * tileSize + y - border;
+                    sy = std::min<int64_t>(std::max<int64_t>(sy,0),dataHeight - 1);
+                    for(uint32_t x = 0;x < extent;x++){
+                        int64_t sx = int64_t(px) * tileSize + x - border;
+                        sx = std::min<int64_t>(std::max<int64_t>(sx,0),dataWidth - 1);
+                        std::memcpy(&tile[(size_t(y) * extent + x) * 4],
+                                &level[(size_t(sy) * dataWidth + size_t(sx)) * 4],4);
+                    }
+                }
+                uint32_t page = layout.pageIndex(lod,px,py);
+                offsets[page] = static_cast<uint64_t>(out.tellp());
+                packed.clear();
+                lz4::compress(tile.data(),tile.size(),packed);
+                if(packed.size() < tile.size()){
+                    packedSizes[page] = static_cast<uint32_t>(packed.size());
+                    out.write(reinterpret_cast<const char*>(packed.data()),packed.size());
+                }else{
+                    packedSizes[page] = static_cast<uint32_t>(tile.size()) |
+                            vtex::STORED_TILE;
+                    out.write(reinterpret_cast<const char*>(tile.data()),tile.size());
+                }
+                storedBytes += packedSizes[page] & ~vtex::STORED_TILE;
+            }
+        }
+        if(lod + 1 < layout.levelCount){
+            level = halve(level,dataWidth,dataHeight);
+            dataWidth = std::max(1u,(dataWidth + 1) / 2);
+            dataHeight = std::max(1u,(dataHeight + 1) / 2);
+        }
+    }
+
+    out.seekp(0);
+    out.write(VIRTUAL_TEXTURE_MAGIC,4);
+    put32(out,VIRTUAL_TEXTURE_VERSION);
+    put32(out,layout.width);
+    put32(out,layout.height);
+    put32(out,layout.virtualWidth);
+    put32(out,layout.virtualHeight);
+    put32(out,layout.tileSize);
+    put32(out,layout.border);
+    put32(out,layout.levelCount);
+    for(uint32_t page = 0;page < layout.pageCount();page++){
+        put64(out,offsets[page]);
+        put32(out,packedSizes[page]);
+    }
+    out.close();
+    if(!out){
+        throw std::runtime_error("failed to write file: " + dstFilename);
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    uint64_t rawBytes = uint64_t(layout.pageCount()) * layout.tileBytes();
+    std::cout<<"cooked "<<srcFilename<<" -> "<<dstFilename<<": "
+             <<layout.width<<"x"<<layout.height<<", "<<layout.levelCount<<" levels, "
+             <<layout.pageCount()<<" pages of "<<tileSize<<"+"<<2 * border<<" texels, "
+             <<rawBytes / (1024.0 * 1024.0)<<" -> "<<storedBytes / (1024.0 * 1024.0)
+             <<" MB, "<<std::chrono::duration<double,std::milli>(
+                   endTime - startTime).count()<<" ms"<<std::endl;
+}
+
+#endif // VIRTUALTEXTURECOOKER_H
@@ -0,0 +1,98 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+/**
+  固定线程数的工作线程池
+  任务按提交顺序被空闲的线程取出执行.队列有容量上限,队列满时 submit 会阻塞,
+  这样任务处理得比提交慢时提交方会被拖慢,而不是无限制地积压任务占用内存.
+  提交的任务中抛出的异常会被丢弃,任务需要自己处理错误
+  */
+class WorkerPool{
+public:
+    //threadCount 为 0 时使用硬件线程数
+    explicit WorkerPool(unsigned threadCount = 0,size_t queueCapacity = 16)
+        : capacity(std::max<size_t>(queueCapacity,1)){
+        if(threadCount == 0){
+            threadCount = std::max(1u,std::thread::hardware_concurrency());
+        }
+        for(unsigned i = 0;i < threadCount;i++){
+            threads.emplace_back([this](){ workerLoop(); });
+        }
+    }
+    ~WorkerPool(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskAvailable.notify_all();
+        for(auto& thread : threads){
+            thread.join();
+        }
+    }
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    //提交一个任务,队列已满时等待
+    void submit(std::function<void()> task){
+        std::unique_lock<std::mutex> lock(mutex);
+        spaceAvailable.wait(lock,[this](){ return tasks.size() < capacity; });
+        tasks.push_back(std::move(task));
+        lock.unlock();
+        taskAvailable.notify_one();
+    }
+    //等待所有已提交的任务执行完毕
+    void wait(){
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock,[this](){ return tasks.empty() && running == 0; });
+    }
+    size_t threadCount() const { return threads.size(); }
+
+private:
+    void workerLoop(){
+        for(;;){
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                taskAvailable.wait(lock,[this](){
+                    return stopping || !tasks.empty();
+                });
+                if(tasks.empty()){
+                    return;//stopping 且没有剩余任务
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+                running++;
+            }
+            spaceAvailable.notify_one();
+            try{
+                task();
+            }catch(...){
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running--;
+            }
+            idle.notify_all();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    size_t capacity;
+    size_t running = 0;//正在执行的任务数
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable spaceAvailable;
+    std::condition_variable idle;
+};
+
+#endif // WORKERPOOL_H